@@ -16,6 +16,7 @@ file(
   include/solarus/entities/CameraPtr.h
   include/solarus/entities/CarriedObject.h
   include/solarus/entities/Chest.h
+  include/solarus/entities/CollisionBroadPhase.h
   include/solarus/entities/CollisionMode.h
   include/solarus/entities/CrystalBlock.h
   include/solarus/entities/Crystal.h
@@ -29,6 +30,7 @@ file(
   include/solarus/entities/EnemyReaction.h
   include/solarus/entities/Entities.h
   include/solarus/entities/Entity.h
+  include/solarus/entities/EntityPool.h
   include/solarus/entities/EntityPtr.h
   include/solarus/entities/EntityState.h
   include/solarus/entities/EntityType.h
@@ -36,6 +38,7 @@ file(
   include/solarus/entities/Explosion.h
   include/solarus/entities/Fire.h
   include/solarus/entities/Ground.h
+  include/solarus/entities/GroundGrid.h
   include/solarus/entities/GroundInfo.h
   include/solarus/entities/Hero.h
   include/solarus/entities/HeroPtr.h
@@ -101,7 +104,9 @@ file(
   include/solarus/lowlevel/BlendMode.h
   include/solarus/lowlevel/BlendModeInfo.h
   include/solarus/lowlevel/Color.h
+  include/solarus/lowlevel/DamageTracker.h
   include/solarus/lowlevel/Debug.h
+  include/solarus/lowlevel/DrawArena.h
   include/solarus/lowlevel/FontResource.h
   include/solarus/lowlevel/Geometry.h
   include/solarus/lowlevel/Hq2xFilter.h
@@ -116,9 +121,11 @@ file(
   include/solarus/lowlevel/PixelFilter.h
   include/solarus/lowlevel/Point.h
   include/solarus/lowlevel/Point.inl
+  include/solarus/lowlevel/Profiler.h
   include/solarus/lowlevel/QuestFiles.h
   include/solarus/lowlevel/Random.h
   include/solarus/lowlevel/Rectangle.h
+  include/solarus/lowlevel/RenderQueue.h
   include/solarus/lowlevel/Scale2xFilter.h
   include/solarus/lowlevel/shaders/GL_2DShader.h
   include/solarus/lowlevel/shaders/GL_ARBShader.h
@@ -130,13 +137,17 @@ file(
   include/solarus/lowlevel/Sound.h
   include/solarus/lowlevel/SpcDecoder.h
   include/solarus/lowlevel/String.h
+  include/solarus/lowlevel/StringInterner.h
   include/solarus/lowlevel/Surface.h
   include/solarus/lowlevel/SurfacePtr.h
   include/solarus/lowlevel/System.h
   include/solarus/lowlevel/TextSurface.h
+  include/solarus/lowlevel/TextureAtlas.h
   include/solarus/lowlevel/Video.h
   include/solarus/lowlevel/VideoMode.h
+  include/solarus/lowlevel/WorkerPool.h
 
+  include/solarus/lua/BinaryData.h
   include/solarus/lua/ExportableToLua.h
   include/solarus/lua/ExportableToLuaPtr.h
   include/solarus/lua/LuaContext.h
@@ -152,6 +163,8 @@ file(
   include/solarus/movements/JumpMovement.h
   include/solarus/movements/Movement.h
   include/solarus/movements/PathFinding.h
+  include/solarus/movements/PathFindingClusters.h
+  include/solarus/movements/PathFindingGrid.h
   include/solarus/movements/PathFindingMovement.h
   include/solarus/movements/PathMovement.h
   include/solarus/movements/PixelMovement.h
@@ -201,10 +214,12 @@ file(
   include/solarus/MapData.h
   include/solarus/QuestProperties.h
   include/solarus/QuestResources.h
+  include/solarus/ResourceCache.h
   include/solarus/ResourceProvider.h
   include/solarus/ResourceType.h
   include/solarus/SavegameConverterV1.h
   include/solarus/Savegame.h
+  include/solarus/SavegameWriter.h
   include/solarus/Settings.h
   include/solarus/SolarusFatal.h
   include/solarus/SpriteAnimationDirection.h
@@ -230,6 +245,7 @@ file(
   src/entities/Camera.cpp
   src/entities/CarriedObject.cpp
   src/entities/Chest.cpp
+  src/entities/CollisionBroadPhase.cpp
   src/entities/CrystalBlock.cpp
   src/entities/Crystal.cpp
   src/entities/CustomEntity.cpp
@@ -241,10 +257,12 @@ file(
   src/entities/EnemyReaction.cpp
   src/entities/Entities.cpp
   src/entities/Entity.cpp
+  src/entities/EntityPool.cpp
   src/entities/EntityState.cpp
   src/entities/EntityTypeInfo.cpp
   src/entities/Explosion.cpp
   src/entities/Fire.cpp
+  src/entities/GroundGrid.cpp
   src/entities/GroundInfo.cpp
   src/entities/Hero.cpp
   src/entities/Hookshot.cpp
@@ -303,7 +321,9 @@ file(
 
   src/lowlevel/BlendModeInfo.cpp
   src/lowlevel/Color.cpp
+  src/lowlevel/DamageTracker.cpp
   src/lowlevel/Debug.cpp
+  src/lowlevel/DrawArena.cpp
   src/lowlevel/FontResource.cpp
   src/lowlevel/Geometry.cpp
   src/lowlevel/Hq2xFilter.cpp
@@ -317,9 +337,11 @@ file(
   src/lowlevel/PixelBits.cpp
   src/lowlevel/PixelFilter.cpp
   src/lowlevel/Point.cpp
+  src/lowlevel/Profiler.cpp
   src/lowlevel/QuestFiles.cpp
   src/lowlevel/Random.cpp
   src/lowlevel/Rectangle.cpp
+  src/lowlevel/RenderQueue.cpp
   src/lowlevel/Scale2xFilter.cpp
   src/lowlevel/shaders/GL_2DShader.cpp
   src/lowlevel/shaders/GL_ARBShader.cpp
@@ -330,13 +352,17 @@ file(
   src/lowlevel/Sound.cpp
   src/lowlevel/SpcDecoder.cpp
   src/lowlevel/String.cpp
+  src/lowlevel/StringInterner.cpp
   src/lowlevel/Surface.cpp
   src/lowlevel/System.cpp
   src/lowlevel/TextSurface.cpp
+  src/lowlevel/TextureAtlas.cpp
   src/lowlevel/Video.cpp
   src/lowlevel/VideoMode.cpp
+  src/lowlevel/WorkerPool.cpp
 
   src/lua/AudioApi.cpp
+  src/lua/BinaryData.cpp
   src/lua/DrawableApi.cpp
   src/lua/EntityApi.cpp
   src/lua/ExportableToLua.cpp
@@ -365,6 +391,8 @@ file(
   src/movements/JumpMovement.cpp
   src/movements/Movement.cpp
   src/movements/PathFinding.cpp
+  src/movements/PathFindingClusters.cpp
+  src/movements/PathFindingGrid.cpp
   src/movements/PathFindingMovement.cpp
   src/movements/PathMovement.cpp
   src/movements/PixelMovement.cpp
@@ -394,9 +422,11 @@ file(
   src/MapData.cpp
   src/QuestProperties.cpp
   src/QuestResources.cpp
+  src/ResourceCache.cpp
   src/ResourceProvider.cpp
   src/SavegameConverterV1.cpp
   src/Savegame.cpp
+  src/SavegameWriter.cpp
   src/Settings.cpp
   src/SolarusFatal.cpp
   src/SpriteAnimation.cpp
@@ -122,6 +122,8 @@ class SOLARUS_API EntityData : public LuaData {
 
     bool import_from_lua(lua_State* l) override;
     bool export_to_lua(std::ostream& out) const override;
+    bool import_from_binary(BinaryDataReader& reader) override;
+    bool export_to_binary(BinaryDataWriter& writer) const override;
 
     static EntityData check_entity_data(lua_State* l, int index, EntityType type);
     static const std::map<EntityType, const EntityTypeDescription> get_entity_type_descriptions();
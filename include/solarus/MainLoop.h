@@ -23,6 +23,7 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -61,6 +62,7 @@ class SOLARUS_API MainLoop {
 
   private:
 
+    void run_headless();
     void check_input();
     void notify_input(const InputEvent& event);
     void draw();
@@ -82,6 +84,12 @@ class SOLARUS_API MainLoop {
                                    * Useful to debug issues that only happen on slow systems. */
     bool turbo;                   /**< Whether to run the simulation as fast as possible
                                    * rather than following real time. */
+    int simulation_frames;        /**< In headless mode, number of cycles to simulate
+                                   * before exiting (0 means normal mode). */
+    std::string profiling_file;   /**< File where to export the timings of each cycle,
+                                   * or an empty string to disable profiling. */
+    bool compile_data;            /**< Whether to only compile the data files of the quest
+                                   * instead of running it. */
 
     std::thread stdin_thread;     /**< Separate thread that reads Lua commands on stdin. */
     std::vector<std::string>
@@ -28,6 +28,7 @@
 #include "solarus/lowlevel/Rectangle.h"
 #include "solarus/lowlevel/SurfacePtr.h"
 #include "solarus/lua/ExportableToLua.h"
+#include "solarus/movements/PathFindingGrid.h"
 #include "solarus/MapData.h"
 #include "solarus/Transition.h"
 
@@ -109,6 +110,12 @@ class SOLARUS_API Map: public ExportableToLua {
     Destination* get_destination();
     int get_destination_side() const;
 
+    // path finding
+    PathFindingGrid& get_path_finding_grid();
+    void notify_ground_changed(int layer, const Rectangle& area);
+    void notify_ground_modifier_changed(const Entity& entity);
+    void notify_entity_removed(const Entity& entity);
+
     // collisions with obstacles (checked before a move)
     bool test_collision_with_border(int x, int y) const;
     bool test_collision_with_border(const Point& point) const;
@@ -120,6 +127,11 @@ class SOLARUS_API Map: public ExportableToLua {
         const Entity& entity_to_check,
         bool& found_diagonal_wall
     ) const;
+    bool test_collision_with_ground(
+        int layer,
+        const Rectangle& collision_box,
+        const Entity& entity_to_check
+    ) const;
     bool test_collision_with_entities(
         int layer,
         const Rectangle& collision_box,
@@ -165,6 +177,24 @@ class SOLARUS_API Map: public ExportableToLua {
     void check_collision_with_detectors(Entity& entity, Sprite& sprite);
     void check_collision_from_detector(Entity& detector);
     void check_collision_from_detector(Entity& detector, Sprite& detector_sprite);
+    void check_collision_with_detectors(
+        Entity& entity,
+        const std::vector<Entity*>& entities_nearby
+    );
+    void check_collision_with_detectors(
+        Entity& entity,
+        Sprite& sprite,
+        const std::vector<Entity*>& entities_nearby
+    );
+    void check_collision_from_detector(
+        Entity& detector,
+        const std::vector<Entity*>& entities_nearby
+    );
+    void check_collision_from_detector(
+        Entity& detector,
+        Sprite& detector_sprite,
+        const std::vector<Entity*>& entities_nearby
+    );
 
     // main loop
     bool notify_input(const InputEvent& event);
@@ -182,6 +212,12 @@ class SOLARUS_API Map: public ExportableToLua {
     void set_suspended(bool suspended);
     void build_background_surface();
     void build_foreground_surface();
+    void prefetch_destination_maps();
+    bool has_ground_modifier(
+        int layer,
+        const Rectangle& box,
+        const Entity& entity_to_ignore
+    ) const;
     void draw_background(const SurfacePtr& dst_surface);
     void draw_foreground(const SurfacePtr& dst_surface);
 
@@ -196,7 +232,8 @@ class SOLARUS_API Map: public ExportableToLua {
     int max_layer;                /**< Highest layer of the map (0 or more). */
 
     std::string tileset_id;       /**< Id of the current tileset. */
-    const Tileset* tileset;       /**< Tileset of the map: every tile of this map
+    std::shared_ptr<const Tileset>
+        tileset;                  /**< Tileset of the map: every tile of this map
                                    * is extracted from this tileset. */
 
     std::string music_id;         /**< Id of the current music of the map:
@@ -228,6 +265,8 @@ class SOLARUS_API Map: public ExportableToLua {
 
     std::unique_ptr<Entities>
         entities;                 /**< The entities on the map. */
+    std::unique_ptr<PathFindingGrid>
+        path_finding_grid;        /**< Nodes reused by path computations (created on first use). */
     bool suspended;               /**< Whether the game is suspended. */
 };
 
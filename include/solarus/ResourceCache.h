@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_RESOURCE_CACHE_H
+#define SOLARUS_RESOURCE_CACHE_H
+
+#include "solarus/Common.h"
+#include "solarus/ResourceType.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Solarus {
+
+class Arguments;
+
+/**
+ * \brief Memory cache shared by all types of loaded quest resources.
+ *
+ * Resources like tilesets, sprite animation sets and sounds are expensive
+ * to load and are kept here to be reused.
+ * Each element has an estimated memory size.
+ * When the total size exceeds the budget, least recently used elements
+ * are evicted.
+ *
+ * An element is never evicted while it is in use, that is,
+ * while somebody else than the cache holds a shared pointer to it.
+ * Elements can also be pinned explicitly to keep them forever.
+ *
+ * Elements are normally accessed from the main thread only,
+ * but contains() may be called from any thread.
+ */
+class SOLARUS_API ResourceCache {
+
+  public:
+
+    /**
+     * \brief Usage statistics of a type of resource.
+     */
+    struct Statistics {
+      int hits = 0;                   /**< Number of requests found in the cache. */
+      int misses = 0;                 /**< Number of requests not found in the cache. */
+      int evictions = 0;              /**< Number of elements evicted to stay within the budget. */
+      int num_elements = 0;           /**< Number of elements currently in the cache. */
+      size_t memory_size = 0;         /**< Estimated size in bytes of these elements. */
+    };
+
+    static void initialize(const Arguments& args);
+    static void quit();
+
+    static size_t get_budget();
+    static void set_budget(size_t budget);
+    static size_t get_memory_size();
+    static Statistics get_statistics(ResourceType resource_type);
+
+    static bool contains(ResourceType resource_type, const std::string& id);
+    template<typename T>
+    static std::shared_ptr<T> find(ResourceType resource_type, const std::string& id);
+    template<typename T>
+    static void add(
+        ResourceType resource_type,
+        const std::string& id,
+        const std::shared_ptr<T>& resource,
+        size_t memory_size
+    );
+    static void set_pinned(ResourceType resource_type, const std::string& id, bool pinned);
+    static void remove(ResourceType resource_type, const std::string& id);
+    static void clear(ResourceType resource_type);
+
+  private:
+
+    static std::shared_ptr<void> find_element(
+        ResourceType resource_type,
+        const std::string& id
+    );
+    static void add_element(
+        ResourceType resource_type,
+        const std::string& id,
+        const std::shared_ptr<void>& resource,
+        size_t memory_size
+    );
+
+};
+
+/**
+ * \brief Returns an element of the cache and marks it as recently used.
+ * \param resource_type Type of resource to get.
+ * \param id Id of the element to get.
+ * \return The element, or nullptr if it is not in the cache.
+ */
+template<typename T>
+inline std::shared_ptr<T> ResourceCache::find(
+    ResourceType resource_type,
+    const std::string& id
+) {
+  return std::static_pointer_cast<T>(find_element(resource_type, id));
+}
+
+/**
+ * \brief Adds an element to the cache.
+ *
+ * Replaces any previous element with the same type and id.
+ * Unused elements may be evicted to stay within the budget.
+ * Since the caller holds the new element, it is not one of them.
+ *
+ * \param resource_type Type of resource to add.
+ * \param id Id of the element to add.
+ * \param resource The element.
+ * \param memory_size Estimated memory used by the element in bytes.
+ */
+template<typename T>
+inline void ResourceCache::add(
+    ResourceType resource_type,
+    const std::string& id,
+    const std::shared_ptr<T>& resource,
+    size_t memory_size
+) {
+  add_element(resource_type, id, std::static_pointer_cast<void>(resource), memory_size);
+}
+
+}
+
+#endif
+
@@ -20,33 +20,76 @@
 #include "solarus/Common.h"
 #include "solarus/entities/Tileset.h"
 #include "solarus/entities/TilePattern.h"
+#include "solarus/MapData.h"
+#include "solarus/ResourceCache.h"
 #include "solarus/ResourceType.h"
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace Solarus {
 
 /**
  * \brief Provides fast access to quest resources.
  *
- * Maintains a cache of already loaded quest resources
+ * Uses the resource cache to keep already loaded quest resources
  * so that next accesses are faster.
+ *
+ * Maps that are likely to be needed soon can also be prefetched:
+ * their data file and their tileset are then read and parsed by a
+ * background thread while the game continues.
+ * Only the creation of entities remains to be done when the map is
+ * actually loaded.
  */
 class SOLARUS_API ResourceProvider {
 
   public:
 
     ResourceProvider();
+    ~ResourceProvider();
+
+    void clear();
 
-    const Tileset& get_tileset(const std::string& tileset_id);
-    // TODO other types of resources
+    std::shared_ptr<const Tileset> get_tileset(const std::string& tileset_id);
+    std::shared_ptr<const MapData> get_map_data(const std::string& map_id);
+
+    void prefetch_maps(const std::vector<std::string>& map_ids);
 
     void invalidate_resource_element(ResourceType resource_type, const std::string& element_id);
 
   private:
 
-    std::map<std::string, std::unique_ptr<Tileset>> tileset_cache;          /**< Cache of loaded tilesets. */
+    void stop_loader_thread();
+    void loader_thread_loop();
+
+    // Prefetching (protected by loader_mutex).
+    std::deque<std::string> maps_to_prefetch;                                /**< Maps waiting to be parsed
+                                                                             * by the loader thread. */
+    std::string map_being_prefetched;                                       /**< Map currently parsed by the
+                                                                             * loader thread, if any. */
+    std::string tileset_being_prefetched;                                   /**< Tileset currently loaded by the
+                                                                             * loader thread, if any. */
+    std::map<std::string, std::shared_ptr<const MapData>> prefetched_maps;  /**< Maps parsed in advance. */
+    std::map<std::string, std::shared_ptr<Tileset>> prefetched_tilesets;    /**< Tilesets loaded in advance and
+                                                                             * not requested yet. */
+    std::map<std::string, std::vector<std::string>>
+        prefetched_map_errors;                                              /**< Errors that happened while
+                                                                             * prefetching maps, not reported yet. */
+    std::map<std::string, std::vector<std::string>>
+        prefetched_tileset_errors;                                          /**< Errors that happened while
+                                                                             * prefetching tilesets, not reported yet. */
+    std::thread loader_thread;                                              /**< Background thread that parses
+                                                                             * prefetched maps. */
+    std::mutex loader_mutex;                                                /**< Protects prefetching data. */
+    std::condition_variable loader_condition;                               /**< Signals changes of the
+                                                                             * prefetching state. */
+    bool loader_stopping;                                                   /**< Whether the loader thread
+                                                                             * should exit. */
 };
 
 }
@@ -20,8 +20,9 @@
 #include "solarus/Common.h"
 #include "solarus/Equipment.h"
 #include "solarus/lua/ExportableToLua.h"
-#include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 struct lua_State;
 
@@ -84,6 +85,7 @@ class SOLARUS_API Savegame: public ExportableToLua {
 
     // creation and destruction
     Savegame(MainLoop& main_loop, const std::string& file_name);
+    ~Savegame();
 
     // file state
     bool is_empty() const;
@@ -115,8 +117,9 @@ class SOLARUS_API Savegame: public ExportableToLua {
 
     virtual const std::string& get_lua_type_name() const override;
 
-  private:
-
+    /**
+     * \brief A value saved, with its type.
+     */
     struct SavedValue {
 
       enum {
@@ -129,7 +132,16 @@ class SOLARUS_API Savegame: public ExportableToLua {
       int int_data;  // Also used for boolean
     };
 
-    std::map<std::string, SavedValue> saved_values;
+    const SavedValue* get_saved_value(const std::string& key) const;
+
+  private:
+
+    std::unordered_map<int, SavedValue>
+        saved_values;        /**< Values saved, by interned key (see StringInterner). */
+    std::unordered_set<int>
+        dirty_keys;          /**< Interned keys set or unset since the previous save. */
+    bool all_dirty;          /**< Whether all values have to be sent at the next save. */
+    int writer_id;           /**< Identifies this savegame in the SavegameWriter. */
 
     bool empty;
     std::string file_name;   /**< Savegame file name relative to the quest write directory. */
@@ -138,8 +150,13 @@ class SOLARUS_API Savegame: public ExportableToLua {
     Game* game;              /**< nullptr if this savegame is not currently running */
 
     void import_from_file();
+    bool import_from_binary(const std::string& buffer);
     static int l_newindex(lua_State* l);
 
+    const SavedValue* find_saved_value(const std::string& key) const;
+    SavedValue& create_saved_value(const std::string& key);
+    void set_dirty(int key_id);
+
     void set_initial_values();
     void set_default_keyboard_controls();
     void set_default_joypad_controls();
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_SAVEGAME_WRITER_H
+#define SOLARUS_SAVEGAME_WRITER_H
+
+#include "solarus/Common.h"
+#include "solarus/Savegame.h"
+#include <map>
+#include <set>
+#include <string>
+
+namespace Solarus {
+
+/**
+ * \brief Writes savegame files from a background thread.
+ *
+ * Savegame::save() only sends the values changed since its previous save.
+ * The writer thread applies them to its own copy of the savegame,
+ * serializes this copy and replaces the file atomically,
+ * so that a crash during the write never leaves a truncated savegame.
+ * Several saves of the same savegame that are waiting for the writer
+ * result in a single write, and a write is skipped when the content of
+ * the file would not change.
+ *
+ * Savegames can be written in the usual Lua format or in the compiled
+ * binary format of BinaryDataWriter, which is smaller and faster to parse.
+ * Savegame::import_from_file() accepts both.
+ */
+namespace SavegameWriter {
+
+/**
+ * \brief File formats of savegames.
+ */
+enum class Format {
+  LUA,                    /**< One "key = value" Lua line per value. */
+  BINARY                  /**< Compiled binary format. */
+};
+
+/**
+ * \brief Values of a savegame that changed since its previous save.
+ */
+struct Changes {
+  std::map<std::string, Savegame::SavedValue>
+      values;             /**< Values set or modified. */
+  std::set<std::string>
+      unset_keys;         /**< Keys that no longer have a value. */
+  bool all_values;        /**< Whether values contains all values of the
+                           * savegame, replacing any previous state. */
+};
+
+SOLARUS_API void set_format(Format format);
+SOLARUS_API Format get_format();
+
+SOLARUS_API int create_savegame_id();
+SOLARUS_API void write(int savegame_id, const std::string& file_name, Changes&& changes);
+SOLARUS_API void release_savegame_id(int savegame_id);
+SOLARUS_API void set_paused(bool paused);
+SOLARUS_API void flush();
+SOLARUS_API void quit();
+
+SOLARUS_API std::string serialize(
+    const std::map<std::string, Savegame::SavedValue>& values,
+    Format format
+);
+
+}  // namespace SavegameWriter
+
+}  // namespace Solarus
+
+#endif
+
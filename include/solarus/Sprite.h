@@ -121,16 +121,16 @@ class Sprite: public Drawable {
 
   private:
 
-    static SpriteAnimationSet& get_animation_set(const std::string& id);
+    static std::shared_ptr<SpriteAnimationSet> get_animation_set(const std::string& id);
     int get_next_frame() const;
     Surface& get_intermediate_surface() const ;
     void set_frame_changed(bool frame_changed);
     void notify_finished();
 
     // animation set
-    static std::map<std::string, SpriteAnimationSet*> all_animation_sets;
     const std::string animation_set_id;  /**< id of this sprite's animation set */
-    SpriteAnimationSet& animation_set;   /**< animation set of this sprite */
+    std::shared_ptr<SpriteAnimationSet>
+        animation_set;                   /**< animation set of this sprite */
 
     // current state of the sprite
 
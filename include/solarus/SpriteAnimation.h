@@ -59,6 +59,8 @@ class SpriteAnimation {
     void enable_pixel_collisions();
     bool are_pixel_collisions_enabled() const;
 
+    size_t get_memory_size() const;
+
   private:
 
     void do_enable_pixel_collisions();
@@ -56,6 +56,7 @@ class SpriteAnimationSet {
     bool are_pixel_collisions_enabled() const;
     const Size& get_max_size() const;
     const Rectangle& get_max_bounding_box() const;
+    size_t get_memory_size() const;
 
   private:
 
@@ -143,6 +143,8 @@ class SOLARUS_API SpriteData : public LuaData {
 
     virtual bool import_from_lua(lua_State* l) override;
     virtual bool export_to_lua(std::ostream& out) const override;
+    virtual bool import_from_binary(BinaryDataReader& reader) override;
+    virtual bool export_to_binary(BinaryDataWriter& writer) const override;
 
   private:
 
@@ -22,10 +22,8 @@
 #include "solarus/lowlevel/Rectangle.h"
 #include "solarus/lowlevel/Size.h"
 #include "solarus/lowlevel/SurfacePtr.h"
-#include <array>
-#include <map>
-#include <memory>
-#include <set>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 namespace Solarus {
@@ -38,7 +36,12 @@ class Color;
  * The main goal of this container is to get objects in a given rectangle as
  * quickly as possible.
  *
- * \param T Type of objects.
+ * Nodes are stored in a flat pool and refer to their children by index.
+ * Elements are stored once in a slot and leaf nodes only store slot indexes
+ * with a copy of the bounding box.
+ * Queries remove duplicates by stamping elements instead of building a set.
+ *
+ * \param T Type of objects. It must be hashable, for example a pointer.
  */
 template <typename T>
 class Quadtree {
@@ -57,6 +60,10 @@ class Quadtree {
     bool remove(const T& element);
     bool move(const T& element, const Rectangle& bounding_box);
 
+    void get_elements(
+        const Rectangle& where,
+        std::vector<T>& result
+    ) const;
     std::vector<T> get_elements(
         const Rectangle& where
     ) const;
@@ -81,80 +88,78 @@ class Quadtree {
 
   private:
 
-    class Node {
-
-      public:
-
-        explicit Node(const Quadtree& quadtree);
-        Node(const Quadtree& quadtree, const Rectangle& cell);
-
-        void clear();
-        void initialize(const Rectangle& cell);
-
-        Rectangle get_cell() const;
-        Size get_cell_size() const;
-
-        bool add(
-            const T& element,
-            const Rectangle& bounding_box
-        );
-        bool remove(
-            const T& element,
-            const Rectangle& bounding_box
-        );
-
-        void get_elements(
-            const Rectangle& region,
-            std::set<T>& result
-        ) const;
-
-        int get_num_elements() const;
-
-        void draw(
-            const SurfacePtr& dst_surface, const Point& dst_position
-        );
-        void draw_rectangle(
-            const Rectangle& rectangle,
-            const Color& line_color,
-            const SurfacePtr& dst_surface,
-            const Point& dst_position
-        );
-
-      private:
-
-        bool is_split() const;
-        void split();
-        void merge();
-        bool is_main_cell(const Rectangle& bounding_box) const;
-
-        const Quadtree& quadtree;
-        std::vector<std::pair<T, Rectangle>> elements;
-        std::array<std::unique_ptr<Node>, 4> children;
-        Rectangle cell;
-        Point center;
-        Color color;
+    /**
+     * \brief An element stored in the quadtree.
+     */
+    struct Slot {
+      T element;                    /**< The element. */
+      Rectangle bounding_box;       /**< Its bounding box when it was added. */
+      bool outside;                 /**< Whether it is outside the quadtree space. */
+      mutable uint32_t stamp;       /**< Last query that returned this element. */
+    };
 
+    /**
+     * \brief Reference to an element in a leaf node.
+     */
+    struct Entry {
+      Rectangle bounding_box;       /**< Bounding box of the element. */
+      int slot;                     /**< Index of the element slot. */
     };
 
-    struct ElementInfo {
-        Rectangle bounding_box;
+    /**
+     * \brief A cell of the quadtree.
+     */
+    struct Node {
+      Rectangle cell;               /**< Area of this node. */
+      int first_child;              /**< Index of the first of the 4 consecutive
+                                     * children, or -1 for a leaf. */
+      std::vector<Entry> entries;   /**< Elements of a leaf node. */
+      Color color;                  /**< Color for debugging. */
     };
 
-    std::map<T, ElementInfo> elements;      /**< Elements in the quadtree and
-                                             * intersecting its space. */
-    std::set<T> elements_outside;           /**< Elements that were added to
-                                             * the quadtree but that are
-                                             * currently outside its space. */
-    Node root;                              /** The root node of the tree. */
+    int allocate_children(Rectangle cell);
+    bool is_split(int node_index) const;
+    int get_leaf_containing(const Rectangle& bounding_box) const;
+    bool add_to_node(int node_index, int slot);
+    bool remove_from_node(int node_index, int slot);
+    void split(int node_index);
+    void merge(int node_index);
+    bool is_main_cell(int node_index, const Rectangle& bounding_box) const;
+    int get_num_elements_in_node(int node_index) const;
+    uint32_t next_stamp() const;
+    void get_elements_in_node(
+        int node_index,
+        const Rectangle& region,
+        std::vector<T>& result
+    ) const;
+    void draw_node(
+        int node_index,
+        const SurfacePtr& dst_surface,
+        const Point& dst_position
+    );
+    static void draw_rectangle(
+        const Rectangle& rectangle,
+        const Color& line_color,
+        const SurfacePtr& dst_surface,
+        const Point& dst_position
+    );
+
+    std::vector<Slot> slots;                /**< Elements of the quadtree,
+                                             * including the ones outside its space. */
+    std::vector<int> free_slots;            /**< Indexes of unused slots. */
+    std::unordered_map<T, int> slot_indexes;/**< Slot of each element. */
+    int num_elements_outside;               /**< Number of elements that were
+                                             * added to the quadtree but that
+                                             * are currently outside its space. */
+    std::vector<Node> nodes;                /**< Node pool. The root node is the first one. */
+    std::vector<int> free_children;         /**< First indexes of unused groups
+                                             * of 4 nodes in the pool. */
+    mutable uint32_t stamp;                 /**< Stamp of the last query. */
 
 };
 
-template<typename T>
-using QuadtreeNode = typename Quadtree<T>::Node;
-
 }
 
 #include "solarus/containers/Quadtree.inl"
 
 #endif
-
@@ -19,8 +19,6 @@
 #include "solarus/lowlevel/Random.h"
 #include "solarus/lowlevel/Surface.h"
 #include <algorithm>
-#include <iterator>
-#include <set>
 
 namespace Solarus {
 
@@ -41,21 +39,44 @@ Quadtree<T>::Quadtree() :
  */
 template<typename T>
 Quadtree<T>::Quadtree(const Rectangle& space) :
-    elements(),
-    root(*this) {
+    slots(),
+    free_slots(),
+    slot_indexes(),
+    num_elements_outside(0),
+    nodes(),
+    free_children(),
+    stamp(0) {
 
     initialize(space);
 }
 
 /**
  * \brief Removes all elements of the quadtree.
+ *
+ * The space of the quadtree is unchanged.
  */
 template<typename T>
 void Quadtree<T>::clear() {
 
-  elements.clear();
-  elements_outside.clear();
-  root.clear();
+  const Rectangle space = nodes.empty() ? Rectangle(0, 0, 256, 256) : get_space();
+
+  slots.clear();
+  free_slots.clear();
+  slot_indexes.clear();
+  num_elements_outside = 0;
+  nodes.clear();
+  free_children.clear();
+  stamp = 0;
+
+  // Create the root node.
+  Node root;
+  root.cell = space;
+  root.first_child = -1;
+  root.entries.reserve(max_in_cell);
+  if (debug_quadtrees) {
+    root.color = Color(Random::get_number(256), Random::get_number(256), Random::get_number(256));
+  }
+  nodes.push_back(std::move(root));
 }
 
 /**
@@ -78,7 +99,7 @@ void Quadtree<T>::initialize(const Rectangle& space) {
     square.set_width(square.get_height());
   }
 
-  root.initialize(square);
+  nodes[0].cell = square;
 }
 
 /**
@@ -87,7 +108,7 @@ void Quadtree<T>::initialize(const Rectangle& space) {
  */
 template<typename T>
 Rectangle Quadtree<T>::get_space() const {
-    return root.get_cell();
+    return nodes[0].cell;
 }
 
 /**
@@ -108,17 +129,34 @@ bool Quadtree<T>::add(const T& element, const Rectangle& bounding_box) {
     return false;
   }
 
-  if (!bounding_box.overlaps(get_space())) {
+  // Store the element in a slot.
+  int slot = 0;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  }
+  else {
+    slot = slots.size();
+    slots.emplace_back();
+  }
+  Slot& info = slots[slot];
+  info.element = element;
+  info.bounding_box = bounding_box;
+  info.outside = !bounding_box.overlaps(get_space());
+  info.stamp = 0;
+
+  if (info.outside) {
     // Out of the space of the quadtree.
-    elements_outside.insert(element);
+    ++num_elements_outside;
   }
-  else if (!root.add(element, bounding_box)) {
+  else if (!add_to_node(0, slot)) {
     // Add failed.
+    slots[slot].element = T();
+    free_slots.push_back(slot);
     return false;
   }
 
-  ElementInfo info = { bounding_box };
-  elements.emplace(element, info);
+  slot_indexes.emplace(element, slot);
 
   return true;
 }
@@ -131,21 +169,28 @@ bool Quadtree<T>::add(const T& element, const Rectangle& bounding_box) {
 template<typename T>
 bool Quadtree<T>::remove(const T& element) {
 
-  const auto& it = elements.find(element);
-  if (it == elements.end()) {
+  const auto& it = slot_indexes.find(element);
+  if (it == slot_indexes.end()) {
     // Unknown element.
     return false;
   }
 
-  Rectangle box = it->second.bounding_box;
-  elements.erase(element);
-  if (elements_outside.erase(element) > 0) {
+  const int slot = it->second;
+  slot_indexes.erase(it);
+
+  bool removed = true;
+  if (slots[slot].outside) {
     // It was outside the quadtree space.
-    return true;
+    --num_elements_outside;
+  }
+  else {
+    // Normal case.
+    removed = remove_from_node(0, slot);
   }
 
-  // Normal case.
-  return root.remove(element, box);
+  slots[slot].element = T();  // Don't keep a reference to the element.
+  free_slots.push_back(slot);
+  return removed;
 }
 
 /**
@@ -165,17 +210,34 @@ bool Quadtree<T>::remove(const T& element) {
 template<typename T>
 bool Quadtree<T>::move(const T& element, const Rectangle& bounding_box) {
 
-  const auto& it = elements.find(element);
-  if (it == elements.end()) {
+  const auto& it = slot_indexes.find(element);
+  if (it == slot_indexes.end()) {
     // Not in the quadtree: error.
     return false;
   }
   else {
-    if (it->second.bounding_box == bounding_box) {
+    Slot& info = slots[it->second];
+    if (info.bounding_box == bounding_box) {
       // Already in the quadtree and no change.
       return true;
     }
 
+    if (!info.outside) {
+      const int leaf_index = get_leaf_containing(info.bounding_box);
+      if (leaf_index != -1 &&
+          nodes[leaf_index].cell.contains(bounding_box)) {
+        // Still in the same single cell: just update the box in place.
+        for (Entry& entry : nodes[leaf_index].entries) {
+          if (entry.slot == it->second) {
+            entry.bounding_box = bounding_box;
+            break;
+          }
+        }
+        info.bounding_box = bounding_box;
+        return true;
+      }
+    }
+
     if (!remove(element)) {
       // Failed to remove.
       return false;
@@ -196,23 +258,45 @@ bool Quadtree<T>::move(const T& element, const Rectangle& bounding_box) {
  */
 template<typename T>
 int Quadtree<T>::get_num_elements() const {
-  return root.get_num_elements() + elements_outside.size();
+  return get_num_elements_in_node(0) + num_elements_outside;
 }
 
 /**
  * \brief Gets the elements intersecting the given rectangle.
- * \param region The rectangle to check.
+ *
+ * No memory is allocated if the result already has enough capacity.
+ *
+ * \param[in] where The rectangle to check.
+ * The rectangle should be entirely contained in the quadtree space.
+ * \param[in,out] result Elements intersecting the rectangle are appended
+ * to this list, in arbitrary order, without duplicates.
+ * Elements outside the quadtree space are not added there.
+ */
+template<typename T>
+void Quadtree<T>::get_elements(
+    const Rectangle& where,
+    std::vector<T>& result
+) const {
+
+  next_stamp();
+  get_elements_in_node(0, where, result);
+}
+
+/**
+ * \brief Gets the elements intersecting the given rectangle.
+ * \param where The rectangle to check.
  * The rectangle should be entirely contained in the quadtree space.
  * \return A list of elements intersecting the rectangle, in arbitrary order.
  * Elements outside the quadtree space are not added there.
  */
 template<typename T>
 std::vector<T> Quadtree<T>::get_elements(
-    const Rectangle& region
+    const Rectangle& where
 ) const {
-  std::set<T> element_set;
-  root.get_elements(region, element_set);
-  return std::vector<T>(element_set.begin(), element_set.end());
+
+  std::vector<T> result;
+  get_elements(where, result);
+  return result;
 }
 
 /**
@@ -224,8 +308,7 @@ std::vector<T> Quadtree<T>::get_elements(
 template<typename T>
 bool Quadtree<T>::contains(const T& element) const {
 
-  const auto& it = elements.find(element);
-  return it != elements.end();
+  return slot_indexes.find(element) != slot_indexes.end();
 }
 
 /**
@@ -236,260 +319,267 @@ bool Quadtree<T>::contains(const T& element) const {
 template<typename T>
 void Quadtree<T>::draw(const SurfacePtr& dst_surface, const Point& dst_position) {
 
-  root.draw(dst_surface, dst_position);
+  draw_node(0, dst_surface, dst_position);
 }
 
 /**
- * \brief Creates a node with default coordinates.
+ * \brief Takes 4 consecutive nodes from the pool to split a cell.
  *
- * Call initialize later to set coordinates.
+ * This may reallocate the pool: references to nodes become invalid.
  *
- * \param quadtree The quadtree this node belongs to.
- */
-template<typename T>
-Quadtree<T>::Node::Node(const Quadtree& quadtree) :
-    Node(quadtree, Rectangle(0, 0, 256, 256)) {
-
-}
-
-/**
- * \brief Creates a node with the given coordinates.
- * \param quadtree The quadtree this node belongs to.
- * \param cell Cell coordinates of the node.
+ * \param cell The cell to split (copied since the pool may move).
+ * \return Index of the first of the 4 new nodes.
  */
 template<typename T>
-Quadtree<T>::Node::Node(const Quadtree& quadtree, const Rectangle& cell) :
-    quadtree(quadtree),
-    elements(),
-    children(),
-    cell(cell),
-    center(cell.get_center()),
-    color() {
+int Quadtree<T>::allocate_children(Rectangle cell) {
 
-  initialize(cell);
+  int first_child = 0;
+  if (!free_children.empty()) {
+    first_child = free_children.back();
+    free_children.pop_back();
+  }
+  else {
+    first_child = nodes.size();
+    nodes.resize(nodes.size() + 4);
+  }
 
-  if (debug_quadtrees) {
-    color = Color(Random::get_number(256), Random::get_number(256), Random::get_number(256));
+  const Point& center = cell.get_center();
+  const Rectangle children_cells[] = {
+      Rectangle(cell.get_top_left(), center),
+      Rectangle(Point(center.x, cell.get_top()), Point(cell.get_right(), center.y)),
+      Rectangle(Point(cell.get_left(), center.y), Point(center.x, cell.get_bottom())),
+      Rectangle(center, cell.get_bottom_right())
+  };
+  for (int i = 0; i < 4; ++i) {
+    Node& child = nodes[first_child + i];
+    child.cell = children_cells[i];
+    child.first_child = -1;
+    child.entries.clear();
+    child.entries.reserve(max_in_cell);
+    if (debug_quadtrees) {
+      child.color = Color(Random::get_number(256), Random::get_number(256), Random::get_number(256));
+    }
   }
+  return first_child;
 }
 
 /**
- * \brief Clears this node.
- *
- * Children nodes and their content are destroyed.
+ * \brief Returns whether a node is split or is a leaf cell.
+ * \param node_index Index of a node.
+ * \return \c true if the node is split.
  */
 template<typename T>
-void Quadtree<T>::Node::clear() {
+bool Quadtree<T>::is_split(int node_index) const {
 
-  elements.clear();
-  std::fill(std::begin(children), std::end(children), nullptr);
+  return nodes[node_index].first_child != -1;
 }
 
 /**
- * \brief Clears this node and initializes it with a new cell rectangle.
- * \param cell The new cell.
+ * \brief Returns the leaf cell that entirely contains a box, if any.
+ * \param bounding_box A bounding box.
+ * \return Index of the leaf node containing the box, or -1 if the box
+ * overlaps several leaves or goes outside the quadtree space.
  */
 template<typename T>
-void Quadtree<T>::Node::initialize(const Rectangle& cell) {
+int Quadtree<T>::get_leaf_containing(const Rectangle& bounding_box) const {
 
-  clear();
-  this->cell = cell;
-  elements.reserve(max_in_cell);
-}
-
-/**
- * \brief Returns the cell represented by this node.
- * \return The cell's rectangle.
- */
-template<typename T>
-Rectangle Quadtree<T>::Node::get_cell() const {
-  return cell;
-}
+  if (!nodes[0].cell.contains(bounding_box)) {
+    return -1;
+  }
 
-/**
- * \brief Returns the size of the cell represented by this node.
- * \return The cell size.
- */
-template<typename T>
-Size Quadtree<T>::Node::get_cell_size() const {
-    return get_cell().get_size();
+  int node_index = 0;
+  while (is_split(node_index)) {
+    const int first_child = nodes[node_index].first_child;
+    node_index = -1;
+    for (int i = 0; i < 4; ++i) {
+      if (nodes[first_child + i].cell.contains(bounding_box)) {
+        node_index = first_child + i;
+        break;
+      }
+    }
+    if (node_index == -1) {
+      // Overlapping several children.
+      return -1;
+    }
+  }
+  return node_index;
 }
 
 /**
- * \brief Adds an element to this node if its bounding box intersects it.
+ * \brief Adds an element to a node if its bounding box intersects it.
  *
  * Splits the node if necessary when the threshold is exceeded.
  *
- * \param element The element to add.
- * \param bounding_box Bounding box of the element.
+ * \param node_index Index of a node.
+ * \param slot Slot of the element to add.
  * \return \c true in case of success.
  */
 template<typename T>
-bool Quadtree<T>::Node::add(
-    const T& element,
-    const Rectangle& bounding_box
-) {
-  if (!get_cell().overlaps(bounding_box)) {
+bool Quadtree<T>::add_to_node(int node_index, int slot) {
+
+  const Rectangle bounding_box = slots[slot].bounding_box;
+  const Rectangle cell = nodes[node_index].cell;
+  if (!cell.overlaps(bounding_box)) {
     // Nothing to do.
     return false;
   }
 
-  if (!is_split()) {
+  if (!is_split(node_index)) {
 
     // See if it is time to split.
-    if (is_main_cell(bounding_box)) {
+    if (is_main_cell(node_index, bounding_box)) {
       // We are the main cell of this element: it counts in the total.
-      if (get_num_elements() >= max_in_cell &&
-          get_cell_size().width > min_cell_size &&
-          get_cell_size().height > min_cell_size) {
-        split();
+      if (get_num_elements_in_node(node_index) >= max_in_cell &&
+          cell.get_width() > min_cell_size &&
+          cell.get_height() > min_cell_size) {
+        split(node_index);
       }
     }
   }
 
-  if (!is_split()) {
+  if (!is_split(node_index)) {
     // Add it to the current node.
-    elements.emplace_back(element, bounding_box);
+    Entry entry = { bounding_box, slot };
+    nodes[node_index].entries.push_back(entry);
     return true;
   }
 
   // Add it to children cells.
-  for (const std::unique_ptr<Node>& child : children) {
-    child->add(element, bounding_box);
+  const int first_child = nodes[node_index].first_child;
+  for (int i = 0; i < 4; ++i) {
+    add_to_node(first_child + i, slot);
   }
   return true;
 }
 
 /**
- * \brief Removes an element from this node if its bounding box intersects it.
+ * \brief Removes an element from a node if its bounding box intersects it.
  *
  * Merges nodes when necessary.
  *
- * \param element The element to remove.
- * \param bounding_box Bounding box of the element.
+ * \param node_index Index of a node.
+ * \param slot Slot of the element to remove.
  * \return \c true in the element was found and removed.
  */
 template<typename T>
-bool Quadtree<T>::Node::remove(
-    const T& element,
-    const Rectangle& bounding_box
-) {
-  if (!get_cell().overlaps(bounding_box)) {
+bool Quadtree<T>::remove_from_node(int node_index, int slot) {
+
+  if (!nodes[node_index].cell.overlaps(slots[slot].bounding_box)) {
     // Nothing to do.
     return false;
   }
 
-  if (!is_split()) {
+  if (!is_split(node_index)) {
     // Remove from this cell.
-    const auto& it = std::find(elements.begin(), elements.end(), std::make_pair(element, bounding_box));
-    if (it == elements.end()) {
+    std::vector<Entry>& entries = nodes[node_index].entries;
+    const auto& it = std::find_if(entries.begin(), entries.end(), [slot](const Entry& entry) {
+      return entry.slot == slot;
+    });
+    if (it == entries.end()) {
       // The element was not here.
       return false;
     }
-    elements.erase(it);
+    entries.erase(it);
     return true;
   }
 
   // Remove from children cells.
+  const int first_child = nodes[node_index].first_child;
   bool removed = false;
-  for (const std::unique_ptr<Node>& child : children) {
-    removed |= child->remove(element, bounding_box);
+  bool children_are_leaves = true;
+  for (int i = 0; i < 4; ++i) {
+    removed |= remove_from_node(first_child + i, slot);
+    children_are_leaves &= !is_split(first_child + i);
   }
 
   if (removed &&
-      !children[0]->is_split()  // We are the parent node of where the element was removed.
+      children_are_leaves  // We are the parent node of where the element was removed.
   ) {
     // See if it is time to merge.
-    int num_elements_in_children = get_num_elements();
+    int num_elements_in_children = get_num_elements_in_node(node_index);
     if (num_elements_in_children < min_in_4_cells) {
-      merge();
+      merge(node_index);
     }
   }
   return removed;
 }
 
 /**
- * \brief Returns whether this node is split or is a leaf cell.
- * \return \c true if the node is split.
- */
-template<typename T>
-bool Quadtree<T>::Node::is_split() const {
-
-  return children[0] != nullptr;
-}
-
-/**
- * \brief Splits this cell in four parts and moves its elements to them.
+ * \brief Splits a leaf cell in four parts and moves its elements to them.
+ * \param node_index Index of a leaf node.
  */
 template<typename T>
-void Quadtree<T>::Node::split() {
+void Quadtree<T>::split(int node_index) {
 
-  Debug::check_assertion(!is_split(), "Quadtree node already split");
+  Debug::check_assertion(!is_split(node_index), "Quadtree node already split");
 
   // Create 4 children cells.
-  const Rectangle& cell = get_cell();
-  const Point& center = cell.get_center();
-  children[0] = std::unique_ptr<Node>(
-      new Node(quadtree, Rectangle(cell.get_top_left(), center))
-  );
-  children[1] = std::unique_ptr<Node>(
-      new Node(quadtree, Rectangle(Point(center.x, cell.get_top()), Point(cell.get_right(), center.y)))
-  );
-  children[2] = std::unique_ptr<Node>(
-      new Node(quadtree, Rectangle(Point(cell.get_left(), center.y), Point(center.x, cell.get_bottom())))
-  );
-  children[3] = std::unique_ptr<Node>(
-      new Node(quadtree, Rectangle(center, cell.get_bottom_right()))
-  );
+  const int first_child = allocate_children(nodes[node_index].cell);
+  nodes[node_index].first_child = first_child;
 
   // Move existing elements into them.
-  for (const std::pair<T, Rectangle>& pair : elements) {
-    for (const std::unique_ptr<Node>& child : children) {
-      child->add(pair.first, pair.second);
+  std::vector<Entry> entries;
+  entries.swap(nodes[node_index].entries);
+  for (const Entry& entry : entries) {
+    for (int i = 0; i < 4; ++i) {
+      add_to_node(first_child + i, entry.slot);
     }
   }
-  elements.clear();
 
-  Debug::check_assertion(is_split(), "Quadtree node split failed");
+  Debug::check_assertion(is_split(node_index), "Quadtree node split failed");
 }
 
 /**
- * \brief Merges the four children cell into this one and destroys them.
+ * \brief Merges the four children cell of a node into it and gives them
+ * back to the pool.
  *
  * The children must already be leaves.
+ *
+ * \param node_index Index of a split node.
  */
 template<typename T>
-void Quadtree<T>::Node::merge() {
+void Quadtree<T>::merge(int node_index) {
 
-  Debug::check_assertion(is_split(), "Quadtree node already merged");
+  Debug::check_assertion(is_split(node_index), "Quadtree node already merged");
 
   // We want to avoid duplicates while preserving a deterministic order.
-  std::set<T> merged_elements;
-  for (const std::unique_ptr<Node>& child : children) {
-    Debug::check_assertion(!child->is_split(), "Quadtree node child is not a leaf");
-    for (const std::pair<T, Rectangle>& pair : child->elements) {
-      const T& element = pair.first;
-      if (merged_elements.insert(element).second) {
-        elements.push_back(pair);
+  const uint32_t merge_stamp = next_stamp();
+  const int first_child = nodes[node_index].first_child;
+  std::vector<Entry>& entries = nodes[node_index].entries;
+  for (int i = 0; i < 4; ++i) {
+    Node& child = nodes[first_child + i];
+    Debug::check_assertion(child.first_child == -1, "Quadtree node child is not a leaf");
+    for (const Entry& entry : child.entries) {
+      const Slot& info = slots[entry.slot];
+      if (info.stamp != merge_stamp) {
+        info.stamp = merge_stamp;
+        entries.push_back(entry);
       }
     }
+    child.entries.clear();
   }
 
-  std::fill(std::begin(children), std::end(children), nullptr);
+  nodes[node_index].first_child = -1;
+  free_children.push_back(first_child);
 
-  Debug::check_assertion(!is_split(), "Quadtree node merge failed");
+  Debug::check_assertion(!is_split(node_index), "Quadtree node merge failed");
 }
 
 /**
- * \brief Returns whether this cell contains a box and is also its main cell.
+ * \brief Returns whether a cell contains a box and is also its main cell.
  *
  * The main cell is used to ensure uniqueness, for example when counting
  * elements.
+ *
+ * \param node_index Index of a node.
+ * \param bounding_box A bounding box.
+ * \return \c true if this is the main cell of the box.
  */
 template<typename T>
-bool Quadtree<T>::Node::is_main_cell(const Rectangle& bounding_box) const {
+bool Quadtree<T>::is_main_cell(int node_index, const Rectangle& bounding_box) const {
 
-  if (!get_cell().overlaps(bounding_box)) {
+  const Rectangle& cell = nodes[node_index].cell;
+  if (!cell.overlaps(bounding_box)) {
     // Not overlapping this cell.
     return false;
   }
@@ -499,7 +589,7 @@ bool Quadtree<T>::Node::is_main_cell(const Rectangle& bounding_box) const {
 
   // Clamp the center to the quadtree space,
   // in case the center it actually outside.
-  const Rectangle& quadtree_space = quadtree.get_space();
+  const Rectangle& quadtree_space = nodes[0].cell;
   center = {
       std::max(quadtree_space.get_left(), std::min(quadtree_space.get_right() - 1, center.x)),
       std::max(quadtree_space.get_top(), std::min(quadtree_space.get_bottom() - 1, center.y))
@@ -507,92 +597,126 @@ bool Quadtree<T>::Node::is_main_cell(const Rectangle& bounding_box) const {
 
   Debug::check_assertion(quadtree_space.contains(center), "Wrong center position");
 
-  return get_cell().contains(center);
+  return cell.contains(center);
 }
 
 /**
- * \brief Returns the number of elements whose center is under this node.
+ * \brief Returns the number of elements whose center is under a node.
+ * \param node_index Index of a node.
  * \return The number of elements under this node.
  */
 template<typename T>
-int Quadtree<T>::Node::get_num_elements() const {
+int Quadtree<T>::get_num_elements_in_node(int node_index) const {
 
   int num_elements = 0;
-  if (!is_split()) {
+  const Node& node = nodes[node_index];
+  if (node.first_child == -1) {
     // Some elements can overlap several cells.
     // To avoid duplicates, we count an element if this cell is its main cell.
     // TODO This information could be stored for better performance.
-    for (const std::pair<T, Rectangle>& pair : elements) {
-      const Rectangle& box = pair.second;
-      if (is_main_cell(box)) {
+    for (const Entry& entry : node.entries) {
+      if (is_main_cell(node_index, entry.bounding_box)) {
         ++num_elements;
       }
     }
   }
   else {
     // Ask children.
-    for (const std::unique_ptr<Node>& child : children) {
-      num_elements += child->get_num_elements();
+    for (int i = 0; i < 4; ++i) {
+      num_elements += get_num_elements_in_node(node.first_child + i);
     }
   }
   return num_elements;
 }
 
 /**
- * \brief Gets the elements intersecting the given rectangle under this node.
+ * \brief Starts a new deduplication pass over elements.
+ * \return The new stamp. Elements marked with it were already seen.
+ */
+template<typename T>
+uint32_t Quadtree<T>::next_stamp() const {
+
+  ++stamp;
+  if (stamp == 0) {
+    // The counter wrapped: old stamps could be mistaken for the new one.
+    for (const Slot& info : slots) {
+      info.stamp = 0;
+    }
+    stamp = 1;
+  }
+  return stamp;
+}
+
+/**
+ * \brief Gets the elements intersecting the given rectangle under a node.
+ *
+ * Elements already stamped by the current query are skipped.
+ *
+ * \param[in] node_index Index of a node.
  * \param[in] region The rectangle to check.
- * \param[in/out] result A list that will be filled with elements.
+ * \param[in,out] result A list that will be filled with elements.
  */
 template<typename T>
-void Quadtree<T>::Node::get_elements(
+void Quadtree<T>::get_elements_in_node(
+    int node_index,
     const Rectangle& region,
-    std::set<T>& result
+    std::vector<T>& result
 ) const {
 
-  if (!get_cell().overlaps(region)) {
+  const Node& node = nodes[node_index];
+  if (!node.cell.overlaps(region)) {
     // Nothing here.
     return;
   }
 
-  if (!is_split()) {
-    for (const std::pair<T, Rectangle>& pair : elements) {
-      if (pair.second.overlaps(region)) {
-        result.insert(pair.first);
+  if (node.first_child == -1) {
+    for (const Entry& entry : node.entries) {
+      if (entry.bounding_box.overlaps(region)) {
+        const Slot& info = slots[entry.slot];
+        if (info.stamp != stamp) {
+          info.stamp = stamp;
+          result.push_back(info.element);
+        }
       }
     }
   }
   else {
     // Get from from children cells.
-    for (const std::unique_ptr<Node>& child : children) {
-      child->get_elements(region, result);
+    for (int i = 0; i < 4; ++i) {
+      get_elements_in_node(node.first_child + i, region, result);
     }
   }
 }
 
 /**
- * \brief Draws the node on a surface for debugging purposes.
+ * \brief Draws a node on a surface for debugging purposes.
+ * \param node_index Index of the node to draw.
  * \param dst_surface The destination surface.
  * \param dst_position Where to draw on that surface.
  */
 template<typename T>
-void Quadtree<T>::Node::draw(const SurfacePtr& dst_surface, const Point& dst_position) {
+void Quadtree<T>::draw_node(
+    int node_index,
+    const SurfacePtr& dst_surface,
+    const Point& dst_position
+) {
 
-  if (!is_split()) {
+  const Node& node = nodes[node_index];
+  if (node.first_child == -1) {
     // Draw the rectangle of the node.
-    draw_rectangle(get_cell(), color, dst_surface, dst_position);
+    draw_rectangle(node.cell, node.color, dst_surface, dst_position);
 
     // Draw bounding boxes of elements.
-    for (const std::pair<T, Rectangle>& pair : elements) {
-      const Rectangle& bounding_box = pair.second;
-      if (is_main_cell(bounding_box)) {
-        draw_rectangle(bounding_box, color, dst_surface, dst_position);
+    for (const Entry& entry : node.entries) {
+      if (is_main_cell(node_index, entry.bounding_box)) {
+        draw_rectangle(entry.bounding_box, node.color, dst_surface, dst_position);
       }
     }
   }
   else {
     // Draw children nodes.
-    for (const std::unique_ptr<Node>& child : children) {
-      child->draw(dst_surface, dst_position);
+    for (int i = 0; i < 4; ++i) {
+      draw_node(node.first_child + i, dst_surface, dst_position);
     }
   }
 }
@@ -605,7 +729,7 @@ void Quadtree<T>::Node::draw(const SurfacePtr& dst_surface, const Point& dst_pos
  * \param dst_position Where to draw on that surface.
  */
 template<typename T>
-void Quadtree<T>::Node::draw_rectangle(
+void Quadtree<T>::draw_rectangle(
     const Rectangle& rectangle,
     const Color& line_color,
     const SurfacePtr& dst_surface,
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_COLLISION_BROAD_PHASE_H
+#define SOLARUS_COLLISION_BROAD_PHASE_H
+
+#include "solarus/Common.h"
+#include "solarus/entities/EntityPtr.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/SpritePtr.h"
+#include <vector>
+
+namespace Solarus {
+
+class Entity;
+class Map;
+class Sprite;
+
+/**
+ * \brief Batches the pixel-precise collision checks of a map cycle.
+ *
+ * Normally, each entity whose sprite frame changes immediately makes its
+ * own spatial query to find nearby detectors.
+ * When the broad phase is enabled, these requests are only recorded
+ * during the update of the entities.
+ * At the end of the update, one spatial query and a sweep and prune pass
+ * find the candidates of all requests, and the narrow phase checks
+ * are dispatched in the order of the requests.
+ *
+ * Batched checks give the same collisions in the same order as immediate
+ * ones:
+ * - Only entities without movement are batched. Entities that move are
+ *   checked immediately, at each step of their path.
+ * - Before any immediate check, the checks recorded so far are done.
+ * - A request whose region overlaps the one of a pending request is not
+ *   batched, since one of them could see the effect of the other.
+ * - Each check is done at the position of the entity when it was requested.
+ *
+ * Checks requested while dispatching are done immediately.
+ * If a check suspends the map, the remaining ones are done when the map
+ * is resumed.
+ *
+ * This is disabled by default.
+ */
+class SOLARUS_API CollisionBroadPhase {
+
+  public:
+
+    explicit CollisionBroadPhase(Map& map);
+
+    static bool is_enabled();
+    static void set_enabled(bool enabled);
+
+    bool is_recording() const;
+    void start();
+    void finish();
+    void flush();
+    void notify_map_resumed();
+    void notify_entity_changed();
+
+    bool add_sprite_changed(Entity& entity, Sprite& sprite);
+    bool add_detector_sprite_changed(Entity& detector, Sprite& detector_sprite);
+
+  private:
+
+    /**
+     * \brief A pixel-precise check of a sprite.
+     */
+    struct SpriteCheck {
+      SpritePtr sprite;                   /**< The sprite to check. */
+      bool from_detector;                 /**< Check entities with this sprite of a detector
+                                           * instead of checking it with detectors. */
+    };
+
+    /**
+     * \brief Collision checks requested by an entity during the cycle.
+     */
+    struct Request {
+      EntityPtr entity;                   /**< The entity to check. */
+      Point xy;                           /**< Position of the entity when requested. */
+      Rectangle box;                      /**< Region where candidates are searched. */
+      std::vector<SpriteCheck> checks;    /**< Checks to do in their order. */
+      std::vector<int> candidates;        /**< Indexes of candidates overlapping this region. */
+    };
+
+    bool add_sprite_check(Entity& entity, Sprite& sprite, bool from_detector);
+    void dispatch_requests();
+    void find_candidates();
+    void get_candidates(
+        const Request& request,
+        const Rectangle& box,
+        std::vector<Entity*>& result
+    ) const;
+    bool has_sprite(const Entity& entity, const Sprite& sprite) const;
+    void dispatch(const Request& request);
+
+    Map& map;                                 /**< The map whose collisions are checked. */
+    bool recording;                           /**< Whether requests are being recorded. */
+    bool dispatching;                         /**< Whether requests are being dispatched. */
+    bool snapshot_valid;                      /**< Whether candidates and their boxes are
+                                               * still up to date. */
+    std::vector<Request> requests;            /**< Requests of the cycle in their order. */
+    std::vector<Entity*> candidates;          /**< Entities found by the spatial query. */
+    std::vector<Rectangle> candidate_boxes;   /**< Bounding box of each candidate. */
+
+};
+
+}
+
+#endif
+
@@ -87,6 +87,7 @@ class SOLARUS_API CustomEntity: public Entity {
     );
     void reset_can_traverse_entities(EntityType type);
 
+    int get_obstacle_traits() const override;
     bool is_hero_obstacle(Hero& hero) override;
     bool is_block_obstacle(Block& block) override;
     bool is_teletransporter_obstacle(Teletransporter& teletransporter) override;
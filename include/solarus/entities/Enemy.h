@@ -84,6 +84,7 @@ class Enemy: public Entity {
 
     static EntityPtr create(
         Game& game,
+        Entities& entities,
         const std::string& breed,
         const std::string& savegame_variable,
         const std::string& name,
@@ -145,6 +146,7 @@ class Enemy: public Entity {
 
     // obstacles
     virtual bool is_obstacle_for(Entity& other) override;
+    virtual int get_obstacle_traits() const override;
     virtual bool is_destructible_obstacle(Destructible& destructible) override;
     virtual bool is_block_obstacle(Block& block) override;
     virtual bool is_teletransporter_obstacle(Teletransporter& teletransporter) override;
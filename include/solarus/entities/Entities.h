@@ -21,18 +21,23 @@
 #include "solarus/containers/Quadtree.h"
 #include "solarus/entities/Camera.h"
 #include "solarus/entities/CameraPtr.h"
+#include "solarus/entities/CollisionBroadPhase.h"
+#include "solarus/entities/EntityPool.h"
 #include "solarus/entities/EntityPtr.h"
 #include "solarus/entities/EntityType.h"
 #include "solarus/entities/Ground.h"
+#include "solarus/entities/GroundGrid.h"
 #include "solarus/entities/HeroPtr.h"
 #include "solarus/entities/TilePtr.h"
 #include "solarus/Transition.h"
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace Solarus {
@@ -51,7 +56,7 @@ using EntityList = std::list<EntityPtr>;
 using EntitySet = std::set<EntityPtr>;
 using EntityVector = std::vector<EntityPtr>;
 using ConstEntityVector = std::vector<ConstEntityPtr>;
-using EntityTree = Quadtree<EntityPtr>;
+using EntityTree = Quadtree<Entity*>;
 
 /**
  * \brief Manages the whole content of a map.
@@ -68,12 +73,18 @@ class SOLARUS_API Entities {
     // Creation and destruction.
     Entities(Game& game, Map& map);
 
+    static bool is_incremental_draw_order_enabled();
+    static void set_incremental_draw_order_enabled(bool enabled);
+
     // Get entities.
     Hero& get_hero();
     const CameraPtr& get_camera() const;
     Ground get_tile_ground(int layer, int x, int y) const;
+    const GroundGrid& get_tile_ground_grid(int layer) const;
+    uint32_t get_ground_version(int layer, const Point& xy) const;
     EntityVector get_entities();
     const std::shared_ptr<Destination>& get_default_destination();
+    CollisionBroadPhase& get_collision_broad_phase();
 
     // By name.
     EntityPtr get_entity(const std::string& name);
@@ -103,6 +114,7 @@ class SOLARUS_API Entities {
     // By coordinates.
     void get_entities_in_rectangle(const Rectangle& rectangle, ConstEntityVector& result) const;
     void get_entities_in_rectangle(const Rectangle& rectangle, EntityVector& result);
+    void get_entities_in_rectangle(const Rectangle& rectangle, std::vector<Entity*>& result);
     void get_entities_in_rectangle_sorted(const Rectangle& rectangle, ConstEntityVector& result) const;
     void get_entities_in_rectangle_sorted(const Rectangle& rectangle, EntityVector& result);
 
@@ -112,6 +124,9 @@ class SOLARUS_API Entities {
     Rectangle get_region_box(const Point& point) const;
 
     // Handle entities.
+    template<typename T, typename... Args>
+    std::shared_ptr<T> make_entity(Args&&... args);
+    const std::shared_ptr<EntityPool>& get_entity_pool() const;
     void create_entities(const MapData& data);
     void add_tile_info(const TileInfo& tile);
     void add_entity(const EntityPtr& entity);
@@ -124,6 +139,7 @@ class SOLARUS_API Entities {
     void bring_to_back(Entity& entity);
     void set_entity_layer(Entity& entity, int layer);
     void notify_entity_bounding_box_changed(Entity& entity);
+    void notify_ground_modifier_changed(const Entity& entity);
 
     // Specific to some entity types.
     bool overlaps_raised_blocks(int layer, const Rectangle& rectangle) ;
@@ -174,10 +190,38 @@ class SOLARUS_API Entities {
         int max;
     };
 
+    /**
+     * \brief Entities of a layer kept in drawing order from a cycle to the next.
+     *
+     * Entities drawn in Z order come first, in the order of the Z cache,
+     * and entities drawn in Y order follow, sorted by their Y coordinate.
+     * From a cycle to the next, only entities whose Y coordinate or
+     * drawing mode changed can break the order, so restoring it is cheap.
+     */
+    class DrawList {
+
+      public:
+
+        void add(const EntityPtr& entity);
+        void remove(const Entity& entity);
+        void bring_to_front(const Entity& entity);
+        void bring_to_back(const Entity& entity);
+        void sort(const Entities& entities);
+        void draw(const Rectangle& region);
+
+      private:
+
+        EntityVector z_ordered;                     /**< Entities drawn in Z order, from back to front. */
+        EntityVector y_ordered;                     /**< Entities drawn in Y order, from top to bottom. */
+    };
+
     void initialize_layers();
     void set_tile_ground(int layer, int x8, int y8, Ground ground);
+    void increment_ground_versions(int layer, const Rectangle& area);
     void remove_marked_entities();
     void notify_entity_removed(Entity& entity);
+    void add_entity_by_type(const EntityPtr& entity, int layer);
+    void remove_entity_by_type(const Entity& entity, int layer);
     void update_crystal_blocks();
 
     // map
@@ -187,11 +231,15 @@ class SOLARUS_API Entities {
     int map_height8;                                /**< Number of 8x8 squares on a column of the map grid */
 
     // tiles
-    int tiles_grid_size;                            /**< Number of 8x8 squares in the map
-                                                     * (tiles_grid_size = map_width8 * map_height8) */
-    ByLayer<std::vector<Ground>> tiles_ground;      /**< For each layer, list of size tiles_grid_size
-                                                     * representing the ground property
+    ByLayer<GroundGrid> tiles_ground;               /**< For each layer, the ground property
                                                      * of each 8x8 square. */
+    ByLayer<std::vector<uint32_t>>
+        ground_versions;                            /**< For each layer, a version of the ground of
+                                                     * each 8x8 square that changes whenever a tile
+                                                     * or an entity may have changed this ground. */
+    std::map<const Entity*, Rectangle>
+        ground_modifier_boxes;                      /**< Bounding box of each enabled entity
+                                                     * that modifies the ground. */
     ByLayer<std::unique_ptr<NonAnimatedRegions>>
         non_animated_regions;                       /**< For each layer, all non-animated tiles are managed
                                                      * here for performance. */
@@ -205,23 +253,36 @@ class SOLARUS_API Entities {
 
     std::map<std::string, EntityPtr>
         named_entities;                             /**< Entities identified by a name. */
-    EntityList all_entities;                        /**< All map entities except tiles and the hero. */
-    std::map<EntityType, ByLayer<EntitySet>>
-        entities_by_type;                           /**< All map entities except tiles, by type and then layer. */
-
-    EntityTree quadtree;                            /**< All map entities except tiles.
+    EntityVector all_entities;                      /**< All map entities except tiles and the hero,
+                                                     * in the order they were added. */
+    std::map<EntityType, ByLayer<EntityVector>>
+        entities_by_type;                           /**< All map entities except tiles, by type and then layer,
+                                                     * in arbitrary order. */
+    std::unordered_map<const Entity*, size_t>
+        entity_type_indexes;                        /**< Index of each entity in its vector of
+                                                     * entities_by_type, to remove it in constant time. */
+    std::shared_ptr<EntityPool> entity_pool;        /**< Memory of entities created with make_entity(). */
+
+    EntityTree quadtree;                            /**< All map entities except tiles
+                                                     * (they are owned by the lists above).
                                                      * Optimized for fast spatial search. */
     ByLayer<ZCache> z_caches;                       /**< For each layer, tracks the relative Z order of entities. */
+    CollisionBroadPhase collision_broad_phase;      /**< Batches collision checks during update(). */
     ByLayer<EntityVector>
         entities_drawn_not_at_their_position;       /**< For each layer, entities to draw even if there position
                                                      * is outside the camera. */
     ByLayer<EntitiesToDraw> entities_to_draw;       /**< For each layer, entities to be drawn at this cycle. */
+    ByLayer<DrawList> draw_lists;                   /**< For each layer, all entities in drawing order.
+                                                     * Only used if the incremental draw order is enabled. */
 
     EntityList entities_to_remove;                  /**< List of entities that need to be removed right now. */
 
     std::shared_ptr<Destination>
         default_destination;                        /**< Default destination of this map or nullptr. */
 
+    static bool incremental_draw_order_enabled;     /**< Whether draw lists replace sorting entities
+                                                     * to draw at each cycle. */
+
 };
 
 /**
@@ -241,7 +302,41 @@ class SOLARUS_API Entities {
  */
 inline Ground Entities::get_tile_ground(int layer, int x, int y) const {
 
-  return tiles_ground.at(layer)[(y >> 3) * map_width8 + (x >> 3)];
+  return tiles_ground.at(layer).get_ground(x, y);
+}
+
+/**
+ * \brief Returns the ground property of tiles of a layer as a grid.
+ *
+ * Only static tiles are considered here (not the dynamic entities).
+ *
+ * \param layer A layer.
+ * \return The ground of each 8x8 square of this layer.
+ */
+inline const GroundGrid& Entities::get_tile_ground_grid(int layer) const {
+
+  return tiles_ground.at(layer);
+}
+
+/**
+ * \brief Returns the version of the ground at the specified point.
+ *
+ * The version of an 8x8 square changes whenever a tile or an entity that
+ * modifies the ground may have changed the ground of this square.
+ * Versions are never reused, even on other maps: if the version is the
+ * same as before, the ground of the square is still the same.
+ * Version 0 is never used.
+ *
+ * This function assumes that the point is inside the map: for performance
+ * reasons, no check is done here.
+ *
+ * \param layer Layer of the point.
+ * \param xy Coordinates of the point.
+ * \return The ground version of the 8x8 square containing this point.
+ */
+inline uint32_t Entities::get_ground_version(int layer, const Point& xy) const {
+
+  return ground_versions.at(layer)[(xy.y >> 3) * map_width8 + (xy.x >> 3)];
 }
 
 /**
@@ -253,6 +348,29 @@ inline const CameraPtr& Entities::get_camera() const {
   return camera;
 }
 
+/**
+ * \brief Creates an entity for this map.
+ *
+ * If entity pools are enabled, the entity is allocated in the pool of this
+ * map. It can still be used like any other entity, including after the map
+ * is destroyed.
+ * The entity is not added to the map.
+ *
+ * \param args Arguments of the constructor of the entity.
+ * \return The entity created.
+ */
+template<typename T, typename... Args>
+std::shared_ptr<T> Entities::make_entity(Args&&... args) {
+
+  if (!EntityPool::is_enabled()) {
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+  return std::allocate_shared<T>(
+      EntityPool::Allocator<T>(entity_pool),
+      std::forward<Args>(args)...
+  );
+}
+
 /**
  * \brief Returns all entities of a type.
  * \return All entities of the type.
@@ -315,7 +433,7 @@ std::set<std::shared_ptr<const T>> Entities::get_entities_by_type(int layer) con
     return result;
   }
 
-  const ByLayer<EntitySet>& sets = it->second;
+  const ByLayer<EntityVector>& sets = it->second;
   const auto& layer_it = sets.find(layer);
   if (layer_it == sets.end()) {
     return result;
@@ -342,7 +460,7 @@ std::set<std::shared_ptr<T>> Entities::get_entities_by_type(int layer) {
     return result;
   }
 
-  const ByLayer<EntitySet>& sets = it->second;
+  const ByLayer<EntityVector>& sets = it->second;
   const auto& layer_it = sets.find(layer);
   if (layer_it == sets.end()) {
     return result;
@@ -229,6 +229,7 @@ class SOLARUS_API Entity: public ExportableToLua {
 
     virtual void notify_obstacle_reached();
     virtual void notify_position_changed();
+    void notify_position_swept(Movement& movement, const std::vector<Point>& positions);
     virtual void notify_layer_changed();
     virtual void notify_ground_below_changed();
     virtual void notify_movement_started();
@@ -333,6 +334,7 @@ class SOLARUS_API Entity: public ExportableToLua {
     virtual bool is_obstacle_for(Entity& other);
     virtual bool is_obstacle_for(Entity& other, const Rectangle& candidate_position);
     bool is_ground_obstacle(Ground ground) const;
+    virtual int get_obstacle_traits() const;
     virtual bool is_hero_obstacle(Hero& hero);
     virtual bool is_block_obstacle(Block& block);
     virtual bool is_teletransporter_obstacle(Teletransporter& teletransporter);
@@ -427,6 +429,7 @@ class SOLARUS_API Entity: public ExportableToLua {
     void finish_initialization();
     void clear_old_movements();
     void clear_old_sprites();
+    void notify_movement_swept_to(Movement& movement, const Point& xy);
 
     MainLoop* main_loop;                        /**< The Solarus main loop. */
     Map* map;                                   /**< The map where this entity is, or nullptr
@@ -443,6 +446,11 @@ class SOLARUS_API Entity: public ExportableToLua {
 
     Ground ground_below;                        /**< Kind of ground under this entity: grass, shallow water, etc.
                                                  * Only used by entities sensible to their ground. */
+    Point ground_below_point;                   /**< Ground point where ground_below was determined. */
+    int ground_below_layer;                     /**< Layer where ground_below was determined. */
+    uint32_t ground_below_version;              /**< Ground version of the 8x8 square of ground_below_point
+                                                 * when ground_below was determined, or 0 if unknown
+                                                 * (see Entities::get_ground_version()). */
 
     Point origin;                               /**< Coordinates of the origin point of the entity,
                                                  * relative to the top-left corner of its rectangle.
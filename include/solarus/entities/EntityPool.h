@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_ENTITY_POOL_H
+#define SOLARUS_ENTITY_POOL_H
+
+#include "solarus/Common.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Solarus {
+
+/**
+ * \brief Memory of the entities created on a map.
+ *
+ * Entities created in bursts, like pickable treasures, explosions or arrows,
+ * are allocated together with their reference count in blocks of a few
+ * size classes.
+ * Blocks freed by removed entities are reused by the next entities of the
+ * same size class instead of going back to the system allocator.
+ *
+ * Each entity allocated here keeps the pool alive, so an entity still
+ * referenced by Lua after its map is destroyed remains valid.
+ * Entities are created and destroyed by the main thread only.
+ *
+ * This is disabled by default.
+ */
+class SOLARUS_API EntityPool {
+
+  public:
+
+    /**
+     * \brief Standard allocator that takes its memory from an entity pool.
+     *
+     * Each copy of the allocator keeps the pool alive.
+     */
+    template<typename T>
+    class Allocator {
+
+      public:
+
+        using value_type = T;
+
+        template<typename U>
+        struct rebind {
+          using other = Allocator<U>;
+        };
+
+        explicit Allocator(const std::shared_ptr<EntityPool>& pool);
+        template<typename U>
+        Allocator(const Allocator<U>& other);
+
+        T* allocate(std::size_t n);
+        void deallocate(T* p, std::size_t n);
+
+        const std::shared_ptr<EntityPool>& get_pool() const;
+
+      private:
+
+        std::shared_ptr<EntityPool> pool;   /**< The pool that provides the memory. */
+    };
+
+    EntityPool();
+
+    EntityPool(const EntityPool& other) = delete;
+    EntityPool& operator=(const EntityPool& other) = delete;
+
+    static bool is_enabled();
+    static void set_enabled(bool enabled);
+
+    void* allocate(std::size_t size);
+    void deallocate(void* block, std::size_t size);
+
+    int get_num_chunks() const;
+    int get_num_blocks_used() const;
+
+  private:
+
+    /**
+     * \brief A free block, linked to the next free block of its size class.
+     */
+    struct FreeBlock {
+      FreeBlock* next;                      /**< Next free block or nullptr. */
+    };
+
+    static constexpr std::size_t
+        block_granularity = 64;             /**< Blocks sizes are multiples of this. */
+    static constexpr std::size_t
+        max_block_size = 4096;              /**< Bigger objects use the system allocator. */
+    static constexpr int
+        blocks_per_chunk = 16;              /**< Blocks allocated at once for a size class. */
+
+    std::vector<FreeBlock*> free_lists;     /**< First free block of each size class. */
+    std::vector<std::unique_ptr<char[]>>
+        chunks;                             /**< Memory of all blocks. */
+    int num_blocks_used;                    /**< Blocks currently given to objects. */
+
+    static bool enabled;                    /**< Whether entities are allocated in pools. */
+
+};
+
+/**
+ * \brief Creates an allocator.
+ * \param pool The pool to take memory from.
+ */
+template<typename T>
+EntityPool::Allocator<T>::Allocator(const std::shared_ptr<EntityPool>& pool):
+  pool(pool) {
+
+}
+
+/**
+ * \brief Creates an allocator of another type using the same pool.
+ * \param other The allocator to copy.
+ */
+template<typename T>
+template<typename U>
+EntityPool::Allocator<T>::Allocator(const Allocator<U>& other):
+  pool(other.get_pool()) {
+
+}
+
+/**
+ * \brief Allocates memory for objects.
+ * \param n Number of objects.
+ * \return The allocated memory.
+ */
+template<typename T>
+T* EntityPool::Allocator<T>::allocate(std::size_t n) {
+  return static_cast<T*>(pool->allocate(n * sizeof(T)));
+}
+
+/**
+ * \brief Frees memory allocated by allocate().
+ * \param p The memory to free.
+ * \param n Number of objects it was allocated for.
+ */
+template<typename T>
+void EntityPool::Allocator<T>::deallocate(T* p, std::size_t n) {
+  pool->deallocate(p, n * sizeof(T));
+}
+
+/**
+ * \brief Returns the pool of this allocator.
+ * \return The pool.
+ */
+template<typename T>
+const std::shared_ptr<EntityPool>& EntityPool::Allocator<T>::get_pool() const {
+  return pool;
+}
+
+/**
+ * \brief Returns whether two allocators use the same pool.
+ * \param lhs An allocator.
+ * \param rhs Another allocator.
+ * \return \c true if memory allocated by one can be freed by the other.
+ */
+template<typename T, typename U>
+bool operator==(const EntityPool::Allocator<T>& lhs, const EntityPool::Allocator<U>& rhs) {
+  return lhs.get_pool() == rhs.get_pool();
+}
+
+/**
+ * \brief Returns whether two allocators use different pools.
+ * \param lhs An allocator.
+ * \param rhs Another allocator.
+ * \return \c true if memory allocated by one cannot be freed by the other.
+ */
+template<typename T, typename U>
+bool operator!=(const EntityPool::Allocator<T>& lhs, const EntityPool::Allocator<U>& rhs) {
+  return !(lhs == rhs);
+}
+
+}
+
+#endif
+
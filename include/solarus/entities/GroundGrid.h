@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_GROUND_GRID_H
+#define SOLARUS_GROUND_GRID_H
+
+#include "solarus/Common.h"
+#include "solarus/entities/Ground.h"
+#include <cstdint>
+#include <vector>
+
+namespace Solarus {
+
+class Rectangle;
+
+/**
+ * \brief Dense raster of the tile grounds of a map layer.
+ *
+ * Each 8x8 square of the layer has one ground.
+ * In addition to this plain array, the grid keeps for each ground a bitset
+ * of the squares that have this ground, both row by row and column by
+ * column.
+ * This allows to test a whole border of a collision box against a set of
+ * obstacle grounds with a few word-wide operations instead of
+ * sampling points one by one.
+ *
+ * Diagonal walls are resolved at the pixel level:
+ * only the squares of the border that have a diagonal ground are
+ * examined individually, with pixel masks of their obstacle half.
+ */
+class SOLARUS_API GroundGrid {
+
+  public:
+
+    static constexpr int num_grounds =
+        static_cast<int>(Ground::LAVA) + 1;     /**< Number of values of Ground. */
+
+    GroundGrid();
+    GroundGrid(int width8, int height8, Ground initial_ground);
+
+    int get_width8() const;
+    int get_height8() const;
+
+    Ground get_ground(int x, int y) const;
+    Ground get_ground8(int x8, int y8) const;
+    void set_ground8(int x8, int y8, Ground ground);
+
+    bool has_obstacle_on_border(
+        const Rectangle& box,
+        uint32_t obstacle_grounds
+    ) const;
+
+  private:
+
+    bool has_obstacle_on_row(
+        int y, int x1, int x2, uint32_t obstacle_grounds) const;
+    bool has_obstacle_on_column(
+        int x, int y1, int y2, uint32_t obstacle_grounds) const;
+
+    int width8;                         /**< Number of squares in a row. */
+    int height8;                        /**< Number of squares in a column. */
+    int row_words;                      /**< Number of 64-bit words of a row bitset. */
+    int column_words;                   /**< Number of 64-bit words of a column bitset. */
+    std::vector<uint8_t> cells;         /**< Ground of each square, row by row. */
+    std::vector<std::vector<uint64_t>>
+        row_bits;                       /**< For each ground, one bitset per row
+                                         * with bit x8 set if square (x8, y8)
+                                         * has this ground. */
+    std::vector<std::vector<uint64_t>>
+        column_bits;                    /**< For each ground, one bitset per column
+                                         * with bit y8 set if square (x8, y8)
+                                         * has this ground. */
+
+};
+
+/**
+ * \brief Returns the ground at the specified point.
+ *
+ * For performance reasons, no check is done on the coordinates.
+ *
+ * \param x X coordinate of the point in pixels.
+ * \param y Y coordinate of the point in pixels.
+ * \return The ground of the 8x8 square containing this point.
+ */
+inline Ground GroundGrid::get_ground(int x, int y) const {
+
+  return static_cast<Ground>(cells[(y >> 3) * width8 + (x >> 3)]);
+}
+
+/**
+ * \brief Returns the ground of an 8x8 square.
+ *
+ * For performance reasons, no check is done on the coordinates.
+ *
+ * \param x8 X coordinate of the square (divided by 8).
+ * \param y8 Y coordinate of the square (divided by 8).
+ * \return The ground of this square.
+ */
+inline Ground GroundGrid::get_ground8(int x8, int y8) const {
+
+  return static_cast<Ground>(cells[y8 * width8 + x8]);
+}
+
+}
+
+#endif
+
@@ -86,6 +86,7 @@ class SOLARUS_API Npc: public Entity {
     void set_traversable(bool traversable);
 
     virtual bool is_obstacle_for(Entity& other) override;
+    virtual int get_obstacle_traits() const override;
     virtual bool is_hero_obstacle(Hero& hero) override;
     virtual bool is_npc_obstacle(Npc& npc) override;
     virtual bool is_enemy_obstacle(Enemy& enemy) override;
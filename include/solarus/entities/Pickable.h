@@ -47,7 +47,7 @@ class Pickable: public Entity {
     );
 
     static std::shared_ptr<Pickable> create(
-        Game& game,
+        Entities& entities,
         const std::string& name,
         int layer,
         const Point& xy,
@@ -52,6 +52,7 @@ class Tileset {
     const SurfacePtr& get_entities_image() const;
     const TilePattern& get_tile_pattern(const std::string& id) const;
     void set_images(const std::string& other_id);
+    size_t get_memory_size() const;
 
   private:
 
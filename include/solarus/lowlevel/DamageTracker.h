@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_DAMAGE_TRACKER_H
+#define SOLARUS_DAMAGE_TRACKER_H
+
+#include "solarus/Common.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/SurfacePtr.h"
+#include <cstdint>
+#include <vector>
+
+namespace Solarus {
+
+class Surface;
+
+/**
+ * \brief Redraws only the regions of a surface that change between frames.
+ *
+ * A surface that tracks its damage does not draw immediately what is drawn
+ * onto it during a frame: the drawing operations are recorded instead.
+ * When the frame is finished, they are compared to the operations of the
+ * previous frame.
+ * Operations that appeared, disappeared, moved or whose source surface
+ * changed give the damaged rectangles, and only these rectangles are
+ * redrawn, by replaying the operations clipped to them.
+ *
+ * Operations that cannot be recorded, like reading the pixels of the surface
+ * during the frame or modifying a source already drawn, flush the recording:
+ * everything is drawn immediately and the whole surface is considered
+ * damaged.
+ *
+ * This only works with surfaces drawn in RAM, that is, software destinations
+ * or any surface when 2D acceleration is disabled.
+ * This is disabled by default.
+ */
+class SOLARUS_API DamageTracker {
+
+  public:
+
+    explicit DamageTracker(Surface& surface);
+    ~DamageTracker();
+
+    DamageTracker(const DamageTracker& other) = delete;
+    DamageTracker& operator=(const DamageTracker& other) = delete;
+
+    static bool is_enabled();
+    static void set_enabled(bool enabled);
+    static void notify_source_changed(const Surface& src_surface);
+
+    bool is_recording() const;
+    bool is_replaying() const;
+    void start();
+    void finish();
+    void flush();
+    void invalidate();
+
+    bool record_clear();
+    void record_draw(
+        Surface& src_surface,
+        const Rectangle& region,
+        const Point& dst_position
+    );
+
+    bool get_damage_since(
+        uint64_t old_version,
+        uint64_t new_version,
+        std::vector<Rectangle>& damage
+    ) const;
+    bool get_render_damage(std::vector<Rectangle>& damage) const;
+    void clear_render_damage();
+
+  private:
+
+    /**
+     * \brief What identifies a drawing operation from one frame to another.
+     */
+    struct OperationKey {
+      uint64_t src_id;                    /**< Unique id of the source surface, or 0 for a color. */
+      uint32_t color;                     /**< Color value of a color source. */
+      int blend_mode;                     /**< Blend mode of the source. */
+      Rectangle region;                   /**< Region of the source drawn. */
+      Point dst_position;                 /**< Where the region is drawn. */
+
+      bool operator==(const OperationKey& other) const;
+    };
+
+    /**
+     * \brief Hash function of operation keys.
+     */
+    struct OperationKeyHash {
+      size_t operator()(const OperationKey& key) const;
+    };
+
+    /**
+     * \brief A recorded drawing operation.
+     */
+    struct Operation {
+      OperationKey key;                   /**< How the operation is identified. */
+      uint64_t src_version;               /**< Content version of the source when drawn. */
+      Rectangle dst_rect;                 /**< Rectangle of the surface drawn by the operation. */
+      SurfacePtr src_surface;             /**< The source surface, until replayed. */
+    };
+
+    Rectangle get_dst_rect(
+        const Surface& src_surface,
+        const Rectangle& region,
+        const Point& dst_position
+    ) const;
+    void compute_damage();
+    void add_damage(const Rectangle& rectangle);
+    void merge_damage();
+    void replay(const Rectangle& clip_rect);
+    void stop_recording();
+
+    Surface& surface;                   /**< The surface whose damage is tracked. */
+    bool recording;                     /**< Whether drawings are being recorded. */
+    bool replaying;                     /**< Whether recorded drawings are being replayed. */
+    bool flushed;                       /**< Whether the current frame was flushed. */
+    bool clear_first;                   /**< Whether the frame starts by clearing the surface. */
+    uint64_t stamp;                     /**< Stamp of the current recording. */
+    std::vector<Operation> operations;  /**< Operations recorded during the current frame. */
+    std::vector<Operation>
+        previous_operations;            /**< Operations of the previous frame, without their sources. */
+    bool previous_valid;                /**< Whether the surface shows exactly the previous operations. */
+    std::vector<Rectangle> damage;      /**< Damaged rectangles of the current frame. */
+    uint64_t damage_old_version;        /**< Content version of the surface before the last damage. */
+    uint64_t damage_new_version;        /**< Content version of the surface after the last damage. */
+    std::vector<Rectangle>
+        render_damage;                  /**< Rectangles changed since the last rendering. */
+    bool render_damage_full;            /**< Whether the whole surface changed since the last rendering. */
+
+};
+
+}
+
+#endif
+
@@ -19,6 +19,7 @@
 
 #include "solarus/Common.h"
 #include <string>
+#include <vector>
 
 #ifndef NDEBUG
 #define SOLARUS_ASSERT(condition, message) Debug::check_assertion(condition, message)
@@ -38,6 +39,7 @@ namespace Debug {
 SOLARUS_API void set_die_on_error(bool die);
 SOLARUS_API void set_show_popup_on_die(bool show);
 SOLARUS_API void set_abort_on_die(bool abort);
+SOLARUS_API void set_error_collector(std::vector<std::string>* collector);
 
 SOLARUS_API void warning(const std::string& message);
 SOLARUS_API void error(const std::string& message);
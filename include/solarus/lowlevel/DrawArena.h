@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_DRAW_ARENA_H
+#define SOLARUS_DRAW_ARENA_H
+
+#include "solarus/Common.h"
+#include "solarus/lowlevel/Color.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/SurfacePtr.h"
+#include <cstdint>
+
+namespace Solarus {
+
+class Point;
+
+/**
+ * \brief Stores the drawings made on GPU surfaces during a frame.
+ *
+ * When a drawing is requested, if the destination surface is in GPU, no
+ * drawing actually occurs: instead, a record is appended to this arena.
+ * At rendering time, the records are flattened into a RenderQueue to perform
+ * all drawings accelerated in GPU.
+ *
+ * Each surface has a list of the records drawn on itself. Records of a list
+ * are linked by index, and each record keeps a snapshot of the list of its
+ * source surface at the time of the drawing, so nothing is copied.
+ *
+ * All records are released at once when a new frame starts, but the memory
+ * is kept for the next frames.
+ */
+class SOLARUS_API DrawArena {
+
+  public:
+
+    /**
+     * \brief Drawings made on a surface.
+     */
+    struct List {
+      int first = -1;                   /**< Index of the first record, or -1. */
+      int last = -1;                    /**< Index of the last record, or -1. */
+      int size = 0;                     /**< Number of records of the list. */
+      uint64_t generation = 0;          /**< Frame when the list was filled. */
+    };
+
+    /**
+     * \brief A surface or a color drawn on another surface.
+     */
+    struct Record {
+      SurfacePtr src_surface;           /**< Surface to draw, or nullptr to fill a color. */
+      Color color;                      /**< Color to fill if there is no surface. */
+      Rectangle src_rect;               /**< Region of the surface to draw. */
+      Rectangle dst_rect;               /**< Where to draw, relative to the parent surface. */
+      List children;                    /**< Records drawn onto the source surface. */
+      int next;                         /**< Index of the next record of the parent list, or -1. */
+    };
+
+    static void quit();
+
+    static void add(
+        List& list,
+        const SurfacePtr& src_surface,
+        const List& src_children,
+        const Rectangle& region,
+        const Point& dst_position
+    );
+    static void add_fill(List& list, const Color& color, const Rectangle& where);
+    static void clear(List& list);
+    static bool is_empty(const List& list);
+    static const Record& get_record(int index);
+
+    static void finish_frame();
+    static int get_num_records();
+    static int get_num_allocations();
+
+};
+
+}
+
+#endif
+
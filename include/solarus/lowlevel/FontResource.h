@@ -18,10 +18,15 @@
 #define SOLARUS_FONT_RESOURCE_H
 
 #include "solarus/Common.h"
+#include "solarus/lowlevel/Rectangle.h"
 #include "solarus/lowlevel/SurfacePtr.h"
+#include "solarus/lowlevel/TextSurface.h"
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <SDL_ttf.h>
 
 namespace Solarus {
@@ -31,8 +36,61 @@ namespace Solarus {
  */
 class FontResource {
 
+  private:
+
+    struct SDL_Surface_Deleter {
+      void operator()(SDL_Surface* sdl_surface) {
+        SDL_FreeSurface(sdl_surface);
+      }
+    };
+    using SDL_Surface_UniquePtr = std::unique_ptr<SDL_Surface, SDL_Surface_Deleter>;
+
   public:
 
+    /**
+     * \brief A character rendered in a glyph atlas.
+     */
+    struct Glyph {
+      Rectangle rect;                                 /**< Region of the glyph in the atlas,
+                                                       * empty if the glyph has no pixels. */
+      int bearing;                                    /**< Where the pixels of the glyph start
+                                                       * relative to the pen position. */
+      int advance;                                    /**< Where the next glyph starts. */
+    };
+
+    /**
+     * \brief The characters already rendered with an outline font, a size
+     * and a rendering mode.
+     *
+     * Each glyph is rendered like a text of one character, so all of them
+     * have the height of a line. They are packed in rows of an atlas image
+     * that grows when it is full.
+     * Glyphs are rendered in white: texts modulate them with their color.
+     */
+    class GlyphAtlas {
+
+      public:
+
+        GlyphAtlas(TTF_Font& font, TextSurface::RenderingMode rendering_mode);
+
+        SDL_Surface* get_surface() const;
+        int get_line_height() const;
+        const Glyph& get_glyph(uint16_t code_point);
+        int get_kerning(uint16_t previous_code_point, uint16_t code_point) const;
+
+      private:
+
+        void add_glyph(uint16_t code_point, Glyph& glyph);
+        void grow(int min_width, int min_height);
+
+        TTF_Font& font;                               /**< The font in the size of this atlas. */
+        TextSurface::RenderingMode rendering_mode;    /**< How glyphs are rendered. */
+        int line_height;                              /**< Height of rows of the atlas. */
+        SDL_Surface_UniquePtr surface;                /**< The atlas image. */
+        Point next_position;                          /**< Where the next glyph goes in the atlas. */
+        std::unordered_map<uint16_t, Glyph> glyphs;   /**< Glyphs rendered so far. */
+    };
+
     static void initialize();
     static void quit();
 
@@ -42,6 +100,14 @@ class FontResource {
     static SurfacePtr get_bitmap_font(const std::string& font_id);
     static TTF_Font& get_outline_font(const std::string& font_id, int size);
 
+    static bool is_glyph_cache_enabled();
+    static void set_glyph_cache_enabled(bool glyph_cache_enabled);
+    static GlyphAtlas& get_glyph_atlas(
+        const std::string& font_id,
+        int size,
+        TextSurface::RenderingMode rendering_mode
+    );
+
   private:
 
     struct SDL_RWops_Deleter {
@@ -77,12 +143,16 @@ class FontResource {
       std::map<int, OutlineFontReader>
           outline_fonts;                              /**< This font in any size it was loaded with.
                                                        * Only used for outline fonts. */
+      std::map<std::pair<int, TextSurface::RenderingMode>, std::unique_ptr<GlyphAtlas>>
+          glyph_atlases;                              /**< Glyphs rendered by size and rendering
+                                                       * mode. Only used for outline fonts. */
     };
 
     static void load_fonts();
 
     static bool fonts_loaded;
-    static std::map<std::string, FontFile> fonts;
+    static bool glyph_cache_enabled;
+    static std::map<std::string, std::shared_ptr<FontFile>> fonts;
 
 };
 
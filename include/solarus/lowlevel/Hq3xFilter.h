@@ -33,11 +33,17 @@ class Hq3xFilter: public PixelFilter {
     Hq3xFilter();
 
     virtual int get_scaling_factor() const override;
-    virtual void filter(
+
+  protected:
+
+    virtual void prepare() const override;
+    virtual void filter_rows(
         const uint32_t* src,
         int src_width,
         int src_height,
-        uint32_t* dst
+        uint32_t* dst,
+        int first_row,
+        int last_row
     ) const override;
 
 };
@@ -27,15 +27,16 @@ namespace Solarus {
 /**
  * \brief Encapsulates the Ogg Vorbis music decoding.
  */
-class OggDecoder {
+class SOLARUS_API OggDecoder {
 
   public:
 
     OggDecoder();
 
-    bool load(std::string&& ogg_data, bool loop);
+    bool load(const std::shared_ptr<const std::string>& ogg_data, bool loop);
     void unload();
-    void decode(ALuint destination_buffer, ALsizei nb_samples);
+    void set_stereo_output(bool stereo_output);
+    ALsizei decode(ALuint destination_buffer, ALsizei nb_samples);
 
   private:
 
@@ -55,6 +56,7 @@ class OggDecoder {
                                         * -1 means no loop. */
     ogg_int64_t loop_end_pcm;          /**< Where to loop from in PCM samples.
                                         * -1 means no loop. */
+    bool stereo_output;                /**< Whether to convert mono data to stereo. */
 
 };
 
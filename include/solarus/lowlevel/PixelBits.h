@@ -18,13 +18,13 @@
 #define SOLARUS_PIXEL_BITS_H
 
 #include "solarus/Common.h"
+#include "solarus/lowlevel/Rectangle.h"
 #include <cstdint>
 #include <vector>
 
 namespace Solarus {
 
 class Point;
-class Rectangle;
 class Surface;
 
 /**
@@ -33,6 +33,12 @@ class Surface;
  * This class stores efficiently the location of the non-transparent pixels of a surface.
  * For each pixel of the image, a bit indicates whether this pixel is transparent.
  * This class perform fast pixel-perfect collision checks.
+ *
+ * Bits are stored in 64-bit words, the leftmost pixel being the most
+ * significant bit.
+ * Words are stored column by column in a single buffer: the words of
+ * consecutive rows are contiguous, so that SIMD instructions can test
+ * several rows at once.
  */
 class PixelBits {
 
@@ -43,22 +49,49 @@ class PixelBits {
     bool test_collision(const PixelBits& other,
         const Point& location1, const Point& location2) const;
 
+    const Rectangle& get_opaque_box() const;
+
   private:
 
+    const uint64_t* get_column(int column) const;
+
     void print() const;
-    void print_mask(uint32_t mask) const;
+    void print_mask(uint64_t mask) const;
 
     int width;               /**< width of the image in pixels */
     int height;              /**< height of the image in pixels */
-    int nb_integers_per_row; /**< number of uint32_t necessary to store
+    int nb_columns;          /**< number of uint64_t necessary to store
                               * the bits of a row of the image */
 
-    std::vector<std::vector<uint32_t>>
-        bits;                /**< A two-dimensional array representing the
-                              * transparency bit of each pixel in the image. */
+    std::vector<uint64_t>
+        bits;                /**< The transparency bit of each pixel,
+                              * column of words by column of words.
+                              * An additional column of zeros
+                              * ends the buffer. */
+
+    Rectangle opaque_box;    /**< Smallest rectangle containing all opaque
+                              * pixels, relative to the image. */
 
 };
 
+/**
+ * \brief Returns the smallest rectangle containing all opaque pixels.
+ * \return The opaque area relative to the image, or a flat rectangle
+ * if the image is fully transparent.
+ */
+inline const Rectangle& PixelBits::get_opaque_box() const {
+  return opaque_box;
+}
+
+/**
+ * \brief Returns the words of a column of 64 pixels, one per row.
+ * \param column Index of a column, between 0 and nb_columns included.
+ * \return The first word of this column.
+ */
+inline const uint64_t* PixelBits::get_column(int column) const {
+  return bits.data() + column * height;
+}
+
 }
 
 #endif
@@ -24,6 +24,9 @@ namespace Solarus {
 
 /**
  * \brief Abstract class for pixel filtering algorithms.
+ *
+ * Output rows only depend on the source image, so the image is split into
+ * bands of rows that are filtered in parallel.
  */
 class PixelFilter {
 
@@ -38,21 +41,40 @@ class PixelFilter {
      */
     virtual int get_scaling_factor() const = 0;
 
+    void filter(
+        const uint32_t* src,
+        int src_width,
+        int src_height,
+        uint32_t* dst
+    ) const;
+
+  protected:
+
+    virtual void prepare() const;
+
     /**
-     * \brief Applies the algorithm on a rectangle of pixels.
-     * \param src The rectangle of pixels in RGBA format.
-     * Must be a buffer of size src_width * dst_width.
+     * \brief Applies the algorithm on some rows of a rectangle of pixels.
+     *
+     * This function may be called from several threads at the same time
+     * with different rows.
+     *
+     * \param src The whole rectangle of pixels in RGBA format.
+     * Must be a buffer of size src_width * src_height.
      * \param src_width Width of the rectangle.
      * \param src_height Height of the rectangle.
-     * \param dst The destination rectangle to write.
+     * \param dst The whole destination rectangle.
      * Must be a buffer of size
-     * src_width * dst_width * get_scaling_factor().
+     * src_width * src_height * get_scaling_factor() * get_scaling_factor().
+     * \param first_row First source row to filter.
+     * \param last_row Source row after the last one to filter.
      */
-    virtual void filter(
+    virtual void filter_rows(
         const uint32_t* src,
         int src_width,
         int src_height,
-        uint32_t* dst
+        uint32_t* dst,
+        int first_row,
+        int last_row
     ) const = 0;
 
 };
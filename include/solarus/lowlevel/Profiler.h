@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_PROFILER_H
+#define SOLARUS_PROFILER_H
+
+#include "solarus/Common.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Solarus {
+
+/**
+ * \brief Measures the real time spent in each phase of the main loop.
+ *
+ * When enabled, the main loop opens a new frame record at each cycle and
+ * the instrumented phases add their duration to it.
+ * Frame records also hold a few counters of work done during the cycle.
+ * The records can then be exported to a CSV or JSON file.
+ *
+ * When disabled (the default), the instrumentation costs a single test.
+ */
+namespace Profiler {
+
+/**
+ * \brief The phases of a main loop cycle that are measured.
+ */
+enum class Phase {
+  INPUT,                  /**< MainLoop::check_input(). */
+  GAME_UPDATE,            /**< Game::update(). */
+  LUA_UPDATE,             /**< LuaContext::update(). */
+  ENTITIES_DRAW,          /**< Entities::draw(). */
+  NB_PHASES
+};
+
+/**
+ * \brief Quantities of work counted during a main loop cycle.
+ */
+enum class Counter {
+  PIXELS_REDRAWN,         /**< Pixels redrawn by damage tracking surfaces. */
+  GROUND_BELOW_HITS,      /**< Entity::update_ground_below() calls that reused
+                           * the known ground. */
+  GROUND_BELOW_MISSES,    /**< Entity::update_ground_below() calls that
+                           * determined the ground again. */
+  DRAW_RECORDS,           /**< Drawings recorded on GPU surfaces. */
+  DRAW_ARENA_ALLOCATIONS, /**< Times the storage of GPU drawings had to grow. */
+  GLYPH_CACHE_HITS,       /**< Characters of texts found already rendered. */
+  GLYPH_CACHE_MISSES,     /**< Characters of texts that had to be rendered. */
+  NB_COUNTERS
+};
+
+SOLARUS_API void set_enabled(bool enabled);
+SOLARUS_API bool is_enabled();
+SOLARUS_API void quit();
+
+SOLARUS_API void start_frame();
+SOLARUS_API int get_num_frames();
+SOLARUS_API void add_phase_time(Phase phase, uint64_t duration);
+SOLARUS_API uint64_t get_phase_time(int frame, Phase phase);
+SOLARUS_API void add_counter(Counter counter, uint64_t value);
+SOLARUS_API uint64_t get_counter(int frame, Counter counter);
+
+SOLARUS_API bool save(const std::string& file_name);
+
+/**
+ * \brief Measures the duration of a phase during the lifetime of this object.
+ */
+class SOLARUS_API PhaseTimer {
+
+  public:
+
+    explicit PhaseTimer(Phase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer& other) = delete;
+    PhaseTimer& operator=(const PhaseTimer& other) = delete;
+
+  private:
+
+    Phase phase;                /**< The phase being measured. */
+    bool enabled;               /**< Whether the profiler was enabled at creation time. */
+    std::chrono::steady_clock::time_point
+        start_date;             /**< Real date when the measure started. */
+
+};
+
+}  // namespace Profiler
+
+}  // namespace Solarus
+
+#endif
+
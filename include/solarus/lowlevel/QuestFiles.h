@@ -75,6 +75,10 @@ SOLARUS_API void data_file_save(
     const std::string& file_name,
     const std::string& buffer
 );
+SOLARUS_API bool data_file_replace(
+    const std::string& file_name,
+    const std::string& buffer
+);
 SOLARUS_API bool data_file_delete(const std::string& file_name);
 SOLARUS_API bool data_file_mkdir(const std::string& dir_name);
 SOLARUS_API std::vector<std::string> data_files_enumerate(
@@ -36,7 +36,12 @@ namespace Solarus {
 class Rectangle {
 
   // low-level classes allowed to manipulate directly the internal SDL rectangle encapsulated
+  friend class DamageTracker;
+  friend class FontResource;
+  friend class RenderQueue;
   friend class Surface;
+  friend class TextSurface;
+  friend class TextureAtlas;
   friend class Video;
 
   public:
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_RENDER_QUEUE_H
+#define SOLARUS_RENDER_QUEUE_H
+
+#include "solarus/Common.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include <SDL.h>
+#include <cstdint>
+#include <vector>
+
+namespace Solarus {
+
+/**
+ * \brief Collects the GPU drawings of a frame and submits them in batches.
+ *
+ * Drawings are added in their painter's order.
+ * When batching is enabled, a texture copy is moved back into an earlier
+ * batch with the same texture and blend mode if nothing drawn in between
+ * overlaps it, so that the result is unchanged.
+ * Each batch is then submitted with a single SDL_RenderGeometry() call
+ * when the SDL version supports it.
+ *
+ * When batching is disabled (the default), drawings are submitted one by
+ * one in their order, like before.
+ */
+class SOLARUS_API RenderQueue {
+
+  public:
+
+    RenderQueue();
+
+    static bool is_batching_enabled();
+    static void set_batching_enabled(bool batching_enabled);
+
+    void add_copy(
+        SDL_Texture* texture,
+        SDL_BlendMode blend_mode,
+        uint8_t opacity,
+        const Rectangle& src_rect,
+        const Rectangle& dst_rect
+    );
+    void add_fill(
+        uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+        const Rectangle& dst_rect
+    );
+
+    int get_num_commands() const;
+    int get_num_batches() const;
+
+    void submit(SDL_Renderer* renderer);
+
+  private:
+
+    /**
+     * \brief A drawing to perform.
+     */
+    struct Command {
+      SDL_Texture* texture;             /**< Texture to copy, or nullptr to fill a color. */
+      SDL_BlendMode blend_mode;         /**< Blend mode of the texture. */
+      uint8_t r, g, b, a;               /**< Fill color, or opacity of the copy in a. */
+      Rectangle src_rect;               /**< Region of the texture to copy. */
+      Rectangle dst_rect;               /**< Where to draw on the renderer. */
+    };
+
+    /**
+     * \brief Consecutive drawings that share the same rendering state.
+     */
+    struct Batch {
+      SDL_Texture* texture;             /**< Texture of the batch, or nullptr for a fill. */
+      SDL_BlendMode blend_mode;         /**< Blend mode of the batch. */
+      Rectangle bounding_box;           /**< Union of the destinations of the batch. */
+      std::vector<int> commands;        /**< Indexes of the commands in the batch. */
+    };
+
+    void add_command(const Command& command);
+    void submit_commands(SDL_Renderer* renderer, const Batch& batch);
+    void submit_geometry(SDL_Renderer* renderer, const Batch& batch);
+
+    std::vector<Command> commands;      /**< All commands of the frame. */
+    std::vector<Batch> batches;         /**< Commands grouped in their drawing order. */
+
+};
+
+}
+
+#endif
+
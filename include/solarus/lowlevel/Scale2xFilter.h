@@ -35,11 +35,16 @@ class Scale2xFilter: public PixelFilter {
     Scale2xFilter();
 
     virtual int get_scaling_factor() const override;
-    virtual void filter(
+
+  protected:
+
+    virtual void filter_rows(
         const uint32_t* src,
         int src_width,
         int src_height,
-        uint32_t* dst
+        uint32_t* dst,
+        int first_row,
+        int last_row
     ) const override;
 
 };
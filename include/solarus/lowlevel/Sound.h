@@ -20,7 +20,8 @@
 #include "solarus/Common.h"
 #include <string>
 #include <list>
-#include <map>
+#include <memory>
+#include <vector>
 #include <al.h>
 #include <alc.h>
 #include <vorbis/vorbisfile.h>
@@ -28,6 +29,7 @@
 namespace Solarus {
 
 class Arguments;
+class OggDecoder;
 
 /**
  * \brief Represents a sound effect that can be played in the program.
@@ -35,10 +37,13 @@ class Arguments;
  * This class also handles the initialization of the whole audio system.
  * To create a sound, prefer the Sound::play() method
  * rather than calling directly the constructor of Sound.
+ * Decoded sounds are kept in the resource cache.
+ * Sounds too long to be decoded at once are streamed when played,
+ * like musics.
  * This class is the only one that depends on the sound decoding library (libsndfile).
  * This class and the Music class are the only ones that depend on the audio mixer library (OpenAL).
  */
-class SOLARUS_API Sound {
+class SOLARUS_API Sound: public std::enable_shared_from_this<Sound> {
 
   public:
 
@@ -48,7 +53,8 @@ class SOLARUS_API Sound {
      * \brief Buffer containing an encoded sound file.
      */
     struct SoundFromMemory {
-      std::string data;         /**< The OGG encded data. */
+      std::shared_ptr<const std::string>
+          data;                 /**< The OGG encoded data. */
       size_t position;          /**< Current position in the buffer. */
       bool loop;                /**< \c true to restart the sound if it finishes. */
     };
@@ -61,6 +67,8 @@ class SOLARUS_API Sound {
     ~Sound();
     void load();
     bool start();
+    bool is_playing() const;
+    size_t get_memory_size() const;
 
     static void load_all();
     static bool exists(const std::string& sound_id);
@@ -74,23 +82,59 @@ class SOLARUS_API Sound {
     static int get_volume();
     static void set_volume(int volume);
 
+    static bool is_mono_enabled();
+    static void set_mono_enabled(bool mono_enabled);
+    static size_t get_stream_threshold();
+    static void set_stream_threshold(size_t stream_threshold);
+
   private:
 
+    /**
+     * \brief A playing instance of a streamed sound.
+     */
+    struct Stream {
+      ALuint source;                             /**< The source playing the buffers. */
+      std::vector<ALuint> buffers;               /**< Buffers queued on the source. */
+      std::unique_ptr<OggDecoder> decoder;       /**< Decoder of this instance. */
+    };
+
     ALuint decode_file(const std::string& file_name);
+    ALuint create_buffer(
+        const std::vector<char>& samples,
+        int num_channels,
+        ALsizei sample_rate
+    );
+    bool start_stream();
+    void stop_stream(Stream& stream);
+    bool update_stream(Stream& stream);
     bool update_playing();
 
+    static constexpr int nb_stream_buffers = 4;  /**< Buffers of a stream. */
+    static constexpr int stream_buffer_samples =
+        16384;                                   /**< Samples per buffer of a stream. */
+
     static ALCdevice* device;
     static ALCcontext* context;
 
     std::string id;                              /**< id of this sound */
     ALuint buffer;                               /**< the OpenAL buffer containing the PCM decoded data of this sound */
     std::list<ALuint> sources;                   /**< the sources currently playing this sound */
-    static std::list<Sound*> current_sounds;     /**< the sounds currently playing */
-    static std::map<std::string, Sound> all_sounds;   /**< all sounds created before */
+    std::shared_ptr<const std::string>
+        encoded_data;                            /**< OGG data of a streamed sound, shared by
+                                                  * its streams, nullptr if the sound is
+                                                  * decoded at once */
+    std::list<std::unique_ptr<Stream>>
+        streams;                                 /**< the streams currently playing this sound */
+    static std::list<std::shared_ptr<Sound>>
+        current_sounds;                          /**< the sounds currently playing */
 
     static bool initialized;                     /**< indicates that the audio system is initialized */
     static bool sounds_preloaded;                /**< true if load_all() was called */
     static float volume;                         /**< the volume of sound effects (0.0 to 1.0) */
+    static bool mono_enabled;                    /**< false to convert mono sounds to stereo
+                                                  * for drivers that play them silently */
+    static size_t stream_threshold;              /**< sounds whose decoded size is
+                                                  * above this are streamed */
 
 };
 
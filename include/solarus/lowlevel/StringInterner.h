@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_STRING_INTERNER_H
+#define SOLARUS_STRING_INTERNER_H
+
+#include "solarus/Common.h"
+#include <string>
+
+namespace Solarus {
+
+/**
+ * \brief Associates a stable integer id to strings.
+ *
+ * Tables keyed by string ids avoid comparing strings on every lookup:
+ * a string is hashed once to get its id, and the id can be kept by callers
+ * that look up the same key repeatedly.
+ * Ids are never reused: an interned string stays until the end of the
+ * program.
+ *
+ * The interner is not thread-safe: only use it from the main thread.
+ */
+namespace StringInterner {
+
+SOLARUS_API int intern(const std::string& value);
+SOLARUS_API int find(const std::string& value);
+SOLARUS_API int find(const char* value);
+SOLARUS_API const std::string& get_string(int id);
+SOLARUS_API int get_num_strings();
+
+}  // namespace StringInterner
+
+}  // namespace Solarus
+
+#endif
+
@@ -18,8 +18,10 @@
 #define SOLARUS_SURFACE_H
 
 #include "solarus/Common.h"
+#include "solarus/lowlevel/DrawArena.h"
 #include "solarus/lowlevel/PixelBits.h"
 #include "solarus/lowlevel/SurfacePtr.h"
+#include "solarus/lowlevel/TextureAtlas.h"
 #include "solarus/Drawable.h"
 #include <SDL.h>
 #include <SDL_image.h>
@@ -31,7 +33,9 @@
 namespace Solarus {
 
 class Color;
+class DamageTracker;
 class PixelFilter;
+class RenderQueue;
 class Size;
 class Surface;
 
@@ -47,6 +51,7 @@ class Surface: public Drawable {
   // low-level classes allowed to manipulate directly the internal SDL surface encapsulated
   friend class TextSurface;
   friend class PixelBits;
+  friend class DamageTracker;
 
   public:
 
@@ -61,6 +66,7 @@ class Surface: public Drawable {
 
     Surface(int width, int height);
     explicit Surface(SDL_Surface* internal_surface);
+    ~Surface();
 
     // Surfaces should only created with std::make_shared.
     // This is what create() functions do, so you should call them rather than
@@ -79,6 +85,11 @@ class Surface: public Drawable {
     bool is_software_destination() const;
     void set_software_destination(bool software_destination);
 
+    bool is_damage_tracked() const;
+    void set_damage_tracked(bool damage_tracked);
+    void start_damage_recording();
+    void finish_damage_recording();
+
     void clear();
     void clear(const Rectangle& where);
     void fill_with_color(const Color& color);
@@ -111,9 +122,6 @@ class Surface: public Drawable {
 
   private:
 
-    class SubSurfaceNode;
-    using SubSurfaceNodePtr = std::shared_ptr<Surface::SubSurfaceNode>;
-
     struct SDL_Surface_Deleter {
         void operator()(SDL_Surface* sdl_surface) {
           SDL_FreeSurface(sdl_surface);
@@ -132,6 +140,8 @@ class Surface: public Drawable {
     bool is_pixel_transparent(int index) const;
     uint32_t get_color_value(const Color& color) const;
     SDL_BlendMode get_sdl_blend_mode() const;
+    void notify_changing() const;
+    void notify_changed();
 
     static SDL_Surface* get_surface_from_file(
         const std::string& file_name,
@@ -142,17 +152,17 @@ class Surface: public Drawable {
     void create_texture_from_surface();
     void add_subsurface(const SurfacePtr& src_surface, const Rectangle& region, const Point& dst_position);
     void clear_subsurfaces();
-    void render(
+    void release_atlas_area();
+    uint8_t render_self(
         SDL_Renderer* renderer,
+        RenderQueue& queue,
         const Rectangle& src_rect,
         const Rectangle& dst_rect,
         const Rectangle& clip_rect,
-        uint8_t opacity,
-        const std::vector<SubSurfaceNodePtr>& subsurfaces
+        uint8_t opacity
     );
 
-    std::vector<SubSurfaceNodePtr>
-        subsurfaces;                      /**< Source Subsurfaces not in the tree yet */
+    DrawArena::List subsurfaces;          /**< What was drawn on this surface in GPU. */
 
     bool software_destination;            /**< Whether this surface should be modified on software side
                                            * (and therefore immediately) when used as a destination */
@@ -166,6 +176,15 @@ class Surface: public Drawable {
                                            * Set to false when drawing a surface on this one. */
     uint8_t opacity;                      /**< Opacity (0: transparent, 255: opaque). */
     int width, height;                    /**< Size of the texture, avoid to use SDL_QueryTexture. */
+    uint64_t id;                          /**< Unique id of this surface. */
+    uint64_t content_version;             /**< Incremented whenever the pixels change. */
+    uint64_t recorded_stamp;              /**< Stamp of the last damage recording that drew
+                                           * this surface, or 0. */
+    std::unique_ptr<DamageTracker>
+        damage_tracker;                   /**< Redraws only what changes, if enabled. */
+    bool atlas_allowed;                   /**< Whether the pixels may go to a texture atlas
+                                           * because they are not supposed to change. */
+    TextureAtlas::Area atlas_area;        /**< Where the pixels are in the texture atlas, if any. */
 
 };
 
@@ -21,6 +21,7 @@
 #include "solarus/lowlevel/Color.h"
 #include "solarus/lowlevel/Point.h"
 #include "solarus/Drawable.h"
+#include <cstdint>
 #include <map>
 #include <string>
 #include <SDL_ttf.h>
@@ -120,6 +121,10 @@ class TextSurface: public Drawable {
     void rebuild();
     void rebuild_bitmap();
     void rebuild_ttf();
+    bool add_glyphs();
+    bool add_bitmap_glyphs();
+    bool add_ttf_glyphs();
+    void update_text_position();
 
     std::string font_id;                              /**< id of the font of the current text surface */
     HorizontalAlignment horizontal_alignment;         /**< horizontal alignment of the current text surface */
@@ -136,6 +141,13 @@ class TextSurface: public Drawable {
 
     std::string text;                                 /**< the string to draw (only one line) */
 
+    int text_width;                                   /**< width of the text, the surface may be larger */
+    bool glyph_layout;                                /**< whether the surface is made of cached glyphs
+                                                       * and more characters can be appended */
+    size_t laid_out_size;                             /**< number of bytes of the text already on the surface */
+    int pen_x;                                        /**< where the next glyph goes on the surface */
+    uint16_t previous_code_point;                     /**< last character laid out, for kerning */
+
 };
 
 }
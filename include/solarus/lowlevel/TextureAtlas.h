@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_TEXTURE_ATLAS_H
+#define SOLARUS_TEXTURE_ATLAS_H
+
+#include "solarus/Common.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include <SDL.h>
+#include <cstdint>
+
+namespace Solarus {
+
+/**
+ * \brief Packs images that never change into a few large textures.
+ *
+ * Images loaded from files like sprite sheets and tileset images are
+ * uploaded to a region of a shared atlas texture the first time the GPU
+ * draws them, rather than each to their own texture.
+ * Drawings of several images can then be submitted in the same batch
+ * (see RenderQueue).
+ *
+ * Atlas pages are filled with a shelf packer. The space of a page is
+ * reclaimed when all images of the page are removed.
+ */
+class SOLARUS_API TextureAtlas {
+
+  public:
+
+    /**
+     * \brief Where an image is stored in the atlas.
+     */
+    struct Area {
+      SDL_Texture* texture = nullptr;   /**< Texture of the atlas page, or nullptr if none. */
+      Rectangle rect;                   /**< Region of the image in the page. */
+      int page = -1;                    /**< Index of the page. */
+      uint64_t generation = 0;          /**< Value of get_generation() when the area was made. */
+    };
+
+    static void quit();
+
+    static bool add(SDL_Renderer* renderer, SDL_Surface& surface, Area& area);
+    static void remove(Area& area);
+    static bool is_valid(const Area& area);
+    static int get_num_pages();
+
+};
+
+}
+
+#endif
+
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_WORKER_POOL_H
+#define SOLARUS_WORKER_POOL_H
+
+#include "solarus/Common.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Solarus {
+
+/**
+ * \brief A small fixed set of threads to split a computation into tasks.
+ *
+ * run() executes a number of independent tasks on the worker threads
+ * and on the calling thread, and returns when all of them are finished.
+ */
+class SOLARUS_API WorkerPool {
+
+  public:
+
+    explicit WorkerPool(int num_threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool& other) = delete;
+    WorkerPool& operator=(const WorkerPool& other) = delete;
+
+    int get_num_threads() const;
+    void run(int num_tasks, const std::function<void(int)>& task);
+
+  private:
+
+    void worker_loop();
+    void run_tasks(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> threads;     /**< The worker threads. */
+    std::mutex mutex;                     /**< Protects the state below. */
+    std::condition_variable work_available;  /**< Signaled when a job starts or at exit. */
+    std::condition_variable work_done;    /**< Signaled when the last task of a job ends. */
+    const std::function<void(int)>*
+        current_task;                     /**< Function of the current job, or nullptr. */
+    int num_tasks;                        /**< Number of tasks of the current job. */
+    int next_task;                        /**< Index of the next task to start. */
+    int num_tasks_running;                /**< Number of tasks started and not finished. */
+    unsigned generation;                  /**< Incremented at each new job. */
+    bool stopping;                        /**< Whether the workers should exit. */
+
+};
+
+}
+
+#endif
+
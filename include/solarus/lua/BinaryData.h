@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_BINARY_DATA_H
+#define SOLARUS_BINARY_DATA_H
+
+#include "solarus/Common.h"
+#include "solarus/EnumInfo.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Solarus {
+
+/**
+ * \brief Encodes data files in the compiled binary format.
+ *
+ * A compiled data file starts with a header that contains a magic number,
+ * the version of the format and the size and hash of the Lua data file it
+ * was compiled from.
+ * Then comes the body, a sequence of variable-length integers where
+ * strings are replaced by their index in a string table.
+ * The string table stores each distinct string once, at the end of the file.
+ *
+ * The layout of the body is defined by each LuaData subclass in
+ * LuaData::export_to_binary() and LuaData::import_from_binary().
+ */
+class SOLARUS_API BinaryDataWriter {
+
+  public:
+
+    BinaryDataWriter();
+
+    void write_int(int value);
+    void write_uint(uint32_t value);
+    void write_bool(bool value);
+    void write_string(const std::string& value);
+    template<typename E>
+    void write_enum(E value);
+
+    std::string finish(const std::string& source_buffer) const;
+
+  private:
+
+    std::string body;             /**< Encoded values so far. */
+    std::vector<std::string>
+        strings;                  /**< String table in order of first use. */
+    std::unordered_map<std::string, uint32_t>
+        string_indexes;           /**< Index of each string of the table. */
+
+};
+
+/**
+ * \brief Decodes data files in the compiled binary format.
+ *
+ * Values are read directly from the buffer of the file, without copying it.
+ * Strings are only copied when they are read.
+ *
+ * Reading past the end of the body or an invalid string index
+ * does not fail immediately: it returns a default value and the reader
+ * becomes invalid. Callers check is_valid() after reading.
+ */
+class SOLARUS_API BinaryDataReader {
+
+  public:
+
+    BinaryDataReader(const std::string& buffer, const std::string& source_buffer);
+
+    static bool is_binary_buffer(const std::string& buffer);
+
+    bool is_valid() const;
+    bool is_at_end() const;
+
+    int read_int();
+    uint32_t read_uint();
+    bool read_bool();
+    std::string read_string();
+    template<typename E>
+    E read_enum(E default_value);
+
+  private:
+
+    const std::string& buffer;    /**< The whole compiled file. */
+    size_t position;              /**< Current reading position in the body. */
+    size_t body_end;              /**< End of the body (start of the string table). */
+    std::vector<std::pair<size_t, size_t>>
+        strings;                  /**< Position and size of each string of the table. */
+    bool valid;                   /**< Whether no error occurred so far. */
+
+};
+
+/**
+ * \brief Writes an enum value.
+ *
+ * The name of the value is written so that the file does not depend
+ * on the order of enum values.
+ *
+ * \param value The value to write.
+ */
+template<typename E>
+void BinaryDataWriter::write_enum(E value) {
+
+  write_string(enum_to_name(value));
+}
+
+/**
+ * \brief Reads an enum value.
+ * \param default_value Value to return in case of error.
+ * \return The value read, or the default value in case of error.
+ */
+template<typename E>
+E BinaryDataReader::read_enum(E default_value) {
+
+  const std::string& name = read_string();
+  for (const auto& kvp : EnumInfoTraits<E>::names) {
+    if (kvp.second == name) {
+      return kvp.first;
+    }
+  }
+  valid = false;
+  return default_value;
+}
+
+}
+
+#endif
+
@@ -35,11 +35,14 @@
 #include "solarus/SpritePtr.h"
 #include "solarus/TimerPtr.h"
 #include <lua.hpp>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace Solarus {
@@ -134,6 +137,19 @@ class LuaContext {
     static const std::string movement_jump_module_name;
     static const std::string movement_pixel_module_name;
 
+    /**
+     * \brief Events tried so often that their presence is tracked as bits.
+     *
+     * Dispatching them costs a bit test when no script defined them.
+     */
+    enum class TrackedEvent {
+      ON_UPDATE,
+      ON_DRAW,
+      ON_PRE_DRAW,
+      ON_POST_DRAW,
+      ON_POSITION_CHANGED
+    };
+
     explicit LuaContext(MainLoop& main_loop);
     ~LuaContext();
 
@@ -198,6 +214,10 @@ class LuaContext {
         const ExportableToLua& userdata,
         const std::string& key
     ) const;
+    bool userdata_has_event(
+        const ExportableToLua& userdata,
+        TrackedEvent event
+    ) const;
     void notify_userdata_destroyed(ExportableToLua& userdata);
     void userdata_close_lua();
 
@@ -214,6 +234,7 @@ class LuaContext {
     void notify_timers_map_suspended(bool suspended);
     void set_entity_timers_suspended(Entity& entity, bool suspended);
     void do_timer_callback(const TimerPtr& timer);
+    void schedule_timer(const TimerPtr& timer);
 
     // Menus.
     void add_menu(
@@ -447,6 +468,7 @@ class LuaContext {
       main_api_get_type,
       main_api_get_metatable,
       main_api_get_os,
+      main_api_get_resource_cache_statistics,
 
       // Audio API.
       audio_api_get_sound_volume,
@@ -634,6 +656,8 @@ class LuaContext {
       path_finding_movement_api_set_target,
       path_finding_movement_api_get_speed,
       path_finding_movement_api_set_speed,
+      path_finding_movement_api_is_long_range,
+      path_finding_movement_api_set_long_range,
       circle_movement_api_set_center,
       circle_movement_api_get_radius,
       circle_movement_api_set_radius,
@@ -1030,11 +1054,51 @@ class LuaContext {
     struct LuaTimerData {
       ScopedLuaRef callback_ref;  /**< Lua ref of the function to call after the timer. */
       const void* context;        /**< Lua table or userdata the timer is attached to. */
+      std::list<TimerPtr>::iterator
+          context_it;             /**< Position of the timer in the list
+                                   * of timers of its context. */
+      uint64_t
+          scheduled_sequence;     /**< Sequence number of the current entry
+                                   * of the timer in timers_by_date, or 0. */
+      uint32_t scheduled_date;    /**< Date of this entry. */
+    };
+
+    /**
+     * \brief Entry of the heap of timers ordered by next update date.
+     *
+     * An entry is obsolete if the timer was removed or scheduled again.
+     */
+    struct ScheduledTimer {
+      uint32_t date;              /**< Next date when the timer needs an update. */
+      uint64_t sequence;          /**< Order of scheduling, to break ties. */
+      TimerPtr timer;             /**< The timer. */
+
+      /**
+       * \brief Heap order: the entry with the earliest date is on top.
+       * \param other Another entry.
+       * \return \c true if this entry comes after the other one.
+       */
+      bool operator<(const ScheduledTimer& other) const {
+        if (date != other.date) {
+          return date > other.date;
+        }
+        return sequence > other.sequence;
+      }
+    };
+
+    /**
+     * \brief Tracked events found on the metatable of a type.
+     */
+    struct MetatableEvents {
+      bool checked = false;       /**< Whether the metatable was checked. */
+      uint32_t events = 0;        /**< Bits of the tracked events defined. */
+      uint32_t num_calls = 0;     /**< LuaTools::get_num_calls() when checked. */
     };
 
     // Executing Lua code.
     bool userdata_has_metafield(
         const ExportableToLua& userdata, const char* key) const;
+    uint32_t get_metatable_events(const std::string& type_name) const;
     bool find_method(int index, const char* function_name);
     bool find_method(const char* function_name);
     void print_stack(lua_State* l);
@@ -1333,6 +1397,14 @@ class LuaContext {
                                         * their context and callback. */
     std::list<TimerPtr>
         timers_to_remove;              /**< Timers to be removed at the next cycle. */
+    std::unordered_map<const void*, std::list<TimerPtr>>
+        timers_by_context;             /**< The timers of each context. */
+    std::vector<ScheduledTimer>
+        timers_by_date;                /**< Heap of timers by next update date.
+                                        * Suspended timers are not scheduled.
+                                        * May contain obsolete entries. */
+    uint64_t last_timer_sequence;      /**< Sequence number of the last
+                                        * entry added to timers_by_date. */
 
     std::set<DrawablePtr>
         drawables;                     /**< All drawable objects created by
@@ -1340,11 +1412,16 @@ class LuaContext {
     std::set<DrawablePtr>
         drawables_to_remove;           /**< Drawable objects to be removed at the
                                         * next cycle. */
-    std::map<const ExportableToLua*, std::set<std::string>>
+    std::unordered_map<const ExportableToLua*, std::unordered_set<int>>
         userdata_fields;               /**< Existing string keys created on each
-                                        * userdata with our __newindex. This is
+                                        * userdata with our __newindex,
+                                        * interned by StringInterner. This is
                                         * only for performance, to avoid Lua
                                         * lookups for callbacks like on_update. */
+    mutable std::unordered_map<std::string, MetatableEvents>
+        metatable_events;              /**< Tracked events defined on the
+                                        * metatable of each type when it was
+                                        * last checked, indexed by type name. */
     std::set<std::string>
         warning_deprecated_functions;  /**< Names of deprecated functions of
                                         * the API for which a warning was emitted. */
@@ -25,6 +25,9 @@ struct lua_State;
 
 namespace Solarus {
 
+class BinaryDataReader;
+class BinaryDataWriter;
+
 /**
  * \brief Abstract class for data the can be loaded and optionally saved as Lua.
  */
@@ -37,6 +40,8 @@ class SOLARUS_API LuaData {
 
     virtual bool import_from_lua(lua_State* l) = 0;
     virtual bool export_to_lua(std::ostream& out) const;  // Optional.
+    virtual bool import_from_binary(BinaryDataReader& reader);  // Optional.
+    virtual bool export_to_binary(BinaryDataWriter& writer) const;  // Optional.
 
     bool import_from_buffer(const std::string& buffer, const std::string& file_name);
     bool import_from_file(const std::string& file_name);
@@ -45,8 +50,19 @@ class SOLARUS_API LuaData {
         bool language_specific = false
     );
 
+    bool import_from_compiled_buffer(
+        const std::string& buffer,
+        const std::string& source_buffer
+    );
+
     bool export_to_buffer(std::string& buffer) const;
     bool export_to_file(const std::string& file_name) const;
+    bool export_to_compiled_buffer(
+        std::string& buffer,
+        const std::string& source_buffer
+    ) const;
+
+    static std::string get_compiled_file_name(const std::string& file_name);
 
     static std::string escape_string(std::string value);
     static std::string escape_multiline_string(std::string value);
@@ -22,6 +22,7 @@
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lua/LuaException.h"
 #include "solarus/SolarusFatal.h"
+#include <cstdint>
 #include <map>
 #include <string>
 #include <lua.hpp>
@@ -58,6 +59,8 @@ bool do_string(
     const std::string& code,
     const std::string& chunk_name
 );
+int get_call_depth();
+uint32_t get_num_calls();
 
 // Error handling.
 template<typename Callable>
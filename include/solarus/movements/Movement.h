@@ -23,6 +23,7 @@
 #include "solarus/lua/ScopedLuaRef.h"
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace Solarus {
 
@@ -45,6 +46,9 @@ class SOLARUS_API Movement: public ExportableToLua {
 
     virtual ~Movement();
 
+    static bool is_swept_steps_enabled();
+    static void set_swept_steps_enabled(bool swept_steps_enabled);
+
     // object controlled
     Entity* get_entity() const;
     void set_entity(Entity* entity);
@@ -110,6 +114,11 @@ class SOLARUS_API Movement: public ExportableToLua {
     // obstacles (only when the movement is applied to an entity)
     void set_default_ignore_obstacles(bool ignore_obstacles);
 
+    // several steps in one update
+    void start_sweep();
+    void finish_sweep();
+    bool notify_swept_steps();
+
   private:
 
     // Object to move (can be an entity, a drawable or a point).
@@ -135,6 +144,10 @@ class SOLARUS_API Movement: public ExportableToLua {
 
     ScopedLuaRef finished_callback_ref;          /**< Lua ref to a function to call when this movement finishes. */
 
+    // swept steps
+    bool sweeping;                               /**< Whether position changes are only recorded for now. */
+    std::vector<Point> swept_positions;          /**< Positions recorded since start_sweep(). */
+
 };
 
 }
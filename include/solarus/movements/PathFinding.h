@@ -19,19 +19,28 @@
 
 #include "solarus/Common.h"
 #include "solarus/lowlevel/Point.h"
-#include <list>
-#include <map>
+#include <cstdint>
 #include <string>
 
 namespace Solarus {
 
 class Map;
 class Entity;
+class PathFindingGrid;
 class Rectangle;
 
 /**
  * \brief Implementation of the A* algorithm to compute a path.
  *
+ * A node is the location of an 8*8 square of the map.
+ * Nodes are stored in the PathFindingGrid of the map so that successive
+ * searches do not allocate memory.
+ * The grid also caches the terrain obstacles and the recent paths, so that
+ * several entities chasing the same target mostly reuse previous work.
+ *
+ * Targets further than 200 pixels are only searched in long range mode,
+ * using the hierarchical abstraction of PathFindingClusters.
+ *
  * In the current implementation, the computed path always corresponds to a
  * shape of 16*16. If the entity to move is bigger, some obstacles may prevent
  * it from following the computed path.
@@ -45,39 +54,26 @@ class SOLARUS_API PathFinding {
         Entity& source_entity,
         Entity& target_entity);
 
+    bool is_long_range() const;
+    void set_long_range(bool long_range);
+
     std::string compute_path();
     std::string compute_path(const Point& offset);
 
   private:
 
-    /**
-     * \brief Represents a node in the path to compute.
-     *
-     * A node is the location of a 16*16 square of the map.
-     * The algorithm tries to find the best sequence of nodes leading to the target.
-     */
-    class Node {
-
-     public:
-
-      Point location;     /**< location of this node on the map */
-      int index;          /**< index of this node's square on the map (depends on the location) */
-
-      // total_cost = previous_cost + heuristic
-      int previous_cost;  /**< cost of the best path that leads to this node */
-      int heuristic;      /**< estimation of the remaining cost to the target */
-      int total_cost;     /**< total cost of this node */
-
-      int parent_index;   /**< index of the square containing the best node leading to this node */
-      char direction;     /**< direction from the parent node to this node (0 to 7) */
-
-      bool operator<(const Node& other) const;
-    };
-
-    int get_square_index(const Point& location) const;
-    bool is_node_transition_valid(const Node& node, int direction) const;
-    void add_index_sorted(Node* node);
-    std::string rebuild_path(const Node* final_node);
+    std::string search(
+        int source_index,
+        int target_index,
+        int total_mdistance,
+        int max_distance,
+        int max_nodes
+    );
+    std::string compute_long_path(int source_index, int target_index);
+    bool is_node_transition_valid(const Point& location, int direction) const;
+    bool is_ground_obstacle(const Point& location, int direction) const;
+    uint32_t get_obstacle_grounds() const;
+    std::string rebuild_path(int final_index) const;
 
     static const Point neighbours_locations[];
     static const Rectangle transition_collision_boxes[];
@@ -85,10 +81,10 @@ class SOLARUS_API PathFinding {
     Map& map;                          /**< the map */
     Entity& source_entity;             /**< the entity to move */
     Entity& target_entity;             /**< the target point */
-
-    std::map<int, Node> closed_list;   /**< the closed list, indexed by the node locations on the map */
-    std::map<int, Node> open_list;     /**< the open list, indexed by the node locations on the map */
-    std::list<int> open_list_indices;  /**< indices of the open list elements, sorted by priority */
+    PathFindingGrid& grid;             /**< the nodes of the map, shared by all searches */
+    bool long_range;                   /**< whether far targets are searched in the clusters of the map */
+    int ground_cache;                  /**< terrain cache of the grid used by the current search,
+                                        * or -1 to test the terrain directly */
 
 };
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_PATH_FINDING_CLUSTERS_H
+#define SOLARUS_PATH_FINDING_CLUSTERS_H
+
+#include "solarus/Common.h"
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace Solarus {
+
+class PathFindingGrid;
+
+/**
+ * \brief Abstract graph of a map used to compute long paths (HPA*).
+ *
+ * The nodes of the map are grouped into square clusters.
+ * Entrances are the nodes where the terrain allows to cross the border
+ * between two adjacent clusters.
+ * The abstract graph links the entrances of a cluster to each other
+ * with the cost of the shortest path inside the cluster,
+ * and each entrance to the matching entrance of the neighbor cluster.
+ *
+ * A long path is first searched in the abstract graph, and then each step
+ * of the abstract path can be refined with the usual A* algorithm.
+ *
+ * Only the terrain is considered here: dynamic obstacles are handled when
+ * refining the path.
+ * Clusters whose terrain changes are marked dirty and rebuilt lazily
+ * the next time a path is requested.
+ */
+class SOLARUS_API PathFindingClusters {
+
+  public:
+
+    /**
+     * \brief Returns whether the terrain allows a transition.
+     *
+     * Parameters are the index of the node where the transition starts
+     * and the direction of the transition (0 to 7).
+     */
+    using TransitionTest = std::function<bool(int, int)>;
+
+    PathFindingClusters(int width8, int height8);
+
+    void invalidate(int x8_min, int y8_min, int x8_max, int y8_max);
+    std::vector<int> find_path(
+        PathFindingGrid& grid,
+        int source_index,
+        int target_index,
+        const TransitionTest& is_transition_valid
+    );
+
+  private:
+
+    /**
+     * \brief Abstract information about a cluster.
+     */
+    struct Cluster {
+      bool dirty;                         /**< Whether the terrain changed since
+                                           * the entrances were computed. */
+      std::vector<int> entrances;         /**< Entrance nodes of this cluster. */
+      std::vector<int> costs;             /**< Cost between each pair of entrances
+                                           * inside the cluster, or -1. */
+      std::vector<std::pair<int, int>>
+          links;                          /**< Position of an entrance in the list
+                                           * and node of the neighbor cluster it leads to. */
+      std::vector<std::pair<int, int>>
+          east_border;                    /**< Pairs of nodes allowing to cross the
+                                           * east border (this cluster, east cluster). */
+      std::vector<std::pair<int, int>>
+          south_border;                   /**< Pairs of nodes allowing to cross the
+                                           * south border (this cluster, south cluster). */
+    };
+
+    int get_cluster_index(int node_index) const;
+    int get_local_index(int cluster_index, int node_index) const;
+    void update(const TransitionTest& is_transition_valid);
+    void compute_border(
+        int cluster_index,
+        bool south,
+        const TransitionTest& is_transition_valid
+    );
+    void compute_entrances(
+        int cluster_index,
+        const TransitionTest& is_transition_valid
+    );
+    void compute_local_costs(
+        int cluster_index,
+        int source_index,
+        bool reverse,
+        const TransitionTest& is_transition_valid,
+        std::vector<int>& costs
+    ) const;
+
+    int width8;                           /**< Number of columns of nodes. */
+    int height8;                          /**< Number of rows of nodes. */
+    int num_columns;                      /**< Number of columns of clusters. */
+    int num_rows;                         /**< Number of rows of clusters. */
+    std::vector<Cluster> clusters;        /**< All clusters, row by row. */
+    bool dirty;                           /**< Whether at least one cluster is dirty. */
+
+};
+
+}
+
+#endif
+
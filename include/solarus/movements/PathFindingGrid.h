@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOLARUS_PATH_FINDING_GRID_H
+#define SOLARUS_PATH_FINDING_GRID_H
+
+#include "solarus/Common.h"
+#include "solarus/entities/EntityType.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/Size.h"
+#include "solarus/movements/PathFindingClusters.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Solarus {
+
+class Entity;
+
+/**
+ * \brief Node storage reused by all path computations of a map.
+ *
+ * There is one node per 8x8 square of the map, allocated once.
+ * Instead of clearing the nodes before each search, a generation counter
+ * tells which nodes were reached by the current search.
+ * Open nodes are kept in an indexed binary heap that supports decreasing
+ * their cost in place.
+ *
+ * The grid also remembers what searches learn about the map:
+ * - Whether the terrain blocks each transition between two nodes.
+ *   Terrain results only depend on the layer and on which grounds are
+ *   obstacles for the moving entity, so they are shared by all entities with
+ *   the same obstacle grounds and invalidated locally when the ground changes.
+ *   Clusters used to compute long paths are attached to this information.
+ * - The paths recently found, so that an entity searching again from the
+ *   same node to the same target reuses the result. Paths are shared by
+ *   entities with the same type, size, obstacle grounds and obstacle traits,
+ *   unless the obstacle rules of the entity are specific to it.
+ *   A path is forgotten when the ground changes on one of its nodes.
+ *   Since dynamic obstacles can move, cached paths also expire after a short
+ *   delay.
+ */
+class SOLARUS_API PathFindingGrid {
+
+  public:
+
+    /**
+     * \brief State of the 8x8 square of the map in the current search.
+     */
+    struct Node {
+      uint32_t generation;  /**< Search that last reached this node. */
+      uint32_t order;       /**< When this node was opened in its search (breaks ties). */
+      int previous_cost;    /**< Cost of the best path that leads to this node. */
+      int total_cost;       /**< Previous cost plus the estimation of the remaining cost. */
+      int parent_index;     /**< Index of the node leading to this one, or -1. */
+      int heap_position;    /**< Position in the open heap, or -1 if the node is closed. */
+      char direction;       /**< Direction from the parent node to this node ('0' to '7'). */
+    };
+
+    /**
+     * \brief Identifies a search whose result can be reused.
+     */
+    struct PathKey {
+      int layer;                  /**< Layer of the search. */
+      uint32_t obstacle_grounds;  /**< Bit field of the grounds that are obstacles. */
+      EntityType source_type;     /**< Type of the entity to move. */
+      Size source_size;           /**< Size of the entity to move. */
+      int obstacle_traits;        /**< Obstacle traits of the entity to move. */
+      const Entity* source_entity;  /**< The entity to move if its obstacle
+                                     * rules are specific to it, or nullptr. */
+      int source_index;           /**< Node where the path starts. */
+      int target_index;           /**< Node where the path ends. */
+    };
+
+    PathFindingGrid(int width8, int height8);
+
+    int get_width8() const;
+    int get_height8() const;
+    bool is_in_grid(const Point& location) const;
+    int get_square_index(const Point& location) const;
+    Point get_square_location(int index) const;
+
+    void start_search();
+    bool is_reached(int index) const;
+    bool is_open(int index) const;
+    bool is_closed(int index) const;
+    Node& get_node(int index);
+    const Node& get_node(int index) const;
+
+    void open(int index);
+    void notify_cost_decreased(int index);
+    bool has_open_nodes() const;
+    int close_best_node();
+
+    int get_ground_cache(int layer, uint32_t obstacle_grounds);
+    bool get_ground_obstacle(int cache, int index, int direction, bool& obstacle) const;
+    void set_ground_obstacle(int cache, int index, int direction, bool obstacle);
+    PathFindingClusters& get_clusters(int cache);
+    void notify_ground_changed(int layer, const Rectangle& area);
+    void notify_ground_modifier_changed(const Entity& entity);
+    void notify_entity_removed(const Entity& entity);
+
+    bool get_cached_path(const PathKey& key, uint32_t now, std::string& path) const;
+    void add_cached_path(const PathKey& key, uint32_t now, const std::string& path);
+
+  private:
+
+    /**
+     * \brief Terrain obstacles of transitions for a layer and a set of
+     * obstacle grounds.
+     */
+    struct GroundCache {
+      int layer;                      /**< Layer of the transitions. */
+      uint32_t obstacle_grounds;      /**< Bit field of the grounds that are obstacles. */
+      std::vector<uint8_t> known;     /**< For each node, one bit per direction telling
+                                       * whether the transition was tested. */
+      std::vector<uint8_t> obstacles; /**< For each node, one bit per direction telling
+                                       * whether the terrain blocks the transition. */
+      std::unique_ptr<PathFindingClusters>
+          clusters;                   /**< Abstract graph for long paths (created on first use). */
+    };
+
+    /**
+     * \brief A path recently found.
+     */
+    struct CachedPath {
+      PathKey key;                    /**< The search that found this path. */
+      uint32_t date;                  /**< When the path was found. */
+      std::string path;               /**< The path found, or an empty string. */
+      int x8_min;                     /**< Leftmost column of the nodes of the path. */
+      int y8_min;                     /**< Top row of the nodes of the path. */
+      int x8_max;                     /**< Rightmost column of the nodes of the path. */
+      int y8_max;                     /**< Bottom row of the nodes of the path. */
+    };
+
+    bool is_better(int index_1, int index_2) const;
+    void place_in_heap(int index, int position);
+    void sift_up(int position);
+    void sift_down(int position);
+    void invalidate_ground(const Rectangle& area, bool all_layers, int layer);
+
+    int width8;                     /**< Number of columns of 8x8 squares. */
+    int height8;                    /**< Number of rows of 8x8 squares. */
+    std::vector<Node> nodes;        /**< One node per 8x8 square of the map. */
+    std::vector<int> open_heap;     /**< Indexes of open nodes, as a binary min-heap. */
+    uint32_t generation;            /**< Number of the current search. */
+    uint32_t next_order;            /**< Order to give to the next opened node. */
+
+    std::vector<GroundCache>
+        ground_caches;              /**< Terrain obstacles for each layer and set of
+                                     * obstacle grounds encountered. */
+    std::map<const Entity*, Rectangle>
+        ground_modifiers;           /**< Bounding box of each entity currently modifying
+                                     * the ground, to invalidate where it was. */
+    std::vector<CachedPath>
+        cached_paths;               /**< Recent paths, used as a circular buffer. */
+    size_t next_cached_path;        /**< Where to store the next path found. */
+
+};
+
+/**
+ * \brief Returns whether a node was reached by the current search.
+ * \param index Index of a node.
+ * \return \c true if the node is open or closed.
+ */
+inline bool PathFindingGrid::is_reached(int index) const {
+  return nodes[index].generation == generation;
+}
+
+/**
+ * \brief Returns whether a node is in the open heap of the current search.
+ * \param index Index of a node.
+ * \return \c true if the node is open.
+ */
+inline bool PathFindingGrid::is_open(int index) const {
+  return is_reached(index) && nodes[index].heap_position != -1;
+}
+
+/**
+ * \brief Returns whether a node was closed during the current search.
+ * \param index Index of a node.
+ * \return \c true if the node is closed.
+ */
+inline bool PathFindingGrid::is_closed(int index) const {
+  return is_reached(index) && nodes[index].heap_position == -1;
+}
+
+/**
+ * \brief Returns a node of the grid.
+ * \param index Index of a node.
+ * \return The node.
+ */
+inline PathFindingGrid::Node& PathFindingGrid::get_node(int index) {
+  return nodes[index];
+}
+
+/**
+ * \overload Const version.
+ */
+inline const PathFindingGrid::Node& PathFindingGrid::get_node(int index) const {
+  return nodes[index];
+}
+
+}
+
+#endif
+
@@ -32,6 +32,7 @@ namespace Solarus {
  * The entity tries to find a path and to avoid the obstacles on the way.
  * To this end, the PathFinding class (i.e. an implementation of the A* algorithm) is used.
  * If the target entity is too far or not reachable, the movement is a random walk.
+ * In long range mode, far targets are also reachable.
  */
 class SOLARUS_API PathFindingMovement: public PathMovement {
 
@@ -40,6 +41,8 @@ class SOLARUS_API PathFindingMovement: public PathMovement {
     explicit PathFindingMovement(int speed);
 
     void set_target(const EntityPtr& target);
+    bool is_long_range() const;
+    void set_long_range(bool long_range);
     virtual bool is_finished() const override;
 
     virtual const std::string& get_lua_type_name() const override;
@@ -53,6 +56,7 @@ class SOLARUS_API PathFindingMovement: public PathMovement {
 
     EntityPtr target;               /**< the entity targeted by this movement (usually the hero) */
     uint32_t next_recomputation_date;
+    bool long_range;                /**< whether targets further than 200 pixels are searched */
 
 };
 
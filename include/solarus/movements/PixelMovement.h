@@ -61,7 +61,7 @@ class SOLARUS_API PixelMovement: public Movement {
 
   private:
 
-    void make_next_step();
+    bool make_next_step();
     void restart();
 
     // movement properties
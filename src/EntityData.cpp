@@ -17,6 +17,7 @@
 #include "solarus/EntityData.h"
 #include "solarus/entities/EntityTypeInfo.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaTools.h"
 #include <ostream>
 
@@ -939,5 +940,98 @@ bool EntityData::export_to_lua(std::ostream& out) const {
   return true;
 }
 
+/**
+ * \copydoc LuaData::import_from_binary
+ */
+bool EntityData::import_from_binary(BinaryDataReader& reader) {
+
+  const EntityType type = reader.read_enum(EntityType::TILE);
+  if (!reader.is_valid() ||
+      !EntityTypeInfo::can_be_stored_in_map_file(type)) {
+    return false;
+  }
+
+  EntityData entity(type);
+  entity.set_name(reader.read_string());
+  entity.set_layer(reader.read_int());
+  const int x = reader.read_int();
+  const int y = reader.read_int();
+  entity.set_xy({ x, y });
+
+  // Fields are stored in the order of the type description.
+  const EntityTypeDescription& type_description = entity_type_descriptions.at(type);
+  if (reader.read_uint() != type_description.size()) {
+    return false;
+  }
+  for (const EntityFieldDescription& field_description : type_description) {
+
+    const std::string& key = field_description.key;
+    switch (field_description.default_value.value_type) {
+
+      case EntityFieldType::STRING:
+        entity.set_string(key, reader.read_string());
+        break;
+
+      case EntityFieldType::INTEGER:
+        entity.set_integer(key, reader.read_int());
+        break;
+
+      case EntityFieldType::BOOLEAN:
+        entity.set_boolean(key, reader.read_bool());
+        break;
+
+      case EntityFieldType::NIL:
+        Debug::die("Nil entity field");
+        break;
+    }
+  }
+
+  if (!reader.is_valid()) {
+    return false;
+  }
+
+  *this = entity;
+  return true;
+}
+
+/**
+ * \copydoc LuaData::export_to_binary
+ */
+bool EntityData::export_to_binary(BinaryDataWriter& writer) const {
+
+  writer.write_enum(get_type());
+  writer.write_string(get_name());
+  writer.write_int(get_layer());
+  writer.write_int(get_xy().x);
+  writer.write_int(get_xy().y);
+
+  const EntityTypeDescription& type_description = entity_type_descriptions.at(get_type());
+  writer.write_uint(type_description.size());
+  for (const EntityFieldDescription& field_description : type_description) {
+
+    const std::string& key = field_description.key;
+    switch (field_description.default_value.value_type) {
+
+      case EntityFieldType::STRING:
+        writer.write_string(get_string(key));
+        break;
+
+      case EntityFieldType::INTEGER:
+        writer.write_int(get_integer(key));
+        break;
+
+      case EntityFieldType::BOOLEAN:
+        writer.write_bool(get_boolean(key));
+        break;
+
+      case EntityFieldType::NIL:
+        Debug::die("Nil entity field");
+        break;
+    }
+  }
+
+  return true;
+}
+
 }  // namespace Solarus
 
@@ -14,26 +14,40 @@
  * You should have received a copy of the GNU General Public License along
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
+#include "solarus/entities/CollisionBroadPhase.h"
+#include "solarus/entities/Entities.h"
+#include "solarus/entities/EntityPool.h"
 #include "solarus/entities/TilePattern.h"
+#include "solarus/entities/TilesetData.h"
 #include "solarus/lowlevel/Color.h"
+#include "solarus/lowlevel/DamageTracker.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/FontResource.h"
 #include "solarus/lowlevel/Logger.h"
 #include "solarus/lowlevel/Music.h"
+#include "solarus/lowlevel/Profiler.h"
 #include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lowlevel/Sound.h"
 #include "solarus/lowlevel/String.h"
 #include "solarus/lowlevel/Surface.h"
 #include "solarus/lowlevel/System.h"
 #include "solarus/lowlevel/Video.h"
 #include "solarus/lua/LuaContext.h"
+#include "solarus/lua/LuaData.h"
 #include "solarus/lua/LuaTools.h"
+#include "solarus/movements/Movement.h"
 #include "solarus/Arguments.h"
 #include "solarus/CurrentQuest.h"
 #include "solarus/Game.h"
 #include "solarus/QuestProperties.h"
 #include "solarus/MainLoop.h"
+#include "solarus/MapData.h"
 #include "solarus/Savegame.h"
+#include "solarus/SavegameWriter.h"
 #include "solarus/Settings.h"
+#include "solarus/SpriteData.h"
 #include <lua.hpp>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -107,6 +121,54 @@ std::string get_quest_path(const Arguments& args) {
   return SOLARUS_DEFAULT_QUEST;
 }
 
+/**
+ * \brief Writes the compiled form of the data files of a resource type.
+ *
+ * Compiled files are written next to their Lua data file,
+ * so only quests with a data directory can be compiled.
+ *
+ * \param resource_type A type of resource.
+ * \param dir_name Directory of the data files of this type.
+ * \return The number of files compiled.
+ */
+template<typename Data>
+int compile_data_files(ResourceType resource_type, const std::string& dir_name) {
+
+  int num_compiled = 0;
+  for (const auto& kvp : CurrentQuest::get_resources(resource_type)) {
+
+    const std::string& file_name = dir_name + "/" + kvp.first + ".dat";
+    if (!QuestFiles::data_file_exists(file_name)) {
+      continue;
+    }
+    if (QuestFiles::data_file_get_location(file_name) !=
+        QuestFiles::DataFileLocation::LOCATION_DATA_DIRECTORY) {
+      Debug::error("Cannot compile '" + file_name + "': not in the data directory");
+      continue;
+    }
+
+    const std::string& buffer = QuestFiles::data_file_read(file_name);
+    Data data;
+    std::string compiled_buffer;
+    if (!data.import_from_buffer(buffer, file_name) ||
+        !data.export_to_compiled_buffer(compiled_buffer, buffer)) {
+      Debug::error("Failed to compile '" + file_name + "'");
+      continue;
+    }
+
+    const std::string& compiled_file_name = QuestFiles::get_quest_path() +
+        "/data/" + LuaData::get_compiled_file_name(file_name);
+    std::ofstream out(compiled_file_name, std::ios::binary);
+    out.write(compiled_buffer.data(), compiled_buffer.size());
+    if (!out) {
+      Debug::error("Cannot write compiled file '" + compiled_file_name + "'");
+      continue;
+    }
+    ++num_compiled;
+  }
+  return num_compiled;
+}
+
 }  // Anonymous namespace.
 
 /**
@@ -121,6 +183,9 @@ MainLoop::MainLoop(const Arguments& args):
   exiting(false),
   debug_lag(0),
   turbo(false),
+  simulation_frames(0),
+  profiling_file(),
+  compile_data(false),
   lua_commands(),
   lua_commands_mutex(),
   num_lua_commands_pushed(0),
@@ -136,6 +201,37 @@ MainLoop::MainLoop(const Arguments& args):
   }
   const std::string& turbo_arg = args.get_argument_value("-turbo");
   turbo = (turbo_arg == "yes");
+  const std::string& simulation_frames_arg = args.get_argument_value("-simulation-frames");
+  if (!simulation_frames_arg.empty()) {
+    std::istringstream iss(simulation_frames_arg);
+    iss >> simulation_frames;
+  }
+  profiling_file = args.get_argument_value("-profile");
+  const std::string& collision_batching_arg = args.get_argument_value("-collision-batching");
+  CollisionBroadPhase::set_enabled(collision_batching_arg == "yes");
+  const std::string& swept_movements_arg = args.get_argument_value("-swept-movements");
+  Movement::set_swept_steps_enabled(swept_movements_arg == "yes");
+  const std::string& damage_tracking_arg = args.get_argument_value("-damage-tracking");
+  DamageTracker::set_enabled(damage_tracking_arg == "yes");
+  const std::string& glyph_cache_arg = args.get_argument_value("-glyph-cache");
+  FontResource::set_glyph_cache_enabled(glyph_cache_arg == "yes");
+  const std::string& incremental_draw_order_arg = args.get_argument_value("-incremental-draw-order");
+  Entities::set_incremental_draw_order_enabled(incremental_draw_order_arg == "yes");
+  const std::string& entity_pool_arg = args.get_argument_value("-entity-pool");
+  EntityPool::set_enabled(entity_pool_arg == "yes");
+  const std::string& mono_sounds_arg = args.get_argument_value("-mono-sounds");
+  Sound::set_mono_enabled(mono_sounds_arg != "no");
+  compile_data = args.has_argument("-compile-data");
+  const std::string& savegame_format_arg = args.get_argument_value("-savegame-format");
+  SavegameWriter::set_format(savegame_format_arg == "binary" ?
+      SavegameWriter::Format::BINARY : SavegameWriter::Format::LUA);
+
+  // A headless simulation never opens a window or an audio device.
+  Arguments system_args(args);
+  if (simulation_frames > 0 || compile_data) {
+    system_args.add_argument("-no-video");
+    system_args.add_argument("-no-audio");
+  }
 
   // Try to open the quest.
   const std::string& quest_path = get_quest_path(args);
@@ -146,19 +242,49 @@ MainLoop::MainLoop(const Arguments& args):
   }
 
   // Initialize engine features (audio, video...).
-  System::initialize(args);
+  System::initialize(system_args);
 
-  if (turbo) {
+  if (simulation_frames > 0) {
+    Logger::info("Headless simulation: " + String::to_string(simulation_frames) + " cycles");
+  }
+  else if (turbo) {
     Logger::info("Turbo mode: yes");
   }
   else {
     Logger::info("Turbo mode: no");
   }
 
+  if (CollisionBroadPhase::is_enabled()) {
+    Logger::info("Collision batching: yes");
+  }
+
+  if (DamageTracker::is_enabled()) {
+    Logger::info("Damage tracking: yes");
+  }
+
+  if (SavegameWriter::get_format() == SavegameWriter::Format::BINARY) {
+    Logger::info("Savegame format: binary");
+  }
+
+  if (!profiling_file.empty()) {
+    Logger::info("Profiling to '" + profiling_file + "'");
+    Profiler::set_enabled(true);
+  }
+
   // Read the quest resource list from data.
   CurrentQuest::initialize();
   TilePattern::initialize();
 
+  if (compile_data) {
+    // Only convert the data files: the quest is not run.
+    const int num_compiled =
+        compile_data_files<MapData>(ResourceType::MAP, "maps") +
+        compile_data_files<TilesetData>(ResourceType::TILESET, "tilesets") +
+        compile_data_files<SpriteData>(ResourceType::SPRITE, "sprites");
+    Logger::info("Compiled data files: " + String::to_string(num_compiled));
+    return;
+  }
+
   // Read the quest general properties.
   load_quest_properties();
 
@@ -167,6 +293,7 @@ MainLoop::MainLoop(const Arguments& args):
       Video::get_quest_size()
   );
   root_surface->set_software_destination(false);  // Accelerate this surface.
+  root_surface->set_damage_tracked(DamageTracker::is_enabled());  // Only effective without acceleration.
 
   // Run the Lua world.
   // Do this after the creation of the window, but before showing the window,
@@ -176,7 +303,8 @@ MainLoop::MainLoop(const Arguments& args):
 
   // Set up the Lua console.
   const std::string& lua_console_arg = args.get_argument_value("-lua-console");
-  const bool enable_lua_console = lua_console_arg.empty() || lua_console_arg == "yes";
+  const bool enable_lua_console = lua_console_arg == "yes" ||
+      (lua_console_arg.empty() && simulation_frames == 0);
   if (enable_lua_console) {
     Logger::info("Lua console: yes");
     initialize_lua_console();
@@ -206,6 +334,9 @@ MainLoop::~MainLoop() {
   if (lua_context != nullptr) {
     lua_context->exit();
   }
+  SavegameWriter::quit();  // Finish writing savegames before closing files.
+  resource_provider.clear();
+  Profiler::quit();
   TilePattern::quit();
   CurrentQuest::quit();
   QuestFiles::close_quest();
@@ -313,7 +444,12 @@ int MainLoop::push_lua_command(const std::string& command) {
  */
 void MainLoop::run() {
 
-  if (!QuestFiles::quest_exists()) {
+  if (!QuestFiles::quest_exists() || compile_data) {
+    return;
+  }
+
+  if (simulation_frames > 0) {
+    run_headless();
     return;
   }
 
@@ -348,6 +484,8 @@ void MainLoop::run() {
       last_frame_date = System::get_real_time() - time_dropped;
     }
 
+    Profiler::start_frame();
+
     // 1. Detect and handle input events.
     check_input();
 
@@ -388,6 +526,39 @@ void MainLoop::run() {
   }
 
   Logger::info("Simulation finished");
+
+  if (!profiling_file.empty()) {
+    Profiler::save(profiling_file);
+  }
+}
+
+/**
+ * \brief Runs a fixed number of cycles as fast as possible, without a window
+ * or an audio device.
+ *
+ * Each cycle detects input, updates the world of one timestep and draws the
+ * quest surface, so that all phases can be profiled.
+ * Since the simulated time only advances by System::timestep, two runs of
+ * the same quest give the same simulation.
+ */
+void MainLoop::run_headless() {
+
+  Logger::info("Headless simulation started");
+
+  int num_frames = 0;
+  while (num_frames < simulation_frames && !is_exiting()) {
+    Profiler::start_frame();
+    check_input();
+    step();
+    draw();
+    ++num_frames;
+  }
+
+  Logger::info("Headless simulation finished after " + String::to_string(num_frames) + " cycles");
+
+  if (!profiling_file.empty()) {
+    Profiler::save(profiling_file);
+  }
 }
 
 /**
@@ -405,6 +576,8 @@ void MainLoop::step() {
  */
 void MainLoop::check_input() {
 
+  Profiler::PhaseTimer timer(Profiler::Phase::INPUT);
+
   // Check SDL events.
   std::unique_ptr<InputEvent> event = InputEvent::get_event();
   while (event != nullptr) {
@@ -469,9 +642,13 @@ void MainLoop::notify_input(const InputEvent& event) {
 void MainLoop::update() {
 
   if (game != nullptr) {
+    Profiler::PhaseTimer timer(Profiler::Phase::GAME_UPDATE);
     game->update();
   }
-  lua_context->update();
+  {
+    Profiler::PhaseTimer timer(Profiler::Phase::LUA_UPDATE);
+    lua_context->update();
+  }
   System::update();
 
   // go to another game?
@@ -497,12 +674,14 @@ void MainLoop::update() {
  */
 void MainLoop::draw() {
 
+  root_surface->start_damage_recording();
   root_surface->clear();
 
   if (game != nullptr) {
     game->draw(root_surface);
   }
   lua_context->main_on_draw(root_surface);
+  root_surface->finish_damage_recording();
   Video::render(root_surface);
 }
 
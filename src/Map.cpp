@@ -16,9 +16,11 @@
  */
 #include "solarus/entities/Destination.h"
 #include "solarus/entities/Ground.h"
+#include "solarus/entities/GroundGrid.h"
 #include "solarus/entities/GroundInfo.h"
 #include "solarus/entities/Hero.h"
 #include "solarus/entities/NonAnimatedRegions.h"
+#include "solarus/entities/Teletransporter.h"
 #include "solarus/entities/TilePattern.h"
 #include "solarus/entities/Tileset.h"
 #include "solarus/lowlevel/Debug.h"
@@ -27,14 +29,39 @@
 #include "solarus/lowlevel/Surface.h"
 #include "solarus/lowlevel/Video.h"
 #include "solarus/lua/LuaContext.h"
+#include "solarus/CurrentQuest.h"
 #include "solarus/Game.h"
 #include "solarus/Map.h"
 #include "solarus/ResourceProvider.h"
 #include "solarus/Savegame.h"
 #include "solarus/Sprite.h"
+#include <algorithm>
 
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Returns the non-diagonal grounds that are obstacles for an entity.
+ * \param entity An entity.
+ * \return Bit field where bit \c n is set if <tt>Ground(n)</tt>
+ * is an obstacle.
+ */
+uint32_t get_obstacle_grounds(const Entity& entity) {
+
+  uint32_t obstacle_grounds = 0;
+  for (int i = 0; i < GroundGrid::num_grounds; ++i) {
+    const Ground ground = static_cast<Ground>(i);
+    if (!GroundInfo::is_ground_diagonal(ground) &&
+        entity.is_ground_obstacle(ground)) {
+      obstacle_grounds |= 1 << i;
+    }
+  }
+  return obstacle_grounds;
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Creates a map.
  * \param id Id of the map, used to determine the data file and
@@ -55,6 +82,7 @@ Map::Map(const std::string& id):
   started(false),
   destination_name(""),
   entities(nullptr),
+  path_finding_grid(nullptr),
   suspended(false) {
 
 }
@@ -87,7 +115,7 @@ const std::string& Map::get_tileset_id() const {
 void Map::set_tileset(const std::string& tileset_id) {
 
   ResourceProvider& resource_provider = get_game().get_resource_provider();
-  tileset = &resource_provider.get_tileset(tileset_id);
+  tileset = resource_provider.get_tileset(tileset_id);
   get_entities().notify_tileset_changed();
   this->tileset_id = tileset_id;
   build_background_surface();
@@ -265,6 +293,7 @@ void Map::unload() {
     background_surface = nullptr;
     foreground_surface = nullptr;
     entities = nullptr;
+    path_finding_grid = nullptr;
 
     loaded = false;
   }
@@ -283,18 +312,16 @@ void Map::load(Game& game) {
       Video::get_quest_size()
   );
 
-  // Read the map data file.
-  MapData data;
-  const std::string& file_name = std::string("maps/") + get_id() + ".dat";
-  bool success = data.import_from_quest_file(file_name);
-
-  if (!success) {
-    Debug::die("Failed to load map data file '" + file_name + "'");
+  // Get the map data, parsed in advance if the map was prefetched.
+  ResourceProvider& resource_provider = game.get_resource_provider();
+  std::shared_ptr<const MapData> map_data = resource_provider.get_map_data(get_id());
+  if (map_data == nullptr) {
+    Debug::die("Failed to load map data file 'maps/" + get_id() + ".dat'");
   }
+  const MapData& data = *map_data;
 
   // Initialize the map from the data just read.
   this->game = &game;
-  ResourceProvider& resource_provider = game.get_resource_provider();
   location.set_xy(data.get_location());
   location.set_size(data.get_size());
   width8 = data.get_size().width / 8;
@@ -305,7 +332,7 @@ void Map::load(Game& game) {
   set_world(data.get_world());
   set_floor(data.get_floor());
   tileset_id = data.get_tileset_id();
-  tileset = &resource_provider.get_tileset(tileset_id);
+  tileset = resource_provider.get_tileset(tileset_id);
   entities = std::unique_ptr<Entities>(new Entities(game, *this));
   entities->create_entities(data);
 
@@ -523,6 +550,9 @@ void Map::draw() {
     return;
   }
 
+  // Only redraw what changed since the previous frame if possible.
+  camera_surface->start_damage_recording();
+
   // background
   draw_background(camera_surface);
 
@@ -534,6 +564,8 @@ void Map::draw() {
 
   // Lua
   get_lua_context().map_on_draw(*this, camera_surface);
+
+  camera_surface->finish_damage_recording();
 }
 
 /**
@@ -699,6 +731,28 @@ void Map::start() {
   Music::play(music_id, true);
   this->entities->notify_map_started();
   get_lua_context().run_map(*this, get_destination());
+  prefetch_destination_maps();
+}
+
+/**
+ * \brief Starts parsing in background the maps where teletransporters of this
+ * map lead to.
+ *
+ * This avoids a pause when the hero takes one of them.
+ */
+void Map::prefetch_destination_maps() {
+
+  std::vector<std::string> map_ids;
+  for (const std::shared_ptr<Teletransporter>& teletransporter :
+      entities->get_entities_by_type<Teletransporter>()) {
+    const std::string& map_id = teletransporter->get_destination_map_id();
+    if (map_id != get_id() &&
+        std::find(map_ids.begin(), map_ids.end(), map_id) == map_ids.end() &&
+        CurrentQuest::resource_exists(ResourceType::MAP, map_id)) {
+      map_ids.push_back(map_id);
+    }
+  }
+  get_game().get_resource_provider().prefetch_maps(map_ids);
 }
 
 /**
@@ -740,6 +794,79 @@ void Map::notify_opening_transition_finished() {
   get_lua_context().map_on_opening_transition_finished(*this, get_destination());
 }
 
+/**
+ * \brief Returns the nodes used by path computations on this map.
+ *
+ * They are created the first time this function is called.
+ *
+ * \return The path finding grid.
+ */
+PathFindingGrid& Map::get_path_finding_grid() {
+
+  Debug::check_assertion(is_loaded(), "This map is not loaded");
+  if (path_finding_grid == nullptr) {
+    path_finding_grid = std::unique_ptr<PathFindingGrid>(
+        new PathFindingGrid(get_width8(), get_height8())
+    );
+
+    // Track entities that already modify the ground.
+    for (const EntityPtr& entity : entities->get_entities()) {
+      if (entity->is_ground_modifier()) {
+        path_finding_grid->notify_ground_modifier_changed(*entity);
+      }
+    }
+  }
+  return *path_finding_grid;
+}
+
+/**
+ * \brief Notifies the map that the tile ground changed in a rectangle.
+ *
+ * Terrain information cached for path computations is invalidated there.
+ *
+ * \param layer The layer where the ground changed.
+ * \param area The rectangle where the ground changed.
+ */
+void Map::notify_ground_changed(int layer, const Rectangle& area) {
+
+  if (path_finding_grid != nullptr) {
+    path_finding_grid->notify_ground_changed(layer, area);
+  }
+}
+
+/**
+ * \brief Notifies the map that an entity modifying the ground was added,
+ * moved, changed or removed.
+ *
+ * Ground versions and terrain information cached for path computations
+ * are invalidated where the entity was and where it is now.
+ *
+ * \param entity An entity that modifies the ground or just stopped
+ * modifying it.
+ */
+void Map::notify_ground_modifier_changed(const Entity& entity) {
+
+  entities->notify_ground_modifier_changed(entity);
+
+  if (path_finding_grid != nullptr) {
+    path_finding_grid->notify_ground_modifier_changed(entity);
+  }
+}
+
+/**
+ * \brief Notifies the map that an entity is being removed.
+ *
+ * Paths cached for this entity are forgotten.
+ *
+ * \param entity The entity being removed.
+ */
+void Map::notify_entity_removed(const Entity& entity) {
+
+  if (path_finding_grid != nullptr) {
+    path_finding_grid->notify_entity_removed(entity);
+  }
+}
+
 /**
  * \brief Tests whether a rectangle has overlaps the outside part of the map area.
  * \param collision_box the rectangle to check
@@ -857,16 +984,16 @@ bool Map::test_collision_with_entities(
     const Rectangle& collision_box,
     Entity& entity_to_check) {
 
-  EntityVector entities_nearby;
+  std::vector<Entity*> entities_nearby;
   get_entities().get_entities_in_rectangle(collision_box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (entity_nearby->overlaps(collision_box) &&
         (entity_nearby->get_layer() == layer || entity_nearby->has_layer_independent_collisions()) &&
         entity_nearby->is_obstacle_for(entity_to_check, collision_box) &&
         entity_nearby->is_enabled() &&
         !entity_nearby->is_being_removed() &&
-        entity_nearby.get() != &entity_to_check) {
+        entity_nearby != &entity_to_check) {
       return true;
     }
   }
@@ -888,16 +1015,61 @@ bool Map::test_collision_with_obstacles(
     const Rectangle& collision_box,
     Entity& entity_to_check) {
 
-  // This function is called very often.
-  // For performance reasons, we only check the border of the of the collision box.
-
   // Collisions with the terrain
   // (i.e., tiles and dynamic entities that may change it).
+  if (test_collision_with_ground(layer, collision_box, entity_to_check)) {
+    return true;
+  }
+
+  // No collision with the terrain: check collisions with dynamic entities.
+  return test_collision_with_entities(layer, collision_box, entity_to_check);
+}
+
+/**
+ * \brief Tests whether a rectangle collides with the ground of the map.
+ *
+ * Dynamic entities that are obstacles are not considered here,
+ * only the terrain (i.e. tiles and dynamic entities that may change it).
+ *
+ * \param layer Layer of the rectangle in the map.
+ * \param collision_box The rectangle to check (its dimensions should be
+ * multiples of 8).
+ * \param entity_to_check The entity to check (used to decide what grounds
+ * are considered as obstacle).
+ * \return \c true if the rectangle is overlapping an obstacle ground.
+ */
+bool Map::test_collision_with_ground(
+    int layer,
+    const Rectangle& collision_box,
+    const Entity& entity_to_check) const {
+
+  // This function is called very often.
+  // For performance reasons, we only check the border of the of the collision box.
   const int x1 = collision_box.get_x();
   const int x2 = x1 + collision_box.get_width() - 1;
   const int y1 = collision_box.get_y();
   const int y2 = y1 + collision_box.get_height() - 1;
 
+  // Usual case: the box is aligned to the 8x8 grid in size and no dynamic
+  // entity changes the ground around it.
+  // Then whole borders are tested at once on the grid of tile grounds.
+  if (collision_box.get_width() > 0 &&
+      collision_box.get_height() > 0 &&
+      collision_box.get_width() % 8 == 0 &&
+      collision_box.get_height() % 8 == 0) {
+
+    if (test_collision_with_border(x1, y1) ||
+        test_collision_with_border(x2, y2)) {
+      return true;
+    }
+
+    if (!has_ground_modifier(layer, collision_box, entity_to_check)) {
+      return entities->get_tile_ground_grid(layer).has_obstacle_on_border(
+          collision_box, get_obstacle_grounds(entity_to_check)
+      );
+    }
+  }
+
   // First, only check the terrain of both extremities of each 8-pixel
   // segment of the border.
   // This is enough for all terrains (except diagonal ones, see below)
@@ -943,8 +1115,39 @@ bool Map::test_collision_with_obstacles(
     }
   }
 
-  // No collision with the terrain: check collisions with dynamic entities.
-  return test_collision_with_entities(layer, collision_box, entity_to_check);
+  return false;
+}
+
+/**
+ * \brief Returns whether a dynamic entity may change the ground in a
+ * rectangle.
+ * \param layer Layer of the rectangle.
+ * \param box The rectangle to check.
+ * \param entity_to_ignore An entity whose own modified ground does not
+ * count.
+ * \return \c true if the ground of a point of this rectangle may differ
+ * from the ground of static tiles.
+ */
+bool Map::has_ground_modifier(
+    int layer,
+    const Rectangle& box,
+    const Entity& entity_to_ignore
+) const {
+
+  ConstEntityVector entities_nearby;
+  get_entities().get_entities_in_rectangle(box, entities_nearby);
+  for (const ConstEntityPtr& entity_nearby: entities_nearby) {
+
+    if (entity_nearby.get() != &entity_to_ignore &&
+        entity_nearby->get_modified_ground() != Ground::EMPTY &&
+        entity_nearby->get_layer() == layer &&
+        entity_nearby->is_enabled() &&
+        !entity_nearby->is_being_removed()) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 /**
@@ -1256,6 +1459,7 @@ Ground Map::get_ground_from_entity(const Entity& entity, const Point& xy) const
  * wants to check this entity.
  * We check whether or not the entity overlaps an entity detector.
  * If the map is suspended, this function does nothing.
+ * Checks postponed by the collision broad phase are done first.
  *
  * \param entity The entity that has just moved (this entity should have
  * a movement sensible to the collisions).
@@ -1271,13 +1475,40 @@ void Map::check_collision_with_detectors(Entity& entity) {
     return;
   }
 
-  // Check this entity with each detector.
+  // Checks postponed earlier in this cycle come first.
+  entities->get_collision_broad_phase().flush();
+  if (suspended) {
+    return;
+  }
 
   // Extend the box because some collision tests work without overlapping.
   Rectangle box = entity.get_extended_bounding_box(8);
-  std::vector<EntityPtr> entities_nearby;
+  std::vector<Entity*> entities_nearby;
   entities->get_entities_in_rectangle(box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  check_collision_with_detectors(entity, entities_nearby);
+}
+
+/**
+ * \brief Checks the collisions between an entity and some candidate detectors.
+ *
+ * This is the narrow phase of check_collision_with_detectors(Entity&).
+ *
+ * \param entity The entity that has just moved.
+ * \param entities_nearby Entities whose bounding box is near the extended
+ * bounding box of this entity. Non-detectors are ignored.
+ */
+void Map::check_collision_with_detectors(
+    Entity& entity,
+    const std::vector<Entity*>& entities_nearby
+) {
+
+  if (entity.is_being_removed() ||
+      !entity.is_enabled()) {
+    return;
+  }
+
+  // Check this entity with each detector.
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (entity.is_being_removed()) {
       return;
@@ -1302,6 +1533,7 @@ void Map::check_collision_with_detectors(Entity& entity) {
  * This function is called when a detector wants to check entities,
  * typically when the detector has just moved.
  * If the map is suspended, this function does nothing.
+ * Checks postponed by the collision broad phase are done first.
  *
  * \param detector A detector.
  */
@@ -1316,14 +1548,43 @@ void Map::check_collision_from_detector(Entity& detector) {
     return;
   }
 
+  // Checks postponed earlier in this cycle come first.
+  entities->get_collision_broad_phase().flush();
+  if (suspended) {
+    return;
+  }
+
+  Rectangle box = detector.get_extended_bounding_box(8);
+  std::vector<Entity*> entities_nearby;
+  entities->get_entities_in_rectangle(box, entities_nearby);
+  check_collision_from_detector(detector, entities_nearby);
+}
+
+/**
+ * \brief Checks the collisions between some candidate entities and a detector.
+ *
+ * This is the narrow phase of check_collision_from_detector(Entity&).
+ * The hero is always checked first, even if it is not a candidate.
+ *
+ * \param detector A detector.
+ * \param entities_nearby Entities whose bounding box is near the extended
+ * bounding box of the detector.
+ */
+void Map::check_collision_from_detector(
+    Entity& detector,
+    const std::vector<Entity*>& entities_nearby
+) {
+
+  if (detector.is_being_removed() ||
+      !detector.is_enabled()) {
+    return;
+  }
+
   // First check the hero.
   detector.check_collision(get_entities().get_hero());
 
   // Check each entity with this detector.
-  Rectangle box = detector.get_extended_bounding_box(8);
-  std::vector<EntityPtr> entities_nearby;
-  entities->get_entities_in_rectangle(box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (detector.is_being_removed()) {
       return;
@@ -1332,8 +1593,8 @@ void Map::check_collision_from_detector(Entity& detector) {
     if (entity_nearby->is_enabled() &&
         !entity_nearby->is_suspended() &&
         !entity_nearby->is_being_removed() &&
-        entity_nearby.get() != &detector &&
-        entity_nearby.get() != &get_entities().get_hero()
+        entity_nearby != &detector &&
+        entity_nearby != &get_entities().get_hero()
     ) {
       detector.check_collision(*entity_nearby);
     }
@@ -1347,6 +1608,8 @@ void Map::check_collision_from_detector(Entity& detector) {
  * This function is called when a detector wants to check entities,
  * typically when its sprite has just changed.
  * If the map is suspended, this function does nothing.
+ * If the collision broad phase is recording, the check may be postponed
+ * to the end of the current cycle.
  *
  * \param detector A detector.
  * \param detector_sprite The detector's sprite to check.
@@ -1362,14 +1625,51 @@ void Map::check_collision_from_detector(Entity& detector, Sprite& detector_sprit
     return;
   }
 
+  CollisionBroadPhase& broad_phase = entities->get_collision_broad_phase();
+  if (broad_phase.add_detector_sprite_changed(detector, detector_sprite)) {
+    return;
+  }
+
+  // Checks postponed earlier in this cycle come first.
+  broad_phase.flush();
+  if (suspended) {
+    return;
+  }
+
+  Rectangle box = detector.get_max_bounding_box();
+  std::vector<Entity*> entities_nearby;
+  entities->get_entities_in_rectangle(box, entities_nearby);
+  check_collision_from_detector(detector, detector_sprite, entities_nearby);
+}
+
+/**
+ * \brief Checks pixel-precise collisions between some candidate entities and
+ * a particular sprite of a detector.
+ *
+ * This is the narrow phase of check_collision_from_detector(Entity&, Sprite&).
+ * The hero is always checked first, even if it is not a candidate.
+ *
+ * \param detector A detector.
+ * \param detector_sprite The detector's sprite to check.
+ * \param entities_nearby Entities whose bounding box is near the maximum
+ * bounding box of the detector.
+ */
+void Map::check_collision_from_detector(
+    Entity& detector,
+    Sprite& detector_sprite,
+    const std::vector<Entity*>& entities_nearby
+) {
+
+  if (detector.is_being_removed() ||
+      !detector.is_enabled()) {
+    return;
+  }
+
   // First check the hero.
   detector.check_collision(detector_sprite, get_entities().get_hero());
 
   // Check each entity with this detector.
-  Rectangle box = detector.get_max_bounding_box();
-  std::vector<EntityPtr> entities_nearby;
-  entities->get_entities_in_rectangle(box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (detector.is_being_removed()) {
       return;
@@ -1378,8 +1678,8 @@ void Map::check_collision_from_detector(Entity& detector, Sprite& detector_sprit
     if (entity_nearby->is_enabled() &&
         !entity_nearby->is_suspended() &&
         !entity_nearby->is_being_removed() &&
-        entity_nearby.get() != &detector &&
-        entity_nearby.get() != &get_entities().get_hero()
+        entity_nearby != &detector &&
+        entity_nearby != &get_entities().get_hero()
     ) {
       detector.check_collision(detector_sprite, *entity_nearby);
     }
@@ -1394,6 +1694,8 @@ void Map::check_collision_from_detector(Entity& detector, Sprite& detector_sprit
  * when the frame of one of its sprites has just changed.
  * We check whether or not the sprite overlaps the detector.
  * If the map is suspended, this function does nothing.
+ * If the collision broad phase is recording, the check may be postponed
+ * to the end of the current cycle.
  *
  * \param entity A map entity.
  * \param sprite The sprite of this entity to check.
@@ -1408,11 +1710,46 @@ void Map::check_collision_with_detectors(Entity& entity, Sprite& sprite) {
     return;
   }
 
-  // Check each detector.
+  CollisionBroadPhase& broad_phase = entities->get_collision_broad_phase();
+  if (broad_phase.add_sprite_changed(entity, sprite)) {
+    return;
+  }
+
+  // Checks postponed earlier in this cycle come first.
+  broad_phase.flush();
+  if (suspended) {
+    return;
+  }
+
   Rectangle box = entity.get_max_bounding_box();
-  std::vector<EntityPtr> entities_nearby;
+  std::vector<Entity*> entities_nearby;
   entities->get_entities_in_rectangle(box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  check_collision_with_detectors(entity, sprite, entities_nearby);
+}
+
+/**
+ * \brief Checks the pixel-precise collisions between an entity and some
+ * candidate detectors.
+ *
+ * This is the narrow phase of check_collision_with_detectors(Entity&, Sprite&).
+ *
+ * \param entity A map entity.
+ * \param sprite The sprite of this entity to check.
+ * \param entities_nearby Entities whose bounding box is near the maximum
+ * bounding box of this entity. Non-detectors are ignored.
+ */
+void Map::check_collision_with_detectors(
+    Entity& entity,
+    Sprite& sprite,
+    const std::vector<Entity*>& entities_nearby
+) {
+
+  if (!entity.is_enabled()) {
+    return;
+  }
+
+  // Check each detector.
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (entity.is_being_removed()) {
       return;
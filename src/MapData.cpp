@@ -16,10 +16,12 @@
  */
 #include "solarus/entities/EntityTypeInfo.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaTools.h"
 #include "solarus/MapData.h"
 #include <ostream>
 #include <sstream>
+#include <utility>
 
 namespace Solarus {
 
@@ -939,5 +941,81 @@ bool MapData::export_to_lua(std::ostream& out) const {
   return true;
 }
 
+/**
+ * \copydoc LuaData::import_from_binary
+ */
+bool MapData::import_from_binary(BinaryDataReader& reader) {
+
+  MapData map;
+
+  // Map properties.
+  const int x = reader.read_int();
+  const int y = reader.read_int();
+  const int width = reader.read_int();
+  const int height = reader.read_int();
+  const int min_layer = reader.read_int();
+  const int max_layer = reader.read_int();
+  if (!reader.is_valid() || min_layer > 0 || max_layer < 0) {
+    return false;
+  }
+  map.set_location({ x, y });
+  map.set_size({ width, height });
+  map.set_min_layer(min_layer);
+  map.set_max_layer(max_layer);
+  map.set_world(reader.read_string());
+  map.set_floor(reader.read_int());
+  map.set_tileset_id(reader.read_string());
+  map.set_music_id(reader.read_string());
+
+  // Entities of each layer, tiles first.
+  for (int layer = min_layer; layer <= max_layer; ++layer) {
+    const uint32_t num_entities = reader.read_uint();
+    for (uint32_t i = 0; i < num_entities && reader.is_valid(); ++i) {
+      EntityData entity;
+      if (!entity.import_from_binary(reader) ||
+          entity.get_layer() != layer ||
+          !map.add_entity(entity).is_valid()) {
+        return false;
+      }
+    }
+  }
+
+  if (!reader.is_valid() || !reader.is_at_end()) {
+    return false;
+  }
+
+  *this = std::move(map);
+  return true;
+}
+
+/**
+ * \copydoc LuaData::export_to_binary
+ */
+bool MapData::export_to_binary(BinaryDataWriter& writer) const {
+
+  writer.write_int(get_location().x);
+  writer.write_int(get_location().y);
+  writer.write_int(get_size().width);
+  writer.write_int(get_size().height);
+  writer.write_int(get_min_layer());
+  writer.write_int(get_max_layer());
+  writer.write_string(get_world());
+  writer.write_int(get_floor());
+  writer.write_string(get_tileset_id());
+  writer.write_string(get_music_id());
+
+  for (int layer = get_min_layer(); layer <= get_max_layer(); ++layer) {
+    const std::deque<EntityData>& layer_entities = get_entities(layer);
+    writer.write_uint(layer_entities.size());
+    for (const EntityData& entity_data : layer_entities) {
+      if (!entity_data.export_to_binary(writer)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
 }  // namespace Solarus
 
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Logger.h"
+#include "solarus/Arguments.h"
+#include "solarus/ResourceCache.h"
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace Solarus {
+
+namespace {
+
+constexpr size_t default_budget = 128 * 1024 * 1024;
+
+/**
+ * \brief An element of the cache.
+ */
+struct Element {
+  ResourceType resource_type;         /**< Type of resource. */
+  std::string id;                     /**< Id of the resource. */
+  std::shared_ptr<void> resource;     /**< The resource. */
+  size_t memory_size;                 /**< Estimated size in bytes. */
+  bool pinned;                        /**< Whether eviction is forbidden. */
+};
+
+using ElementKey = std::pair<ResourceType, std::string>;
+
+std::mutex mutex;                     /**< Protects everything below. */
+std::list<Element> elements;          /**< Elements, most recently used first. */
+std::map<ElementKey, std::list<Element>::iterator>
+    elements_by_key;                  /**< Index of elements by type and id. */
+std::map<ResourceType, ResourceCache::Statistics>
+    statistics;                       /**< Statistics of each type of resource. */
+size_t budget = default_budget;       /**< Maximum total size in bytes. */
+size_t memory_size = 0;               /**< Current total size in bytes. */
+
+/**
+ * \brief Removes an element from the cache.
+ *
+ * The mutex must be locked.
+ *
+ * \param it The element to remove.
+ * \return The resource of this element, that should be released
+ * after unlocking the mutex.
+ */
+std::shared_ptr<void> remove_element(std::list<Element>::iterator it) {
+
+  ResourceCache::Statistics& type_statistics = statistics[it->resource_type];
+  --type_statistics.num_elements;
+  type_statistics.memory_size -= it->memory_size;
+  memory_size -= it->memory_size;
+
+  std::shared_ptr<void> resource = std::move(it->resource);
+  elements_by_key.erase(ElementKey(it->resource_type, it->id));
+  elements.erase(it);
+  return resource;
+}
+
+/**
+ * \brief Evicts least recently used elements until the budget is respected.
+ *
+ * Pinned elements and elements in use are skipped.
+ * The mutex must be locked.
+ *
+ * \param[out] evicted Resources evicted, to be released after unlocking
+ * the mutex.
+ */
+void evict_elements(std::vector<std::shared_ptr<void>>& evicted) {
+
+  auto it = elements.end();
+  while (memory_size > budget && it != elements.begin()) {
+    --it;
+    if (it->pinned || it->resource.use_count() > 1) {
+      continue;
+    }
+    ++statistics[it->resource_type].evictions;
+    auto next = std::next(it);
+    evicted.push_back(remove_element(it));
+    it = next;
+  }
+}
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Initializes the resource cache.
+ *
+ * Options recognized:
+ *   -resource-cache-size=MEGABYTES
+ *
+ * \param args Command-line arguments.
+ */
+void ResourceCache::initialize(const Arguments& args) {
+
+  set_budget(default_budget);
+
+  const std::string& size_arg = args.get_argument_value("-resource-cache-size");
+  if (!size_arg.empty()) {
+    std::istringstream iss(size_arg);
+    int megabytes = 0;
+    if (!(iss >> megabytes) || megabytes < 0) {
+      Debug::error("Invalid resource cache size: '" + size_arg + "'");
+    }
+    else {
+      set_budget(static_cast<size_t>(megabytes) * 1024 * 1024);
+      std::ostringstream oss;
+      oss << "Resource cache size: " << megabytes << " MB";
+      Logger::info(oss.str());
+    }
+  }
+}
+
+/**
+ * \brief Removes all elements and resets the statistics.
+ */
+void ResourceCache::quit() {
+
+  std::list<Element> removed_elements;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    removed_elements.swap(elements);
+    elements_by_key.clear();
+    statistics.clear();
+    memory_size = 0;
+  }
+}
+
+/**
+ * \brief Returns the maximum memory size of the cache.
+ * \return The budget in bytes.
+ */
+size_t ResourceCache::get_budget() {
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return budget;
+}
+
+/**
+ * \brief Sets the maximum memory size of the cache.
+ *
+ * Unused elements are evicted if necessary.
+ * Elements in use may still make the cache go over the budget.
+ *
+ * \param budget The budget in bytes.
+ */
+void ResourceCache::set_budget(size_t budget) {
+
+  std::vector<std::shared_ptr<void>> evicted;
+  std::lock_guard<std::mutex> lock(mutex);
+  Solarus::budget = budget;
+  evict_elements(evicted);
+}
+
+/**
+ * \brief Returns the estimated memory size of all elements in the cache.
+ * \return The memory size in bytes.
+ */
+size_t ResourceCache::get_memory_size() {
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return memory_size;
+}
+
+/**
+ * \brief Returns the usage statistics of a type of resource.
+ * \param resource_type A type of resource.
+ * \return The statistics.
+ */
+ResourceCache::Statistics ResourceCache::get_statistics(ResourceType resource_type) {
+
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto& it = statistics.find(resource_type);
+  if (it == statistics.end()) {
+    return Statistics();
+  }
+  return it->second;
+}
+
+/**
+ * \brief Returns whether an element is in the cache.
+ *
+ * Unlike find(), this does not change the statistics nor the order of
+ * eviction, and may be called from any thread.
+ *
+ * \param resource_type Type of resource to check.
+ * \param id Id of the element to check.
+ * \return \c true if the element is in the cache.
+ */
+bool ResourceCache::contains(ResourceType resource_type, const std::string& id) {
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return elements_by_key.find(ElementKey(resource_type, id)) != elements_by_key.end();
+}
+
+/**
+ * \brief Returns an element of the cache and marks it as recently used.
+ * \param resource_type Type of resource to get.
+ * \param id Id of the element to get.
+ * \return The element, or nullptr if it is not in the cache.
+ */
+std::shared_ptr<void> ResourceCache::find_element(
+    ResourceType resource_type,
+    const std::string& id
+) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const auto& it = elements_by_key.find(ElementKey(resource_type, id));
+  if (it == elements_by_key.end()) {
+    ++statistics[resource_type].misses;
+    return nullptr;
+  }
+
+  ++statistics[resource_type].hits;
+  elements.splice(elements.begin(), elements, it->second);
+  return it->second->resource;
+}
+
+/**
+ * \brief Adds an element to the cache.
+ * \param resource_type Type of resource to add.
+ * \param id Id of the element to add.
+ * \param resource The element.
+ * \param memory_size Estimated memory used by the element in bytes.
+ */
+void ResourceCache::add_element(
+    ResourceType resource_type,
+    const std::string& id,
+    const std::shared_ptr<void>& resource,
+    size_t memory_size
+) {
+  std::vector<std::shared_ptr<void>> evicted;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const ElementKey key(resource_type, id);
+  const auto& it = elements_by_key.find(key);
+  if (it != elements_by_key.end()) {
+    evicted.push_back(remove_element(it->second));
+  }
+
+  elements.push_front(Element{ resource_type, id, resource, memory_size, false });
+  elements_by_key[key] = elements.begin();
+  Statistics& type_statistics = statistics[resource_type];
+  ++type_statistics.num_elements;
+  type_statistics.memory_size += memory_size;
+  Solarus::memory_size += memory_size;
+
+  evict_elements(evicted);
+}
+
+/**
+ * \brief Sets whether an element of the cache can be evicted.
+ * \param resource_type Type of resource.
+ * \param id Id of the element. It must be in the cache.
+ * \param pinned \c true to keep the element in the cache until it is
+ * explicitly removed.
+ */
+void ResourceCache::set_pinned(
+    ResourceType resource_type,
+    const std::string& id,
+    bool pinned
+) {
+  std::vector<std::shared_ptr<void>> evicted;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const auto& it = elements_by_key.find(ElementKey(resource_type, id));
+  Debug::check_assertion(it != elements_by_key.end(),
+      "No such element in the resource cache: '" + id + "'");
+  it->second->pinned = pinned;
+
+  if (!pinned) {
+    evict_elements(evicted);
+  }
+}
+
+/**
+ * \brief Removes an element from the cache if it is there.
+ *
+ * If the element is in use, it continues to live while it is used.
+ *
+ * \param resource_type Type of resource to remove.
+ * \param id Id of the element to remove.
+ */
+void ResourceCache::remove(ResourceType resource_type, const std::string& id) {
+
+  std::shared_ptr<void> removed;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const auto& it = elements_by_key.find(ElementKey(resource_type, id));
+  if (it != elements_by_key.end()) {
+    removed = remove_element(it->second);
+  }
+}
+
+/**
+ * \brief Removes all elements of a type from the cache.
+ * \param resource_type Type of resource to remove.
+ */
+void ResourceCache::clear(ResourceType resource_type) {
+
+  std::vector<std::shared_ptr<void>> removed;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (auto it = elements.begin(); it != elements.end();) {
+    auto next = std::next(it);
+    if (it->resource_type == resource_type) {
+      removed.push_back(remove_element(it));
+    }
+    it = next;
+  }
+}
+
+}
+
@@ -14,37 +14,239 @@
  * You should have received a copy of the GNU General Public License along
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
+#include "solarus/lowlevel/Debug.h"
 #include "solarus/ResourceProvider.h"
+#include <algorithm>
 
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Reads and parses the data file of a map.
+ *
+ * This function may be called from the loader thread.
+ *
+ * \param map_id Id of the map to load.
+ * \return The map data, or nullptr in case of failure.
+ */
+std::shared_ptr<MapData> load_map_data(const std::string& map_id) {
+
+  std::shared_ptr<MapData> data = std::make_shared<MapData>();
+  const std::string& file_name = std::string("maps/") + map_id + ".dat";
+  if (!data->import_from_quest_file(file_name)) {
+    return nullptr;
+  }
+  return data;
+}
+
+/**
+ * \brief Reports on the main thread errors that happened in the loader thread.
+ * \param errors The error messages to report.
+ */
+void report_errors(const std::vector<std::string>& errors) {
+
+  for (const std::string& error : errors) {
+    Debug::error(error);
+  }
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Creates a resource provider.
  */
-ResourceProvider::ResourceProvider() {
+ResourceProvider::ResourceProvider():
+  loader_stopping(false) {
+}
+
+/**
+ * \brief Destroys the resource provider.
+ */
+ResourceProvider::~ResourceProvider() {
+
+  stop_loader_thread();
+}
+
+/**
+ * \brief Stops prefetching and clears all caches.
+ *
+ * This function must be called before the quest files are closed.
+ */
+void ResourceProvider::clear() {
+
+  stop_loader_thread();
+
+  std::lock_guard<std::mutex> lock(loader_mutex);
+  maps_to_prefetch.clear();
+  prefetched_maps.clear();
+  prefetched_tilesets.clear();
+  prefetched_map_errors.clear();
+  prefetched_tileset_errors.clear();
+  ResourceCache::clear(ResourceType::TILESET);
 }
 
 /**
  * \brief Provides the tileset with the given id.
+ *
+ * If the tileset is not in the resource cache but was prefetched,
+ * it is taken from the prefetched ones.
+ * If it is being prefetched right now, waits for the loader thread to finish.
+ *
  * \param tileset_id A tileset id.
- * \return The corresponding tileset.
+ * \return The corresponding tileset. It stays in the cache at least while
+ * you keep this pointer.
  */
-const Tileset& ResourceProvider::get_tileset(const std::string& tileset_id) {
+std::shared_ptr<const Tileset> ResourceProvider::get_tileset(const std::string& tileset_id) {
 
-  auto it = tileset_cache.find(tileset_id);
-  if (it != tileset_cache.end()) {
-    return *it->second;
+  std::shared_ptr<Tileset> tileset = ResourceCache::find<Tileset>(
+      ResourceType::TILESET, tileset_id
+  );
+  if (tileset != nullptr) {
+    return tileset;
   }
 
-  it = tileset_cache.emplace(
-        tileset_id,
-        std::unique_ptr<Tileset>(new Tileset(tileset_id))
-  ).first;
-  Tileset& tileset = *it->second;
-  tileset.load();
+  std::vector<std::string> errors;
+  {
+    std::unique_lock<std::mutex> lock(loader_mutex);
+    loader_condition.wait(lock, [&]() {
+      return tileset_being_prefetched != tileset_id;
+    });
+    const auto& prefetched_it = prefetched_tilesets.find(tileset_id);
+    if (prefetched_it != prefetched_tilesets.end()) {
+      tileset = std::move(prefetched_it->second);
+      prefetched_tilesets.erase(prefetched_it);
+    }
+    const auto& errors_it = prefetched_tileset_errors.find(tileset_id);
+    if (errors_it != prefetched_tileset_errors.end()) {
+      errors = std::move(errors_it->second);
+      prefetched_tileset_errors.erase(errors_it);
+    }
+  }
+  report_errors(errors);
+
+  if (tileset == nullptr) {
+    tileset = std::make_shared<Tileset>(tileset_id);
+    tileset->load();
+  }
+
+  ResourceCache::add(ResourceType::TILESET, tileset_id, tileset, tileset->get_memory_size());
   return tileset;
 }
 
+/**
+ * \brief Provides the data of the given map.
+ *
+ * If the map was prefetched, this is immediate.
+ * If it is being prefetched right now, waits for the loader thread to finish.
+ * Otherwise, the map data file is parsed now.
+ *
+ * \param map_id A map id.
+ * \return The corresponding map data, or nullptr if it could not be loaded.
+ */
+std::shared_ptr<const MapData> ResourceProvider::get_map_data(const std::string& map_id) {
+
+  bool wanted = false;
+  std::shared_ptr<const MapData> data;
+  std::vector<std::string> errors;
+  {
+    std::unique_lock<std::mutex> lock(loader_mutex);
+
+    // No need to wait for other maps before this one.
+    const auto& to_prefetch_it = std::remove(
+        maps_to_prefetch.begin(), maps_to_prefetch.end(), map_id
+    );
+    wanted = to_prefetch_it != maps_to_prefetch.end();
+    maps_to_prefetch.erase(to_prefetch_it, maps_to_prefetch.end());
+
+    loader_condition.wait(lock, [&]() {
+      return map_being_prefetched != map_id;
+    });
+    const auto& it = prefetched_maps.find(map_id);
+    if (it != prefetched_maps.end()) {
+      data = it->second;
+      const auto& errors_it = prefetched_map_errors.find(map_id);
+      if (errors_it != prefetched_map_errors.end()) {
+        errors = std::move(errors_it->second);
+        prefetched_map_errors.erase(errors_it);
+      }
+    }
+  }
+
+  if (data != nullptr) {
+    report_errors(errors);
+    return data;
+  }
+
+  data = load_map_data(map_id);
+
+  if (wanted && data != nullptr) {
+    // The loader thread did not get to it yet: keep it like a prefetched map.
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    prefetched_maps.emplace(map_id, data);
+  }
+  return data;
+}
+
+/**
+ * \brief Starts parsing in background maps that will probably be needed soon.
+ *
+ * Prefetched maps that are not in the list are forgotten.
+ *
+ * \param map_ids Ids of the maps to prefetch.
+ */
+void ResourceProvider::prefetch_maps(const std::vector<std::string>& map_ids) {
+
+  std::lock_guard<std::mutex> lock(loader_mutex);
+
+  const auto& is_wanted = [&](const std::string& map_id) {
+    return std::find(map_ids.begin(), map_ids.end(), map_id) != map_ids.end();
+  };
+
+  // Forget maps that are no longer reachable, and their unused tilesets.
+  for (auto it = prefetched_maps.begin(); it != prefetched_maps.end();) {
+    if (!is_wanted(it->first)) {
+      prefetched_map_errors.erase(it->first);
+      it = prefetched_maps.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  for (auto it = prefetched_tilesets.begin(); it != prefetched_tilesets.end();) {
+    const bool used = std::any_of(prefetched_maps.begin(), prefetched_maps.end(),
+        [&](const std::pair<const std::string, std::shared_ptr<const MapData>>& kvp) {
+      return kvp.second->get_tileset_id() == it->first;
+    });
+    if (!used) {
+      prefetched_tileset_errors.erase(it->first);
+      it = prefetched_tilesets.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  maps_to_prefetch.clear();
+  for (const std::string& map_id : map_ids) {
+    if (prefetched_maps.find(map_id) == prefetched_maps.end() &&
+        map_id != map_being_prefetched &&
+        std::find(maps_to_prefetch.begin(), maps_to_prefetch.end(), map_id) == maps_to_prefetch.end()) {
+      maps_to_prefetch.push_back(map_id);
+    }
+  }
+
+  if (maps_to_prefetch.empty()) {
+    return;
+  }
+
+  if (!loader_thread.joinable()) {
+    loader_stopping = false;
+    loader_thread = std::thread(&ResourceProvider::loader_thread_loop, this);
+  }
+  loader_condition.notify_all();
+}
+
 /**
  * \brief Notifies the resource provider that cached data (if any) is no longer valid.
  *
@@ -57,10 +259,25 @@ void ResourceProvider::invalidate_resource_element(
     ResourceType resource_type,
     const std::string& element_id) {
 
+  std::unique_lock<std::mutex> lock(loader_mutex);
+
   switch (resource_type) {
 
   case ResourceType::TILESET:
-    tileset_cache.erase(element_id);
+    loader_condition.wait(lock, [&]() {
+      return tileset_being_prefetched != element_id;
+    });
+    ResourceCache::remove(ResourceType::TILESET, element_id);
+    prefetched_tilesets.erase(element_id);
+    prefetched_tileset_errors.erase(element_id);
+    break;
+
+  case ResourceType::MAP:
+    loader_condition.wait(lock, [&]() {
+      return map_being_prefetched != element_id;
+    });
+    prefetched_maps.erase(element_id);
+    prefetched_map_errors.erase(element_id);
     break;
 
   default:
@@ -68,4 +285,106 @@ void ResourceProvider::invalidate_resource_element(
   }
 }
 
+/**
+ * \brief Stops the loader thread if it is running.
+ *
+ * Waits for the map being prefetched if any.
+ */
+void ResourceProvider::stop_loader_thread() {
+
+  if (!loader_thread.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    loader_stopping = true;
+  }
+  loader_condition.notify_all();
+  loader_thread.join();
+  loader_stopping = false;
 }
+
+/**
+ * \brief Main function of the loader thread.
+ *
+ * Parses the maps to prefetch one by one, as well as their tileset
+ * if it is not loaded yet.
+ * Errors are not reported from this thread: they are collected and
+ * reported by the main thread when the resource is actually needed.
+ * Anything that fails here is left to the main thread, that will
+ * try again and report the error itself.
+ */
+void ResourceProvider::loader_thread_loop() {
+
+  std::unique_lock<std::mutex> lock(loader_mutex);
+  while (true) {
+
+    loader_condition.wait(lock, [&]() {
+      return loader_stopping || !maps_to_prefetch.empty();
+    });
+    if (loader_stopping) {
+      return;
+    }
+
+    const std::string map_id = maps_to_prefetch.front();
+    maps_to_prefetch.pop_front();
+    map_being_prefetched = map_id;
+    lock.unlock();
+
+    std::shared_ptr<MapData> map_data;
+    std::vector<std::string> map_errors;
+    Debug::set_error_collector(&map_errors);
+    try {
+      map_data = load_map_data(map_id);
+    }
+    catch (const std::exception&) {
+      map_data = nullptr;
+    }
+    Debug::set_error_collector(nullptr);
+
+    lock.lock();
+    map_being_prefetched.clear();
+
+    if (map_data != nullptr) {
+      prefetched_maps[map_id] = map_data;
+      if (!map_errors.empty()) {
+        prefetched_map_errors[map_id] = std::move(map_errors);
+      }
+
+      const std::string& tileset_id = map_data->get_tileset_id();
+      if (!ResourceCache::contains(ResourceType::TILESET, tileset_id) &&
+          prefetched_tilesets.find(tileset_id) == prefetched_tilesets.end()) {
+        tileset_being_prefetched = tileset_id;
+        lock.unlock();
+
+        std::shared_ptr<Tileset> tileset;
+        std::vector<std::string> tileset_errors;
+        Debug::set_error_collector(&tileset_errors);
+        try {
+          tileset = std::make_shared<Tileset>(tileset_id);
+          tileset->load();
+        }
+        catch (const std::exception&) {
+          tileset = nullptr;
+        }
+        Debug::set_error_collector(nullptr);
+
+        lock.lock();
+        tileset_being_prefetched.clear();
+        if (tileset != nullptr &&
+            !ResourceCache::contains(ResourceType::TILESET, tileset_id)) {
+          prefetched_tilesets.emplace(tileset_id, std::move(tileset));
+          if (!tileset_errors.empty()) {
+            prefetched_tileset_errors[tileset_id] = std::move(tileset_errors);
+          }
+        }
+      }
+    }
+
+    loader_condition.notify_all();
+  }
+}
+
+}
+
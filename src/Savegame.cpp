@@ -16,14 +16,17 @@
  */
 #include "solarus/Savegame.h"
 #include "solarus/SavegameConverterV1.h"
+#include "solarus/SavegameWriter.h"
 #include "solarus/MainLoop.h"
 #include "solarus/lowlevel/QuestFiles.h"
 #include "solarus/lowlevel/InputEvent.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/StringInterner.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaContext.h"
 #include "solarus/lua/LuaTools.h"
 #include <lua.hpp>
-#include <sstream>
+#include <utility>
 
 namespace Solarus {
 
@@ -81,6 +84,10 @@ const std::string Savegame::KEY_ABILITY_GET_BACK_FROM_DEATH =
  */
 Savegame::Savegame(MainLoop& main_loop, const std::string& file_name):
   ExportableToLua(),
+  saved_values(),
+  dirty_keys(),
+  all_dirty(true),
+  writer_id(SavegameWriter::create_savegame_id()),
   empty(true),
   file_name(file_name),
   main_loop(main_loop),
@@ -91,6 +98,16 @@ Savegame::Savegame(MainLoop& main_loop, const std::string& file_name):
   // at this point, but is needed by initialize() when calling item scripts.
 }
 
+/**
+ * \brief Destroys this savegame.
+ *
+ * Saves already requested are still written.
+ */
+Savegame::~Savegame() {
+
+  SavegameWriter::release_savegame_id(writer_id);
+}
+
 /**
  * \brief Initializes the data from the file or from initial values if the file
  * does not exist.
@@ -105,6 +122,9 @@ void Savegame::initialize() {
   Debug::check_assertion(!quest_write_dir.empty(),
       "The quest write directory for savegames was not set in quest.dat");
 
+  // Make sure that a previous save of this file is finished.
+  SavegameWriter::flush();
+
   if (!QuestFiles::data_file_exists(file_name)) {
     // This save does not exist yet.
     empty = true;
@@ -193,12 +213,24 @@ void Savegame::set_default_joypad_controls() {
 
 /**
  * \brief Import the savegame data from the file.
+ *
+ * The file can be in the binary format, in the Lua format
+ * or in the obsolete format of Solarus 0.9.
  */
 void Savegame::import_from_file() {
 
-  // Try to parse as Lua first.
-  lua_State* l = luaL_newstate();
   const std::string& buffer = QuestFiles::data_file_read(file_name);
+
+  if (BinaryDataReader::is_binary_buffer(buffer)) {
+    if (!import_from_binary(buffer)) {
+      Debug::die(std::string("Failed to load savegame file '")
+          + file_name + "': invalid binary savegame");
+    }
+    return;
+  }
+
+  // Try to parse as Lua.
+  lua_State* l = luaL_newstate();
   const int load_result = luaL_loadbuffer(l, buffer.data(), buffer.size(), file_name.c_str());
 
   // Call the Lua savegame file.
@@ -238,6 +270,51 @@ void Savegame::import_from_file() {
   lua_close(l);
 }
 
+/**
+ * \brief Import the savegame data from a file in the binary format.
+ *
+ * The layout is the number of values, followed by the key, the type and
+ * the value of each one.
+ * See SavegameWriter::serialize().
+ *
+ * \param buffer Content of the file.
+ * \return \c true in case of success. In case of failure,
+ * values of this savegame are unspecified.
+ */
+bool Savegame::import_from_binary(const std::string& buffer) {
+
+  BinaryDataReader reader(buffer, "");
+  const uint32_t num_values = reader.read_uint();
+  for (uint32_t i = 0; i < num_values && reader.is_valid(); ++i) {
+
+    const std::string& key = reader.read_string();
+    if (!LuaTools::is_valid_lua_identifier(key)) {
+      return false;
+    }
+
+    const uint32_t type = reader.read_uint();
+    switch (type) {
+
+    case SavedValue::VALUE_STRING:
+      set_string(key, reader.read_string());
+      break;
+
+    case SavedValue::VALUE_INTEGER:
+      set_integer(key, reader.read_int());
+      break;
+
+    case SavedValue::VALUE_BOOLEAN:
+      set_boolean(key, reader.read_bool());
+      break;
+
+    default:
+      return false;
+    }
+  }
+
+  return reader.is_valid() && reader.is_at_end();
+}
+
 /**
  * \brief __newindex function of the environment of the savegame file.
  *
@@ -280,28 +357,36 @@ int Savegame::l_newindex(lua_State* l) {
 
 /**
  * \brief Saves the data into a file.
+ *
+ * Only values changed since the previous save are copied here.
+ * The file is serialized and written later by a background thread,
+ * see SavegameWriter.
  */
 void Savegame::save() {
 
-  std::ostringstream oss;
-  for (const auto& kvp: saved_values) {
-    const std::string& key = kvp.first;
-    oss << key << " = ";
-    const SavedValue& value = kvp.second;
-    if (value.type == SavedValue::VALUE_BOOLEAN) {
-      oss << (value.int_data ? "true" : "false");
-    }
-    else if (value.type == SavedValue::VALUE_INTEGER) {
-      oss << value.int_data;
+  SavegameWriter::Changes changes;
+  changes.all_values = all_dirty;
+  if (all_dirty) {
+    for (const auto& kvp : saved_values) {
+      changes.values.emplace(StringInterner::get_string(kvp.first), kvp.second);
     }
-    else {  // String.
-      oss << "\"" << value.string_data << "\"";
+  }
+  else {
+    for (int key_id : dirty_keys) {
+      const std::string& key = StringInterner::get_string(key_id);
+      const auto& it = saved_values.find(key_id);
+      if (it != saved_values.end()) {
+        changes.values.emplace(key, it->second);
+      }
+      else {
+        changes.unset_keys.insert(key);
+      }
     }
-    oss << "\n";
   }
 
-  const std::string& text = oss.str();
-  QuestFiles::data_file_save(file_name, text);
+  SavegameWriter::write(writer_id, file_name, std::move(changes));
+  dirty_keys.clear();
+  all_dirty = false;
   empty = false;
 }
 
@@ -384,16 +469,8 @@ void Savegame::notify_game_finished() {
  */
 bool Savegame::is_string(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  bool result = false;
-  const auto& it = saved_values.find(key);
-  if (it != saved_values.end()) {
-    const SavedValue& value = it->second;
-    result = (value.type == SavedValue::VALUE_STRING);
-  }
-  return result;
+  const SavedValue* value = find_saved_value(key);
+  return value != nullptr && value->type == SavedValue::VALUE_STRING;
 }
 
 /**
@@ -403,21 +480,16 @@ bool Savegame::is_string(const std::string& key) const {
  */
 std::string Savegame::get_string(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  const auto& it = saved_values.find(key);
-  if (it == saved_values.end()) {
+  const SavedValue* value = find_saved_value(key);
+  if (value == nullptr) {
     return "";
   }
-
-  const SavedValue& value = it->second;
-  if (value.type != SavedValue::VALUE_STRING) {
+  if (value->type != SavedValue::VALUE_STRING) {
     Debug::error(std::string("Value '") + key + "' is not a string");
     return "";
   }
 
-  return value.string_data;
+  return value->string_data;
 }
 
 /**
@@ -427,11 +499,9 @@ std::string Savegame::get_string(const std::string& key) const {
  */
 void Savegame::set_string(const std::string& key, const std::string& value) {
 
-  Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  saved_values[key].type = SavedValue::VALUE_STRING;
-  saved_values[key].string_data = value;
+  SavedValue& saved_value = create_saved_value(key);
+  saved_value.type = SavedValue::VALUE_STRING;
+  saved_value.string_data = value;
 }
 
 /**
@@ -441,16 +511,8 @@ void Savegame::set_string(const std::string& key, const std::string& value) {
  */
 bool Savegame::is_integer(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  bool result = false;
-  const auto& it = saved_values.find(key);
-  if (it != saved_values.end()) {
-    const SavedValue& value = it->second;
-    result = (value.type == SavedValue::VALUE_INTEGER);
-  }
-  return result;
+  const SavedValue* value = find_saved_value(key);
+  return value != nullptr && value->type == SavedValue::VALUE_INTEGER;
 }
 
 /**
@@ -460,20 +522,15 @@ bool Savegame::is_integer(const std::string& key) const {
  */
 int Savegame::get_integer(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  const auto& it = saved_values.find(key);
-  if (it == saved_values.end()) {
+  const SavedValue* value = find_saved_value(key);
+  if (value == nullptr) {
     return 0;
   }
-
-  const SavedValue& value = it->second;
-  if (value.type != SavedValue::VALUE_INTEGER) {
+  if (value->type != SavedValue::VALUE_INTEGER) {
     Debug::error(std::string("Value '") + key + "' is not an integer");
   }
 
-  return value.int_data;
+  return value->int_data;
 }
 
 /**
@@ -483,11 +540,9 @@ int Savegame::get_integer(const std::string& key) const {
  */
 void Savegame::set_integer(const std::string& key, int value) {
 
-  Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  saved_values[key].type = SavedValue::VALUE_INTEGER;
-  saved_values[key].int_data = value;
+  SavedValue& saved_value = create_saved_value(key);
+  saved_value.type = SavedValue::VALUE_INTEGER;
+  saved_value.int_data = value;
 }
 
 /**
@@ -497,16 +552,8 @@ void Savegame::set_integer(const std::string& key, int value) {
  */
 bool Savegame::is_boolean(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  bool result = false;
-  const auto& it = saved_values.find(key);
-  if (it != saved_values.end()) {
-    const SavedValue& value = it->second;
-    result = (value.type == SavedValue::VALUE_BOOLEAN);
-  }
-  return result;
+  const SavedValue* value = find_saved_value(key);
+  return value != nullptr && value->type == SavedValue::VALUE_BOOLEAN;
 }
 
 /**
@@ -516,20 +563,15 @@ bool Savegame::is_boolean(const std::string& key) const {
  */
 bool Savegame::get_boolean(const std::string& key) const {
 
-  SOLARUS_ASSERT(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  const auto& it = saved_values.find(key);
-  if (it == saved_values.end()) {
+  const SavedValue* value = find_saved_value(key);
+  if (value == nullptr) {
     return false;
   }
-
-  const SavedValue& value = it->second;
-  if (value.type != SavedValue::VALUE_BOOLEAN) {
+  if (value->type != SavedValue::VALUE_BOOLEAN) {
     Debug::error(std::string("Value '") + key + "' is not a boolean");
     return false;
   }
-  return value.int_data != 0;
+  return value->int_data != 0;
 }
 
 /**
@@ -539,11 +581,9 @@ bool Savegame::get_boolean(const std::string& key) const {
  */
 void Savegame::set_boolean(const std::string& key, bool value) {
 
-  Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
-      std::string("Savegame variable '") + key + "' is not a valid key");
-
-  saved_values[key].type = SavedValue::VALUE_BOOLEAN;
-  saved_values[key].int_data = value;
+  SavedValue& saved_value = create_saved_value(key);
+  saved_value.type = SavedValue::VALUE_BOOLEAN;
+  saved_value.int_data = value;
 }
 
 /**
@@ -552,10 +592,88 @@ void Savegame::set_boolean(const std::string& key, bool value) {
  */
 void Savegame::unset(const std::string& key) {
 
-  Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
+  const int key_id = StringInterner::find(key);
+  if (key_id == -1 || saved_values.erase(key_id) == 0) {
+    // This key is not set: only check it.
+    Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
+        std::string("Savegame variable '") + key + "' is not a valid key");
+    return;
+  }
+  set_dirty(key_id);
+}
+
+/**
+ * \brief Returns a value saved, whatever its type.
+ *
+ * This needs a single lookup, unlike is_string() followed by get_string()
+ * for example.
+ * The key is not checked: an invalid key is simply not found.
+ *
+ * \param key Name of the value to get.
+ * \return The value associated with this key, or nullptr if there is no
+ * such value.
+ */
+const Savegame::SavedValue* Savegame::get_saved_value(const std::string& key) const {
+
+  const int key_id = StringInterner::find(key);
+  if (key_id == -1) {
+    return nullptr;
+  }
+
+  const auto& it = saved_values.find(key_id);
+  if (it == saved_values.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+/**
+ * \brief Like get_saved_value(), but also checks the key in debug mode.
+ *
+ * Keys are only checked when they are not found:
+ * keys of existing values were checked when they were set.
+ *
+ * \param key Name of the value to get.
+ * \return The value associated with this key, or nullptr if there is no
+ * such value.
+ */
+const Savegame::SavedValue* Savegame::find_saved_value(const std::string& key) const {
+
+  const SavedValue* value = get_saved_value(key);
+  SOLARUS_ASSERT(value != nullptr || LuaTools::is_valid_lua_identifier(key),
       std::string("Savegame variable '") + key + "' is not a valid key");
+  return value;
+}
+
+/**
+ * \brief Returns the value with the given key, creating it if necessary,
+ * and marks it as changed since the previous save.
+ * \param key Name of the value.
+ * \return The value associated with this key.
+ */
+Savegame::SavedValue& Savegame::create_saved_value(const std::string& key) {
+
+  int key_id = StringInterner::find(key);
+  if (key_id == -1 || saved_values.find(key_id) == saved_values.end()) {
+    // New value: check the key.
+    Debug::check_assertion(LuaTools::is_valid_lua_identifier(key),
+        std::string("Savegame variable '") + key + "' is not a valid key");
+    key_id = StringInterner::intern(key);
+  }
 
-  saved_values.erase(key);
+  set_dirty(key_id);
+  return saved_values[key_id];
+}
+
+/**
+ * \brief Marks a value as changed since the previous save.
+ * \param key_id Interned name of the value set or unset.
+ */
+void Savegame::set_dirty(int key_id) {
+
+  if (!all_dirty) {
+    dirty_keys.insert(key_id);
+  }
 }
 
 /**
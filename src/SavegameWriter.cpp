@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/SavegameWriter.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lua/BinaryData.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Solarus {
+
+namespace SavegameWriter {
+
+namespace {
+
+  /**
+   * \brief A save waiting for the writer thread.
+   */
+  struct WriteRequest {
+    int savegame_id;                    /**< The savegame to write. */
+    std::string file_name;              /**< File to write, or an empty string
+                                         * to release the savegame. */
+    Changes changes;                    /**< Values changed since the previous request. */
+    Format format;                      /**< Format to write. */
+  };
+
+  /**
+   * \brief The writer thread copy of a savegame.
+   */
+  struct SavegameState {
+    std::map<std::string, Savegame::SavedValue>
+        values;                         /**< All values as of the last request. */
+    std::string file_name;              /**< File to write. */
+    Format format;                      /**< Format to write. */
+    std::string written_buffer;         /**< Content of the last successful write. */
+  };
+
+  Format current_format = Format::LUA;  /**< Format of savegames written. */
+  int next_savegame_id = 0;             /**< Id of the next savegame created. */
+
+  // Shared with the writer thread (protected by mutex).
+  std::thread writer_thread;            /**< Thread that serializes and writes files. */
+  std::mutex mutex;                     /**< Protects the requests. */
+  std::condition_variable condition;    /**< Signals new requests and finished writes. */
+  std::vector<WriteRequest>
+      pending_requests;                 /**< Requests not yet taken by the writer thread. */
+  bool writing = false;                 /**< Whether the writer thread is processing requests. */
+  bool stopping = false;                /**< Whether the writer thread should stop
+                                         * once all requests are processed. */
+  bool paused = false;                  /**< Whether the writer thread should leave
+                                         * requests pending. */
+
+  // Only used by the writer thread.
+  std::map<int, SavegameState> states;  /**< Copy of each savegame written. */
+
+  /**
+   * \brief Applies a save request to the writer thread copy of its savegame.
+   * \param request The request to apply.
+   */
+  void apply_request(WriteRequest& request) {
+
+    SavegameState& state = states[request.savegame_id];
+    state.file_name = request.file_name;
+    state.format = request.format;
+
+    Changes& changes = request.changes;
+    if (changes.all_values) {
+      state.values = std::move(changes.values);
+    }
+    else {
+      for (auto& kvp : changes.values) {
+        state.values[kvp.first] = std::move(kvp.second);
+      }
+    }
+    for (const std::string& key : changes.unset_keys) {
+      state.values.erase(key);
+    }
+  }
+
+  /**
+   * \brief Serializes and writes the savegames of some requests.
+   *
+   * All requests are applied first so that a savegame saved several times
+   * is written only once, in the order of its last request.
+   * Released savegames are forgotten only after these writes.
+   *
+   * \param requests The requests to process.
+   * \param buffer Buffer to reuse for serializing savegames.
+   */
+  void process_requests(std::vector<WriteRequest>& requests, std::string& buffer) {
+
+    std::vector<int> savegame_ids;
+    std::vector<int> released_ids;
+    for (WriteRequest& request : requests) {
+      if (request.file_name.empty()) {
+        released_ids.push_back(request.savegame_id);
+        continue;
+      }
+      savegame_ids.erase(
+          std::remove(savegame_ids.begin(), savegame_ids.end(), request.savegame_id),
+          savegame_ids.end()
+      );
+      savegame_ids.push_back(request.savegame_id);
+      apply_request(request);
+    }
+
+    for (int savegame_id : savegame_ids) {
+      SavegameState& state = states[savegame_id];
+      buffer = serialize(state.values, state.format);
+      if (buffer == state.written_buffer &&
+          QuestFiles::data_file_exists(state.file_name)) {
+        // Nothing changed since the previous write.
+        continue;
+      }
+
+      if (!QuestFiles::data_file_replace(state.file_name, buffer)) {
+        Debug::error("Cannot write savegame file '" + state.file_name + "'");
+        state.written_buffer.clear();
+        continue;
+      }
+      // Keep the content written and reuse the previous one as the next buffer.
+      std::swap(buffer, state.written_buffer);
+    }
+
+    // Saved then released: the last save was written above.
+    for (int savegame_id : released_ids) {
+      states.erase(savegame_id);
+    }
+  }
+
+  /**
+   * \brief Main function of the writer thread.
+   */
+  void writer_thread_loop() {
+
+    // Requests being processed, swapped with pending_requests.
+    std::vector<WriteRequest> requests;
+    std::string buffer;
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        writing = false;
+        condition.notify_all();
+        condition.wait(lock, []() {
+          return stopping || (!paused && !pending_requests.empty());
+        });
+        if (pending_requests.empty()) {
+          return;
+        }
+        requests.swap(pending_requests);
+        writing = true;
+      }
+
+      process_requests(requests, buffer);
+      requests.clear();
+    }
+  }
+
+  /**
+   * \brief Adds a request for the writer thread.
+   * \param request The request to add.
+   */
+  void push_request(WriteRequest&& request) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writer_thread.joinable()) {
+      stopping = false;
+      writer_thread = std::thread(writer_thread_loop);
+    }
+    pending_requests.push_back(std::move(request));
+    condition.notify_all();
+  }
+
+  /**
+   * \brief Appends a string value as a Lua string literal.
+   * \param oss The stream to write.
+   * \param value The string value.
+   */
+  void write_lua_string(std::ostringstream& oss, const std::string& value) {
+
+    oss << "\"";
+    for (char c : value) {
+      switch (c) {
+
+      case '\\':
+      case '"':
+        oss << '\\' << c;
+        break;
+
+      case '\n':
+        oss << "\\n";
+        break;
+
+      case '\r':
+        oss << "\\r";
+        break;
+
+      default:
+        oss << c;
+      }
+    }
+    oss << "\"";
+  }
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Sets the format of savegame files written from now on.
+ *
+ * Savegames in any format can always be read.
+ *
+ * \param format The format to use.
+ */
+void set_format(Format format) {
+  current_format = format;
+}
+
+/**
+ * \brief Returns the format of savegame files written.
+ * \return The format used.
+ */
+Format get_format() {
+  return current_format;
+}
+
+/**
+ * \brief Returns a new identifier for a savegame object.
+ *
+ * Each savegame object should release its identifier
+ * with release_savegame_id() when it is destroyed.
+ *
+ * \return A new savegame id.
+ */
+int create_savegame_id() {
+  return next_savegame_id++;
+}
+
+/**
+ * \brief Requests to write a savegame.
+ *
+ * The first request of a savegame id must contain all values.
+ * The function returns immediately: the file is written later
+ * by the writer thread.
+ *
+ * \param savegame_id Id of the savegame object.
+ * \param file_name Savegame file name relative to the quest write directory.
+ * \param changes Values changed since the previous request of this id.
+ */
+void write(int savegame_id, const std::string& file_name, Changes&& changes) {
+
+  Debug::check_assertion(!file_name.empty(), "Missing savegame file name");
+
+  WriteRequest request;
+  request.savegame_id = savegame_id;
+  request.file_name = file_name;
+  request.changes = std::move(changes);
+  request.format = current_format;
+  push_request(std::move(request));
+}
+
+/**
+ * \brief Notifies that a savegame object no longer exists.
+ *
+ * Its copy in the writer thread is freed once its pending saves,
+ * if any, are written.
+ *
+ * \param savegame_id Id of the destroyed savegame object.
+ */
+void release_savegame_id(int savegame_id) {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writer_thread.joinable()) {
+      // Never saved.
+      return;
+    }
+  }
+
+  WriteRequest request;
+  request.savegame_id = savegame_id;
+  request.changes.all_values = false;
+  request.format = current_format;
+  push_request(std::move(request));
+}
+
+/**
+ * \brief Suspends or resumes the processing of requests.
+ *
+ * While paused, requests are kept pending, as if the writer thread was busy.
+ * quit() still writes them.
+ *
+ * \param paused \c true to suspend the writer thread, \c false to resume it.
+ */
+void set_paused(bool paused) {
+
+  std::lock_guard<std::mutex> lock(mutex);
+  SavegameWriter::paused = paused;
+  condition.notify_all();
+}
+
+/**
+ * \brief Waits until all requested saves are written.
+ *
+ * Call this function before reading, testing or deleting savegame files.
+ * It must not be called while the writer thread is paused.
+ */
+void flush() {
+
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, []() {
+    return pending_requests.empty() && !writing;
+  });
+}
+
+/**
+ * \brief Writes all requested saves and stops the writer thread.
+ *
+ * Call this function before closing the quest files.
+ */
+void quit() {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writer_thread.joinable()) {
+      return;
+    }
+    stopping = true;
+    condition.notify_all();
+  }
+
+  writer_thread.join();
+  states.clear();
+}
+
+/**
+ * \brief Returns the content of a savegame file.
+ *
+ * The Lua format has one line per value, like <tt>key = value</tt>.
+ * The binary format has the number of values, followed by the key,
+ * the type and the value of each one.
+ *
+ * \param values The values of the savegame.
+ * \param format The format to use.
+ * \return The content of the savegame file.
+ */
+std::string serialize(
+    const std::map<std::string, Savegame::SavedValue>& values,
+    Format format
+) {
+
+  if (format == Format::BINARY) {
+    BinaryDataWriter writer;
+    writer.write_uint(static_cast<uint32_t>(values.size()));
+    for (const auto& kvp : values) {
+      const Savegame::SavedValue& value = kvp.second;
+      writer.write_string(kvp.first);
+      writer.write_uint(value.type);
+      if (value.type == Savegame::SavedValue::VALUE_BOOLEAN) {
+        writer.write_bool(value.int_data != 0);
+      }
+      else if (value.type == Savegame::SavedValue::VALUE_INTEGER) {
+        writer.write_int(value.int_data);
+      }
+      else {  // String.
+        writer.write_string(value.string_data);
+      }
+    }
+    return writer.finish("");
+  }
+
+  std::ostringstream oss;
+  for (const auto& kvp : values) {
+    const std::string& key = kvp.first;
+    oss << key << " = ";
+    const Savegame::SavedValue& value = kvp.second;
+    if (value.type == Savegame::SavedValue::VALUE_BOOLEAN) {
+      oss << (value.int_data ? "true" : "false");
+    }
+    else if (value.type == Savegame::SavedValue::VALUE_INTEGER) {
+      oss << value.int_data;
+    }
+    else {  // String.
+      write_lua_string(oss, value.string_data);
+    }
+    oss << "\n";
+  }
+  return oss.str();
+}
+
+}  // namespace SavegameWriter
+
+}  // namespace Solarus
+
@@ -20,6 +20,7 @@
 #include "solarus/SpriteAnimationSet.h"
 #include "solarus/Game.h"
 #include "solarus/Map.h"
+#include "solarus/ResourceCache.h"
 #include "solarus/lowlevel/Color.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/PixelBits.h"
@@ -36,8 +37,6 @@
 
 namespace Solarus {
 
-std::map<std::string, SpriteAnimationSet*> Sprite::all_animation_sets;
-
 /**
  * \brief Initializes the sprites system.
  */
@@ -49,37 +48,29 @@ void Sprite::initialize() {
  */
 void Sprite::quit() {
 
-  // delete the animations loaded
-  for (auto& kvp: all_animation_sets) {
-    delete kvp.second;
-  }
-  all_animation_sets.clear();
+  // Delete the animations loaded.
+  ResourceCache::clear(ResourceType::SPRITE);
 }
 
 /**
  * \brief Returns the sprite animation set corresponding to the specified id.
  *
  * The animation set may be created if it is new, or just retrieved from
- * memory if it way already used before.
+ * the resource cache if it was already used recently.
  *
  * \param id id of the animation set
  * \return the corresponding animation set
  */
-SpriteAnimationSet& Sprite::get_animation_set(const std::string& id) {
+std::shared_ptr<SpriteAnimationSet> Sprite::get_animation_set(const std::string& id) {
 
-  SpriteAnimationSet* animation_set = nullptr;
-  auto it = all_animation_sets.find(id);
-  if (it != all_animation_sets.end()) {
-    animation_set = it->second;
+  std::shared_ptr<SpriteAnimationSet> animation_set =
+      ResourceCache::find<SpriteAnimationSet>(ResourceType::SPRITE, id);
+  if (animation_set == nullptr) {
+    animation_set = std::make_shared<SpriteAnimationSet>(id);
+    ResourceCache::add(ResourceType::SPRITE, id, animation_set, animation_set->get_memory_size());
   }
-  else {
-    animation_set = new SpriteAnimationSet(id);
-    all_animation_sets[id] = animation_set;
-  }
-
-  Debug::check_assertion(animation_set != nullptr, "No animation set");
 
-  return *animation_set;
+  return animation_set;
 }
 
 /**
@@ -103,7 +94,7 @@ Sprite::Sprite(const std::string& id):
   blink_next_change_date(0),
   finished_callback_ref() {
 
-  set_current_animation(animation_set.get_default_animation());
+  set_current_animation(animation_set->get_default_animation());
 }
 
 /**
@@ -123,7 +114,7 @@ const std::string& Sprite::get_animation_set_id() const {
  * \return the animation set of this sprite
  */
 const SpriteAnimationSet& Sprite::get_animation_set() const {
-  return animation_set;
+  return *animation_set;
 }
 
 /**
@@ -134,7 +125,7 @@ const SpriteAnimationSet& Sprite::get_animation_set() const {
  * \param tileset The tileset.
  */
 void Sprite::set_tileset(const Tileset& tileset) {
-  animation_set.set_tileset(tileset);
+  animation_set->set_tileset(tileset);
 }
 
 /**
@@ -143,7 +134,7 @@ void Sprite::set_tileset(const Tileset& tileset) {
  * All sprites that use the same animation set as this one will be affected.
  */
 void Sprite::enable_pixel_collisions() {
-  animation_set.enable_pixel_collisions();
+  animation_set->enable_pixel_collisions();
 }
 
 /**
@@ -151,7 +142,7 @@ void Sprite::enable_pixel_collisions() {
  * \return true if the pixel-perfect collisions are enabled
  */
 bool Sprite::are_pixel_collisions_enabled() const {
-  return animation_set.are_pixel_collisions_enabled();
+  return animation_set->are_pixel_collisions_enabled();
 }
 
 /**
@@ -171,7 +162,7 @@ Size Sprite::get_size() const {
  * \return The maximum frame size.
  */
 const Size& Sprite::get_max_size() const {
-  return animation_set.get_max_size();
+  return animation_set->get_max_size();
 }
 
 /**
@@ -199,7 +190,7 @@ Point Sprite::get_origin() const {
  */
 const Rectangle& Sprite::get_max_bounding_box() const {
 
-  return animation_set.get_max_bounding_box();
+  return animation_set->get_max_bounding_box();
 }
 
 /**
@@ -264,8 +255,8 @@ void Sprite::set_current_animation(const std::string& animation_name) {
   if (animation_name != this->current_animation_name || !is_animation_started()) {
 
     this->current_animation_name = animation_name;
-    if (animation_set.has_animation(animation_name)) {
-      this->current_animation = &animation_set.get_animation(animation_name);
+    if (animation_set->has_animation(animation_name)) {
+      this->current_animation = &animation_set->get_animation(animation_name);
       set_frame_delay(current_animation->get_frame_delay());
     }
     else {
@@ -298,7 +289,7 @@ void Sprite::set_current_animation(const std::string& animation_name) {
  * \return true if this animation exists
  */
 bool Sprite::has_animation(const std::string& animation_name) const {
-  return animation_set.has_animation(animation_name);
+  return animation_set->has_animation(animation_name);
 }
 
 /**
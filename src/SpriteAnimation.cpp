@@ -208,5 +208,17 @@ bool SpriteAnimation::are_pixel_collisions_enabled() const {
   return directions[0].are_pixel_collisions_enabled();
 }
 
+/**
+ * \brief Returns an estimation of the memory used by the image of this animation.
+ * \return The size in bytes, or 0 if the image belongs to a tileset.
+ */
+size_t SpriteAnimation::get_memory_size() const {
+
+  if (src_image_is_tileset || src_image == nullptr) {
+    return 0;
+  }
+  return src_image->get_width() * src_image->get_height() * sizeof(uint32_t);
+}
+
 }
 
@@ -205,5 +205,18 @@ const Rectangle& SpriteAnimationSet::get_max_bounding_box() const {
   return max_bounding_box;
 }
 
+/**
+ * \brief Returns an estimation of the memory used by this animation set.
+ * \return The size in bytes.
+ */
+size_t SpriteAnimationSet::get_memory_size() const {
+
+  size_t size = 0;
+  for (const auto& kvp : animations) {
+    size += kvp.second.get_memory_size();
+  }
+  return size;
+}
+
 }
 
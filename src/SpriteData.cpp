@@ -16,6 +16,7 @@
  */
 #include "solarus/SpriteData.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaTools.h"
 #include <algorithm>
 #include <ostream>
@@ -688,6 +689,89 @@ bool SpriteData::import_from_lua(lua_State* l) {
   return true;
 }
 
+/**
+ * \copydoc LuaData::import_from_binary
+ */
+bool SpriteData::import_from_binary(BinaryDataReader& reader) {
+
+  SpriteData sprite;
+
+  const std::string& default_name = reader.read_string();
+  const uint32_t num_animations = reader.read_uint();
+  for (uint32_t i = 0; i < num_animations && reader.is_valid(); ++i) {
+
+    const std::string& animation_name = reader.read_string();
+    const std::string& src_image = reader.read_string();
+    const uint32_t frame_delay = reader.read_uint();
+    const int frame_to_loop_on = reader.read_int();
+
+    std::deque<SpriteAnimationDirectionData> directions;
+    const uint32_t num_directions = reader.read_uint();
+    for (uint32_t j = 0; j < num_directions && reader.is_valid(); ++j) {
+      const int x = reader.read_int();
+      const int y = reader.read_int();
+      const int frame_width = reader.read_int();
+      const int frame_height = reader.read_int();
+      const int origin_x = reader.read_int();
+      const int origin_y = reader.read_int();
+      const int num_frames = reader.read_int();
+      const int num_columns = reader.read_int();
+      if (num_columns < 1 || num_columns > num_frames) {
+        return false;
+      }
+      directions.emplace_back(
+            Point(x, y), Size(frame_width, frame_height),
+            Point(origin_x, origin_y), num_frames, num_columns);
+    }
+
+    if (!sprite.add_animation(animation_name,
+        SpriteAnimationData(src_image, directions, frame_delay, frame_to_loop_on))) {
+      return false;
+    }
+  }
+
+  if (!reader.is_valid() || !reader.is_at_end()) {
+    return false;
+  }
+  if (num_animations > 0 && !sprite.set_default_animation_name(default_name)) {
+    return false;
+  }
+
+  *this = std::move(sprite);
+  return true;
+}
+
+/**
+ * \copydoc LuaData::export_to_binary
+ */
+bool SpriteData::export_to_binary(BinaryDataWriter& writer) const {
+
+  writer.write_string(default_animation_name);
+  writer.write_uint(animations.size());
+  for (const auto& kvp : animations) {
+    const SpriteAnimationData& animation = kvp.second;
+    writer.write_string(kvp.first);
+    writer.write_string(animation.get_src_image());
+    writer.write_uint(animation.get_frame_delay());
+    writer.write_int(animation.get_loop_on_frame());
+
+    const std::deque<SpriteAnimationDirectionData>& directions = animation.get_directions();
+    writer.write_uint(directions.size());
+    for (const SpriteAnimationDirectionData& direction : directions) {
+      writer.write_int(direction.get_xy().x);
+      writer.write_int(direction.get_xy().y);
+      writer.write_int(direction.get_size().width);
+      writer.write_int(direction.get_size().height);
+      writer.write_int(direction.get_origin().x);
+      writer.write_int(direction.get_origin().y);
+      writer.write_int(direction.get_num_frames());
+      writer.write_int(direction.get_num_columns());
+    }
+  }
+
+  return true;
+}
+
 /**
  * \copydoc LuaData::export_to_lua
  */
@@ -189,7 +189,7 @@ bool Bomb::notify_action_command_pressed() {
       && get_hero().get_facing_entity() == this
       && get_hero().is_facing_point_in(get_bounding_box())) {
 
-    get_hero().start_lifting(std::make_shared<CarriedObject>(
+    get_hero().start_lifting(get_entities().make_entity<CarriedObject>(
         get_hero(),
         *this,
         "entities/bomb",
@@ -258,7 +258,7 @@ void Bomb::update() {
  */
 void Bomb::explode() {
 
-  get_entities().add_entity(std::make_shared<Explosion>(
+  get_entities().add_entity(get_entities().make_entity<Explosion>(
       "", get_layer(), get_center_point(), true
   ));
   Sound::play("explosion");
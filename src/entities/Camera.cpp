@@ -19,6 +19,8 @@
 #include "solarus/entities/EntityState.h"
 #include "solarus/entities/Hero.h"
 #include "solarus/entities/Separator.h"
+#include "solarus/lowlevel/DamageTracker.h"
+#include "solarus/lowlevel/Surface.h"
 #include "solarus/lowlevel/System.h"
 #include "solarus/lowlevel/Video.h"
 #include "solarus/lua/LuaContext.h"
@@ -260,6 +262,7 @@ bool Camera::can_be_drawn() const {
 void Camera::create_surface() {
 
   surface = Surface::create(get_size());
+  surface->set_damage_tracked(DamageTracker::is_enabled());
 }
 
 /**
@@ -248,7 +248,7 @@ void CarriedObject::break_item() {
     }
   }
   else {
-    get_entities().add_entity(std::make_shared<Explosion>(
+    get_entities().add_entity(get_entities().make_entity<Explosion>(
         "", get_layer(), get_xy(), true
     ));
     Sound::play("explosion");
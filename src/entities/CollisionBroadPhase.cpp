@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/CollisionBroadPhase.h"
+#include "solarus/entities/Entities.h"
+#include "solarus/entities/Entity.h"
+#include "solarus/Map.h"
+#include "solarus/Sprite.h"
+#include <algorithm>
+
+namespace Solarus {
+
+namespace {
+
+  bool enabled = false;         /**< Whether maps batch their collision checks. */
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates a collision broad phase for a map.
+ * \param map The map.
+ */
+CollisionBroadPhase::CollisionBroadPhase(Map& map):
+  map(map),
+  recording(false),
+  dispatching(false),
+  snapshot_valid(false),
+  requests(),
+  candidates(),
+  candidate_boxes() {
+
+}
+
+/**
+ * \brief Returns whether maps batch their collision checks.
+ * \return \c true if the broad phase is enabled.
+ */
+bool CollisionBroadPhase::is_enabled() {
+  return enabled;
+}
+
+/**
+ * \brief Sets whether maps batch their collision checks.
+ *
+ * This takes effect at the next cycle.
+ *
+ * \param enabled \c true to enable the broad phase.
+ */
+void CollisionBroadPhase::set_enabled(bool enabled) {
+  Solarus::enabled = enabled;
+}
+
+/**
+ * \brief Returns whether collision requests are currently recorded.
+ * \return \c true if checks can be postponed to finish().
+ */
+bool CollisionBroadPhase::is_recording() const {
+  return recording;
+}
+
+/**
+ * \brief Starts recording the collision requests of a cycle.
+ *
+ * Does nothing if the broad phase is disabled.
+ */
+void CollisionBroadPhase::start() {
+
+  recording = enabled;
+}
+
+/**
+ * \brief Stops recording and does all collision checks requested
+ * since start().
+ */
+void CollisionBroadPhase::finish() {
+
+  recording = false;
+  flush();
+}
+
+/**
+ * \brief Does the collision checks recorded so far.
+ *
+ * This function should be called before any collision check that is not
+ * postponed, so that checks are done in the order they were requested.
+ * Does nothing if checks are already being dispatched.
+ */
+void CollisionBroadPhase::flush() {
+
+  if (dispatching) {
+    // The current dispatch does them.
+    return;
+  }
+  dispatch_requests();
+}
+
+/**
+ * \brief Notifies the broad phase that the map was just resumed.
+ *
+ * Does the checks that were left when a collision suspended the map.
+ */
+void CollisionBroadPhase::notify_map_resumed() {
+
+  if (recording) {
+    // They will be done by the next flush.
+    return;
+  }
+  flush();
+}
+
+/**
+ * \brief Notifies the broad phase that an entity was created or that
+ * its bounding box changed.
+ *
+ * If this happens while checks are dispatched, candidates found before
+ * are no longer reliable and the remaining checks make their own
+ * spatial query like immediate checks do.
+ */
+void CollisionBroadPhase::notify_entity_changed() {
+
+  if (dispatching) {
+    snapshot_valid = false;
+  }
+}
+
+/**
+ * \brief Does the collision checks of the recorded requests.
+ *
+ * If a collision suspends the map, the remaining requests are kept
+ * until the map is resumed.
+ */
+void CollisionBroadPhase::dispatch_requests() {
+
+  if (requests.empty() || map.is_suspended()) {
+    return;
+  }
+
+  find_candidates();
+
+  // No request is recorded while dispatching.
+  dispatching = true;
+  size_t i = 0;
+  for (; i < requests.size(); ++i) {
+    if (map.is_suspended()) {
+      break;
+    }
+    dispatch(requests[i]);
+  }
+  dispatching = false;
+  snapshot_valid = false;
+
+  // Keep what was not dispatched for when the map is resumed.
+  requests.erase(requests.begin(), requests.begin() + i);
+
+  candidates.clear();
+  candidate_boxes.clear();
+}
+
+/**
+ * \brief Records that the frame of a sprite has changed and that this sprite
+ * should be checked with detectors.
+ * \param entity The entity.
+ * \param sprite A sprite of this entity.
+ * \return \c true if the check is postponed, \c false if it should be
+ * done now.
+ */
+bool CollisionBroadPhase::add_sprite_changed(Entity& entity, Sprite& sprite) {
+
+  return add_sprite_check(entity, sprite, false);
+}
+
+/**
+ * \brief Records that the frame of a detector sprite has changed and that
+ * this sprite should check entities.
+ * \param detector The detector.
+ * \param detector_sprite A sprite of this detector.
+ * \return \c true if the check is postponed, \c false if it should be
+ * done now.
+ */
+bool CollisionBroadPhase::add_detector_sprite_changed(Entity& detector, Sprite& detector_sprite) {
+
+  return add_sprite_check(detector, detector_sprite, true);
+}
+
+/**
+ * \brief Records a pixel-precise check if it can be postponed without
+ * changing its result.
+ * \param entity The entity.
+ * \param sprite A sprite of this entity.
+ * \param from_detector \c true to check entities with this sprite of a
+ * detector, \c false to check the sprite with detectors.
+ * \return \c true if the check is postponed, \c false if it should be
+ * done now.
+ */
+bool CollisionBroadPhase::add_sprite_check(Entity& entity, Sprite& sprite, bool from_detector) {
+
+  if (!recording || dispatching) {
+    return false;
+  }
+
+  if (entity.get_movement() != nullptr) {
+    // The entity may move later in this cycle:
+    // its checks have to be done along its path.
+    return false;
+  }
+
+  const Rectangle& box = entity.get_max_bounding_box();
+  for (Request& request : requests) {
+    if (!request.box.overlaps(box)) {
+      continue;
+    }
+
+    if (&request == &requests.back() &&
+        request.entity.get() == &entity &&
+        request.xy == entity.get_xy()) {
+      // Another sprite of the last entity requested, still at the same place.
+      for (const SpriteCheck& check : request.checks) {
+        if (check.sprite.get() == &sprite && check.from_detector == from_detector) {
+          // Already requested with another frame.
+          return false;
+        }
+      }
+      request.checks.push_back({
+          std::static_pointer_cast<Sprite>(sprite.shared_from_this()),
+          from_detector
+      });
+      return true;
+    }
+
+    // One of both checks could see the effects of the other one.
+    return false;
+  }
+
+  requests.emplace_back();
+  Request& request = requests.back();
+  request.entity = std::static_pointer_cast<Entity>(entity.shared_from_this());
+  request.xy = entity.get_xy();
+  request.box = box;
+  request.checks.push_back({
+      std::static_pointer_cast<Sprite>(sprite.shared_from_this()),
+      from_detector
+  });
+  return true;
+}
+
+/**
+ * \brief Finds the candidates of all requests.
+ *
+ * Makes a single spatial query around all requests and then matches
+ * requests and candidates by sweeping them along the x axis.
+ */
+void CollisionBroadPhase::find_candidates() {
+
+  Rectangle all_boxes;
+  bool first = true;
+  for (const Request& request : requests) {
+    all_boxes = first ? request.box : all_boxes | request.box;
+    first = false;
+  }
+
+  // One spatial query for everyone.
+  candidates.clear();
+  map.get_entities().get_entities_in_rectangle(all_boxes, candidates);
+  candidate_boxes.clear();
+  candidate_boxes.reserve(candidates.size());
+  for (const Entity* candidate : candidates) {
+    candidate_boxes.push_back(candidate->get_max_bounding_box());
+  }
+
+  // Sort requests and candidates by their left side.
+  std::vector<int> sorted_requests(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    sorted_requests[i] = i;
+  }
+  std::sort(sorted_requests.begin(), sorted_requests.end(), [this](int a, int b) {
+    return requests[a].box.get_left() < requests[b].box.get_left();
+  });
+  std::vector<int> sorted_candidates(candidates.size());
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    sorted_candidates[i] = i;
+  }
+  std::sort(sorted_candidates.begin(), sorted_candidates.end(), [this](int a, int b) {
+    return candidate_boxes[a].get_left() < candidate_boxes[b].get_left();
+  });
+
+  // Sweep: keep the candidates whose x range can still overlap a request.
+  std::vector<int> active_candidates;
+  size_t next_candidate = 0;
+  for (int request_index : sorted_requests) {
+    Request& request = requests[request_index];
+    const Rectangle& box = request.box;
+
+    while (next_candidate < sorted_candidates.size() &&
+        candidate_boxes[sorted_candidates[next_candidate]].get_left() < box.get_right()) {
+      active_candidates.push_back(sorted_candidates[next_candidate]);
+      ++next_candidate;
+    }
+
+    request.candidates.clear();
+    for (size_t i = 0; i < active_candidates.size();) {
+      const int candidate_index = active_candidates[i];
+      const Rectangle& candidate_box = candidate_boxes[candidate_index];
+      if (candidate_box.get_right() <= box.get_left()) {
+        // Too far on the left for this request and the next ones.
+        active_candidates[i] = active_candidates.back();
+        active_candidates.pop_back();
+        continue;
+      }
+      if (candidate_box.overlaps(box)) {
+        request.candidates.push_back(candidate_index);
+      }
+      ++i;
+    }
+
+    // Keep the order of the spatial query like immediate checks do.
+    std::sort(request.candidates.begin(), request.candidates.end());
+  }
+
+  snapshot_valid = true;
+}
+
+/**
+ * \brief Returns the candidates of a request that overlap a box.
+ *
+ * If entities were moved or created since the candidates were found,
+ * makes a new spatial query instead.
+ *
+ * \param[in] request A request whose candidates were found.
+ * \param[in] box The box to check, included in the region of the request.
+ * \param[out] result The candidates overlapping the box.
+ */
+void CollisionBroadPhase::get_candidates(
+    const Request& request,
+    const Rectangle& box,
+    std::vector<Entity*>& result
+) const {
+
+  result.clear();
+  if (!snapshot_valid) {
+    map.get_entities().get_entities_in_rectangle(box, result);
+    return;
+  }
+
+  for (int candidate_index : request.candidates) {
+    if (candidate_boxes[candidate_index].overlaps(box)) {
+      result.push_back(candidates[candidate_index]);
+    }
+  }
+}
+
+/**
+ * \brief Returns whether a sprite still belongs to an entity.
+ * \param entity An entity.
+ * \param sprite A sprite.
+ * \return \c true if the sprite is one of the entity's sprites
+ * and was not removed.
+ */
+bool CollisionBroadPhase::has_sprite(const Entity& entity, const Sprite& sprite) const {
+
+  for (const SpritePtr& entity_sprite : entity.get_sprites()) {
+    if (entity_sprite.get() == &sprite) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief Does the narrow phase checks of a request.
+ *
+ * The checks are done at the position of the entity when they were
+ * requested, in case a script moved it since.
+ *
+ * \param request The request to dispatch.
+ */
+void CollisionBroadPhase::dispatch(const Request& request) {
+
+  Entity& entity = *request.entity;
+  if (entity.is_being_removed()) {
+    return;
+  }
+
+  const Point xy = entity.get_xy();
+  if (xy != request.xy) {
+    entity.set_xy(request.xy);
+  }
+
+  std::vector<Entity*> entities_nearby;
+  for (const SpriteCheck& check : request.checks) {
+    if (map.is_suspended() || entity.is_being_removed()) {
+      break;
+    }
+    if (!has_sprite(entity, *check.sprite)) {
+      continue;
+    }
+    get_candidates(request, entity.get_max_bounding_box(), entities_nearby);
+    if (check.from_detector) {
+      map.check_collision_from_detector(entity, *check.sprite, entities_nearby);
+    }
+    else {
+      map.check_collision_with_detectors(entity, *check.sprite, entities_nearby);
+    }
+  }
+
+  if (xy != request.xy) {
+    entity.set_xy(xy);
+  }
+}
+
+}
+
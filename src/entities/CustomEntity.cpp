@@ -419,6 +419,19 @@ void CustomEntity::reset_can_traverse_entities(EntityType type) {
   can_traverse_entities_type.erase(type);
 }
 
+/**
+ * \copydoc Entity::get_obstacle_traits
+ */
+int CustomEntity::get_obstacle_traits() const {
+
+  // Rules set by scripts may use Lua functions: they cannot be compared.
+  if (!can_traverse_entities_general.is_empty() ||
+      !can_traverse_entities_type.empty()) {
+    return -1;
+  }
+  return 0;
+}
+
 /**
  * \copydoc Entity::is_hero_obstacle
  */
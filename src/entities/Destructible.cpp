@@ -292,7 +292,7 @@ bool Destructible::test_collision_custom(Entity& entity) {
 void Destructible::create_treasure() {
 
   get_entities().add_entity(Pickable::create(
-      get_game(),
+      get_entities(),
       "",
       get_layer(),
       get_xy(),
@@ -398,7 +398,7 @@ bool Destructible::notify_action_command_pressed() {
     if (get_equipment().has_ability(Ability::LIFT, get_weight())) {
 
       uint32_t explosion_date = get_can_explode() ? System::now() + 6000 : 0;
-      get_hero().start_lifting(std::make_shared<CarriedObject>(
+      get_hero().start_lifting(get_entities().make_entity<CarriedObject>(
           get_hero(),
           *this,
           get_animation_set_id(),
@@ -456,6 +456,7 @@ void Destructible::play_destroy_animation() {
   if (is_ground_modifier()) {
     update_ground_observers();  // The ground has just disappeared.
   }
+  get_map().notify_ground_modifier_changed(*this);
 }
 
 /**
@@ -471,7 +472,7 @@ bool Destructible::is_waiting_for_regeneration() const {
  */
 void Destructible::explode() {
 
-  get_entities().add_entity(std::make_shared<Explosion>(
+  get_entities().add_entity(get_entities().make_entity<Explosion>(
       "", get_layer(), get_xy(), true
   ));
   Sound::play("explosion");
@@ -528,6 +529,7 @@ void Destructible::update() {
     }
     is_regenerating = true;
     regeneration_date = 0;
+    get_map().notify_ground_modifier_changed(*this);
     get_lua_context()->destructible_on_regenerating(*this);
   }
   else if (is_regenerating &&
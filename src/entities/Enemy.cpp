@@ -127,6 +127,7 @@ Enemy::Enemy(
  * - or a pickable treasure if the enemy has one
  *
  * \param game the current game
+ * \param entities the entities of the map where the enemy will be
  * \param breed breed of the enemy to create
  * \param name a name identifying the enemy
  * \param savegame_variable name of the boolean variable indicating that the enemy is dead
@@ -138,6 +139,7 @@ Enemy::Enemy(
  */
 EntityPtr Enemy::create(
     Game& game,
+    Entities& entities,
     const std::string& breed,
     const std::string& savegame_variable,
     const std::string& name,
@@ -152,13 +154,13 @@ EntityPtr Enemy::create(
 
     // the enemy is dead: create its pickable treasure (if any) instead
     if (treasure.is_saved() && !game.get_savegame().get_boolean(treasure.get_savegame_variable())) {
-      return Pickable::create(game, "", layer, xy, treasure, FALLING_NONE, true);
+      return Pickable::create(entities, "", layer, xy, treasure, FALLING_NONE, true);
     }
     return nullptr;
   }
 
   // create the enemy
-  std::shared_ptr<Enemy> enemy = std::make_shared<Enemy>(
+  std::shared_ptr<Enemy> enemy = entities.make_entity<Enemy>(
       game, name, layer, xy, breed, treasure
   );
 
@@ -257,6 +259,15 @@ bool Enemy::is_obstacle_for(Entity& other) {
   return !is_traversable() || other.is_enemy_obstacle(*this);
 }
 
+/**
+ * \copydoc Entity::get_obstacle_traits
+ */
+int Enemy::get_obstacle_traits() const {
+
+  // Flying enemies traverse destructibles.
+  return static_cast<int>(obstacle_behavior);
+}
+
 /**
  * \brief Returns whether a low wall is currently considered as an obstacle
  * by this entity.
@@ -821,7 +832,7 @@ void Enemy::update() {
       Point xy;
       xy.x = get_top_left_x() + Random::get_number(get_width());
       xy.y = get_top_left_y() + Random::get_number(get_height());
-      get_entities().add_entity(std::make_shared<Explosion>(
+      get_entities().add_entity(get_entities().make_entity<Explosion>(
           "", get_map().get_max_layer(), xy, false
       ));
       Sound::play("explosion");
@@ -839,7 +850,7 @@ void Enemy::update() {
 
     // Create the pickable treasure if any.
     get_entities().add_entity(Pickable::create(
-        get_game(),
+        get_entities(),
         "",
         get_layer(),
         get_xy(),
@@ -18,6 +18,7 @@
 #include "solarus/entities/CrystalBlock.h"
 #include "solarus/entities/Destination.h"
 #include "solarus/entities/Entities.h"
+#include "solarus/entities/EntityPool.h"
 #include "solarus/entities/EntityTypeInfo.h"
 #include "solarus/entities/Hero.h"
 #include "solarus/entities/NonAnimatedRegions.h"
@@ -30,10 +31,12 @@
 #include "solarus/lowlevel/Color.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/Music.h"
+#include "solarus/lowlevel/Profiler.h"
 #include "solarus/lowlevel/Surface.h"
 #include "solarus/lua/LuaContext.h"
 #include "solarus/Game.h"
 #include "solarus/Map.h"
+#include <algorithm>
 #include <sstream>
 #include <lua.hpp>
 
@@ -130,8 +133,12 @@ class DrawingOrderComparator {
 
 };
 
+uint32_t last_ground_version = 0;  /**< Last ground version given to 8x8 squares of any map. */
+
 }  // Anonymous namespace.
 
+bool Entities::incremental_draw_order_enabled = false;
+
 /**
  * \brief Constructor.
  * \param game The game.
@@ -142,18 +149,24 @@ Entities::Entities(Game& game, Map& map):
   map(map),
   map_width8(0),
   map_height8(0),
-  tiles_grid_size(0),
   tiles_ground(),
+  ground_versions(),
+  ground_modifier_boxes(),
   non_animated_regions(),
   tiles_in_animated_regions(),
   hero(game.get_hero()),
   camera(nullptr),
   named_entities(),
   all_entities(),
+  entities_by_type(),
+  entity_type_indexes(),
+  entity_pool(std::make_shared<EntityPool>()),
   quadtree(),
   z_caches(),
+  collision_broad_phase(map),
   entities_drawn_not_at_their_position(),
   entities_to_draw(),
+  draw_lists(),
   entities_to_remove(),
   default_destination(nullptr) {
 
@@ -161,11 +174,11 @@ Entities::Entities(Game& game, Map& map):
   initialize_layers();
   map_width8 = map.get_width8();
   map_height8 = map.get_height8();
-  tiles_grid_size = map.get_width8() * map.get_height8();
   for (int layer = map.get_min_layer(); layer <= map.get_max_layer(); ++layer) {
 
     Ground initial_ground = (layer == map.get_min_layer()) ? Ground::TRAVERSABLE : Ground::EMPTY;
-    tiles_ground[layer].assign(tiles_grid_size, initial_ground);
+    tiles_ground[layer] = GroundGrid(map_width8, map_height8, initial_ground);
+    ground_versions[layer] = std::vector<uint32_t>(map_width8 * map_height8, ++last_ground_version);
 
     non_animated_regions[layer] = std::unique_ptr<NonAnimatedRegions>(
         new NonAnimatedRegions(map, layer)
@@ -181,6 +194,32 @@ Entities::Entities(Game& game, Map& map):
   add_entity(std::make_shared<Camera>(map));
 }
 
+/**
+ * \brief Returns whether entities are kept in drawing order from a cycle
+ * to the next.
+ * \return \c true if the incremental draw order is enabled.
+ */
+bool Entities::is_incremental_draw_order_enabled() {
+  return incremental_draw_order_enabled;
+}
+
+/**
+ * \brief Sets whether entities are kept in drawing order from a cycle
+ * to the next.
+ *
+ * When disabled (the default), the entities to draw are searched around
+ * the camera and sorted again at each cycle.
+ * When enabled, each layer keeps a list of its entities in drawing order.
+ * The list is updated when entities are added, removed or change their
+ * layer or Z order, and entities drawn in Y order are moved
+ * only when their Y coordinate changes.
+ *
+ * \param enabled \c true to enable the incremental draw order.
+ */
+void Entities::set_incremental_draw_order_enabled(bool enabled) {
+  incremental_draw_order_enabled = enabled;
+}
+
 /**
  * \brief Creates live entities from the given data.
  */
@@ -232,6 +271,14 @@ EntityVector Entities::get_entities() {
   return result;
 }
 
+/**
+ * \brief Returns the memory of entities created by make_entity().
+ * \return The entity pool of this map.
+ */
+const std::shared_ptr<EntityPool>& Entities::get_entity_pool() const {
+  return entity_pool;
+}
+
 /**
  * \brief Returns the default destination of the map.
  * \return The default destination, or nullptr if there exists no destination
@@ -241,6 +288,15 @@ const std::shared_ptr<Destination>& Entities::get_default_destination() {
   return default_destination;
 }
 
+/**
+ * \brief Returns the object that batches collision checks with detectors
+ * during update().
+ * \return The collision broad phase.
+ */
+CollisionBroadPhase& Entities::get_collision_broad_phase() {
+  return collision_broad_phase;
+}
+
 /**
  * \brief Sets the tile ground property of an 8*8 square of the map.
  *
@@ -255,8 +311,9 @@ const std::shared_ptr<Destination>& Entities::get_default_destination() {
 void Entities::set_tile_ground(int layer, int x8, int y8, Ground ground) {
 
   if (x8 >= 0 && x8 < map_width8 && y8 >= 0 && y8 < map_height8) {
-    int index = y8 * map_width8 + x8;
-    tiles_ground[layer][index] = ground;
+    tiles_ground[layer].set_ground8(x8, y8, ground);
+    increment_ground_versions(layer, Rectangle(x8 * 8, y8 * 8, 8, 8));
+    map.notify_ground_changed(layer, Rectangle(x8 * 8, y8 * 8, 8, 8));
   }
 }
 
@@ -430,11 +487,12 @@ void Entities::get_entities_in_rectangle(
     const Rectangle& rectangle, ConstEntityVector& result
 ) const {
 
-  EntityVector non_const_result = quadtree.get_elements(rectangle);
+  std::vector<Entity*> raw_result;
+  quadtree.get_elements(rectangle, raw_result);
 
-  result.reserve(non_const_result.size());
-  for (const ConstEntityPtr& entity : non_const_result) {
-      result.push_back(entity);
+  result.reserve(result.size() + raw_result.size());
+  for (const Entity* entity : raw_result) {
+    result.push_back(std::static_pointer_cast<const Entity>(entity->shared_from_this()));
   }
 }
 
@@ -445,7 +503,33 @@ void Entities::get_entities_in_rectangle(
     const Rectangle& rectangle, EntityVector& result
 ) {
 
-  result = quadtree.get_elements(rectangle);
+  std::vector<Entity*> raw_result;
+  quadtree.get_elements(rectangle, raw_result);
+
+  result.reserve(result.size() + raw_result.size());
+  for (Entity* entity : raw_result) {
+    result.push_back(std::static_pointer_cast<Entity>(entity->shared_from_this()));
+  }
+}
+
+/**
+ * \brief Returns all entities whose bounding box overlaps the given rectangle,
+ * without taking ownership of them.
+ *
+ * This is faster than the other versions because no reference counter
+ * is touched.
+ * The entities remain valid until the next call to update(),
+ * which may destroy entities removed from the map.
+ *
+ * \param[in] rectangle A rectangle.
+ * \param[in,out] result The entities in that rectangle are appended to
+ * this list, in arbitrary order.
+ */
+void Entities::get_entities_in_rectangle(
+    const Rectangle& rectangle, std::vector<Entity*>& result
+) {
+
+  quadtree.get_elements(rectangle, result);
 }
 
 /**
@@ -631,7 +715,7 @@ EntitySet Entities::get_entities_by_type(EntityType type, int layer) {
     return result;
   }
 
-  const ByLayer<EntitySet>& sets = it->second;
+  const ByLayer<EntityVector>& sets = it->second;
   const auto& layer_it = sets.find(layer);
   if (layer_it == sets.end()) {
     return result;
@@ -674,6 +758,12 @@ void Entities::bring_to_front(Entity& entity) {
   const EntityPtr& shared_entity = std::static_pointer_cast<Entity>(entity.shared_from_this());
   int layer = entity.get_layer();
   z_caches.at(layer).bring_to_front(shared_entity);
+  draw_lists.at(layer).bring_to_front(entity);
+
+  // The topmost entity decides the ground.
+  if (entity.is_ground_modifier()) {
+    notify_ground_modifier_changed(entity);
+  }
 }
 
 /**
@@ -685,6 +775,12 @@ void Entities::bring_to_back(Entity& entity) {
   const EntityPtr& shared_entity = std::static_pointer_cast<Entity>(entity.shared_from_this());
   int layer = entity.get_layer();
   z_caches.at(layer).bring_to_back(shared_entity);
+  draw_lists.at(layer).bring_to_back(entity);
+
+  // The topmost entity decides the ground.
+  if (entity.is_ground_modifier()) {
+    notify_ground_modifier_changed(entity);
+  }
 }
 
 /**
@@ -706,7 +802,8 @@ void Entities::notify_map_started() {
 
   // Now, tiles_in_animated_regions contains the tiles that won't be optimized.
   // Notify entities.
-  for (const EntityPtr& entity: all_entities) {
+  for (size_t i = 0; i < all_entities.size(); ++i) {
+    const EntityPtr entity = all_entities[i];
     entity->notify_map_started();
     entity->notify_tileset_changed();
   }
@@ -720,8 +817,8 @@ void Entities::notify_map_started() {
  */
 void Entities::notify_map_opening_transition_finished() {
 
-  for (const EntityPtr& entity: all_entities) {
-    entity->notify_map_opening_transition_finished();
+  for (size_t i = 0; i < all_entities.size(); ++i) {
+    all_entities[i]->notify_map_opening_transition_finished();
   }
   hero->notify_map_opening_transition_finished();
 }
@@ -737,8 +834,8 @@ void Entities::notify_tileset_changed() {
     non_animated_regions[layer]->notify_tileset_changed();
   }
 
-  for (const EntityPtr& entity: all_entities) {
-    entity->notify_tileset_changed();
+  for (size_t i = 0; i < all_entities.size(); ++i) {
+    all_entities[i]->notify_tileset_changed();
   }
   hero->notify_tileset_changed();
 }
@@ -748,8 +845,8 @@ void Entities::notify_tileset_changed() {
  */
 void Entities::notify_map_finished() {
 
-  for (const EntityPtr& entity: all_entities) {
-    notify_entity_removed(*entity);
+  for (size_t i = 0; i < all_entities.size(); ++i) {
+    notify_entity_removed(*all_entities[i]);
   }
 }
 
@@ -763,10 +860,12 @@ void Entities::initialize_layers() {
   Debug::check_assertion(z_caches.empty(), "Layers already initialized");
 
   for (int layer = map.get_min_layer(); layer <= map.get_max_layer(); ++layer) {
-    tiles_ground[layer] = std::vector<Ground>();
+    tiles_ground[layer] = GroundGrid();
+    ground_versions[layer] = std::vector<uint32_t>();
     non_animated_regions[layer] = std::unique_ptr<NonAnimatedRegions>();
     tiles_in_animated_regions[layer] = std::vector<TilePtr>();
     z_caches[layer] = ZCache();
+    draw_lists[layer] = DrawList();
   }
 }
 
@@ -965,7 +1064,8 @@ void Entities::add_entity(const EntityPtr& entity) {
     const int layer = entity->get_layer();
 
     // Update the quadtree.
-    quadtree.add(entity, entity->get_max_bounding_box());
+    quadtree.add(entity.get(), entity->get_max_bounding_box());
+    collision_broad_phase.notify_entity_changed();
 
     // Update the specific entities lists.
     switch (entity->get_type()) {
@@ -996,14 +1096,10 @@ void Entities::add_entity(const EntityPtr& entity) {
 
     // Track the insertion order.
     z_caches[layer].add(entity);
+    draw_lists[layer].add(entity);
 
     // Update the list of entities by type.
-    auto it = entities_by_type.find(type);
-    if (it == entities_by_type.end()) {
-      it = entities_by_type.emplace(type, ByLayer<EntitySet>()).first;
-    }
-    ByLayer<EntitySet>& sets = it->second;
-    sets[layer].insert(entity);
+    add_entity_by_type(entity, layer);
 
     // Update the list of all entities.
     if (type != EntityType::HERO) {
@@ -1051,6 +1147,11 @@ void Entities::add_entity(const EntityPtr& entity) {
   if (type != EntityType::HERO) {
     entity->set_map(map);
   }
+
+  // Update the terrain known by path finding.
+  if (entity->is_ground_modifier()) {
+    map.notify_ground_modifier_changed(*entity);
+  }
 }
 
 /**
@@ -1067,6 +1168,10 @@ void Entities::remove_entity(Entity& entity) {
     // Tell the entity.
     entity.notify_being_removed();
 
+    // Update the terrain and the paths known by path finding.
+    map.notify_ground_modifier_changed(entity);
+    map.notify_entity_removed(entity);
+
     // Remove the entity from the by name list
     // to allow users to create a new one with
     // the same name right now.
@@ -1105,6 +1210,19 @@ void Entities::remove_entities_with_prefix(const std::string& prefix) {
  */
 void Entities::remove_marked_entities() {
 
+  if (entities_to_remove.empty()) {
+    return;
+  }
+
+  // Remove them from the whole list in a single pass.
+  const auto& is_being_removed = [](const EntityPtr& entity) {
+    return entity->is_being_removed();
+  };
+  all_entities.erase(
+      std::remove_if(all_entities.begin(), all_entities.end(), is_being_removed),
+      all_entities.end()
+  );
+
   // Remove the marked entities.
   for (const EntityPtr& entity: entities_to_remove) {
 
@@ -1112,10 +1230,9 @@ void Entities::remove_marked_entities() {
     const int layer = entity->get_layer();
 
     // Remove it from the quadtree.
-    quadtree.remove(entity);
+    quadtree.remove(entity.get());
 
-    // Remove it from the whole list.
-    all_entities.remove(entity);
+    // Remove it from the by name list.
     const std::string& name = entity->get_name();
     if (!name.empty()) {
       named_entities.erase(name);
@@ -1134,13 +1251,13 @@ void Entities::remove_marked_entities() {
 
     // Track the insertion order.
     z_caches.at(layer).remove(entity);
+    draw_lists.at(layer).remove(*entity);
 
     // Update the list of entities by type.
-    const auto& it = entities_by_type.find(type);
-    if (it != entities_by_type.end()) {
-      ByLayer<EntitySet>& sets = it->second;
-      sets[layer].erase(entity);
-    }
+    remove_entity_by_type(*entity, layer);
+
+    // Forget the ground it was modifying.
+    notify_ground_modifier_changed(*entity);
 
     // Destroy it.
     notify_entity_removed(*entity);
@@ -1148,6 +1265,46 @@ void Entities::remove_marked_entities() {
   entities_to_remove.clear();
 }
 
+/**
+ * \brief Adds an entity to the list of entities of its type on a layer.
+ * \param entity The entity to add.
+ * \param layer The layer of the entity.
+ */
+void Entities::add_entity_by_type(const EntityPtr& entity, int layer) {
+
+  EntityVector& entities = entities_by_type[entity->get_type()][layer];
+  entity_type_indexes[entity.get()] = entities.size();
+  entities.push_back(entity);
+}
+
+/**
+ * \brief Removes an entity from the list of entities of its type on a layer.
+ *
+ * The last entity of the list takes its place.
+ * Nothing happens if the entity was not present.
+ *
+ * \param entity The entity to remove.
+ * \param layer The layer where the entity was.
+ */
+void Entities::remove_entity_by_type(const Entity& entity, int layer) {
+
+  const auto& index_it = entity_type_indexes.find(&entity);
+  if (index_it == entity_type_indexes.end()) {
+    return;
+  }
+  const size_t index = index_it->second;
+  entity_type_indexes.erase(index_it);
+
+  EntityVector& entities = entities_by_type[entity.get_type()][layer];
+  Debug::check_assertion(index < entities.size() && entities[index].get() == &entity,
+      "Wrong index of entity by type");
+  if (index + 1 != entities.size()) {
+    entities[index] = std::move(entities.back());
+    entity_type_indexes[entities[index].get()] = index;
+  }
+  entities.pop_back();
+}
+
 /**
  * \brief Suspends or resumes the movement and animations of the entities.
  *
@@ -1163,11 +1320,16 @@ void Entities::set_suspended(bool suspended) {
   hero->set_suspended(suspended);
 
   // other entities
-  for (const EntityPtr& entity: all_entities) {
-    entity->set_suspended(suspended);
+  for (size_t i = 0; i < all_entities.size(); ++i) {
+    all_entities[i]->set_suspended(suspended);
   }
 
   // note that we don't suspend the tiles
+
+  if (!suspended) {
+    // Batched collision checks interrupted by the suspension.
+    collision_broad_phase.notify_map_resumed();
+  }
 }
 
 /**
@@ -1177,12 +1339,17 @@ void Entities::update() {
 
   Debug::check_assertion(map.is_started(), "The map is not started");
 
+  // Collision checks may be batched until all entities are updated.
+  collision_broad_phase.start();
+
   // First update the hero.
   hero->update();
 
   // Update the dynamic entities.
-  for (const EntityPtr& entity: all_entities) {
+  // Entities created meanwhile are added at the end and updated too.
+  for (size_t i = 0; i < all_entities.size(); ++i) {
 
+    Entity* entity = all_entities[i].get();
     if (
         !entity->is_being_removed() &&
         entity->get_type() != EntityType::CAMERA  // The camera is updated after.
@@ -1191,6 +1358,9 @@ void Entities::update() {
     }
   }
 
+  // Entities removed during this cycle still exist here.
+  collision_broad_phase.finish();
+
   // Update the camera after everyone else.
   camera->update();
   entities_to_draw.clear();  // Invalidate entities to draw.
@@ -1204,6 +1374,8 @@ void Entities::update() {
  */
 void Entities::draw() {
 
+  Profiler::PhaseTimer timer(Profiler::Phase::ENTITIES_DRAW);
+
   const CameraPtr& camera = get_camera();
   if (camera == nullptr) {
     return;
@@ -1211,23 +1383,24 @@ void Entities::draw() {
 
   const SurfacePtr& camera_surface = camera->get_surface();
 
+  // Draw entities in the camera,
+  // or nearby because of possible
+  // on_pre_draw()/on_draw()/on_post_draw() reimplementations.
+  // TODO it would probably be better to detect entities with
+  // such events and make their is_drawn_at_its_position()
+  // method return false.
+  Rectangle around_camera(
+      Point(
+          camera->get_x() - camera->get_size().width,
+          camera->get_y() - camera->get_size().height
+      ),
+      camera->get_size() * 3
+  );
+
   // Lazily build the list of entities to draw.
-  if (entities_to_draw.empty()) {
-
-    // Add entities in the camera,
-    // or nearby because of possible
-    // on_pre_draw()/on_draw()/on_post_draw() reimplementations.
-    // TODO it would probably be better to detect entities with
-    // such events and make their is_drawn_at_its_position()
-    // method return false.
+  if (!incremental_draw_order_enabled && entities_to_draw.empty()) {
+
     EntityVector entities_in_camera;
-    Rectangle around_camera(
-        Point(
-            camera->get_x() - camera->get_size().width,
-            camera->get_y() - camera->get_size().height
-        ),
-        camera->get_size() * 3
-    );
     get_entities_in_rectangle(around_camera, entities_in_camera);
 
     for (const EntityPtr& entity : entities_in_camera) {
@@ -1279,8 +1452,15 @@ void Entities::draw() {
     non_animated_regions[layer]->draw_on_map();
 
     // Draw dynamic entities, ordered by their data structure.
-    for (const EntityPtr& entity: entities_to_draw[layer]) {
-      entity->draw_on_map();
+    if (incremental_draw_order_enabled) {
+      DrawList& draw_list = draw_lists[layer];
+      draw_list.sort(*this);
+      draw_list.draw(around_camera);
+    }
+    else {
+      for (const EntityPtr& entity: entities_to_draw[layer]) {
+        entity->draw_on_map();
+      }
     }
   }
 
@@ -1306,18 +1486,20 @@ void Entities::set_entity_layer(Entity& entity, int layer) {
     // Track the insertion order.
     z_caches.at(old_layer).remove(shared_entity);
     z_caches.at(layer).add(shared_entity);
+    draw_lists.at(old_layer).remove(entity);
+    draw_lists.at(layer).add(shared_entity);
 
     // Update the list of entities by type and layer.
-    const EntityType type = entity.get_type();
-    const auto& it = entities_by_type.find(type);
-    if (it != entities_by_type.end()) {
-      ByLayer<EntitySet>& sets = it->second;
-      sets[old_layer].erase(shared_entity);
-      sets[layer].insert(shared_entity);
-    }
+    remove_entity_by_type(entity, old_layer);
+    add_entity_by_type(shared_entity, layer);
 
     // Update the entity after the lists because this function might be called again.
     entity.set_layer(layer);
+
+    // Update the terrain known by path finding.
+    if (entity.is_ground_modifier()) {
+      map.notify_ground_modifier_changed(entity);
+    }
   }
 }
 
@@ -1332,8 +1514,71 @@ void Entities::notify_entity_bounding_box_changed(Entity& entity) {
 
   // Note that if the entity is not in the quadtree
   // (i.e. not managed by MapEntities) this does nothing.
-  EntityPtr shared_entity = std::static_pointer_cast<Entity>(entity.shared_from_this());
-  quadtree.move(shared_entity, shared_entity->get_max_bounding_box());
+  quadtree.move(&entity, entity.get_max_bounding_box());
+  collision_broad_phase.notify_entity_changed();
+
+  // A ground modifier that changes its size also changes the ground.
+  const auto& it = ground_modifier_boxes.find(&entity);
+  if (it != ground_modifier_boxes.end() &&
+      it->second.get_size() != entity.get_size()) {
+    notify_ground_modifier_changed(entity);
+  }
+}
+
+/**
+ * \brief Notifies that an entity modifying the ground was added,
+ * moved, changed or removed.
+ *
+ * The ground versions are incremented where the entity was and where
+ * it is now, on all layers.
+ *
+ * \param entity An entity that modifies the ground or just stopped
+ * modifying it.
+ */
+void Entities::notify_ground_modifier_changed(const Entity& entity) {
+
+  // Where the entity was.
+  const auto& it = ground_modifier_boxes.find(&entity);
+  if (it != ground_modifier_boxes.end()) {
+    for (const auto& kvp : ground_versions) {
+      increment_ground_versions(kvp.first, it->second);
+    }
+    ground_modifier_boxes.erase(it);
+  }
+
+  // Where it is now.
+  if (entity.is_ground_modifier() &&
+      entity.is_enabled() &&
+      !entity.is_being_removed()) {
+    const Rectangle& box = entity.get_bounding_box();
+    ground_modifier_boxes[&entity] = box;
+    for (const auto& kvp : ground_versions) {
+      increment_ground_versions(kvp.first, box);
+    }
+  }
+}
+
+/**
+ * \brief Gives a new ground version to the 8x8 squares that overlap
+ * a rectangle.
+ * \param layer Layer of the rectangle.
+ * \param area The rectangle where the ground may have changed.
+ * It may exceed the map.
+ */
+void Entities::increment_ground_versions(int layer, const Rectangle& area) {
+
+  const int x8_min = std::max(area.get_x(), 0) / 8;
+  const int y8_min = std::max(area.get_y(), 0) / 8;
+  const int x8_max = std::min((area.get_x() + area.get_width() + 7) / 8, map_width8);
+  const int y8_max = std::min((area.get_y() + area.get_height() + 7) / 8, map_height8);
+
+  std::vector<uint32_t>& versions = ground_versions.at(layer);
+  const uint32_t version = ++last_ground_version;
+  for (int y8 = y8_min; y8 < y8_max; ++y8) {
+    for (int x8 = x8_min; x8 < x8_max; ++x8) {
+      versions[y8 * map_width8 + x8] = version;
+    }
+  }
 }
 
 /**
@@ -1439,5 +1684,174 @@ void Entities::ZCache::bring_to_back(const ConstEntityPtr& entity) {
   z_values.insert(std::make_pair(entity, min));
 }
 
+/**
+ * \brief Inserts an entity in the list.
+ *
+ * If it is drawn in Z order, it goes above all others like in the Z cache.
+ * If it is drawn in Y order, it gets placed at the next sort.
+ *
+ * \param entity The entity to add.
+ */
+void Entities::DrawList::add(const EntityPtr& entity) {
+
+  if (entity->is_drawn_in_y_order()) {
+    y_ordered.push_back(entity);
+  }
+  else {
+    z_ordered.push_back(entity);
+  }
+}
+
+/**
+ * \brief Removes an entity from the list.
+ *
+ * Nothing happens if the entity was not present.
+ *
+ * \param entity The entity to remove.
+ */
+void Entities::DrawList::remove(const Entity& entity) {
+
+  for (EntityVector* entities: { &z_ordered, &y_ordered }) {
+    const auto& it = std::find_if(entities->begin(), entities->end(),
+        [&entity](const EntityPtr& element) {
+      return element.get() == &entity;
+    });
+    if (it != entities->end()) {
+      entities->erase(it);
+      return;
+    }
+  }
+}
+
+/**
+ * \brief Puts an entity drawn in Z order above all others.
+ *
+ * Nothing happens if the entity is drawn in Y order.
+ *
+ * \param entity The entity to bring to front.
+ */
+void Entities::DrawList::bring_to_front(const Entity& entity) {
+
+  const auto& it = std::find_if(z_ordered.begin(), z_ordered.end(),
+      [&entity](const EntityPtr& element) {
+    return element.get() == &entity;
+  });
+  if (it != z_ordered.end()) {
+    std::rotate(it, it + 1, z_ordered.end());
+  }
 }
 
+/**
+ * \brief Puts an entity drawn in Z order behind all others.
+ *
+ * Nothing happens if the entity is drawn in Y order.
+ *
+ * \param entity The entity to bring to back.
+ */
+void Entities::DrawList::bring_to_back(const Entity& entity) {
+
+  const auto& it = std::find_if(z_ordered.begin(), z_ordered.end(),
+      [&entity](const EntityPtr& element) {
+    return element.get() == &entity;
+  });
+  if (it != z_ordered.end()) {
+    std::rotate(z_ordered.begin(), it, it + 1);
+  }
+}
+
+/**
+ * \brief Restores the drawing order after entities have changed.
+ *
+ * Entities whose drawing mode changed are moved to the other part of the
+ * list, and entities drawn in Y order are sorted again.
+ * Since most entities keep the same order from a cycle to the next,
+ * an insertion sort only moves the ones that went past their neighbors.
+ *
+ * \param entities The map entities, to get the Z order of entities that
+ * are now drawn in Z order.
+ */
+void Entities::DrawList::sort(const Entities& entities) {
+
+  const size_t num_y_ordered = y_ordered.size();
+
+  // Move entities now drawn in Y order.
+  size_t kept = 0;
+  for (size_t i = 0; i < z_ordered.size(); ++i) {
+    if (z_ordered[i]->is_drawn_in_y_order()) {
+      y_ordered.push_back(std::move(z_ordered[i]));
+    }
+    else {
+      if (kept != i) {
+        z_ordered[kept] = std::move(z_ordered[i]);
+      }
+      ++kept;
+    }
+  }
+  z_ordered.resize(kept);
+
+  // Move entities now drawn in Z order.
+  kept = 0;
+  for (size_t i = 0; i < y_ordered.size(); ++i) {
+    if (i < num_y_ordered && !y_ordered[i]->is_drawn_in_y_order()) {
+      const int z = entities.get_entity_relative_z_order(y_ordered[i]);
+      const auto& it = std::upper_bound(z_ordered.begin(), z_ordered.end(), z,
+          [&entities](int value, const EntityPtr& element) {
+        return value < entities.get_entity_relative_z_order(element);
+      });
+      z_ordered.insert(it, std::move(y_ordered[i]));
+    }
+    else {
+      if (kept != i) {
+        y_ordered[kept] = std::move(y_ordered[i]);
+      }
+      ++kept;
+    }
+  }
+  y_ordered.resize(kept);
+
+  // Move entities whose Y coordinate went past their neighbors.
+  for (size_t i = 1; i < y_ordered.size(); ++i) {
+    const int y = y_ordered[i]->get_y();
+    if (y_ordered[i - 1]->get_y() <= y) {
+      continue;
+    }
+    EntityPtr entity = std::move(y_ordered[i]);
+    size_t j = i;
+    while (j > 0 && y_ordered[j - 1]->get_y() > y) {
+      y_ordered[j] = std::move(y_ordered[j - 1]);
+      --j;
+    }
+    y_ordered[j] = std::move(entity);
+  }
+}
+
+/**
+ * \brief Draws the enabled and visible entities of the list that overlap
+ * a region or that are not drawn at their position.
+ *
+ * Entities may be added, removed or reordered while they are drawn,
+ * for example by Lua events. Some of them may then be skipped or drawn
+ * twice during this cycle.
+ *
+ * \param region The region where to draw entities.
+ */
+void Entities::DrawList::draw(const Rectangle& region) {
+
+  for (EntityVector* entities: { &z_ordered, &y_ordered }) {
+    for (size_t i = 0; i < entities->size(); ++i) {
+      const EntityPtr& entity = (*entities)[i];
+      if (!entity->is_enabled() || !entity->is_visible()) {
+        continue;
+      }
+      if (!entity->get_max_bounding_box().overlaps(region) &&
+          entity->is_drawn_at_its_position()) {
+        continue;
+      }
+      // Keep the entity alive even if it leaves the list while being drawn.
+      EntityPtr drawn_entity = entity;
+      drawn_entity->draw_on_map();
+    }
+  }
+}
+
+}
@@ -29,6 +29,7 @@
 #include "solarus/entities/Tileset.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/Geometry.h"
+#include "solarus/lowlevel/Profiler.h"
 #include "solarus/lowlevel/System.h"
 #include "solarus/lua/LuaContext.h"
 #include "solarus/movements/Movement.h"
@@ -64,6 +65,9 @@ Entity::Entity(
   layer(layer),
   bounding_box(xy, size),
   ground_below(Ground::EMPTY),
+  ground_below_point(),
+  ground_below_layer(layer),
+  ground_below_version(0),
   origin(0, 0),
   name(name),
   direction(direction),
@@ -169,11 +173,14 @@ Ground Entity::get_modified_ground() const {
  */
 void Entity::update_ground_observers() {
 
+  // Update the terrain known by path finding.
+  get_map().notify_ground_modifier_changed(*this);
+
   // Update overlapping entities that are sensible to their ground.
   const Rectangle& box = get_bounding_box();
-  std::vector<EntityPtr> entities_nearby;
+  std::vector<Entity*> entities_nearby;
   get_entities().get_entities_in_rectangle(box, entities_nearby);
-  for (const EntityPtr& entity_nearby: entities_nearby) {
+  for (Entity* entity_nearby: entities_nearby) {
 
     if (!entity_nearby->is_ground_observer()) {
       // The entity does not care about the ground below it.
@@ -225,15 +232,31 @@ void Entity::update_ground_below() {
   // Note that even if the entity is suspended,
   // the user might want to know the ground below it.
 
-  if (map->test_collision_with_border(get_ground_point())) {
+  const Point& ground_point = get_ground_point();
+  if (map->test_collision_with_border(ground_point)) {
     // If the entity is outside the map, which is legal during a scrolling
     // transition, don't try to determine any ground.
     return;
   }
 
+  // Nothing can have changed if the ground point is the same
+  // and its 8x8 square still has the same ground version.
+  const uint32_t ground_version =
+      get_entities().get_ground_version(get_layer(), ground_point);
+  if (ground_version == ground_below_version &&
+      ground_point == ground_below_point &&
+      get_layer() == ground_below_layer) {
+    Profiler::add_counter(Profiler::Counter::GROUND_BELOW_HITS, 1);
+    return;
+  }
+  Profiler::add_counter(Profiler::Counter::GROUND_BELOW_MISSES, 1);
+  ground_below_point = ground_point;
+  ground_below_layer = get_layer();
+  ground_below_version = ground_version;
+
   Ground previous_ground = this->ground_below;
   this->ground_below = get_map().get_ground(
-      get_layer(), get_ground_point(), this
+      get_layer(), ground_point, this
   );
   if (this->ground_below != previous_ground) {
     notify_ground_below_changed();
@@ -321,6 +344,7 @@ void Entity::set_map(Map& map) {
   }
 
   this->ground_below = Ground::EMPTY;
+  this->ground_below_version = 0;
 
   if (!initialized && map.is_loaded()) {
     // The entity is being created on a map already running.
@@ -1660,6 +1684,138 @@ void Entity::notify_position_changed() {
   }
 }
 
+/**
+ * \brief Notifies this entity that its movement made several steps at once.
+ *
+ * Detectors are checked at each intermediate position like if the steps
+ * had been notified one by one, but with a single spatial query around
+ * the whole path.
+ * Then notify_position_changed() is called once at the final position.
+ *
+ * If a detector removes or moves this entity, or stops or replaces the
+ * movement, the remaining steps are dropped like they would have been
+ * without sweeping, and the entity stays where this happened.
+ * The Lua event of the movement is called once, with the position where
+ * the entity stays.
+ *
+ * \param movement The movement that made the steps.
+ * \param positions The successive positions of the entity during the
+ * steps. The last one is the current position.
+ */
+void Entity::notify_position_swept(Movement& movement, const std::vector<Point>& positions) {
+
+  if (is_on_map()) {
+    // Checks postponed earlier in this cycle come first.
+    get_entities().get_collision_broad_phase().flush();
+  }
+
+  const Point final_xy = get_xy();
+  if (positions.size() > 1 &&
+      is_on_map() &&
+      is_enabled() &&
+      !get_map().is_suspended()) {
+
+    // One spatial query for all intermediate positions.
+    const size_t num_steps = positions.size() - 1;
+    const Rectangle final_box = get_extended_bounding_box(8) | get_max_bounding_box();
+    Rectangle swept_box = final_box;
+    for (size_t i = 0; i < num_steps; ++i) {
+      Rectangle step_box = final_box;
+      step_box.add_xy(positions[i] - final_xy);
+      swept_box |= step_box;
+    }
+    std::vector<Entity*> candidates;
+    get_entities().get_entities_in_rectangle(swept_box, candidates);
+    std::vector<Rectangle> candidate_boxes;
+    candidate_boxes.reserve(candidates.size());
+    for (const Entity* candidate : candidates) {
+      candidate_boxes.push_back(candidate->get_max_bounding_box());
+    }
+
+    // Keep the candidates overlapping a box, in the order of the query.
+    std::vector<Entity*> entities_nearby;
+    const auto& get_entities_nearby = [&](const Rectangle& box) -> const std::vector<Entity*>& {
+      entities_nearby.clear();
+      for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidate_boxes[i].overlaps(box)) {
+          entities_nearby.push_back(candidates[i]);
+        }
+      }
+      return entities_nearby;
+    };
+
+    // The movement may already be stopped or finished by its last step.
+    const bool was_stopped = movement.is_stopped();
+    const bool was_finished = movement.is_finished();
+
+    // Replay the checks of notify_position_changed() at each step.
+    for (size_t i = 0; i < num_steps; ++i) {
+      const Point& xy = positions[i];
+      set_xy(xy);
+
+      if (is_detector()) {
+        get_map().check_collision_from_detector(*this, get_entities_nearby(get_extended_bounding_box(8)));
+      }
+      if (!get_map().is_suspended()) {
+        get_map().check_collision_with_detectors(*this, get_entities_nearby(get_extended_bounding_box(8)));
+      }
+      for (size_t j = 0; j < sprites.size(); ++j) {
+        if (sprites[j].removed || get_map().is_suspended()) {
+          continue;
+        }
+        SpritePtr sprite = sprites[j].sprite;  // Keep it alive during the checks.
+        if (sprite->are_pixel_collisions_enabled()) {
+          get_map().check_collision_with_detectors(*this, *sprite, get_entities_nearby(get_max_bounding_box()));
+        }
+      }
+
+      if (is_being_removed() || get_xy() != xy) {
+        // A detector removed or moved this entity: it was already notified.
+        notify_movement_swept_to(movement, xy);
+        return;
+      }
+
+      if (get_movement().get() != &movement ||
+          (!was_stopped && movement.is_stopped()) ||
+          (!was_finished && movement.is_finished())) {
+        // A detector stopped or replaced the movement: the next steps
+        // would not have happened.
+        // Detectors were checked here already, notify the rest.
+        notify_movement_swept_to(movement, xy);
+        notify_bounding_box_changed();
+        if (is_ground_modifier()) {
+          update_ground_observers();
+        }
+        update_ground_below();
+        if (are_movement_notifications_enabled()) {
+          get_lua_context()->entity_on_position_changed(*this, get_xy(), get_layer());
+        }
+        return;
+      }
+
+      if (get_map().is_suspended()) {
+        break;
+      }
+    }
+    set_xy(final_xy);
+  }
+
+  notify_movement_swept_to(movement, final_xy);
+  notify_position_changed();
+}
+
+/**
+ * \brief Calls the Lua event of a movement whose steps were swept.
+ * \param movement The movement that made the steps.
+ * \param xy The position where the steps ended.
+ */
+void Entity::notify_movement_swept_to(Movement& movement, const Point& xy) {
+
+  if (movement.are_lua_notifications_enabled()) {
+    get_lua_context()->movement_on_position_changed(movement, xy);
+  }
+}
+
 /**
  * \brief Returns whether this entity is able to detect other entities.
  *
@@ -2326,6 +2482,24 @@ void Entity::notify_enabled(bool /* enabled */) {
   update_ground_below();
 }
 
+/**
+ * \brief Returns a value that summarizes how this entity decides which
+ * other entities are obstacles for it.
+ *
+ * Two entities of the same type with the same value and the same obstacle
+ * grounds consider the same entities as obstacles, so they can share the
+ * paths found for one of them.
+ * Redefine this function if your entity type has obstacle rules
+ * that depend on something else than its type.
+ *
+ * \return A value identifying the obstacle rules of this entity,
+ * or -1 if they are specific to this entity.
+ */
+int Entity::get_obstacle_traits() const {
+
+  return 0;
+}
+
 /**
  * \brief Returns whether this entity is an obstacle for another one.
  *
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/EntityPool.h"
+#include "solarus/lowlevel/Debug.h"
+#include <new>
+
+namespace Solarus {
+
+bool EntityPool::enabled = false;
+
+/**
+ * \brief Creates an empty pool.
+ */
+EntityPool::EntityPool():
+  free_lists(max_block_size / block_granularity, nullptr),
+  chunks(),
+  num_blocks_used(0) {
+
+}
+
+/**
+ * \brief Returns whether entities are allocated in pools.
+ * \return \c true if entity pools are enabled.
+ */
+bool EntityPool::is_enabled() {
+  return enabled;
+}
+
+/**
+ * \brief Sets whether entities are allocated in pools.
+ *
+ * This only changes how entities created from now on are allocated.
+ *
+ * \param enabled \c true to enable entity pools.
+ */
+void EntityPool::set_enabled(bool enabled) {
+  EntityPool::enabled = enabled;
+}
+
+/**
+ * \brief Allocates a block of memory.
+ * \param size Size of the block in bytes.
+ * \return The block.
+ */
+void* EntityPool::allocate(std::size_t size) {
+
+  if (size == 0 || size > max_block_size) {
+    return ::operator new(size);
+  }
+
+  const std::size_t size_class = (size - 1) / block_granularity;
+  if (free_lists[size_class] == nullptr) {
+    // Allocate a chunk of blocks of this size class.
+    const std::size_t block_size = (size_class + 1) * block_granularity;
+    chunks.emplace_back(new char[block_size * blocks_per_chunk]);
+    char* chunk = chunks.back().get();
+    for (int i = blocks_per_chunk - 1; i >= 0; --i) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * block_size);
+      block->next = free_lists[size_class];
+      free_lists[size_class] = block;
+    }
+  }
+
+  FreeBlock* block = free_lists[size_class];
+  free_lists[size_class] = block->next;
+  ++num_blocks_used;
+  return block;
+}
+
+/**
+ * \brief Frees a block of memory allocated by allocate().
+ * \param block The block to free.
+ * \param size Size of the block in bytes, as passed to allocate().
+ */
+void EntityPool::deallocate(void* block, std::size_t size) {
+
+  if (size == 0 || size > max_block_size) {
+    ::operator delete(block);
+    return;
+  }
+
+  Debug::check_assertion(num_blocks_used > 0, "No block to free in entity pool");
+  const std::size_t size_class = (size - 1) / block_granularity;
+  FreeBlock* free_block = static_cast<FreeBlock*>(block);
+  free_block->next = free_lists[size_class];
+  free_lists[size_class] = free_block;
+  --num_blocks_used;
+}
+
+/**
+ * \brief Returns the number of chunks of blocks allocated so far.
+ *
+ * This only grows when more blocks of a size class are used at the same
+ * time than ever before.
+ *
+ * \return The number of chunks.
+ */
+int EntityPool::get_num_chunks() const {
+  return static_cast<int>(chunks.size());
+}
+
+/**
+ * \brief Returns the number of blocks currently used by objects.
+ * \return The number of blocks used.
+ */
+int EntityPool::get_num_blocks_used() const {
+  return num_blocks_used;
+}
+
+}
+
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/GroundGrid.h"
+#include "solarus/entities/GroundInfo.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include <algorithm>
+#include <array>
+
+namespace Solarus {
+
+constexpr int GroundGrid::num_grounds;
+
+namespace {
+
+/**
+ * \brief Obstacle pixels of an 8x8 square with a diagonal ground.
+ */
+struct DiagonalMask {
+  uint8_t rows[8];      /**< For each row y, bit x is set if pixel (x, y) is an obstacle. */
+  uint8_t columns[8];   /**< For each column x, bit y is set if pixel (x, y) is an obstacle. */
+};
+
+/**
+ * \brief Returns whether a pixel of an 8x8 square with a diagonal ground
+ * is in the obstacle half.
+ * \param ground A ground.
+ * \param x X coordinate of the pixel in the square.
+ * \param y Y coordinate of the pixel in the square.
+ * \return \c true if the ground is diagonal and the pixel is an obstacle.
+ */
+bool is_diagonal_obstacle(Ground ground, int x, int y) {
+
+  switch (ground) {
+
+  case Ground::WALL_TOP_RIGHT:
+  case Ground::WALL_TOP_RIGHT_WATER:
+    return y <= x;
+
+  case Ground::WALL_TOP_LEFT:
+  case Ground::WALL_TOP_LEFT_WATER:
+    return y <= 7 - x;
+
+  case Ground::WALL_BOTTOM_LEFT:
+  case Ground::WALL_BOTTOM_LEFT_WATER:
+    return y >= x;
+
+  case Ground::WALL_BOTTOM_RIGHT:
+  case Ground::WALL_BOTTOM_RIGHT_WATER:
+    return y >= 7 - x;
+
+  default:
+    return false;
+  }
+}
+
+/**
+ * \brief Computes the pixel masks of all grounds.
+ * \return The mask of each ground, empty for non-diagonal ones.
+ */
+std::array<DiagonalMask, GroundGrid::num_grounds> compute_diagonal_masks() {
+
+  std::array<DiagonalMask, GroundGrid::num_grounds> masks;
+  for (int i = 0; i < GroundGrid::num_grounds; ++i) {
+    DiagonalMask& mask = masks[i];
+    for (int j = 0; j < 8; ++j) {
+      mask.rows[j] = 0;
+      mask.columns[j] = 0;
+    }
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        if (is_diagonal_obstacle(static_cast<Ground>(i), x, y)) {
+          mask.rows[y] |= 1 << x;
+          mask.columns[x] |= 1 << y;
+        }
+      }
+    }
+  }
+  return masks;
+}
+
+/**
+ * \brief Computes the bit field of diagonal grounds.
+ * \return Bit field where bit \c n is set if <tt>Ground(n)</tt> is diagonal.
+ */
+uint32_t compute_diagonal_grounds() {
+
+  uint32_t diagonal_grounds = 0;
+  for (int i = 0; i < GroundGrid::num_grounds; ++i) {
+    if (GroundInfo::is_ground_diagonal(static_cast<Ground>(i))) {
+      diagonal_grounds |= 1 << i;
+    }
+  }
+  return diagonal_grounds;
+}
+
+const std::array<DiagonalMask, GroundGrid::num_grounds> diagonal_masks =
+    compute_diagonal_masks();
+const uint32_t diagonal_grounds = compute_diagonal_grounds();
+
+/**
+ * \brief Returns the index of the lowest bit set in a word.
+ * \param bits A non-zero word.
+ * \return Index of its lowest bit set.
+ */
+int get_lowest_bit_index(uint64_t bits) {
+
+  int index = 0;
+  if ((bits & 0xFFFFFFFF) == 0) {
+    bits >>= 32;
+    index += 32;
+  }
+  while ((bits & 1) == 0) {
+    bits >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+/**
+ * \brief Returns a word with the bits of a range set.
+ * \param first Index of the first bit of the range (0 to 63).
+ * \param last Index of the last bit of the range (\c first to 63).
+ * \return The bits from \c first to \c last.
+ */
+uint64_t get_range_bits(int first, int last) {
+
+  return (~uint64_t(0) << first) & (~uint64_t(0) >> (63 - last));
+}
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates an empty grid.
+ */
+GroundGrid::GroundGrid():
+  width8(0),
+  height8(0),
+  row_words(0),
+  column_words(0),
+  cells(),
+  row_bits(num_grounds),
+  column_bits(num_grounds) {
+
+}
+
+/**
+ * \brief Creates a grid where all squares have the same ground.
+ * \param width8 Number of 8x8 squares in a row.
+ * \param height8 Number of 8x8 squares in a column.
+ * \param initial_ground Ground of all squares.
+ */
+GroundGrid::GroundGrid(int width8, int height8, Ground initial_ground):
+  width8(width8),
+  height8(height8),
+  row_words((width8 + 63) / 64),
+  column_words((height8 + 63) / 64),
+  cells(width8 * height8, static_cast<uint8_t>(initial_ground)),
+  row_bits(num_grounds),
+  column_bits(num_grounds) {
+
+  for (int i = 0; i < num_grounds; ++i) {
+    row_bits[i].assign(height8 * row_words, 0);
+    column_bits[i].assign(width8 * column_words, 0);
+  }
+
+  std::vector<uint64_t>& rows = row_bits[static_cast<int>(initial_ground)];
+  for (int y8 = 0; y8 < height8; ++y8) {
+    for (int x8 = 0; x8 < width8; ++x8) {
+      rows[y8 * row_words + (x8 >> 6)] |= uint64_t(1) << (x8 & 63);
+    }
+  }
+
+  std::vector<uint64_t>& columns = column_bits[static_cast<int>(initial_ground)];
+  for (int x8 = 0; x8 < width8; ++x8) {
+    for (int y8 = 0; y8 < height8; ++y8) {
+      columns[x8 * column_words + (y8 >> 6)] |= uint64_t(1) << (y8 & 63);
+    }
+  }
+}
+
+/**
+ * \brief Returns the number of 8x8 squares in a row.
+ * \return The width of the grid in squares.
+ */
+int GroundGrid::get_width8() const {
+  return width8;
+}
+
+/**
+ * \brief Returns the number of 8x8 squares in a column.
+ * \return The height of the grid in squares.
+ */
+int GroundGrid::get_height8() const {
+  return height8;
+}
+
+/**
+ * \brief Sets the ground of an 8x8 square.
+ *
+ * For performance reasons, no check is done on the coordinates.
+ *
+ * \param x8 X coordinate of the square (divided by 8).
+ * \param y8 Y coordinate of the square (divided by 8).
+ * \param ground The ground to set.
+ */
+void GroundGrid::set_ground8(int x8, int y8, Ground ground) {
+
+  const int index = y8 * width8 + x8;
+  const int old_ground = cells[index];
+  const int new_ground = static_cast<int>(ground);
+  if (new_ground == old_ground) {
+    return;
+  }
+  cells[index] = static_cast<uint8_t>(new_ground);
+
+  const int row_index = y8 * row_words + (x8 >> 6);
+  const uint64_t row_bit = uint64_t(1) << (x8 & 63);
+  row_bits[old_ground][row_index] &= ~row_bit;
+  row_bits[new_ground][row_index] |= row_bit;
+
+  const int column_index = x8 * column_words + (y8 >> 6);
+  const uint64_t column_bit = uint64_t(1) << (y8 & 63);
+  column_bits[old_ground][column_index] &= ~column_bit;
+  column_bits[new_ground][column_index] |= column_bit;
+}
+
+/**
+ * \brief Returns whether a pixel of the border of a rectangle is an obstacle.
+ *
+ * Squares with a diagonal ground are always obstacles on their
+ * wall half, and never on the other half.
+ *
+ * \param box The rectangle to test, in pixels. It must not be empty
+ * and must be entirely inside the grid.
+ * \param obstacle_grounds Bit field where bit \c n is set if
+ * <tt>Ground(n)</tt> is an obstacle. Bits of diagonal grounds are ignored.
+ * \return \c true if at least one pixel of the border is an obstacle.
+ */
+bool GroundGrid::has_obstacle_on_border(
+    const Rectangle& box,
+    uint32_t obstacle_grounds
+) const {
+
+  const int x1 = box.get_x();
+  const int x2 = x1 + box.get_width() - 1;
+  const int y1 = box.get_y();
+  const int y2 = y1 + box.get_height() - 1;
+
+  obstacle_grounds &= ~diagonal_grounds;
+  return has_obstacle_on_row(y1, x1, x2, obstacle_grounds) ||
+      has_obstacle_on_row(y2, x1, x2, obstacle_grounds) ||
+      has_obstacle_on_column(x1, y1, y2, obstacle_grounds) ||
+      has_obstacle_on_column(x2, y1, y2, obstacle_grounds);
+}
+
+/**
+ * \brief Returns whether a pixel of a horizontal segment is an obstacle.
+ * \param y Y coordinate of the segment.
+ * \param x1 X coordinate of the first pixel.
+ * \param x2 X coordinate of the last pixel.
+ * \param obstacle_grounds Bit field of non-diagonal obstacle grounds.
+ * \return \c true if at least one pixel is an obstacle.
+ */
+bool GroundGrid::has_obstacle_on_row(
+    int y, int x1, int x2, uint32_t obstacle_grounds) const {
+
+  const int y8 = y >> 3;
+  const int first_x8 = x1 >> 3;
+  const int last_x8 = x2 >> 3;
+  const int first_word = first_x8 >> 6;
+  const int last_word = last_x8 >> 6;
+
+  for (int word = first_word; word <= last_word; ++word) {
+
+    const uint64_t range = get_range_bits(
+        word == first_word ? (first_x8 & 63) : 0,
+        word == last_word ? (last_x8 & 63) : 63
+    );
+    const int index = y8 * row_words + word;
+    uint64_t obstacles = 0;
+    uint64_t diagonals = 0;
+    for (int ground = 0; ground < num_grounds; ++ground) {
+      if ((obstacle_grounds & (1 << ground)) != 0) {
+        obstacles |= row_bits[ground][index];
+      }
+      else if ((diagonal_grounds & (1 << ground)) != 0) {
+        diagonals |= row_bits[ground][index];
+      }
+    }
+
+    if ((obstacles & range) != 0) {
+      return true;
+    }
+
+    // Diagonal squares: test the pixels of the segment inside them.
+    diagonals &= range;
+    while (diagonals != 0) {
+      const int x8 = word * 64 + get_lowest_bit_index(diagonals);
+      diagonals &= diagonals - 1;
+      const DiagonalMask& mask = diagonal_masks[cells[y8 * width8 + x8]];
+      const int first_x = std::max(x1, x8 * 8) - x8 * 8;
+      const int last_x = std::min(x2, x8 * 8 + 7) - x8 * 8;
+      if ((mask.rows[y & 7] & get_range_bits(first_x, last_x)) != 0) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/**
+ * \brief Returns whether a pixel of a vertical segment is an obstacle.
+ * \param x X coordinate of the segment.
+ * \param y1 Y coordinate of the first pixel.
+ * \param y2 Y coordinate of the last pixel.
+ * \param obstacle_grounds Bit field of non-diagonal obstacle grounds.
+ * \return \c true if at least one pixel is an obstacle.
+ */
+bool GroundGrid::has_obstacle_on_column(
+    int x, int y1, int y2, uint32_t obstacle_grounds) const {
+
+  const int x8 = x >> 3;
+  const int first_y8 = y1 >> 3;
+  const int last_y8 = y2 >> 3;
+  const int first_word = first_y8 >> 6;
+  const int last_word = last_y8 >> 6;
+
+  for (int word = first_word; word <= last_word; ++word) {
+
+    const uint64_t range = get_range_bits(
+        word == first_word ? (first_y8 & 63) : 0,
+        word == last_word ? (last_y8 & 63) : 63
+    );
+    const int index = x8 * column_words + word;
+    uint64_t obstacles = 0;
+    uint64_t diagonals = 0;
+    for (int ground = 0; ground < num_grounds; ++ground) {
+      if ((obstacle_grounds & (1 << ground)) != 0) {
+        obstacles |= column_bits[ground][index];
+      }
+      else if ((diagonal_grounds & (1 << ground)) != 0) {
+        diagonals |= column_bits[ground][index];
+      }
+    }
+
+    if ((obstacles & range) != 0) {
+      return true;
+    }
+
+    // Diagonal squares: test the pixels of the segment inside them.
+    diagonals &= range;
+    while (diagonals != 0) {
+      const int y8 = word * 64 + get_lowest_bit_index(diagonals);
+      diagonals &= diagonals - 1;
+      const DiagonalMask& mask = diagonal_masks[cells[y8 * width8 + x8]];
+      const int first_y = std::max(y1, y8 * 8) - y8 * 8;
+      const int last_y = std::min(y2, y8 * 8 + 7) - y8 * 8;
+      if ((mask.columns[x & 7] & get_range_bits(first_y, last_y)) != 0) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+}
+
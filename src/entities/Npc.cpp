@@ -16,6 +16,7 @@
  */
 #include "solarus/entities/Npc.h"
 #include "solarus/entities/CarriedObject.h"
+#include "solarus/entities/Entities.h"
 #include "solarus/entities/Hero.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/QuestFiles.h"
@@ -172,6 +173,15 @@ bool Npc::is_hero_obstacle(Hero& /* hero */) {
   return true;
 }
 
+/**
+ * \copydoc Entity::get_obstacle_traits
+ */
+int Npc::get_obstacle_traits() const {
+
+  // Usual NPCs traverse other usual NPCs and enemies.
+  return subtype;
+}
+
 /**
  * \brief Returns whether an NPC is currently considered as an obstacle by this entity.
  * \param npc an NPC
@@ -290,7 +300,7 @@ bool Npc::notify_action_command_pressed() {
         if (sprite != nullptr) {
           animation_set_id = sprite->get_animation_set_id();
         }
-        hero.start_lifting(std::make_shared<CarriedObject>(
+        hero.start_lifting(get_entities().make_entity<CarriedObject>(
             hero,
             *this,
             animation_set_id,
@@ -86,7 +86,7 @@ EntityType Pickable::get_type() const {
  * or:
  * - the animation of the item is missing in sprite 'entities/items'.
  *
- * \param game the current game
+ * \param entities the entities of the map where the pickable treasure will be
  * \param name Name identifying the entity on the map or an empty string.
  * \param layer layer of the pickable treasure to create on the map
  * \param xy Coordinates of the pickable treasure to create
@@ -98,7 +98,7 @@ EntityType Pickable::get_type() const {
  * \return the pickable item created, or nullptr
  */
 std::shared_ptr<Pickable> Pickable::create(
-    Game& /* game */,
+    Entities& entities,
     const std::string& name,
     int layer,
     const Point& xy,
@@ -113,7 +113,7 @@ std::shared_ptr<Pickable> Pickable::create(
     return nullptr;
   }
 
-  std::shared_ptr<Pickable> pickable = std::make_shared<Pickable>(
+  std::shared_ptr<Pickable> pickable = entities.make_entity<Pickable>(
       name, layer, xy, treasure
   );
 
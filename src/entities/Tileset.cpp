@@ -189,6 +189,24 @@ bool Tileset::is_loaded() const {
   return tiles_image != nullptr;
 }
 
+/**
+ * \brief Returns an estimation of the memory used by this tileset.
+ *
+ * Only the images are counted: tile patterns are negligible in comparison.
+ *
+ * \return The size in bytes.
+ */
+size_t Tileset::get_memory_size() const {
+
+  size_t size = 0;
+  for (const SurfacePtr& image : { tiles_image, entities_image }) {
+    if (image != nullptr) {
+      size += image->get_width() * image->get_height() * sizeof(uint32_t);
+    }
+  }
+  return size;
+}
+
 /**
  * \brief Returns the image containing the tiles of this tileset.
  * \return the tiles image
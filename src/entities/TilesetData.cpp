@@ -17,9 +17,11 @@
 #include "solarus/entities/GroundInfo.h"
 #include "solarus/entities/TilesetData.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaTools.h"
 #include <ostream>
 #include <sstream>
+#include <utility>
 
 namespace Solarus {
 
@@ -543,4 +545,88 @@ bool TilesetData::export_to_lua(std::ostream& out) const {
   return true;
 }
 
+/**
+ * \copydoc LuaData::import_from_binary
+ */
+bool TilesetData::import_from_binary(BinaryDataReader& reader) {
+
+  TilesetData tileset;
+
+  const int r = reader.read_uint();
+  const int g = reader.read_uint();
+  const int b = reader.read_uint();
+  const int a = reader.read_uint();
+  tileset.set_background_color(Color(r, g, b, a));
+
+  const uint32_t num_patterns = reader.read_uint();
+  for (uint32_t i = 0; i < num_patterns && reader.is_valid(); ++i) {
+
+    const std::string& id = reader.read_string();
+    TilePatternData pattern;
+    pattern.set_ground(reader.read_enum(Ground::TRAVERSABLE));
+    pattern.set_default_layer(reader.read_int());
+    pattern.set_scrolling(reader.read_enum(TileScrolling::NONE));
+    pattern.set_repeat_mode(reader.read_enum(TilePatternRepeatMode::ALL));
+
+    const uint32_t num_frames = reader.read_uint();
+    if (num_frames == 0) {
+      return false;
+    }
+    std::vector<Rectangle> frames;
+    for (uint32_t j = 0; j < num_frames && reader.is_valid(); ++j) {
+      const int x = reader.read_int();
+      const int y = reader.read_int();
+      const int width = reader.read_int();
+      const int height = reader.read_int();
+      frames.emplace_back(x, y, width, height);
+    }
+    pattern.set_frames(frames);
+
+    if (!tileset.add_pattern(id, pattern)) {
+      return false;
+    }
+  }
+
+  if (!reader.is_valid() || !reader.is_at_end()) {
+    return false;
+  }
+
+  *this = std::move(tileset);
+  return true;
+}
+
+/**
+ * \copydoc LuaData::export_to_binary
+ */
+bool TilesetData::export_to_binary(BinaryDataWriter& writer) const {
+
+  uint8_t r, g, b, a;
+  get_background_color().get_components(r, g, b, a);
+  writer.write_uint(r);
+  writer.write_uint(g);
+  writer.write_uint(b);
+  writer.write_uint(a);
+
+  writer.write_uint(patterns.size());
+  for (const auto& kvp : patterns) {
+    const TilePatternData& pattern = kvp.second;
+    writer.write_string(kvp.first);
+    writer.write_enum(pattern.get_ground());
+    writer.write_int(pattern.get_default_layer());
+    writer.write_enum(pattern.get_scrolling());
+    writer.write_enum(pattern.get_repeat_mode());
+
+    const std::vector<Rectangle>& frames = pattern.get_frames();
+    writer.write_uint(frames.size());
+    for (const Rectangle& frame : frames) {
+      writer.write_int(frame.get_x());
+      writer.write_int(frame.get_y());
+      writer.write_int(frame.get_width());
+      writer.write_int(frame.get_height());
+    }
+  }
+
+  return true;
+}
+
 }
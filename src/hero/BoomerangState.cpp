@@ -93,7 +93,7 @@ void Hero::BoomerangState::update() {
       boomerang_direction8 = direction_pressed8;
     }
     double angle = Geometry::degrees_to_radians(boomerang_direction8 * 45);
-    get_entities().add_entity(std::make_shared<Boomerang>(
+    get_entities().add_entity(get_entities().make_entity<Boomerang>(
         std::static_pointer_cast<Hero>(get_entity().shared_from_this()),
         max_distance,
         speed,
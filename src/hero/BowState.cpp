@@ -53,7 +53,7 @@ void Hero::BowState::update() {
   Hero& hero = get_entity();
   if (get_sprites().is_animation_finished()) {
     Sound::play("bow");
-    get_entities().add_entity(std::make_shared<Arrow>(hero));
+    get_entities().add_entity(get_entities().make_entity<Arrow>(hero));
     hero.set_state(new FreeState(hero));
   }
 }
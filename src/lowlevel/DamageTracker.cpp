@@ -0,0 +1,626 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/DamageTracker.h"
+#include "solarus/lowlevel/Color.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Surface.h"
+#include "solarus/lowlevel/Video.h"
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+namespace Solarus {
+
+namespace {
+
+  bool enabled = false;           /**< Whether surfaces that support it track their damage. */
+  uint64_t next_stamp = 1;        /**< Stamp of the next recording started. */
+  std::vector<DamageTracker*>
+      recording_trackers;         /**< Trackers currently recording a frame. */
+
+  /**
+   * \brief Above this number of rectangles, the damage is replaced by their union.
+   */
+  constexpr size_t max_damage_rectangles = 32;
+
+  /**
+   * \brief Returns the area of a rectangle.
+   */
+  uint64_t get_area(const Rectangle& rectangle) {
+    return static_cast<uint64_t>(rectangle.get_width()) * rectangle.get_height();
+  }
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Compares two operation keys.
+ * \param other Another key.
+ * \return \c true if they identify the same operation.
+ */
+bool DamageTracker::OperationKey::operator==(const OperationKey& other) const {
+
+  return src_id == other.src_id &&
+      color == other.color &&
+      blend_mode == other.blend_mode &&
+      region == other.region &&
+      dst_position == other.dst_position;
+}
+
+/**
+ * \brief Computes the hash value of an operation key.
+ * \param key The key.
+ * \return The hash value.
+ */
+size_t DamageTracker::OperationKeyHash::operator()(const OperationKey& key) const {
+
+  size_t hash = std::hash<uint64_t>()(key.src_id);
+  const int values[] = {
+      static_cast<int>(key.color),
+      key.blend_mode,
+      key.region.get_x(),
+      key.region.get_y(),
+      key.region.get_width(),
+      key.region.get_height(),
+      key.dst_position.x,
+      key.dst_position.y
+  };
+  for (int value : values) {
+    hash = hash * 31 + std::hash<int>()(value);
+  }
+  return hash;
+}
+
+/**
+ * \brief Creates a damage tracker for a surface.
+ * \param surface The surface whose damage is tracked.
+ */
+DamageTracker::DamageTracker(Surface& surface):
+  surface(surface),
+  recording(false),
+  replaying(false),
+  flushed(false),
+  clear_first(false),
+  stamp(0),
+  operations(),
+  previous_operations(),
+  previous_valid(false),
+  damage(),
+  damage_old_version(0),
+  damage_new_version(0),
+  render_damage(),
+  render_damage_full(true) {
+
+}
+
+/**
+ * \brief Destroys this damage tracker.
+ */
+DamageTracker::~DamageTracker() {
+
+  stop_recording();
+}
+
+/**
+ * \brief Returns whether surfaces that support it track their damage.
+ * \return \c true if damage tracking is enabled.
+ */
+bool DamageTracker::is_enabled() {
+  return enabled;
+}
+
+/**
+ * \brief Sets whether surfaces that support it track their damage.
+ *
+ * This takes effect at the next frame.
+ *
+ * \param enabled \c true to enable damage tracking.
+ */
+void DamageTracker::set_enabled(bool enabled) {
+  Solarus::enabled = enabled;
+}
+
+/**
+ * \brief Notifies trackers that the pixels of a surface are about to change.
+ *
+ * Recordings where this surface is already used as a source are flushed,
+ * because replaying them later would draw the new pixels.
+ *
+ * \param src_surface The surface that changes.
+ */
+void DamageTracker::notify_source_changed(const Surface& src_surface) {
+
+  if (recording_trackers.empty() ||
+      src_surface.recorded_stamp == 0) {
+    return;
+  }
+
+  // Stamps grow, so a tracker that started after the surface was last
+  // recorded cannot have recorded it.
+  const std::vector<DamageTracker*> trackers = recording_trackers;
+  for (DamageTracker* tracker : trackers) {
+    if (tracker->stamp <= src_surface.recorded_stamp) {
+      tracker->flush();
+    }
+  }
+}
+
+/**
+ * \brief Returns whether drawings onto the surface are being recorded.
+ * \return \c true if drawings are postponed to finish().
+ */
+bool DamageTracker::is_recording() const {
+  return recording;
+}
+
+/**
+ * \brief Returns whether recorded drawings are being replayed onto the
+ * surface.
+ * \return \c true during the replay.
+ */
+bool DamageTracker::is_replaying() const {
+  return replaying;
+}
+
+/**
+ * \brief Starts recording the drawings of a frame.
+ *
+ * Does nothing if damage tracking is disabled or if the surface is drawn
+ * by the GPU.
+ */
+void DamageTracker::start() {
+
+  if (recording ||
+      !enabled ||
+      (!surface.is_software_destination() && Video::is_acceleration_enabled())) {
+    return;
+  }
+
+  recording = true;
+  flushed = false;
+  clear_first = false;
+  stamp = next_stamp++;
+  operations.clear();
+  recording_trackers.push_back(this);
+}
+
+/**
+ * \brief Stops recording without drawing anything.
+ */
+void DamageTracker::stop_recording() {
+
+  if (!recording) {
+    return;
+  }
+
+  recording = false;
+  recording_trackers.erase(
+      std::remove(recording_trackers.begin(), recording_trackers.end(), this),
+      recording_trackers.end()
+  );
+}
+
+/**
+ * \brief Finishes the frame: redraws the damaged regions of the surface.
+ *
+ * Does nothing if no frame is being recorded.
+ */
+void DamageTracker::finish() {
+
+  if (flushed) {
+    // Everything was already drawn.
+    flushed = false;
+    return;
+  }
+
+  if (!recording) {
+    return;
+  }
+  stop_recording();
+
+  compute_damage();
+
+  damage_old_version = surface.content_version;
+  if (!damage.empty()) {
+
+    if (surface.internal_surface == nullptr) {
+      surface.create_software_surface();
+    }
+
+    uint64_t num_pixels = 0;
+    replaying = true;
+    for (const Rectangle& rectangle : damage) {
+      replay(rectangle);
+      num_pixels += get_area(rectangle);
+    }
+    surface.notify_changed();
+    replaying = false;
+    Profiler::add_counter(Profiler::Counter::PIXELS_REDRAWN, num_pixels);
+
+    if (!render_damage_full) {
+      render_damage.insert(render_damage.end(), damage.begin(), damage.end());
+      if (render_damage.size() > max_damage_rectangles) {
+        render_damage_full = true;
+        render_damage.clear();
+      }
+    }
+  }
+  damage_new_version = surface.content_version;
+
+  // Keep the operations for the next frame, but not their sources.
+  previous_operations.swap(operations);
+  operations.clear();
+  for (Operation& operation : previous_operations) {
+    operation.src_surface = nullptr;
+  }
+  previous_valid = true;
+}
+
+/**
+ * \brief Immediately draws everything recorded so far and stops recording
+ * until the end of the frame.
+ *
+ * This is done when something that cannot be recorded happens.
+ * The whole surface is then considered as damaged.
+ */
+void DamageTracker::flush() {
+
+  if (!recording) {
+    return;
+  }
+  stop_recording();
+  flushed = true;
+
+  if (surface.internal_surface == nullptr) {
+    surface.create_software_surface();
+  }
+
+  replaying = true;
+  if (clear_first) {
+    SDL_FillRect(
+        surface.internal_surface.get(),
+        nullptr,
+        surface.get_color_value(Color::transparent)
+    );
+  }
+  for (const Operation& operation : operations) {
+    operation.src_surface->raw_draw_region(
+        operation.key.region,
+        surface,
+        operation.key.dst_position
+    );
+  }
+  surface.notify_changed();
+  replaying = false;
+  operations.clear();
+  Profiler::add_counter(Profiler::Counter::PIXELS_REDRAWN, get_area(Rectangle(surface.get_size())));
+
+  invalidate();
+}
+
+/**
+ * \brief Notifies the tracker that the surface was modified outside a
+ * recorded frame.
+ *
+ * The next frame will redraw the whole surface.
+ */
+void DamageTracker::invalidate() {
+
+  flush();
+  previous_operations.clear();
+  previous_valid = false;
+  render_damage.clear();
+  render_damage_full = true;
+}
+
+/**
+ * \brief Records that the surface is cleared.
+ *
+ * Clearing can only be recorded as the first operation of the frame.
+ * Otherwise, the recording is flushed.
+ *
+ * \return \c true if the clear was recorded, \c false if it has to be done
+ * immediately.
+ */
+bool DamageTracker::record_clear() {
+
+  if (!recording) {
+    return false;
+  }
+
+  if (!operations.empty()) {
+    flush();
+    return false;
+  }
+
+  clear_first = true;
+  return true;
+}
+
+/**
+ * \brief Records a drawing onto the surface.
+ * \param src_surface The surface to draw.
+ * \param region The subrectangle to draw in the source surface.
+ * \param dst_position Coordinates on the tracked surface.
+ */
+void DamageTracker::record_draw(
+    Surface& src_surface,
+    const Rectangle& region,
+    const Point& dst_position) {
+
+  Operation operation;
+  if (src_surface.internal_surface == nullptr && src_surface.internal_color != nullptr) {
+    // A color: surfaces created to fill colors are temporary,
+    // so identify the operation by the color value.
+    operation.key.src_id = 0;
+    operation.key.color = surface.get_color_value(*src_surface.internal_color);
+  }
+  else {
+    operation.key.src_id = src_surface.id;
+    operation.key.color = 0;
+  }
+  operation.key.blend_mode = static_cast<int>(src_surface.get_blend_mode());
+  operation.key.region = region;
+  operation.key.dst_position = dst_position;
+  operation.src_version = src_surface.content_version;
+  operation.dst_rect = get_dst_rect(src_surface, region, dst_position);
+  operation.src_surface = std::static_pointer_cast<Surface>(src_surface.shared_from_this());
+  operations.push_back(std::move(operation));
+
+  src_surface.recorded_stamp = std::max(src_surface.recorded_stamp, stamp);
+}
+
+/**
+ * \brief Returns the rectangle of the surface drawn by an operation.
+ * \param src_surface The surface drawn.
+ * \param region The subrectangle drawn in the source surface.
+ * \param dst_position Coordinates on the tracked surface.
+ * \return The rectangle modified, clipped to the tracked surface.
+ */
+Rectangle DamageTracker::get_dst_rect(
+    const Surface& src_surface,
+    const Rectangle& region,
+    const Point& dst_position) const {
+
+  // Like blitting, clip the region to the source first.
+  const Rectangle src_rect = region & Rectangle(src_surface.get_size());
+  Rectangle dst_rect(
+      dst_position + (src_rect.get_xy() - region.get_xy()),
+      src_rect.get_size()
+  );
+  return dst_rect & Rectangle(surface.get_size());
+}
+
+/**
+ * \brief If the surface was only redrawn by this tracker between two content
+ * versions, returns the damaged rectangles.
+ * \param[in] old_version A previous content version of the surface.
+ * \param[in] new_version The current content version of the surface.
+ * \param[out] damage The rectangles that changed between both versions.
+ * \return \c true in case of success, \c false if unknown, in which case the
+ * whole surface should be considered damaged.
+ */
+bool DamageTracker::get_damage_since(
+    uint64_t old_version,
+    uint64_t new_version,
+    std::vector<Rectangle>& damage) const {
+
+  if (old_version == new_version) {
+    damage.clear();
+    return true;
+  }
+
+  if (old_version != damage_old_version ||
+      new_version != damage_new_version) {
+    return false;
+  }
+
+  damage = this->damage;
+  return true;
+}
+
+/**
+ * \brief Returns the rectangles that changed since the surface was last
+ * rendered.
+ * \param[out] damage The rectangles changed.
+ * \return \c true in case of success, \c false if the whole surface has to be
+ * rendered again.
+ */
+bool DamageTracker::get_render_damage(std::vector<Rectangle>& damage) const {
+
+  if (render_damage_full) {
+    return false;
+  }
+
+  damage = render_damage;
+  return true;
+}
+
+/**
+ * \brief Notifies the tracker that the surface was just rendered.
+ */
+void DamageTracker::clear_render_damage() {
+
+  render_damage.clear();
+  render_damage_full = false;
+}
+
+/**
+ * \brief Compares the operations of the frame to the previous ones and
+ * determines the damaged rectangles.
+ */
+void DamageTracker::compute_damage() {
+
+  damage.clear();
+
+  if (!previous_valid) {
+    add_damage(Rectangle(surface.get_size()));
+    return;
+  }
+
+  // Index previous operations by key, in their order.
+  std::unordered_map<OperationKey, std::vector<size_t>, OperationKeyHash> previous_indexes;
+  previous_indexes.reserve(previous_operations.size());
+  for (size_t i = 0; i < previous_operations.size(); ++i) {
+    previous_indexes[previous_operations[i].key].push_back(i);
+  }
+  std::unordered_map<OperationKey, size_t, OperationKeyHash> num_matched;
+  std::vector<bool> matched(previous_operations.size(), false);
+
+  std::vector<Rectangle> src_damage;
+  size_t last_index = 0;
+  bool first_match = true;
+  for (const Operation& operation : operations) {
+
+    const auto it = previous_indexes.find(operation.key);
+    size_t& num_used = num_matched[operation.key];
+    if (it == previous_indexes.end() || num_used >= it->second.size()) {
+      // New operation.
+      add_damage(operation.dst_rect);
+      continue;
+    }
+
+    const size_t index = it->second[num_used];
+    ++num_used;
+    matched[index] = true;
+
+    if (!first_match && index < last_index) {
+      // The operation is now drawn in a different order.
+      add_damage(operation.dst_rect);
+      continue;
+    }
+    first_match = false;
+    last_index = index;
+
+    const Operation& previous_operation = previous_operations[index];
+    if (operation.src_version == previous_operation.src_version) {
+      // Unchanged.
+      continue;
+    }
+
+    // The source has changed: see if it knows where.
+    const DamageTracker* src_tracker = operation.src_surface->damage_tracker.get();
+    if (src_tracker == nullptr ||
+        !src_tracker->get_damage_since(previous_operation.src_version, operation.src_version, src_damage)) {
+      add_damage(operation.dst_rect);
+      continue;
+    }
+
+    const Rectangle& region = operation.key.region;
+    for (Rectangle rectangle : src_damage) {
+      rectangle &= region;
+      rectangle.add_xy(operation.key.dst_position - region.get_xy());
+      add_damage(rectangle & operation.dst_rect);
+    }
+  }
+
+  // Operations that disappeared.
+  for (size_t i = 0; i < previous_operations.size(); ++i) {
+    if (!matched[i]) {
+      add_damage(previous_operations[i].dst_rect);
+    }
+  }
+
+  merge_damage();
+}
+
+/**
+ * \brief Adds a rectangle to the damage of the current frame.
+ * \param rectangle The damaged rectangle.
+ */
+void DamageTracker::add_damage(const Rectangle& rectangle) {
+
+  const Rectangle clipped_rectangle = rectangle & Rectangle(surface.get_size());
+  if (!clipped_rectangle.is_flat()) {
+    damage.push_back(clipped_rectangle);
+  }
+}
+
+/**
+ * \brief Unites overlapping damaged rectangles.
+ *
+ * When there are too many rectangles or when they cover most of the
+ * surface, the damage is simplified.
+ */
+void DamageTracker::merge_damage() {
+
+  if (damage.size() > max_damage_rectangles) {
+    Rectangle union_rectangle = damage.front();
+    for (const Rectangle& rectangle : damage) {
+      union_rectangle |= rectangle;
+    }
+    damage.assign(1, union_rectangle);
+    return;
+  }
+
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < damage.size() && !merged; ++i) {
+      for (size_t j = i + 1; j < damage.size(); ++j) {
+        if (damage[i].overlaps(damage[j])) {
+          damage[i] |= damage[j];
+          damage.erase(damage.begin() + j);
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Redrawing most of the surface in one pass is cheaper.
+  uint64_t total_area = 0;
+  for (const Rectangle& rectangle : damage) {
+    total_area += get_area(rectangle);
+  }
+  const Rectangle whole_surface(surface.get_size());
+  if (total_area * 4 >= get_area(whole_surface) * 3) {
+    damage.assign(1, whole_surface);
+  }
+}
+
+/**
+ * \brief Replays the operations of the frame restricted to a rectangle.
+ * \param clip_rect The rectangle to redraw.
+ */
+void DamageTracker::replay(const Rectangle& clip_rect) {
+
+  SDL_Surface* internal_surface = surface.internal_surface.get();
+  SDL_SetClipRect(internal_surface, clip_rect.get_internal_rect());
+
+  if (clear_first) {
+    SDL_FillRect(
+        internal_surface,
+        clip_rect.get_internal_rect(),
+        surface.get_color_value(Color::transparent)
+    );
+  }
+
+  for (const Operation& operation : operations) {
+    if (operation.dst_rect.overlaps(clip_rect)) {
+      operation.src_surface->raw_draw_region(
+          operation.key.region,
+          surface,
+          operation.key.dst_position
+      );
+    }
+  }
+
+  SDL_SetClipRect(internal_surface, nullptr);
+}
+
+}
+
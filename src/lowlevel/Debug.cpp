@@ -28,6 +28,7 @@ namespace {
   bool die_on_error = false;
   bool show_popup_on_die = true;
   bool abort_on_die = false;
+  thread_local std::vector<std::string>* error_collector = nullptr;
 
 }
 
@@ -62,6 +63,22 @@ SOLARUS_API void set_abort_on_die(bool abort) {
   abort_on_die = abort;
 }
 
+/**
+ * \brief Sets where errors of the current thread should be collected.
+ *
+ * While a collector is set, Debug::error() only appends the message to it,
+ * and Debug::die() appends the message and throws a SolarusFatal exception
+ * without showing anything.
+ * This allows background threads to report their errors later
+ * from the main thread.
+ *
+ * \param collector Where to put error messages of the current thread,
+ * or nullptr to report them immediately again.
+ */
+SOLARUS_API void set_error_collector(std::vector<std::string>* collector) {
+  error_collector = collector;
+}
+
 /**
  * \brief Prints "Warning: " and a message on both stdout and error.txt.
  * \param message The warning message to print.
@@ -81,6 +98,12 @@ SOLARUS_API void warning(const std::string& message) {
  */
 SOLARUS_API void error(const std::string& message) {
 
+  if (error_collector != nullptr) {
+    // Reported later by another thread.
+    error_collector->push_back(message);
+    return;
+  }
+
   if (die_on_error) {
     // Errors are fatal.
     die(message);
@@ -124,6 +147,11 @@ void SOLARUS_API check_assertion(bool assertion, const std::string& error_messag
  */
 void SOLARUS_API die(const std::string& error_message) {
 
+  if (error_collector != nullptr) {
+    error_collector->push_back(error_message);
+    throw SolarusFatal(error_message);
+  }
+
   Logger::fatal(error_message);
 
   if (show_popup_on_die) {
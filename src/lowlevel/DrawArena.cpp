@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/DrawArena.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Surface.h"
+#include <utility>
+#include <vector>
+
+namespace Solarus {
+
+namespace {
+
+  std::vector<DrawArena::Record> records;   /**< Records of the current frame. */
+  uint64_t generation = 1;                  /**< Incremented when a new frame starts. */
+  bool frame_finished = false;              /**< Whether the next record starts a new frame. */
+  int num_allocations = 0;                  /**< Number of times the storage had to grow. */
+
+  /**
+   * \brief Appends a record to a list.
+   *
+   * Starts a new frame first if the previous one was rendered.
+   *
+   * \param list The list to append to.
+   * \param record The record to add.
+   */
+  void append(DrawArena::List& list, DrawArena::Record&& record) {
+
+    if (frame_finished) {
+      // Release the records of the previous frame but keep the memory.
+      records.clear();
+      ++generation;
+      frame_finished = false;
+    }
+
+    if (list.generation != generation) {
+      // The list was filled during a previous frame.
+      DrawArena::clear(list);
+      list.generation = generation;
+    }
+
+    if (records.size() == records.capacity()) {
+      ++num_allocations;
+      Profiler::add_counter(Profiler::Counter::DRAW_ARENA_ALLOCATIONS, 1);
+    }
+    Profiler::add_counter(Profiler::Counter::DRAW_RECORDS, 1);
+
+    const int index = static_cast<int>(records.size());
+    record.next = -1;
+    records.emplace_back(std::move(record));
+
+    if (list.last != -1) {
+      records[list.last].next = index;
+    }
+    else {
+      list.first = index;
+    }
+    list.last = index;
+    ++list.size;
+  }
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Releases all records and their memory.
+ *
+ * Lists previously filled become empty.
+ * This must be called before the renderer is destroyed because records
+ * keep their surfaces alive.
+ */
+void DrawArena::quit() {
+
+  records.clear();
+  records.shrink_to_fit();
+  ++generation;
+  frame_finished = false;
+  num_allocations = 0;
+}
+
+/**
+ * \brief Records that a surface is drawn onto another one.
+ * \param list The list of the destination surface.
+ * \param src_surface The surface to draw.
+ * \param src_children The list of the surface to draw.
+ * Its current records are drawn too, even if it changes later.
+ * \param region Region of the surface to draw.
+ * \param dst_position Where to draw, relative to the destination surface.
+ */
+void DrawArena::add(
+    List& list,
+    const SurfacePtr& src_surface,
+    const List& src_children,
+    const Rectangle& region,
+    const Point& dst_position) {
+
+  Record record;
+  record.src_surface = src_surface;
+  record.src_rect = region;
+  record.dst_rect = Rectangle(dst_position);
+  if (!is_empty(src_children)) {
+    record.children = src_children;
+  }
+
+  // Clip the source rectangle to the size of the source surface.
+  // Otherwise, SDL_RenderCopy() will stretch the image.
+  // FIXME still buggy with software renderer for now but should be fixed soon :
+  // https://bugzilla.libsdl.org/show_bug.cgi?id=1968
+  Rectangle& src_rect = record.src_rect;
+  if (src_rect.get_x() < 0) {
+    src_rect.set_x(0);
+    src_rect.set_width(src_rect.get_width() + region.get_x());
+    record.dst_rect.add_x(-region.get_x());
+  }
+  if (src_rect.get_x() + src_rect.get_width() > src_surface->get_width()) {
+    src_rect.set_width(src_surface->get_width() - src_rect.get_x());
+  }
+  if (src_rect.get_y() < 0) {
+    src_rect.set_y(0);
+    src_rect.set_height(src_rect.get_height() + region.get_y());
+    record.dst_rect.add_y(-region.get_y());
+  }
+  if (src_rect.get_y() + src_rect.get_height() > src_surface->get_height()) {
+    src_rect.set_height(src_surface->get_height() - src_rect.get_y());
+  }
+
+  append(list, std::move(record));
+}
+
+/**
+ * \brief Records that a rectangle is filled with a color.
+ * \param list The list of the destination surface.
+ * \param color The color to fill.
+ * \param where The rectangle to fill, relative to the destination surface.
+ */
+void DrawArena::add_fill(List& list, const Color& color, const Rectangle& where) {
+
+  Record record;
+  record.color = color;
+  record.src_rect = Rectangle(where.get_size());
+  record.dst_rect = where;
+
+  append(list, std::move(record));
+}
+
+/**
+ * \brief Empties a list.
+ *
+ * Records are not released until the next frame: other lists may
+ * still use them.
+ *
+ * \param list The list to clear.
+ */
+void DrawArena::clear(List& list) {
+
+  list.first = -1;
+  list.last = -1;
+  list.size = 0;
+}
+
+/**
+ * \brief Returns whether a list has no record in the current frame.
+ * \param list A list.
+ * \return \c true if there is nothing to draw.
+ */
+bool DrawArena::is_empty(const List& list) {
+
+  return list.size == 0 || list.generation != generation;
+}
+
+/**
+ * \brief Returns a record of the current frame.
+ * \param index Index of the record.
+ * \return The record.
+ */
+const DrawArena::Record& DrawArena::get_record(int index) {
+
+  SOLARUS_ASSERT(index >= 0 && index < static_cast<int>(records.size()),
+      "Invalid draw record index");
+  return records[index];
+}
+
+/**
+ * \brief Notifies the arena that the current frame was rendered.
+ *
+ * Records stay valid so that the same frame can be rendered again, until
+ * something new is drawn: all lists are then emptied at once.
+ */
+void DrawArena::finish_frame() {
+
+  frame_finished = true;
+}
+
+/**
+ * \brief Returns the number of records of the current frame.
+ * \return The number of records.
+ */
+int DrawArena::get_num_records() {
+
+  return static_cast<int>(records.size());
+}
+
+/**
+ * \brief Returns how many times the memory of the arena had to grow.
+ *
+ * Once the arena is large enough for a frame, this no longer changes.
+ *
+ * \return The number of allocations.
+ */
+int DrawArena::get_num_allocations() {
+
+  return num_allocations;
+}
+
+}
+
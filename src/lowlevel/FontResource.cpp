@@ -17,14 +17,54 @@
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/QuestFiles.h"
 #include "solarus/lowlevel/FontResource.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Size.h"
 #include "solarus/lowlevel/Surface.h"
+#include "solarus/lowlevel/Video.h"
 #include "solarus/CurrentQuest.h"
+#include "solarus/ResourceCache.h"
+#include <algorithm>
 #include <utility>
 
 namespace Solarus {
 
+namespace {
+
+  constexpr int glyph_atlas_width = 512;      /**< Initial width of glyph atlases. */
+  constexpr int glyph_atlas_num_rows = 4;     /**< Initial number of rows of glyph atlases. */
+
+  /**
+   * \brief Creates a transparent image in the video pixel format.
+   * \param width Width of the image.
+   * \param height Height of the image.
+   * \return The image.
+   */
+  SDL_Surface* create_atlas_surface(int width, int height) {
+
+    SDL_PixelFormat* format = Video::get_pixel_format();
+    SDL_Surface* surface = SDL_CreateRGBSurface(
+        0,
+        width,
+        height,
+        32,
+        format->Rmask,
+        format->Gmask,
+        format->Bmask,
+        format->Amask
+    );
+    Debug::check_assertion(surface != nullptr,
+        std::string("Failed to create glyph atlas: ") + SDL_GetError());
+
+    // Glyphs are copied as they are, both into and from the atlas.
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    return surface;
+  }
+
+}  // Anonymous namespace.
+
 bool FontResource::fonts_loaded = false;
-std::map<std::string, FontResource::FontFile> FontResource::fonts;
+bool FontResource::glyph_cache_enabled = false;
+std::map<std::string, std::shared_ptr<FontResource::FontFile>> FontResource::fonts;
 
 /**
  * \brief Initializes the font system.
@@ -40,12 +80,16 @@ void FontResource::initialize() {
 void FontResource::quit() {
 
   fonts.clear();
+  ResourceCache::clear(ResourceType::FONT);
   fonts_loaded = false;
   TTF_Quit();
 }
 
 /**
  * \brief Loads the fonts declared in the quest resource list.
+ *
+ * Fonts are few and small, so they are all kept in memory.
+ * They are pinned in the resource cache, only to count their memory.
  */
 void FontResource::load_fonts() {
 
@@ -57,37 +101,37 @@ void FontResource::load_fonts() {
 
     const std::string& font_id = kvp.first;
 
-    FontFile font;
+    std::shared_ptr<FontFile> font = std::make_shared<FontFile>();
 
     // Load the font.
 
     bool bitmap_font = false;
     const std::string file_name_start = std::string("fonts/") + font_id;
     if (QuestFiles::data_file_exists(file_name_start + ".png")) {
-      font.file_name = file_name_start + ".png";
+      font->file_name = file_name_start + ".png";
       bitmap_font = true;
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".PNG")) {
-      font.file_name = file_name_start + ".PNG";
+      font->file_name = file_name_start + ".PNG";
       bitmap_font = true;
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".ttf")) {
-      font.file_name = file_name_start + ".ttf";
+      font->file_name = file_name_start + ".ttf";
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".TTF")) {
-      font.file_name = file_name_start + ".TTF";
+      font->file_name = file_name_start + ".TTF";
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".ttc")) {
-      font.file_name = file_name_start + ".ttc";
+      font->file_name = file_name_start + ".ttc";
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".TTC")) {
-      font.file_name = file_name_start + ".TTC";
+      font->file_name = file_name_start + ".TTC";
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".fon")) {
-      font.file_name = file_name_start + ".fon";
+      font->file_name = file_name_start + ".fon";
     }
     else if (QuestFiles::data_file_exists(file_name_start + ".FON")) {
-      font.file_name = file_name_start + ".FON";
+      font->file_name = file_name_start + ".FON";
     }
     else {
       Debug::error(std::string("Cannot find font file 'fonts/")
@@ -98,15 +142,21 @@ void FontResource::load_fonts() {
 
     if (bitmap_font) {
       // It's a bitmap font.
-      font.bitmap_font = Surface::create(font.file_name, Surface::DIR_DATA);
+      font->bitmap_font = Surface::create(font->file_name, Surface::DIR_DATA);
     }
 
     else {
       // It's an outline font.
-      font.buffer = QuestFiles::data_file_read(font.file_name);
-      font.bitmap_font = nullptr;
+      font->buffer = QuestFiles::data_file_read(font->file_name);
+      font->bitmap_font = nullptr;
     }
 
+    size_t memory_size = font->buffer.size();
+    if (font->bitmap_font != nullptr) {
+      memory_size += font->bitmap_font->get_width() * font->bitmap_font->get_height() * sizeof(uint32_t);
+    }
+    ResourceCache::add(ResourceType::FONT, font_id, font, memory_size);
+    ResourceCache::set_pinned(ResourceType::FONT, font_id, true);
     fonts.emplace(font_id, std::move(font));
   }
 
@@ -159,7 +209,7 @@ bool FontResource::is_bitmap_font(const std::string& font_id) {
 
   const auto& kvp = fonts.find(font_id);
   Debug::check_assertion(kvp != fonts.end(), std::string("No such font: '") + font_id + "'");
-  return kvp->second.bitmap_font != nullptr;
+  return kvp->second->bitmap_font != nullptr;
 }
 
 /**
@@ -175,8 +225,8 @@ SurfacePtr FontResource::get_bitmap_font(const std::string& font_id) {
 
   const auto& kvp = fonts.find(font_id);
   Debug::check_assertion(kvp != fonts.end(), std::string("No such font: '") + font_id + "'");
-  Debug::check_assertion(kvp->second.bitmap_font != nullptr, std::string("This is not a bitmap font: '") + font_id + "'");
-  return kvp->second.bitmap_font;
+  Debug::check_assertion(kvp->second->bitmap_font != nullptr, std::string("This is not a bitmap font: '") + font_id + "'");
+  return kvp->second->bitmap_font;
 }
 
 /**
@@ -193,10 +243,10 @@ TTF_Font& FontResource::get_outline_font(const std::string& font_id, int size) {
 
   const auto& kvp = fonts.find(font_id);
   Debug::check_assertion(kvp != fonts.end(), std::string("No such font: '") + font_id + "'");
-  FontFile& font = kvp->second;
+  FontFile& font = *kvp->second;
   Debug::check_assertion(font.bitmap_font == nullptr, std::string("This is not an outline font: '") + font_id + "'");
 
-  std::map<int, OutlineFontReader>& outline_fonts = kvp->second.outline_fonts;
+  std::map<int, OutlineFontReader>& outline_fonts = kvp->second->outline_fonts;
 
   const auto& kvp2 = outline_fonts.find(size);
   if (kvp2 != outline_fonts.end()) {
@@ -218,5 +268,201 @@ TTF_Font& FontResource::get_outline_font(const std::string& font_id, int size) {
   return *outline_fonts.at(size).outline_font;
 }
 
+/**
+ * \brief Returns whether texts with outline fonts are made of cached glyphs.
+ * \return \c true if the glyph cache is enabled.
+ */
+bool FontResource::is_glyph_cache_enabled() {
+  return glyph_cache_enabled;
+}
+
+/**
+ * \brief Sets whether texts with outline fonts are made of cached glyphs.
+ *
+ * When enabled, each character is rendered once and texts are assembled
+ * from the rendered glyphs. Texts that only grow at the end, like dialogs
+ * revealed letter by letter, only draw their new characters.
+ * Overlapping characters of some fonts may look slightly different.
+ *
+ * This is disabled by default.
+ *
+ * \param glyph_cache_enabled \c true to enable the glyph cache.
+ */
+void FontResource::set_glyph_cache_enabled(bool glyph_cache_enabled) {
+  FontResource::glyph_cache_enabled = glyph_cache_enabled;
+}
+
+/**
+ * \brief Returns the glyphs of an outline font rendered with the specified
+ * properties.
+ * \param font_id Id of the outline font to get. It must exist.
+ * \param size Size to use.
+ * \param rendering_mode Rendering mode to use.
+ * \return The glyph atlas.
+ */
+FontResource::GlyphAtlas& FontResource::get_glyph_atlas(
+    const std::string& font_id,
+    int size,
+    TextSurface::RenderingMode rendering_mode
+) {
+
+  TTF_Font& outline_font = get_outline_font(font_id, size);
+  FontFile& font = *fonts.at(font_id);
+
+  const auto key = std::make_pair(size, rendering_mode);
+
+  std::unique_ptr<GlyphAtlas>& atlas = font.glyph_atlases[key];
+  if (atlas == nullptr) {
+    atlas = std::unique_ptr<GlyphAtlas>(new GlyphAtlas(outline_font, rendering_mode));
+  }
+  return *atlas;
+}
+
+/**
+ * \brief Creates an empty glyph atlas.
+ * \param font The font in the wanted size.
+ * \param rendering_mode How to render glyphs.
+ */
+FontResource::GlyphAtlas::GlyphAtlas(
+    TTF_Font& font,
+    TextSurface::RenderingMode rendering_mode):
+  font(font),
+  rendering_mode(rendering_mode),
+  line_height(std::max(1, TTF_FontHeight(&font))),
+  surface(create_atlas_surface(glyph_atlas_width, line_height * glyph_atlas_num_rows)),
+  next_position(),
+  glyphs() {
+
 }
 
+/**
+ * \brief Returns the image where glyphs are rendered.
+ *
+ * The image may change when new glyphs are added.
+ *
+ * \return The atlas image.
+ */
+SDL_Surface* FontResource::GlyphAtlas::get_surface() const {
+  return surface.get();
+}
+
+/**
+ * \brief Returns the height of all glyphs.
+ * \return The height of a line of text.
+ */
+int FontResource::GlyphAtlas::get_line_height() const {
+  return line_height;
+}
+
+/**
+ * \brief Returns a glyph, rendering it if this is the first time.
+ * \param code_point The character to get.
+ * \return The glyph. It remains valid as long as the atlas exists.
+ */
+const FontResource::Glyph& FontResource::GlyphAtlas::get_glyph(uint16_t code_point) {
+
+  const auto& it = glyphs.find(code_point);
+  if (it != glyphs.end()) {
+    Profiler::add_counter(Profiler::Counter::GLYPH_CACHE_HITS, 1);
+    return it->second;
+  }
+
+  Profiler::add_counter(Profiler::Counter::GLYPH_CACHE_MISSES, 1);
+  Glyph& glyph = glyphs[code_point];
+  add_glyph(code_point, glyph);
+  return glyph;
+}
+
+/**
+ * \brief Returns the kerning offset between two characters.
+ * \param previous_code_point The previous character.
+ * \param code_point The character that follows it.
+ * \return The horizontal offset to add before the second character.
+ */
+int FontResource::GlyphAtlas::get_kerning(
+    uint16_t previous_code_point, uint16_t code_point) const {
+
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) >= SDL_VERSIONNUM(2, 0, 14)
+  if (TTF_GetFontKerning(&font)) {
+    return TTF_GetFontKerningSizeGlyphs(&font, previous_code_point, code_point);
+  }
+#else
+  (void) previous_code_point;
+  (void) code_point;
+#endif
+  return 0;
+}
+
+/**
+ * \brief Renders a glyph into the atlas.
+ * \param[in] code_point The character to render.
+ * \param[out] glyph Where the glyph was placed.
+ */
+void FontResource::GlyphAtlas::add_glyph(uint16_t code_point, Glyph& glyph) {
+
+  glyph.rect = Rectangle();
+  glyph.bearing = 0;
+  glyph.advance = 0;
+
+  int min_x, max_x, min_y, max_y, advance;
+  if (TTF_GlyphMetrics(&font, code_point, &min_x, &max_x, &min_y, &max_y, &advance) == 0) {
+    // The rendered glyph starts at its left bearing, not at the pen position.
+    glyph.bearing = min_x;
+    glyph.advance = advance;
+  }
+
+  // Texts modulate the white glyphs with their color.
+  const SDL_Color white = { 255, 255, 255, 255 };
+  SDL_Surface* rendered_surface = nullptr;
+  switch (rendering_mode) {
+
+  case TextSurface::RenderingMode::SOLID:
+    rendered_surface = TTF_RenderGlyph_Solid(&font, code_point, white);
+    break;
+
+  case TextSurface::RenderingMode::ANTIALIASING:
+    rendered_surface = TTF_RenderGlyph_Blended(&font, code_point, white);
+    break;
+  }
+
+  if (rendered_surface == nullptr) {
+    // Some fonts fail to render whitespaces.
+    return;
+  }
+  SDL_Surface_UniquePtr rendered(rendered_surface);
+  const Size size(rendered->w, rendered->h);
+
+  // Find some room in the current row or in a new one.
+  line_height = std::max(line_height, size.height);
+  if (next_position.x + size.width > surface->w) {
+    next_position.x = 0;
+    next_position.y += line_height;
+  }
+  if (size.width > surface->w ||
+      next_position.y + size.height > surface->h) {
+    grow(size.width, next_position.y + size.height);
+  }
+
+  // Copy the pixels as they are.
+  glyph.rect = Rectangle(next_position, size);
+  SDL_SetSurfaceBlendMode(rendered.get(), SDL_BLENDMODE_NONE);
+  SDL_BlitSurface(rendered.get(), nullptr, surface.get(), glyph.rect.get_internal_rect());
+  next_position.x += size.width;
+}
+
+/**
+ * \brief Makes the atlas image bigger, keeping its glyphs.
+ * \param min_width Minimum width of the new image.
+ * \param min_height Minimum height of the new image.
+ */
+void FontResource::GlyphAtlas::grow(int min_width, int min_height) {
+
+  SDL_Surface_UniquePtr new_surface(create_atlas_surface(
+      std::max(surface->w, min_width),
+      std::max(surface->h * 2, min_height)
+  ));
+  SDL_BlitSurface(surface.get(), nullptr, new_surface.get(), nullptr);
+  surface = std::move(new_surface);
+}
+
+}
@@ -35,18 +35,32 @@ int Hq2xFilter::get_scaling_factor() const {
 }
 
 /**
- * \copydoc PixelFilter::filter
+ * \copydoc PixelFilter::prepare
  */
-void Hq2xFilter::filter(
-    const uint32_t* src,
-    int src_width,
-    int src_height,
-    uint32_t* dst) const {
+void Hq2xFilter::prepare() const {
 
   // Make sure hqx is initialized.
   Hq4xFilter::initialize_hqx();
+}
+
+/**
+ * \copydoc PixelFilter::filter_rows
+ */
+void Hq2xFilter::filter_rows(
+    const uint32_t* src,
+    int src_width,
+    int src_height,
+    uint32_t* dst,
+    int first_row,
+    int last_row) const {
 
-  hq2x_32(const_cast<uint32_t*>(src), dst, src_width, src_height);
+  const uint32_t src_row_bytes = src_width * 4;
+  hq2x_32_rb_rows(
+      const_cast<uint32_t*>(src), src_row_bytes,
+      dst, src_row_bytes * 2,
+      src_width, src_height,
+      first_row, last_row
+  );
 }
 
 }
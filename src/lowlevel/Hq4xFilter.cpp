@@ -38,18 +38,32 @@ int Hq4xFilter::get_scaling_factor() const {
 }
 
 /**
- * \copydoc PixelFilter::filter
+ * \copydoc PixelFilter::prepare
  */
-void Hq4xFilter::filter(
+void Hq4xFilter::prepare() const {
+
+  // Make sure hqx is initialized before rows are filtered in parallel.
+  initialize_hqx();
+}
+
+/**
+ * \copydoc PixelFilter::filter_rows
+ */
+void Hq4xFilter::filter_rows(
     const uint32_t* src,
     int src_width,
     int src_height,
-    uint32_t* dst) const {
-
-  // Make sure hqx is initialized.
-  initialize_hqx();
+    uint32_t* dst,
+    int first_row,
+    int last_row) const {
 
-  hq4x_32(const_cast<uint32_t*>(src), dst, src_width, src_height);
+  const uint32_t src_row_bytes = src_width * 4;
+  hq4x_32_rb_rows(
+      const_cast<uint32_t*>(src), src_row_bytes,
+      dst, src_row_bytes * 4,
+      src_width, src_height,
+      first_row, last_row
+  );
 }
 
 /**
@@ -19,6 +19,7 @@
 #include "solarus/lowlevel/QuestFiles.h"
 #include <al.h>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace Solarus {
@@ -31,17 +32,19 @@ OggDecoder::OggDecoder():
   ogg_mem(),
   ogg_info(nullptr),
   loop_start_pcm(-1),
-  loop_end_pcm(-1) {
+  loop_end_pcm(-1),
+  stereo_output(false) {
 
 }
 
 /**
  * \brief Loads an OGG file from the memory.
  * \param ogg_data The memory area to read.
+ * It is shared, not copied: several decoders can read the same data.
  * \param loop Whether the music should loop if reaching the end.
  * \return \c true in case of success.
  */
-bool OggDecoder::load(std::string&& ogg_data, bool loop) {
+bool OggDecoder::load(const std::shared_ptr<const std::string>& ogg_data, bool loop) {
 
   ogg_file = OggFileUniquePtr(new OggVorbis_File());
 
@@ -103,22 +106,33 @@ bool OggDecoder::load(std::string&& ogg_data, bool loop) {
  */
 void OggDecoder::unload() {
   ogg_file = nullptr;
-  ogg_mem.data.clear();
+  ogg_mem.data = nullptr;
   ogg_info = nullptr;
   loop_start_pcm = -1;
   loop_end_pcm = -1;
 }
 
+/**
+ * \brief Sets whether mono data is converted to stereo when decoded.
+ * \param stereo_output \c true to fill buffers with stereo data
+ * even if the OGG data is mono.
+ */
+void OggDecoder::set_stereo_output(bool stereo_output) {
+  this->stereo_output = stereo_output;
+}
+
 /**
  * \brief Decodes a chunk of the previously loaded OGG data into PCM data
  * and plays it.
  * \param decoded_data Pointer to where you want the decoded data to be written.
  * \param nb_samples Number of samples to write.
+ * \return Number of bytes written to the buffer.
+ * 0 means that the end of the data is reached.
  */
-void OggDecoder::decode(ALuint destination_buffer, ALsizei nb_samples) {
+ALsizei OggDecoder::decode(ALuint destination_buffer, ALsizei nb_samples) {
 
   if (ogg_info == nullptr) {
-    return;
+    return 0;
   }
 
   // Read the encoded music properties.
@@ -167,7 +181,7 @@ void OggDecoder::decode(ALuint destination_buffer, ALsizei nb_samples) {
         std::ostringstream oss;
         oss << "Error while decoding ogg chunk: " << bytes_read;
         Debug::error(oss.str());
-        return;
+        return 0;
       }
     }
     else {
@@ -192,14 +206,28 @@ void OggDecoder::decode(ALuint destination_buffer, ALsizei nb_samples) {
   while (remaining_bytes > 0 && bytes_read > 0);
 
   // Put this decoded data into the buffer.
-  alBufferData(destination_buffer, al_format, raw_data.data(), ALsizei(total_bytes_read), sample_rate);
+  if (num_channels == 1 && stereo_output) {
+    const size_t nb_decoded_samples = size_t(total_bytes_read) / sizeof(ALshort);
+    std::vector<ALshort> stereo_data(nb_decoded_samples * 2);
+    for (size_t i = 0; i < nb_decoded_samples; ++i) {
+      stereo_data[2 * i] = raw_data[i];
+      stereo_data[2 * i + 1] = raw_data[i];
+    }
+    alBufferData(destination_buffer, AL_FORMAT_STEREO16, stereo_data.data(), ALsizei(stereo_data.size() * sizeof(ALshort)), sample_rate);
+  }
+  else {
+    alBufferData(destination_buffer, al_format, raw_data.data(), ALsizei(total_bytes_read), sample_rate);
+  }
 
   int error = alGetError();
   if (error != AL_NO_ERROR) {
     std::ostringstream oss;
     oss << "Failed to fill the audio buffer with decoded OGG data: error " << error;
     Debug::error(oss.str());
+    return 0;
   }
+
+  return ALsizei(total_bytes_read);
 }
 
 }
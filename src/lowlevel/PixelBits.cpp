@@ -23,8 +23,111 @@
 #include <algorithm>
 #include <iostream> // print functions
 
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define SOLARUS_PIXEL_BITS_SSE2
+#  include <emmintrin.h>
+#endif
+
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Tests the rows of a column of 64 pixels of the intersection
+ * of two images.
+ *
+ * Each row of an image is read from two consecutive columns of words:
+ * the 64 bits starting at a given bit offset in the first column.
+ *
+ * \param a_words First column of words of image a, starting at the first
+ * row of the intersection.
+ * \param a_next_words Next column of words of image a.
+ * \param a_shift Bit offset of the intersection in the first column of a.
+ * \param b_words First column of words of image b.
+ * \param b_next_words Next column of words of image b.
+ * \param b_shift Bit offset of the intersection in the first column of b.
+ * \param mask Bits of the column that are in the intersection.
+ * \param nb_rows Number of rows of the intersection.
+ * \return \c true if an opaque pixel of a overlaps an opaque pixel of b.
+ */
+bool test_column_collision(
+    const uint64_t* a_words,
+    const uint64_t* a_next_words,
+    int a_shift,
+    const uint64_t* b_words,
+    const uint64_t* b_next_words,
+    int b_shift,
+    uint64_t mask,
+    int nb_rows
+) {
+  int row = 0;
+
+#if defined(__AVX2__)
+  // Four rows per instruction.
+  const __m128i a_left_count = _mm_cvtsi32_si128(a_shift);
+  const __m128i a_right_count = _mm_cvtsi32_si128(64 - a_shift);  // 64 gives 0.
+  const __m128i b_left_count = _mm_cvtsi32_si128(b_shift);
+  const __m128i b_right_count = _mm_cvtsi32_si128(64 - b_shift);
+  const __m256i mask_4 = _mm256_set1_epi64x(static_cast<long long>(mask));
+  for (; row + 4 <= nb_rows; row += 4) {
+    const __m256i a = _mm256_or_si256(
+        _mm256_sll_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_words + row)), a_left_count),
+        _mm256_srl_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_next_words + row)), a_right_count)
+    );
+    const __m256i b = _mm256_or_si256(
+        _mm256_sll_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_words + row)), b_left_count),
+        _mm256_srl_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_next_words + row)), b_right_count)
+    );
+    if (!_mm256_testz_si256(_mm256_and_si256(a, b), mask_4)) {
+      return true;
+    }
+  }
+#elif defined(SOLARUS_PIXEL_BITS_SSE2)
+  // Two rows per instruction.
+  const __m128i a_left_count = _mm_cvtsi32_si128(a_shift);
+  const __m128i a_right_count = _mm_cvtsi32_si128(64 - a_shift);  // 64 gives 0.
+  const __m128i b_left_count = _mm_cvtsi32_si128(b_shift);
+  const __m128i b_right_count = _mm_cvtsi32_si128(64 - b_shift);
+  const __m128i mask_2 = _mm_set1_epi64x(static_cast<long long>(mask));
+  const __m128i zero = _mm_setzero_si128();
+  for (; row + 2 <= nb_rows; row += 2) {
+    const __m128i a = _mm_or_si128(
+        _mm_sll_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_words + row)), a_left_count),
+        _mm_srl_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_next_words + row)), a_right_count)
+    );
+    const __m128i b = _mm_or_si128(
+        _mm_sll_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b_words + row)), b_left_count),
+        _mm_srl_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b_next_words + row)), b_right_count)
+    );
+    const __m128i overlap = _mm_and_si128(_mm_and_si128(a, b), mask_2);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(overlap, zero)) != 0xFFFF) {
+      return true;
+    }
+  }
+#endif
+
+  // Remaining rows, or all of them without SIMD support.
+  for (; row < nb_rows; ++row) {
+    uint64_t a = a_words[row] << a_shift;
+    if (a_shift != 0) {
+      a |= a_next_words[row] >> (64 - a_shift);
+    }
+    uint64_t b = b_words[row] << b_shift;
+    if (b_shift != 0) {
+      b |= b_next_words[row] >> (64 - b_shift);
+    }
+    if ((a & b & mask) != 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Creates a pixel bits object.
  * \param surface The surface where the image is.
@@ -33,8 +136,9 @@ namespace Solarus {
 PixelBits::PixelBits(const Surface& surface, const Rectangle& image_position):
   width(0),
   height(0),
-  nb_integers_per_row(0),
-  bits() {
+  nb_columns(0),
+  bits(),
+  opaque_box() {
 
   // Create a list of boolean values representing the transparency of each pixel.
   // This list is implemented as bit fields.
@@ -54,38 +158,38 @@ PixelBits::PixelBits(const Surface& surface, const Rectangle& image_position):
   width = clipped_image_position.get_width();
   height = clipped_image_position.get_height();
 
-  nb_integers_per_row = width >> 5; // width / 32
-  if ((width & 31) != 0) { // width % 32 != 0
-    nb_integers_per_row++;
+  nb_columns = width >> 6; // width / 64
+  if ((width & 63) != 0) { // width % 64 != 0
+    nb_columns++;
   }
 
-  int pixel_index = clipped_image_position.get_y() * surface.get_width() + clipped_image_position.get_x();
+  // One more column of zeros so that the next column always exists.
+  bits.assign((nb_columns + 1) * height, 0);
 
-  bits.resize(height);
+  int min_x = width;
+  int min_y = height;
+  int max_x = -1;
+  int max_y = -1;
+  int pixel_index = clipped_image_position.get_y() * surface.get_width() + clipped_image_position.get_x();
   for (int i = 0; i < height; ++i) {
-    bits[i].resize(nb_integers_per_row);
-
-    // Fill the bits for this row, using nb_integers_per_row sequences of 32 bits.
-    int k = -1;
-    uint32_t mask = 0x00000000;  // Current bit in the sequence of 32 bits.
     for (int j = 0; j < width; ++j) {
-      if (mask == 0x00000000) {
-        // Time for a new sequence of 32 bits.
-        k++;
-        mask = 0x80000000;
-        bits[i][k] = 0x00000000;  // Initialize the sequence to transparent.
-      }
 
       // If the pixel is opaque.
       if (!surface.is_pixel_transparent(pixel_index)) {
-        bits[i][k] |= mask;
+        bits[(j >> 6) * height + i] |= UINT64_C(0x8000000000000000) >> (j & 63);
+        min_x = std::min(min_x, j);
+        max_x = std::max(max_x, j);
+        min_y = std::min(min_y, i);
+        max_y = i;
       }
-
-      mask >>= 1;
       ++pixel_index;
     }
     pixel_index += surface.get_width() - width;
   }
+
+  if (max_x != -1) {
+    opaque_box = Rectangle(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+  }
 }
 
 /**
@@ -103,14 +207,16 @@ bool PixelBits::test_collision(
 ) const {
   const bool debug_pixel_collisions = false;
 
-  if (bits.empty()) {
-    // No image.
+  if (opaque_box.is_flat() || other.opaque_box.is_flat()) {
+    // No opaque pixel.
     return false;
   }
 
-  // Compute both bounding boxes.
-  const Rectangle bounding_box1(location1.x, location1.y, width, height);
-  const Rectangle bounding_box2(location2.x, location2.y, other.width, other.height);
+  // Compute both bounding boxes, restricted to opaque pixels.
+  Rectangle bounding_box1(opaque_box);
+  bounding_box1.add_xy(location1);
+  Rectangle bounding_box2(other.opaque_box);
+  bounding_box2.add_xy(location2);
 
   // Check collision between the two bounding boxes.
   if (!bounding_box1.overlaps(bounding_box2)) {
@@ -125,111 +231,42 @@ bool PixelBits::test_collision(
     other.print();
   }
 
-  // Compute the intersection between both rectangles.
-  const int intersection_x = std::max(bounding_box1.get_x(), bounding_box2.get_x());
-  const int intersection_y = std::max(bounding_box1.get_y(), bounding_box2.get_y());
-  const Rectangle intersection(
-      intersection_x,
-      intersection_y,
-      std::min(bounding_box1.get_x() + bounding_box1.get_width(),
-          bounding_box2.get_x() + bounding_box2.get_width()) - intersection_x,
-      std::min(bounding_box1.get_y() + bounding_box1.get_height(),
-          bounding_box2.get_y() + bounding_box2.get_height()) - intersection_y);
+  // Compute the intersection between both rectangles
+  // and its position in each image.
+  const Rectangle intersection = bounding_box1.get_intersection(bounding_box2);
+  const Point offset1 = intersection.get_xy() - location1;
+  const Point offset2 = intersection.get_xy() - location2;
 
   if (debug_pixel_collisions) {
     std::cout << "intersection: " << intersection << "\n";
-  }
-
-  // compute the relative position of the intersection rectangle for each bounding_box
-  Point offset1 = intersection.get_xy() - bounding_box1.get_xy();
-  Point offset2 = intersection.get_xy() - bounding_box2.get_xy();
-
-  if (debug_pixel_collisions) {
     std::cout << "offset1.x = " << offset1.x << ", offset1.y = " << offset1.y;
     std::cout << ", offset2.x = " << offset2.x << ", offset2.y = " << offset2.y << std::endl;
   }
 
-  // For each row of the intersection, we will call row 'a' the row coming from the right bounding box
-  // and row 'b' the one coming from the left bounding box.
-
-  std::vector<std::vector<uint32_t>>::const_iterator rows_a;           // for each row: array of masks of the right bounding box
-  std::vector<std::vector<uint32_t>>::const_iterator rows_b;           // for each row: array of masks of the left bounding box
-
-  int nb_masks_per_row_a;    // number of masks on row a that are in the intersection (row b may have one more mask)
-  int nb_masks_per_row_b;    // number of masks on row b that are in the intersection
-  int nb_unused_masks_row_b; // number of unused masks on row b (i.e. before the intersection)
-  int nb_unused_bits_row_b;  // number of unused bits on the first used mask of row b
-  int nb_used_bits_row_b;    // number of bits used on the first used mask of row b
-
-  // make sure row a starts after row b
-  if (bounding_box1.get_x() > bounding_box2.get_x()) {
-    rows_a = this->bits.begin() + offset1.y;
-    rows_b = other.bits.begin() + offset2.y;
-    nb_unused_masks_row_b = offset2.x >> 5;
-    nb_unused_bits_row_b = offset2.x & 31;
-  }
-  else {
-    rows_a = other.bits.begin() + offset2.y;
-    rows_b = this->bits.begin() + offset1.y;
-    nb_unused_masks_row_b = offset1.x >> 5;
-    nb_unused_bits_row_b = offset1.x & 31;
-  }
-  nb_used_bits_row_b = 32 - nb_unused_bits_row_b;
-
-  // compute the number of masks in the intersection on row a
-  nb_masks_per_row_a = intersection.get_width() >> 5;
-  if ((intersection.get_width() & 31) != 0) {
-    nb_masks_per_row_a++;
-  }
-
-  // compute the number of masks in the intersection on row b
-  nb_masks_per_row_b = (intersection.get_width() + nb_unused_bits_row_b) >> 5;
-  if (((intersection.get_width() + nb_unused_bits_row_b) & 31) != 0) {
-    nb_masks_per_row_b++;
-  }
-
-  // check the collisions each row of the intersection rectangle
-  for (int i = 0; i < intersection.get_height(); ++i) {
-
-    // current row
-    const std::vector<uint32_t>& bits_a = *rows_a;
-    const std::vector<uint32_t>& bits_b = *rows_b;
-
-    ++rows_a;
-    ++rows_b;
-
-    if (debug_pixel_collisions) {
-      std::cout << "*** checking row " << i << " of the intersection rectangle\n";
-    }
-
-    // Check each mask.
-    for (int j = 0; j < nb_masks_per_row_a; ++j) {
-
-      // We compare the left of a with the right part of b,
-      // and the right part of a with the right part of the next b if any.
-
-      uint32_t mask_a = bits_a[j];
-      uint32_t mask_b = bits_b[j + nb_unused_masks_row_b];
-      uint32_t mask_a_left = mask_a >> nb_unused_bits_row_b;
-      uint32_t next_mask_b_left = 0x00000000;
-      if (j + 1 < nb_masks_per_row_a ||            // Not the last a-mask.
-          nb_masks_per_row_b > nb_masks_per_row_a  // Last a-mask but there exists one more b-mask.
-          ) {
-        // We are still inside the intersection: next_mask_b_left exists.
-        next_mask_b_left = bits_b[j + nb_unused_masks_row_b + 1] >> nb_used_bits_row_b;
-      }
-
-      if (debug_pixel_collisions) {
-        std::cout << "mask_a = ";
-        print_mask(mask_a);
-        std::cout << ", mask b = ";
-        print_mask(mask_b);
-        std::cout << "\n";
-      }
-
-      if (((mask_a_left & mask_b) | (mask_a & next_mask_b_left)) != 0x00000000) {
-        return true;
-      }
+  // Check the intersection 64 pixels wide at a time.
+  const int intersection_width = intersection.get_width();
+  for (int x = 0; x < intersection_width; x += 64) {
+
+    const int remaining_width = intersection_width - x;
+    const uint64_t mask = (remaining_width >= 64) ?
+        ~UINT64_C(0) : ~UINT64_C(0) << (64 - remaining_width);
+
+    const int x1 = offset1.x + x;
+    const int x2 = offset2.x + x;
+    const int column1 = x1 >> 6;
+    const int column2 = x2 >> 6;
+
+    if (test_column_collision(
+        this->get_column(column1) + offset1.y,
+        this->get_column(column1 + 1) + offset1.y,
+        x1 & 63,
+        other.get_column(column2) + offset2.y,
+        other.get_column(column2 + 1) + offset2.y,
+        x2 & 63,
+        mask,
+        intersection.get_height()
+    )) {
+      return true;
     }
   }
 
@@ -243,35 +280,23 @@ void PixelBits::print() const {
 
   std::cout << "frame size is " << width << " x " << height << std::endl;
   for (int i = 0; i < height; i++) {
-    int k = -1;
-    uint32_t mask = 0x00000000;
-    for (int j = 0; j < width; j++) {
-
-      if (mask == 0x00000000) {
-        k++;
-        mask = 0x80000000;
+    for (int j = 0; j < width; j += 64) {
+      const uint64_t mask = get_column(j >> 6)[i];
+      for (int k = 0; k < 64 && j + k < width; ++k) {
+        std::cout << (((mask << k) & UINT64_C(0x8000000000000000)) != 0 ? "X" : ".");
       }
-
-      if (bits[i][k] & mask) {
-        std::cout << "X";
-      }
-      else {
-        std::cout << ".";
-      }
-
-      mask >>= 1;
     }
     std::cout << std::endl;
   }
 }
 
 /**
- * \brief Prints an ASCII representation of a 32-bit mask (for debugging purposes only).
+ * \brief Prints an ASCII representation of a 64-bit mask (for debugging purposes only).
  */
-void PixelBits::print_mask(uint32_t mask) const {
+void PixelBits::print_mask(uint64_t mask) const {
 
-  for (int i = 0; i < 32; i++) {
-    std::cout << (((mask & 0x80000000) != 0x00000000) ? "X" : ".");
+  for (int i = 0; i < 64; i++) {
+    std::cout << (((mask & UINT64_C(0x8000000000000000)) != 0) ? "X" : ".");
     mask <<= 1;
   }
 }
@@ -15,9 +15,38 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "solarus/lowlevel/PixelFilter.h"
+#include "solarus/lowlevel/WorkerPool.h"
+#include <algorithm>
+#include <thread>
 
 namespace Solarus {
 
+namespace {
+
+/**
+ * Bands smaller than this are not worth a thread.
+ */
+constexpr int min_rows_per_band = 16;
+
+/**
+ * Maximum number of threads filtering an image, including the caller.
+ */
+constexpr int max_filter_threads = 4;
+
+/**
+ * \brief Returns the threads used to filter bands of rows.
+ * \return The worker pool, created at the first call.
+ */
+WorkerPool& get_worker_pool() {
+
+  static WorkerPool worker_pool(
+      std::max(0, std::min(static_cast<int>(std::thread::hardware_concurrency()), max_filter_threads) - 1)
+  );
+  return worker_pool;
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Constructor.
  */
@@ -30,5 +59,54 @@ PixelFilter::PixelFilter() {
 PixelFilter::~PixelFilter() {
 }
 
+/**
+ * \brief Applies the algorithm on a rectangle of pixels.
+ *
+ * The rectangle is split into bands of rows filtered in parallel.
+ *
+ * \param src The rectangle of pixels in RGBA format.
+ * Must be a buffer of size src_width * src_height.
+ * \param src_width Width of the rectangle.
+ * \param src_height Height of the rectangle.
+ * \param dst The destination rectangle to write.
+ * Must be a buffer of size
+ * src_width * src_height * get_scaling_factor() * get_scaling_factor().
+ */
+void PixelFilter::filter(
+    const uint32_t* src,
+    int src_width,
+    int src_height,
+    uint32_t* dst
+) const {
+
+  prepare();
+
+  WorkerPool& worker_pool = get_worker_pool();
+  const int num_bands = std::max(1, std::min(
+      worker_pool.get_num_threads() + 1,
+      src_height / min_rows_per_band
+  ));
+
+  if (num_bands == 1) {
+    filter_rows(src, src_width, src_height, dst, 0, src_height);
+    return;
+  }
+
+  worker_pool.run(num_bands, [&](int band) {
+    const int first_row = src_height * band / num_bands;
+    const int last_row = src_height * (band + 1) / num_bands;
+    filter_rows(src, src_width, src_height, dst, first_row, last_row);
+  });
+}
+
+/**
+ * \brief Called by filter() before filtering rows, on the calling thread.
+ *
+ * Redefine it to perform initializations that are not thread-safe.
+ * Does nothing by default.
+ */
+void PixelFilter::prepare() const {
+}
+
 }
 
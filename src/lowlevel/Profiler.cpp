@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Logger.h"
+#include "solarus/lowlevel/System.h"
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace Solarus {
+
+namespace Profiler {
+
+namespace {
+
+  /**
+   * \brief Measures of a frame.
+   */
+  struct FrameRecord {
+    std::array<uint64_t, static_cast<size_t>(Phase::NB_PHASES)>
+        phase_times;                    /**< Duration of each phase in microseconds. */
+    std::array<uint64_t, static_cast<size_t>(Counter::NB_COUNTERS)>
+        counters;                       /**< Value of each counter. */
+  };
+
+  const char* const phase_names[] = {
+      "input",
+      "game_update",
+      "lua_update",
+      "entities_draw"
+  };
+
+  const char* const counter_names[] = {
+      "pixels_redrawn",
+      "ground_below_hits",
+      "ground_below_misses",
+      "draw_records",
+      "draw_arena_allocations",
+      "glyph_cache_hits",
+      "glyph_cache_misses"
+  };
+
+  bool enabled = false;                 /**< Whether measures are recorded. */
+  std::vector<FrameRecord> frames;      /**< Measures of each frame. */
+
+  /**
+   * \brief Returns whether a file name has the given extension.
+   */
+  bool has_extension(const std::string& file_name, const std::string& extension) {
+
+    return file_name.size() >= extension.size() &&
+        file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0;
+  }
+
+  /**
+   * \brief Writes the records as CSV, one line per frame.
+   */
+  void write_csv(std::ostream& out) {
+
+    out << "frame,simulated_time";
+    for (const char* phase_name : phase_names) {
+      out << "," << phase_name;
+    }
+    for (const char* counter_name : counter_names) {
+      out << "," << counter_name;
+    }
+    out << "\n";
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+      out << i << "," << (i + 1) * System::timestep;
+      for (uint64_t duration : frames[i].phase_times) {
+        out << "," << duration;
+      }
+      for (uint64_t value : frames[i].counters) {
+        out << "," << value;
+      }
+      out << "\n";
+    }
+  }
+
+  /**
+   * \brief Writes the records as a JSON object.
+   */
+  void write_json(std::ostream& out) {
+
+    out << "{\n  \"timestep\": " << System::timestep
+        << ",\n  \"unit\": \"us\",\n  \"frames\": [";
+    for (size_t i = 0; i < frames.size(); ++i) {
+      out << (i == 0 ? "\n" : ",\n") << "    { \"frame\": " << i;
+      for (size_t j = 0; j < frames[i].phase_times.size(); ++j) {
+        out << ", \"" << phase_names[j] << "\": " << frames[i].phase_times[j];
+      }
+      for (size_t j = 0; j < frames[i].counters.size(); ++j) {
+        out << ", \"" << counter_names[j] << "\": " << frames[i].counters[j];
+      }
+      out << " }";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+}
+
+/**
+ * \brief Enables or disables the recording of measures.
+ * \param enabled \c true to record measures.
+ */
+SOLARUS_API void set_enabled(bool enabled) {
+
+  Profiler::enabled = enabled;
+}
+
+/**
+ * \brief Returns whether measures are being recorded.
+ * \return \c true if the profiler is enabled.
+ */
+SOLARUS_API bool is_enabled() {
+
+  return enabled;
+}
+
+/**
+ * \brief Disables the profiler and discards all records.
+ */
+SOLARUS_API void quit() {
+
+  enabled = false;
+  frames.clear();
+}
+
+/**
+ * \brief Opens a new frame record.
+ *
+ * Subsequent measures are added to this frame until the next call.
+ * Does nothing if the profiler is disabled.
+ */
+SOLARUS_API void start_frame() {
+
+  if (!enabled) {
+    return;
+  }
+
+  frames.emplace_back();
+  frames.back().phase_times.fill(0);
+  frames.back().counters.fill(0);
+}
+
+/**
+ * \brief Returns the number of frames recorded so far.
+ * \return The number of frames.
+ */
+SOLARUS_API int get_num_frames() {
+
+  return static_cast<int>(frames.size());
+}
+
+/**
+ * \brief Adds time spent in a phase to the current frame.
+ *
+ * Does nothing if the profiler is disabled or if no frame was started.
+ *
+ * \param phase The phase measured.
+ * \param duration Real time spent in microseconds.
+ */
+SOLARUS_API void add_phase_time(Phase phase, uint64_t duration) {
+
+  if (!enabled || frames.empty()) {
+    return;
+  }
+
+  frames.back().phase_times[static_cast<size_t>(phase)] += duration;
+}
+
+/**
+ * \brief Returns the time spent in a phase during a recorded frame.
+ * \param frame Index of a recorded frame.
+ * \param phase The phase to get.
+ * \return The real time spent in microseconds.
+ */
+SOLARUS_API uint64_t get_phase_time(int frame, Phase phase) {
+
+  return frames.at(frame).phase_times[static_cast<size_t>(phase)];
+}
+
+/**
+ * \brief Adds a value to a counter of the current frame.
+ *
+ * Does nothing if the profiler is disabled or if no frame was started.
+ *
+ * \param counter The counter to increase.
+ * \param value The value to add.
+ */
+SOLARUS_API void add_counter(Counter counter, uint64_t value) {
+
+  if (!enabled || frames.empty()) {
+    return;
+  }
+
+  frames.back().counters[static_cast<size_t>(counter)] += value;
+}
+
+/**
+ * \brief Returns the value of a counter during a recorded frame.
+ * \param frame Index of a recorded frame.
+ * \param counter The counter to get.
+ * \return The value counted during this frame.
+ */
+SOLARUS_API uint64_t get_counter(int frame, Counter counter) {
+
+  return frames.at(frame).counters[static_cast<size_t>(counter)];
+}
+
+/**
+ * \brief Exports all records to a file.
+ *
+ * The format is JSON if the file name ends with ".json", CSV otherwise.
+ * The file name is a regular path on the host filesystem, not a quest file.
+ *
+ * \param file_name Path of the file to write.
+ * \return \c true in case of success.
+ */
+SOLARUS_API bool save(const std::string& file_name) {
+
+  std::ofstream out(file_name.c_str());
+  if (!out) {
+    Logger::error("Cannot write profiling file '" + file_name + "'");
+    return false;
+  }
+
+  if (has_extension(file_name, ".json")) {
+    write_json(out);
+  }
+  else {
+    write_csv(out);
+  }
+  return static_cast<bool>(out);
+}
+
+/**
+ * \brief Starts measuring a phase.
+ * \param phase The phase to measure.
+ */
+PhaseTimer::PhaseTimer(Phase phase):
+  phase(phase),
+  enabled(Profiler::enabled) {
+
+  if (enabled) {
+    start_date = std::chrono::steady_clock::now();
+  }
+}
+
+/**
+ * \brief Stops measuring the phase and records its duration.
+ */
+PhaseTimer::~PhaseTimer() {
+
+  if (enabled) {
+    const auto duration = std::chrono::steady_clock::now() - start_date;
+    add_phase_time(phase, std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+  }
+}
+
+}  // namespace Profiler
+
+}  // namespace Solarus
+
@@ -23,7 +23,11 @@
 #include <physfs.h>
 #include <fstream>
 #include <cstdlib>  // exit(), mkstemp(), tmpnam()
-#include <cstdio>   // remove()
+#include <cstdio>   // remove(), rename()
+
+#ifdef _WIN32
+#include <windows.h>  // MoveFileExA()
+#endif
 #ifdef HAVE_UNISTD_H
 #  include <unistd.h>
 #endif
@@ -336,6 +340,64 @@ SOLARUS_API void data_file_save(
   PHYSFS_close(file);
 }
 
+/**
+ * \brief Saves a buffer into a data file, replacing it atomically.
+ *
+ * The buffer is first written to a temporary file next to the destination,
+ * which is then renamed.
+ * If the program stops during the write, the file keeps its previous content.
+ * Unlike data_file_save(), this function may be called from any thread.
+ *
+ * \param file_name Name of the file to write, relative to the Solarus write
+ * directory.
+ * \param buffer A memory area with the data to write.
+ * \return \c true in case of success.
+ */
+SOLARUS_API bool data_file_replace(
+    const std::string& file_name,
+    const std::string& buffer
+) {
+  const char* write_dir = PHYSFS_getWriteDir();
+  if (write_dir == nullptr) {
+    return false;
+  }
+
+  const std::string& temporary_file_name = file_name + ".tmp";
+  PHYSFS_File* file = PHYSFS_openWrite(temporary_file_name.c_str());
+  if (file == nullptr) {
+    return false;
+  }
+
+  // A short write is a failure too.
+  // Closing the file also flushes it.
+  const bool written = buffer.empty() ||
+      PHYSFS_write(file, buffer.data(), (PHYSFS_uint32) buffer.size(), 1) == 1;
+  if (!PHYSFS_close(file) || !written) {
+    PHYSFS_delete(temporary_file_name.c_str());
+    return false;
+  }
+
+  const std::string& full_file_name = std::string(write_dir) + "/" + file_name;
+  const std::string& full_temporary_file_name = full_file_name + ".tmp";
+#ifdef _WIN32
+  // rename() does not replace an existing file on Windows.
+  const bool renamed = MoveFileExA(
+      full_temporary_file_name.c_str(),
+      full_file_name.c_str(),
+      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+  ) != 0;
+#else
+  const bool renamed =
+      std::rename(full_temporary_file_name.c_str(), full_file_name.c_str()) == 0;
+#endif
+  if (!renamed) {
+    PHYSFS_delete(temporary_file_name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * \brief Removes a file from the write directory.
  * \param file_name Name of the file to delete, relative to the Solarus
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/RenderQueue.h"
+
+namespace Solarus {
+
+namespace {
+
+  bool batching_enabled = false;    /**< Whether drawings are grouped by texture. */
+
+  /**
+   * \brief How many batches back a drawing can be moved.
+   */
+  constexpr int max_batch_lookback = 16;
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates an empty render queue.
+ */
+RenderQueue::RenderQueue():
+  commands(),
+  batches() {
+
+}
+
+/**
+ * \brief Returns whether drawings are grouped by texture.
+ * \return \c true if batching is enabled.
+ */
+bool RenderQueue::is_batching_enabled() {
+  return batching_enabled;
+}
+
+/**
+ * \brief Sets whether drawings are grouped by texture.
+ *
+ * This also controls whether images are packed into texture atlases.
+ *
+ * \param batching_enabled \c true to enable batching.
+ */
+void RenderQueue::set_batching_enabled(bool batching_enabled) {
+  Solarus::batching_enabled = batching_enabled;
+}
+
+/**
+ * \brief Adds the copy of a texture region to the queue.
+ * \param texture The texture to draw.
+ * \param blend_mode How to blend the texture.
+ * \param opacity Opacity of the drawing (0 to 255).
+ * \param src_rect Region of the texture to draw.
+ * \param dst_rect Where to draw it on the renderer.
+ */
+void RenderQueue::add_copy(
+    SDL_Texture* texture,
+    SDL_BlendMode blend_mode,
+    uint8_t opacity,
+    const Rectangle& src_rect,
+    const Rectangle& dst_rect) {
+
+  add_command({ texture, blend_mode, 255, 255, 255, opacity, src_rect, dst_rect });
+}
+
+/**
+ * \brief Adds a color fill to the queue.
+ * \param r Red component.
+ * \param g Green component.
+ * \param b Blue component.
+ * \param a Alpha component.
+ * \param dst_rect The rectangle to fill on the renderer.
+ */
+void RenderQueue::add_fill(
+    uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+    const Rectangle& dst_rect) {
+
+  add_command({ nullptr, SDL_BLENDMODE_NONE, r, g, b, a, Rectangle(), dst_rect });
+}
+
+/**
+ * \brief Adds a command to the latest possible compatible batch.
+ * \param command The command to add.
+ */
+void RenderQueue::add_command(const Command& command) {
+
+  const int index = static_cast<int>(commands.size());
+  commands.push_back(command);
+
+  if (batching_enabled && command.texture != nullptr) {
+    // Look for a batch with the same state that the command can join
+    // without passing over something that overlaps it.
+    const int last = static_cast<int>(batches.size()) - 1;
+    for (int i = last; i >= 0 && i > last - max_batch_lookback; --i) {
+      Batch& batch = batches[i];
+      if (batch.texture == command.texture &&
+          batch.blend_mode == command.blend_mode) {
+        batch.commands.push_back(index);
+        batch.bounding_box |= command.dst_rect;
+        return;
+      }
+      if (batch.bounding_box.overlaps(command.dst_rect)) {
+        break;
+      }
+    }
+  }
+
+  batches.push_back({ command.texture, command.blend_mode, command.dst_rect, { index } });
+}
+
+/**
+ * \brief Returns the number of drawings in the queue.
+ * \return The number of commands.
+ */
+int RenderQueue::get_num_commands() const {
+  return static_cast<int>(commands.size());
+}
+
+/**
+ * \brief Returns the number of groups of drawings that will be submitted.
+ * \return The number of batches.
+ */
+int RenderQueue::get_num_batches() const {
+  return static_cast<int>(batches.size());
+}
+
+/**
+ * \brief Performs all drawings of the queue and empties it.
+ * \param renderer The renderer where to draw.
+ */
+void RenderQueue::submit(SDL_Renderer* renderer) {
+
+  for (const Batch& batch : batches) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (batching_enabled &&
+        batch.texture != nullptr &&
+        batch.commands.size() > 1) {
+      submit_geometry(renderer, batch);
+      continue;
+    }
+#endif
+    submit_commands(renderer, batch);
+  }
+
+  commands.clear();
+  batches.clear();
+}
+
+/**
+ * \brief Submits the commands of a batch one by one.
+ * \param renderer The renderer where to draw.
+ * \param batch The batch to submit.
+ */
+void RenderQueue::submit_commands(SDL_Renderer* renderer, const Batch& batch) {
+
+  if (batch.texture != nullptr) {
+    SDL_SetTextureBlendMode(batch.texture, batch.blend_mode);
+  }
+
+  for (int index : batch.commands) {
+    const Command& command = commands[index];
+    if (command.texture == nullptr) {
+      SDL_SetRenderDrawColor(renderer, command.r, command.g, command.b, command.a);
+      SDL_RenderFillRect(renderer, command.dst_rect.get_internal_rect());
+    }
+    else {
+      SDL_SetTextureAlphaMod(command.texture, command.a);
+      SDL_RenderCopy(
+          renderer,
+          command.texture,
+          command.src_rect.get_internal_rect(),
+          command.dst_rect.get_internal_rect()
+      );
+    }
+  }
+}
+
+/**
+ * \brief Submits the commands of a texture batch as a single geometry.
+ *
+ * The opacity of each command is passed as the alpha of its vertices.
+ *
+ * \param renderer The renderer where to draw.
+ * \param batch The batch to submit.
+ */
+void RenderQueue::submit_geometry(SDL_Renderer* renderer, const Batch& batch) {
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  int texture_width = 0;
+  int texture_height = 0;
+  SDL_QueryTexture(batch.texture, nullptr, nullptr, &texture_width, &texture_height);
+  if (texture_width <= 0 || texture_height <= 0) {
+    return;
+  }
+  const float u_scale = 1.0f / texture_width;
+  const float v_scale = 1.0f / texture_height;
+
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+  vertices.reserve(batch.commands.size() * 4);
+  indices.reserve(batch.commands.size() * 6);
+
+  for (int index : batch.commands) {
+    const Command& command = commands[index];
+    const Rectangle& src = command.src_rect;
+    const Rectangle& dst = command.dst_rect;
+    const SDL_Color color = { 255, 255, 255, command.a };
+    const float left = static_cast<float>(dst.get_x());
+    const float top = static_cast<float>(dst.get_y());
+    const float right = static_cast<float>(dst.get_x() + dst.get_width());
+    const float bottom = static_cast<float>(dst.get_y() + dst.get_height());
+    const float u1 = src.get_x() * u_scale;
+    const float v1 = src.get_y() * v_scale;
+    const float u2 = (src.get_x() + src.get_width()) * u_scale;
+    const float v2 = (src.get_y() + src.get_height()) * v_scale;
+
+    const int first = static_cast<int>(vertices.size());
+    vertices.push_back({ { left, top }, color, { u1, v1 } });
+    vertices.push_back({ { right, top }, color, { u2, v1 } });
+    vertices.push_back({ { right, bottom }, color, { u2, v2 } });
+    vertices.push_back({ { left, bottom }, color, { u1, v2 } });
+    const int quad_indices[] = { 0, 1, 2, 0, 2, 3 };
+    for (int quad_index : quad_indices) {
+      indices.push_back(first + quad_index);
+    }
+  }
+
+  SDL_SetTextureBlendMode(batch.texture, batch.blend_mode);
+  SDL_SetTextureAlphaMod(batch.texture, 255);
+  SDL_RenderGeometry(
+      renderer,
+      batch.texture,
+      vertices.data(),
+      static_cast<int>(vertices.size()),
+      indices.data(),
+      static_cast<int>(indices.size())
+  );
+#else
+  submit_commands(renderer, batch);
+#endif
+}
+
+}
+
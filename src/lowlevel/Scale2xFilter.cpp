@@ -16,8 +16,56 @@
  */
 #include "solarus/lowlevel/Scale2xFilter.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define SOLARUS_SCALE2X_SSE2
+#  include <emmintrin.h>
+#endif
+
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Applies Scale2x on one pixel.
+ * \param b Pixel above.
+ * \param d Pixel on the left.
+ * \param e The pixel to scale.
+ * \param f Pixel on the right.
+ * \param h Pixel below.
+ * \param dst_row1 Where to write the two pixels of the upper output row.
+ * \param dst_row2 Where to write the two pixels of the lower output row.
+ */
+inline void scale2x_pixel(
+    uint32_t b,
+    uint32_t d,
+    uint32_t e,
+    uint32_t f,
+    uint32_t h,
+    uint32_t* dst_row1,
+    uint32_t* dst_row2) {
+
+  if (b != h && d != f) {
+    dst_row1[0] = (d == b) ? d : e;
+    dst_row1[1] = (b == f) ? f : e;
+    dst_row2[0] = (d == h) ? d : e;
+    dst_row2[1] = (h == f) ? f : e;
+  }
+  else {
+    dst_row1[0] = dst_row1[1] = dst_row2[0] = dst_row2[1] = e;
+  }
+}
+
+#ifdef SOLARUS_SCALE2X_SSE2
+/**
+ * \brief Returns a where mask is set and b elsewhere.
+ */
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+}  // Anonymous namespace.
+
 /**
  * \brief Constructor.
  */
@@ -33,64 +81,77 @@ int Scale2xFilter::get_scaling_factor() const {
 }
 
 /**
- * \copydoc PixelFilter::filter
+ * \copydoc PixelFilter::filter_rows
  */
-void Scale2xFilter::filter(
+void Scale2xFilter::filter_rows(
     const uint32_t* src,
     int src_width,
     int src_height,
-    uint32_t* dst) const {
+    uint32_t* dst,
+    int first_row,
+    int last_row) const {
 
   const int dst_width = src_width * 2;
 
-  int e1 = 0;
-  int e2, e3, e4;
-  int b, d, e = 0, f,  h;
-  for (int row = 0; row < src_height; row++) {
-    for (int col = 0; col < src_width; col++) {
-
-      // compute a to i
-
-      b = e - src_width;
-      d = e - 1;
-      f = e + 1;
-      h = e + src_width;
-
-      if (row == 0) {
-        b = e;
-      }
-      if (row == src_height - 1) {
-        h = e;
-      }
-      if (col == 0) {
-        d = e;
-      }
-      if (col == src_width - 1) {
-        f = e;
-      }
-
-      // compute e1 to e4
-      e2 = e1 + 1;
-      e3 = e1 + dst_width;
-      e4 = e3 + 1;
-
-      // compute the color
-
-      if (src[b] != src[h] && src[d] != src[f]) {
-        dst[e1] = src[(src[d] == src[b]) ? d : e];
-        dst[e2] = src[(src[b] == src[f]) ? f : e];
-        dst[e3] = src[(src[d] == src[h]) ? d : e];
-        dst[e4] = src[(src[h] == src[f]) ? f : e];
-      }
-      else {
-        dst[e1] = dst[e2] = dst[e3] = dst[e4] = src[e];
-      }
-      e1 += 2;
-      e++;
+  for (int row = first_row; row < last_row; ++row) {
+
+    // Rows above and below, repeating the border.
+    const uint32_t* src_row = src + row * src_width;
+    const uint32_t* src_row_above = (row == 0) ? src_row : src_row - src_width;
+    const uint32_t* src_row_below = (row == src_height - 1) ? src_row : src_row + src_width;
+    uint32_t* dst_row1 = dst + row * 2 * dst_width;
+    uint32_t* dst_row2 = dst_row1 + dst_width;
+
+    if (src_width == 1) {
+      scale2x_pixel(src_row_above[0], src_row[0], src_row[0], src_row[0], src_row_below[0],
+          dst_row1, dst_row2);
+      continue;
     }
-    e1 += dst_width;
-  }
 
+    // First column: repeat the left border.
+    scale2x_pixel(src_row_above[0], src_row[0], src_row[0], src_row[1], src_row_below[0],
+        dst_row1, dst_row2);
+
+    int col = 1;
+#ifdef SOLARUS_SCALE2X_SSE2
+    // Four pixels at a time, except the last one of the row.
+    for (; col + 4 < src_width; col += 4) {
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row_above + col));
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + col - 1));
+      const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + col));
+      const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + col + 1));
+      const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row_below + col));
+
+      // b != h && d != f
+      const __m128i different = _mm_andnot_si128(
+          _mm_or_si128(_mm_cmpeq_epi32(b, h), _mm_cmpeq_epi32(d, f)),
+          _mm_set1_epi32(-1)
+      );
+      const __m128i e1 = select(_mm_and_si128(different, _mm_cmpeq_epi32(d, b)), d, e);
+      const __m128i e2 = select(_mm_and_si128(different, _mm_cmpeq_epi32(b, f)), f, e);
+      const __m128i e3 = select(_mm_and_si128(different, _mm_cmpeq_epi32(d, h)), d, e);
+      const __m128i e4 = select(_mm_and_si128(different, _mm_cmpeq_epi32(h, f)), f, e);
+
+      // Interleave the left and right output pixels.
+      __m128i* dst1 = reinterpret_cast<__m128i*>(dst_row1 + col * 2);
+      __m128i* dst2 = reinterpret_cast<__m128i*>(dst_row2 + col * 2);
+      _mm_storeu_si128(dst1, _mm_unpacklo_epi32(e1, e2));
+      _mm_storeu_si128(dst1 + 1, _mm_unpackhi_epi32(e1, e2));
+      _mm_storeu_si128(dst2, _mm_unpacklo_epi32(e3, e4));
+      _mm_storeu_si128(dst2 + 1, _mm_unpackhi_epi32(e3, e4));
+    }
+#endif
+
+    for (; col < src_width - 1; ++col) {
+      scale2x_pixel(src_row_above[col], src_row[col - 1], src_row[col], src_row[col + 1], src_row_below[col],
+          dst_row1 + col * 2, dst_row2 + col * 2);
+    }
+
+    // Last column: repeat the right border.
+    col = src_width - 1;
+    scale2x_pixel(src_row_above[col], src_row[col - 1], src_row[col], src_row[col], src_row_below[col],
+        dst_row1 + col * 2, dst_row2 + col * 2);
+  }
 }
 
 }
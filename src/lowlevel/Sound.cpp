@@ -21,11 +21,16 @@
 #include "solarus/lowlevel/QuestFiles.h"
 #include "solarus/lowlevel/Logger.h"
 #include "solarus/lowlevel/Music.h"
+#include "solarus/lowlevel/OggDecoder.h"
 #include "solarus/lowlevel/Sound.h"
 #include "solarus/lowlevel/String.h"
+#include "solarus/lowlevel/System.h"
 #include "solarus/Arguments.h"
 #include "solarus/CurrentQuest.h"
+#include "solarus/ResourceCache.h"
 #include <cstdio>
+#include <utility>
+#include <vector>
 
 namespace Solarus {
 
@@ -34,8 +39,11 @@ ALCcontext* Sound::context = nullptr;
 bool Sound::initialized = false;
 bool Sound::sounds_preloaded = false;
 float Sound::volume = 1.0;
-std::list<Sound*> Sound::current_sounds;
-std::map<std::string, Sound> Sound::all_sounds;
+bool Sound::mono_enabled = true;
+size_t Sound::stream_threshold = 1024 * 1024;
+std::list<std::shared_ptr<Sound>> Sound::current_sounds;
+constexpr int Sound::nb_stream_buffers;
+constexpr int Sound::stream_buffer_samples;
 
 namespace {
 
@@ -54,7 +62,7 @@ size_t cb_read(void* ptr, size_t /* size */, size_t nb_bytes, void* datasource)
 
   Sound::SoundFromMemory* mem = static_cast<Sound::SoundFromMemory*>(datasource);
 
-  const size_t total_size = mem->data.size();
+  const size_t total_size = mem->data->size();
   if (mem->position >= total_size) {
     if (mem->loop) {
       mem->position = 0;
@@ -67,7 +75,7 @@ size_t cb_read(void* ptr, size_t /* size */, size_t nb_bytes, void* datasource)
     nb_bytes = total_size - mem->position;
   }
 
-  std::memcpy(ptr, mem->data.data() + mem->position, nb_bytes);
+  std::memcpy(ptr, mem->data->data() + mem->position, nb_bytes);
   mem->position += nb_bytes;
 
   return nb_bytes;
@@ -98,12 +106,12 @@ int cb_seek(void* datasource, ogg_int64_t offset, int whence) {
     break;
 
   case SEEK_END:
-    mem->position = mem->data.size() - offset;
+    mem->position = mem->data->size() - offset;
     break;
   }
 
-  if (mem->position >= mem->data.size()) {
-    mem->position = mem->data.size();
+  if (mem->position >= mem->data->size()) {
+    mem->position = mem->data->size();
   }
 
   return 0;
@@ -156,7 +164,11 @@ Sound::Sound(const std::string& sound_id):
  */
 Sound::~Sound() {
 
-  if (is_initialized() && buffer != AL_NONE) {
+  if (!is_initialized()) {
+    return;
+  }
+
+  if (buffer != AL_NONE) {
 
     // stop the sources where this buffer is attached
     for (ALuint source: sources) {
@@ -165,7 +177,10 @@ Sound::~Sound() {
       alDeleteSources(1, &source);
     }
     alDeleteBuffers(1, &buffer);
-    current_sounds.remove(this);
+  }
+
+  for (const std::unique_ptr<Stream>& stream: streams) {
+    stop_stream(*stream);
   }
 }
 
@@ -230,7 +245,8 @@ void Sound::quit() {
     Music::quit();
 
     // clear the sounds
-    all_sounds.clear();
+    current_sounds.clear();
+    ResourceCache::clear(ResourceType::SOUND);
 
     // uninitialize OpenAL
 
@@ -255,19 +271,49 @@ bool Sound::is_initialized() {
 
 /**
  * \brief Loads and decodes all sounds listed in the game database.
+ *
+ * Stops when the resource cache is full: preloading more sounds would
+ * only evict the previous ones.
+ * Sounds not preloaded are decoded the first time they are played.
  */
 void Sound::load_all() {
 
   if (is_initialized() && !sounds_preloaded) {
 
+    const uint32_t start_time = System::get_real_time();
+    int num_loaded = 0;
+    int num_skipped = 0;
+    size_t memory_size = 0;
+
     const std::map<std::string, std::string>& sound_elements =
         CurrentQuest::get_resources(ResourceType::SOUND);
     for (const auto& kvp: sound_elements) {
       const std::string& sound_id = kvp.first;
 
-      all_sounds[sound_id] = Sound(sound_id);
-      all_sounds[sound_id].load();
+      if (ResourceCache::contains(ResourceType::SOUND, sound_id)) {
+        continue;
+      }
+
+      if (ResourceCache::get_memory_size() >= ResourceCache::get_budget()) {
+        ++num_skipped;
+        continue;
+      }
+
+      std::shared_ptr<Sound> sound = std::make_shared<Sound>(sound_id);
+      sound->load();
+      memory_size += sound->get_memory_size();
+      ResourceCache::add(ResourceType::SOUND, sound_id, sound, sound->get_memory_size());
+      ++num_loaded;
+    }
+
+    std::ostringstream oss;
+    oss << "Preloaded " << num_loaded << " sounds in "
+        << System::get_real_time() - start_time << " ms ("
+        << memory_size / 1024 << " KB)";
+    if (num_skipped > 0) {
+      oss << ", " << num_skipped << " sounds left to load when played";
     }
+    Logger::info(oss.str());
 
     sounds_preloaded = true;
   }
@@ -291,11 +337,18 @@ bool Sound::exists(const std::string& sound_id) {
  */
 void Sound::play(const std::string& sound_id) {
 
-  if (all_sounds.find(sound_id) == all_sounds.end()) {
-    all_sounds[sound_id] = Sound(sound_id);
+  if (!is_initialized()) {
+    return;
+  }
+
+  std::shared_ptr<Sound> sound = ResourceCache::find<Sound>(ResourceType::SOUND, sound_id);
+  if (sound == nullptr) {
+    sound = std::make_shared<Sound>(sound_id);
+    sound->load();
+    ResourceCache::add(ResourceType::SOUND, sound_id, sound, sound->get_memory_size());
   }
 
-  all_sounds[sound_id].start();
+  sound->start();
 }
 
 /**
@@ -318,6 +371,49 @@ void Sound::set_volume(int volume) {
   Logger::info(std::string("Sound volume: ") + String::to_string(get_volume()));
 }
 
+/**
+ * \brief Returns whether mono sounds are played in mono.
+ * \return \c true if mono sounds stay mono,
+ * \c false if they are converted to stereo.
+ */
+bool Sound::is_mono_enabled() {
+  return mono_enabled;
+}
+
+/**
+ * \brief Sets whether mono sounds are played in mono.
+ *
+ * Mono sounds are kept mono by default: they take half the memory of
+ * stereo ones. Some audio drivers accept them without reporting any error
+ * but make no sound: disable mono for them to convert mono sounds to stereo.
+ * This only affects sounds loaded afterwards.
+ *
+ * \param mono_enabled \c true to keep mono sounds mono,
+ * \c false to convert them to stereo.
+ */
+void Sound::set_mono_enabled(bool mono_enabled) {
+  Sound::mono_enabled = mono_enabled;
+}
+
+/**
+ * \brief Returns the decoded size above which sounds are streamed.
+ * \return The size in bytes.
+ */
+size_t Sound::get_stream_threshold() {
+  return stream_threshold;
+}
+
+/**
+ * \brief Sets the decoded size above which sounds are streamed.
+ *
+ * This only affects sounds loaded afterwards.
+ *
+ * \param stream_threshold The size in bytes.
+ */
+void Sound::set_stream_threshold(size_t stream_threshold) {
+  Sound::stream_threshold = stream_threshold;
+}
+
 /**
  * \brief Updates the audio (music and sound) system.
  *
@@ -326,14 +422,14 @@ void Sound::set_volume(int volume) {
 void Sound::update() {
 
   // update the playing sounds
-  std::list<Sound*> sounds_to_remove;
-  for (Sound* sound: current_sounds) {
+  std::list<std::shared_ptr<Sound>> sounds_to_remove;
+  for (const std::shared_ptr<Sound>& sound: current_sounds) {
     if (!sound->update_playing()) {
       sounds_to_remove.push_back(sound);
     }
   }
 
-  for (Sound* sound: sounds_to_remove) {
+  for (const std::shared_ptr<Sound>& sound: sounds_to_remove) {
     current_sounds.remove(sound);
   }
 
@@ -341,6 +437,36 @@ void Sound::update() {
   Music::update();
 }
 
+/**
+ * \brief Returns the memory used by the decoded data of this sound.
+ *
+ * For a streamed sound, this is the size of its encoded data.
+ *
+ * \return The size in bytes, or 0 if the sound is not loaded.
+ */
+size_t Sound::get_memory_size() const {
+
+  if (encoded_data != nullptr) {
+    return encoded_data->size();
+  }
+
+  if (buffer == AL_NONE) {
+    return 0;
+  }
+
+  ALint size = 0;
+  alGetBufferi(buffer, AL_SIZE, &size);
+  return static_cast<size_t>(size);
+}
+
+/**
+ * \brief Returns whether this sound is currently playing.
+ * \return \c true if at least one instance of this sound is playing.
+ */
+bool Sound::is_playing() const {
+  return !sources.empty() || !streams.empty();
+}
+
 /**
  * \brief Updates this sound when it is playing.
  * \return true if the sound is still playing, false if it is finished.
@@ -348,21 +474,84 @@ void Sound::update() {
 bool Sound::update_playing() {
 
   // See if this sound is still playing.
-  if (sources.empty()) {
+  if (!sources.empty()) {
+    ALuint source = *sources.begin();
+    ALint status;
+    alGetSourcei(source, AL_SOURCE_STATE, &status);
+
+    if (status != AL_PLAYING) {
+      sources.pop_front();
+      alSourcei(source, AL_BUFFER, 0);
+      alDeleteSources(1, &source);
+    }
+  }
+
+  // Refill the streams and remove the finished ones.
+  auto it = streams.begin();
+  while (it != streams.end()) {
+    if (!update_stream(**it)) {
+      stop_stream(**it);
+      it = streams.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  return is_playing();
+}
+
+/**
+ * \brief Refills the buffers of a stream that were played.
+ * \param stream A stream of this sound.
+ * \return \c true if the stream is still playing, \c false if it is finished.
+ */
+bool Sound::update_stream(Stream& stream) {
+
+  ALint nb_processed = 0;
+  alGetSourcei(stream.source, AL_BUFFERS_PROCESSED, &nb_processed);
+  for (int i = 0; i < nb_processed; ++i) {
+    ALuint stream_buffer;
+    alSourceUnqueueBuffers(stream.source, 1, &stream_buffer);
+    if (stream.decoder->decode(stream_buffer, stream_buffer_samples) > 0) {
+      alSourceQueueBuffers(stream.source, 1, &stream_buffer);
+    }
+  }
+
+  ALint nb_queued = 0;
+  alGetSourcei(stream.source, AL_BUFFERS_QUEUED, &nb_queued);
+  if (nb_queued == 0) {
+    // Everything was decoded and played.
     return false;
   }
 
-  ALuint source = *sources.begin();
   ALint status;
-  alGetSourcei(source, AL_SOURCE_STATE, &status);
-
+  alGetSourcei(stream.source, AL_SOURCE_STATE, &status);
   if (status != AL_PLAYING) {
-    sources.pop_front();
-    alSourcei(source, AL_BUFFER, 0);
-    alDeleteSources(1, &source);
+    // The source played all buffers before we could refill them.
+    alSourcePlay(stream.source);
   }
+  return true;
+}
 
-  return !sources.empty();
+/**
+ * \brief Stops a stream of this sound and releases its resources.
+ * \param stream A stream of this sound.
+ */
+void Sound::stop_stream(Stream& stream) {
+
+  alSourceStop(stream.source);
+
+  ALint nb_queued = 0;
+  alGetSourcei(stream.source, AL_BUFFERS_QUEUED, &nb_queued);
+  for (int i = 0; i < nb_queued; ++i) {
+    ALuint stream_buffer;
+    alSourceUnqueueBuffers(stream.source, 1, &stream_buffer);
+  }
+  alSourcei(stream.source, AL_BUFFER, 0);
+  alDeleteSources(1, &stream.source);
+  alDeleteBuffers(ALsizei(stream.buffers.size()), stream.buffers.data());
+  stream.decoder->unload();
 }
 
 /**
@@ -382,7 +571,7 @@ void Sound::load() {
   // Create an OpenAL buffer with the sound decoded by the library.
   buffer = decode_file(file_name);
 
-  // buffer is now AL_NONE if there was an error.
+  // buffer is now AL_NONE if there was an error or if the sound is streamed.
 }
 
 /**
@@ -395,11 +584,15 @@ bool Sound::start() {
 
   if (is_initialized()) {
 
-    if (buffer == AL_NONE) { // first time: load and decode the file
+    if (buffer == AL_NONE && encoded_data == nullptr) {
+      // first time: load and decode the file
       load();
     }
 
-    if (buffer != AL_NONE) {
+    if (encoded_data != nullptr) {
+      success = start_stream();
+    }
+    else if (buffer != AL_NONE) {
 
       // create a source
       ALuint source;
@@ -418,8 +611,8 @@ bool Sound::start() {
       }
       else {
         sources.push_back(source);
-        current_sounds.remove(this); // to avoid duplicates
-        current_sounds.push_back(this);
+        current_sounds.remove(shared_from_this()); // to avoid duplicates
+        current_sounds.push_back(shared_from_this());
         alSourcePlay(source);
         error = alGetError();
         if (error != AL_NO_ERROR) {
@@ -436,10 +629,61 @@ bool Sound::start() {
   return success;
 }
 
+/**
+ * \brief Starts playing a new stream of this sound.
+ *
+ * The sound must be a streamed one.
+ *
+ * \return \c true in case of success.
+ */
+bool Sound::start_stream() {
+
+  std::unique_ptr<Stream> stream(new Stream());
+  stream->decoder = std::unique_ptr<OggDecoder>(new OggDecoder());
+  if (!stream->decoder->load(encoded_data, false)) {
+    Debug::error("Cannot load sound '" + id + "' for streaming");
+    return false;
+  }
+  stream->decoder->set_stereo_output(!mono_enabled);
+
+  stream->buffers.resize(nb_stream_buffers);
+  alGenBuffers(nb_stream_buffers, stream->buffers.data());
+  alGenSources(1, &stream->source);
+  alSourcef(stream->source, AL_GAIN, volume);
+
+  // Decode the beginning, update() will take care of the rest.
+  ALsizei nb_filled = 0;
+  while (nb_filled < nb_stream_buffers &&
+      stream->decoder->decode(stream->buffers[nb_filled], stream_buffer_samples) > 0) {
+    ++nb_filled;
+  }
+  alSourceQueueBuffers(stream->source, nb_filled, stream->buffers.data());
+  alSourcePlay(stream->source);
+
+  const int error = alGetError();
+  if (error != AL_NO_ERROR) {
+    std::ostringstream oss;
+    oss << "Cannot play sound '" << id << "': error " << error;
+    Debug::error(oss.str());
+    stop_stream(*stream);
+    return false;
+  }
+
+  streams.push_back(std::move(stream));
+  current_sounds.remove(shared_from_this()); // to avoid duplicates
+  current_sounds.push_back(shared_from_this());
+  return true;
+}
+
 /**
  * \brief Loads the specified sound file and decodes its content into an OpenAL buffer.
+ *
+ * If the decoded sound would be larger than stream_threshold, it is not
+ * decoded: its encoded data is kept instead to stream it when played.
+ *
  * \param file_name name of the file to open
  * \return the buffer created, or AL_NONE if the sound could not be loaded
+ * or is streamed
  */
 ALuint Sound::decode_file(const std::string& file_name) {
 
@@ -454,7 +698,7 @@ ALuint Sound::decode_file(const std::string& file_name) {
   SoundFromMemory mem;
   mem.loop = false;
   mem.position = 0;
-  mem.data = QuestFiles::data_file_read(file_name);
+  mem.data = std::make_shared<const std::string>(QuestFiles::data_file_read(file_name));
 
   OggVorbis_File file;
   int error = ov_open_callbacks(&mem, &file, nullptr, 0, ogg_callbacks);
@@ -464,86 +708,137 @@ ALuint Sound::decode_file(const std::string& file_name) {
     oss << "Cannot load sound file '" << file_name
         << "' from memory: error " << error;
     Debug::error(oss.str());
+    return AL_NONE;
   }
-  else {
 
-    // read the encoded sound properties
-    vorbis_info* info = ov_info(&file, -1);
-    ALsizei sample_rate = ALsizei(info->rate);
+  // read the encoded sound properties
+  vorbis_info* info = ov_info(&file, -1);
+  const ALsizei sample_rate = ALsizei(info->rate);
+  const int num_channels = info->channels;
 
-    ALenum format = AL_NONE;
-    if (info->channels == 1) {
-      format = AL_FORMAT_MONO16;
-    }
-    else if (info->channels == 2) {
-      format = AL_FORMAT_STEREO16;
+  if (num_channels != 1 && num_channels != 2) {
+    Debug::error(std::string("Invalid audio format for sound file '")
+        + file_name + "'");
+    ov_clear(&file);
+    return AL_NONE;
+  }
+
+  const ogg_int64_t nb_samples = ov_pcm_total(&file, -1);
+  const size_t decoded_size = nb_samples > 0 ?
+      size_t(nb_samples) * num_channels * sizeof(ALshort) : 0;
+  const size_t buffer_size = mono_enabled ? decoded_size : decoded_size / num_channels * 2;
+
+  if (buffer_size > stream_threshold) {
+    // Too long to be decoded at once: it will be streamed.
+    ov_clear(&file);
+    encoded_data = mem.data;
+    return AL_NONE;
+  }
+
+  // decode the sound with vorbisfile, directly into a buffer of the
+  // expected size
+  std::vector<char> samples(decoded_size);
+  size_t total_bytes_read = 0;
+  char extra_samples[4096];
+  int bitstream;
+  long bytes_read;
+  do {
+    char* destination = extra_samples;
+    int max_bytes = sizeof(extra_samples);
+    if (total_bytes_read < samples.size()) {
+      destination = samples.data() + total_bytes_read;
+      max_bytes = int(std::min(samples.size() - total_bytes_read, size_t(65536)));
     }
 
-    if (format == AL_NONE) {
-      Debug::error(std::string("Invalid audio format for sound file '")
-          + file_name + "'");
+    bytes_read = ov_read(&file, destination, max_bytes, 0, 2, 1, &bitstream);
+    if (bytes_read < 0) {
+      std::ostringstream oss;
+      oss << "Error while decoding ogg chunk in sound file '"
+          << file_name << "': " << bytes_read;
+      Debug::error(oss.str());
     }
     else {
-      // decode the sound with vorbisfile
-      std::vector<char> samples;
-      int bitstream;
-      long bytes_read;
-      long total_bytes_read = 0;
-      const int buffer_size = 16384;
-      char samples_buffer[buffer_size];
-      do {
-        bytes_read = ov_read(&file, samples_buffer, buffer_size, 0, 2, 1, &bitstream);
-        if (bytes_read < 0) {
-          std::ostringstream oss;
-          oss << "Error while decoding ogg chunk in sound file '"
-              << file_name << "': " << bytes_read;
-          Debug::error(oss.str());
-        }
-        else {
-          total_bytes_read += bytes_read;
-          if (format == AL_FORMAT_STEREO16) {
-            samples.insert(samples.end(), samples_buffer, samples_buffer + bytes_read);
-          }
-          else {
-            // mono sound files make no sound on some machines
-            // workaround: convert them on-the-fly into stereo sounds
-            // TODO find a better solution
-            for (int i = 0; i < bytes_read; i += 2) {
-              samples.insert(samples.end(), samples_buffer + i, samples_buffer + i + 2);
-              samples.insert(samples.end(), samples_buffer + i, samples_buffer + i + 2);
-            }
-            total_bytes_read += bytes_read;
-          }
-        }
+      if (destination == extra_samples) {
+        // More data than announced.
+        samples.insert(samples.end(), extra_samples, extra_samples + bytes_read);
       }
-      while (bytes_read > 0);
+      total_bytes_read += bytes_read;
+    }
+  }
+  while (bytes_read > 0);
+  samples.resize(total_bytes_read);
+  ov_clear(&file);
+
+  // copy the samples into an OpenAL buffer
+  buffer = create_buffer(samples, num_channels, sample_rate);
+  if (buffer == AL_NONE) {
+    Debug::error("Cannot copy the sound samples of '" + file_name + "'");
+  }
 
-      // copy the samples into an OpenAL buffer
-      alGenBuffers(1, &buffer);
-      if (alGetError() != AL_NO_ERROR) {
-          Debug::error("Failed to generate audio buffer");
-      }
-      alBufferData(buffer,
-          AL_FORMAT_STEREO16,
-          reinterpret_cast<ALshort*>(samples.data()),
-          ALsizei(total_bytes_read),
-          sample_rate);
-      ALenum error = alGetError();
-      if (error != AL_NO_ERROR) {
-        std::ostringstream oss;
-        oss << "Cannot copy the sound samples of '"
-            << file_name << "' into buffer " << buffer
-            << ": error " << error;
-        Debug::error(oss.str());
-        buffer = AL_NONE;
-      }
+  return buffer;
+}
+
+/**
+ * \brief Creates an OpenAL buffer with decoded samples.
+ *
+ * Mono sounds are converted to stereo unless mono is enabled,
+ * or if the audio backend rejects them.
+ *
+ * \param samples The decoded 16-bit samples.
+ * \param num_channels Number of channels of the samples: 1 or 2.
+ * \param sample_rate The sample rate.
+ * \return The buffer created, or AL_NONE in case of error.
+ */
+ALuint Sound::create_buffer(
+    const std::vector<char>& samples,
+    int num_channels,
+    ALsizei sample_rate
+) {
+  ALuint new_buffer = AL_NONE;
+  alGenBuffers(1, &new_buffer);
+  if (alGetError() != AL_NO_ERROR) {
+    Debug::error("Failed to generate audio buffer");
+    return AL_NONE;
+  }
+
+  ALenum error = AL_NO_ERROR;
+  if (num_channels == 2 || mono_enabled) {
+    const ALenum format = (num_channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+    alBufferData(new_buffer,
+        format,
+        samples.data(),
+        ALsizei(samples.size()),
+        sample_rate);
+    error = alGetError();
+  }
+
+  if (num_channels == 1 && (!mono_enabled || error != AL_NO_ERROR)) {
+    // Mono sound files make no sound on some machines:
+    // duplicate each sample into two channels.
+    std::vector<char> stereo_samples(samples.size() * 2);
+    for (size_t i = 0; i + 1 < samples.size(); i += 2) {
+      stereo_samples[2 * i] = samples[i];
+      stereo_samples[2 * i + 1] = samples[i + 1];
+      stereo_samples[2 * i + 2] = samples[i];
+      stereo_samples[2 * i + 3] = samples[i + 1];
     }
-    ov_clear(&file);
+    alBufferData(new_buffer,
+        AL_FORMAT_STEREO16,
+        stereo_samples.data(),
+        ALsizei(stereo_samples.size()),
+        sample_rate);
+    error = alGetError();
   }
 
-  mem.data.clear();
+  if (error != AL_NO_ERROR) {
+    std::ostringstream oss;
+    oss << "Cannot fill audio buffer " << new_buffer << ": error " << error;
+    Debug::error(oss.str());
+    alDeleteBuffers(1, &new_buffer);
+    return AL_NONE;
+  }
 
-  return buffer;
+  return new_buffer;
 }
 
 }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/StringInterner.h"
+#include "solarus/lowlevel/Debug.h"
+#include <unordered_map>
+#include <vector>
+
+namespace Solarus {
+
+namespace StringInterner {
+
+namespace {
+
+  std::unordered_map<std::string, int>
+      ids;                              /**< Id of each interned string. */
+  std::vector<const std::string*>
+      strings;                          /**< Interned strings indexed by id.
+                                         * They point to the keys of ids,
+                                         * which never move. */
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Returns the id of a string, interning it if necessary.
+ * \param value A string.
+ * \return Its id, a non-negative integer.
+ */
+int intern(const std::string& value) {
+
+  const auto& result = ids.emplace(value, static_cast<int>(strings.size()));
+  if (result.second) {
+    // New string.
+    strings.push_back(&result.first->first);
+  }
+  return result.first->second;
+}
+
+/**
+ * \brief Returns the id of a string without interning it.
+ *
+ * Use this function for lookups: a string never interned cannot be
+ * the key of any table.
+ *
+ * \param value A string.
+ * \return Its id, or -1 if this string was never interned.
+ */
+int find(const std::string& value) {
+
+  const auto& it = ids.find(value);
+  if (it == ids.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+/**
+ * \brief Returns the id of a string without interning it.
+ *
+ * Version with const char*, for keys that come from Lua.
+ *
+ * \param value A string.
+ * \return Its id, or -1 if this string was never interned.
+ */
+int find(const char* value) {
+
+  return find(std::string(value));
+}
+
+/**
+ * \brief Returns the string of an id.
+ * \param id Id of an interned string.
+ * \return The corresponding string.
+ */
+const std::string& get_string(int id) {
+
+  SOLARUS_ASSERT(id >= 0 && id < static_cast<int>(strings.size()),
+      "Invalid interned string id");
+  return *strings[id];
+}
+
+/**
+ * \brief Returns the number of strings interned so far.
+ * \return The number of strings.
+ */
+int get_num_strings() {
+
+  return static_cast<int>(strings.size());
+}
+
+}  // namespace StringInterner
+
+}  // namespace Solarus
+
@@ -16,85 +16,44 @@
  */
 #include "solarus/lowlevel/Surface.h"
 #include "solarus/lowlevel/Color.h"
+#include "solarus/lowlevel/DamageTracker.h"
 #include "solarus/lowlevel/Size.h"
 #include "solarus/lowlevel/Rectangle.h"
 #include "solarus/lowlevel/QuestFiles.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/Video.h"
 #include "solarus/lowlevel/PixelFilter.h"
+#include "solarus/lowlevel/RenderQueue.h"
 #include "solarus/lua/LuaContext.h"
 #include "solarus/Transition.h"
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <sstream>
 
 namespace Solarus {
 
-/**
- * \brief Stores the tree of what surfaces have to be drawn on other surfaces.
- *
- * When a drawing is requested, if the destination surface is in GPU, no
- * drawing actually occurs: instead, the information is stored into this tree.
- * At rendering time, the tree is traversed to perform all drawings
- * accelerated in GPU.
- *
- * The root node of the tree is the screen, and the children nodes are the
- * surfaces drawn on it.
- *
- * Each node represents a source surface drawn somewhere, and the list of
- * surfaces drawn on itself.
- */
-class Surface::SubSurfaceNode {
-
-  public:
-
-    /**
-     * Creates a subsurface node.
-     * \param src_surface The surface to draw.
-     * \param src_rect Region of the surface to draw.
-     * \param dst_rect The rectangle where to draw the surface, relative to
-     * the parent surface.
-     * \param subsurfaces Surfaces drawn onto src_surface.
-     */
-    SubSurfaceNode(
-        SurfacePtr src_surface,
-        const Rectangle& src_rect,
-        const Rectangle& dst_rect,
-        const std::vector<SubSurfaceNodePtr>& subsurfaces
-    ):
-      src_surface(src_surface),
-      src_rect(src_rect),
-      dst_rect(dst_rect),
-      subsurfaces(subsurfaces) {
-
-      // Clip the source rectangle to the size of the source surface.
-      // Otherwise, SDL_RenderCopy() will stretch the image.
-      // FIXME still buggy with software renderer for now but should be fixed soon :
-      // https://bugzilla.libsdl.org/show_bug.cgi?id=1968
-      if (this->src_rect.get_x() < 0) {
-        this->src_rect.set_x(0);
-        this->src_rect.set_width(this->src_rect.get_width() + src_rect.get_x());
-        this->dst_rect.add_x(-src_rect.get_x());
-      }
-      if (this->src_rect.get_x() + this->src_rect.get_width() > src_surface->get_width()) {
-        this->src_rect.set_width(src_surface->get_width() - this->src_rect.get_x());
-      }
-      if (src_rect.get_y() < 0) {
-        this->src_rect.set_y(0);
-        this->src_rect.set_height(this->src_rect.get_height() + src_rect.get_y());
-        this->dst_rect.add_y(-src_rect.get_y());
-      }
-      if (this->src_rect.get_y() + this->src_rect.get_height() > src_surface->get_height()) {
-        this->src_rect.set_height(src_surface->get_height() - this->src_rect.get_y());
-      }
+namespace {
 
-    }
+  std::atomic<uint64_t> next_surface_id(1);  /**< Id of the next surface created. */
+
+  /**
+   * \brief A list of drawings still to render, with the position of its
+   * surface on the renderer.
+   */
+  struct PendingList {
+    int next;                                /**< Index of the next record to render. */
+    int remaining;                           /**< Number of records left. */
+    Rectangle src_rect;                      /**< Region of the surface drawn. */
+    Rectangle dst_rect;                      /**< Where the surface is on the renderer. */
+    Rectangle clip_rect;                     /**< Portion of the renderer to draw on. */
+    uint8_t opacity;                         /**< Opacity of the surface. */
+  };
 
-    SurfacePtr src_surface;                      /**< Surface to draw. */
-    Rectangle src_rect;                          /**< Region of the surface to draw. */
-    Rectangle dst_rect;                          /**< The rectangle where to draw the surface, relative to the parent surface. */
-    std::vector<SubSurfaceNodePtr> subsurfaces;  /**< Subsurfaces drawn onto src_surface. */
-};
+  std::vector<PendingList> pending_lists;    /**< Stack used to flatten drawings,
+                                              * kept to avoid allocations. */
+
+}  // Anonymous namespace.
 
 /**
  * \brief Creates a surface with the specified size.
@@ -110,7 +69,13 @@ Surface::Surface(int width, int height):
   is_rendered(false),
   opacity(255),
   width(width),
-  height(height) {
+  height(height),
+  id(next_surface_id++),
+  content_version(0),
+  recorded_stamp(0),
+  damage_tracker(nullptr),
+  atlas_allowed(false),
+  atlas_area() {
 
   Debug::check_assertion(width > 0 && height > 0,
       "Attempt to create a surface with an empty size");
@@ -132,7 +97,13 @@ Surface::Surface(SDL_Surface* internal_surface):
   internal_texture(nullptr),
   internal_color(nullptr),
   is_rendered(false),
-  opacity(255) {
+  opacity(255),
+  id(next_surface_id++),
+  content_version(0),
+  recorded_stamp(0),
+  damage_tracker(nullptr),
+  atlas_allowed(false),
+  atlas_area() {
 
   width = internal_surface->w;
   height = internal_surface->h;
@@ -152,6 +123,14 @@ Surface::Surface(SDL_Surface* internal_surface):
   }
 }
 
+/**
+ * \brief Destroys this surface.
+ */
+Surface::~Surface() {
+
+  release_atlas_area();
+}
+
 /**
  * \brief Creates a surface with the specified size.
  *
@@ -196,6 +175,7 @@ SurfacePtr Surface::create(const std::string& file_name,
   }
 
   SurfacePtr surface = std::make_shared<Surface>(sdl_surface);
+  surface->atlas_allowed = true;  // Images are usually not modified.
   return surface;
 }
 
@@ -331,6 +311,7 @@ uint8_t Surface::get_opacity() const {
  */
 void Surface::set_opacity(uint8_t opacity) {
 
+  notify_changing();
   this->opacity = opacity;
 
   if (software_destination  // The destination surface is in RAM.
@@ -344,7 +325,7 @@ void Surface::set_opacity(uint8_t opacity) {
     if (error != 0) {
       Debug::error(SDL_GetError());
     }
-    is_rendered = false;  // The surface has changed.
+    notify_changed();  // The surface has changed.
   }
 
   // If this is a hardware surface, the opacity is applied later.
@@ -365,6 +346,11 @@ std::string Surface::get_pixels() const {
     return "";  // TODO
   }
 
+  if (damage_tracker != nullptr) {
+    // Draw what was recorded before reading.
+    damage_tracker->flush();
+  }
+
   const int num_pixels = get_width() * get_height();
   if (internal_surface == nullptr) {
     // No surface: this may be a color.
@@ -454,6 +440,69 @@ void Surface::set_software_destination(bool software_destination) {
   // The software surface if any will be created lazily.
 }
 
+/**
+ * \brief Returns whether this surface only redraws regions that change
+ * between frames.
+ * \return \c true if damage tracking is active for this surface.
+ */
+bool Surface::is_damage_tracked() const {
+  return damage_tracker != nullptr;
+}
+
+/**
+ * \brief Sets whether this surface only redraws regions that change between
+ * frames.
+ *
+ * Frames are delimited by start_damage_recording() and
+ * finish_damage_recording().
+ * This has no effect if damage tracking is globally disabled
+ * (see DamageTracker::set_enabled()) or if this surface is drawn by the GPU.
+ *
+ * \param damage_tracked \c true to track the damage of this surface.
+ */
+void Surface::set_damage_tracked(bool damage_tracked) {
+
+  if (damage_tracked == is_damage_tracked()) {
+    return;
+  }
+
+  if (damage_tracked) {
+    damage_tracker = std::unique_ptr<DamageTracker>(new DamageTracker(*this));
+  }
+  else {
+    damage_tracker->flush();
+    damage_tracker = nullptr;
+  }
+}
+
+/**
+ * \brief Starts a frame of this surface.
+ *
+ * If damage is tracked, drawings onto this surface are recorded
+ * until finish_damage_recording() is called.
+ * Otherwise, does nothing.
+ */
+void Surface::start_damage_recording() {
+
+  if (damage_tracker != nullptr) {
+    damage_tracker->start();
+  }
+}
+
+/**
+ * \brief Finishes a frame of this surface.
+ *
+ * If damage is tracked, redraws the regions that changed since the previous
+ * frame.
+ * Otherwise, does nothing.
+ */
+void Surface::finish_damage_recording() {
+
+  if (damage_tracker != nullptr) {
+    damage_tracker->finish();
+  }
+}
+
 /**
  * \brief Creates an internal surface in software mode for this surface.
  */
@@ -492,6 +541,12 @@ void Surface::create_software_surface() {
  */
 void Surface::clear() {
 
+  if (damage_tracker != nullptr && damage_tracker->record_clear()) {
+    // Cleared when the frame is finished.
+    return;
+  }
+
+  notify_changing();
   clear_subsurfaces();
 
   internal_color = nullptr;
@@ -512,6 +567,7 @@ void Surface::clear() {
       internal_surface = nullptr;
     }
   }
+  notify_changed();
 }
 
 /**
@@ -532,12 +588,16 @@ void Surface::clear(const Rectangle& where) {
     return;
   }
 
+  if (damage_tracker != nullptr) {
+    damage_tracker->flush();
+  }
+  notify_changing();
   SDL_FillRect(
       internal_surface.get(),
       where.get_internal_rect(),
       get_color_value(Color::transparent)
   );
-  is_rendered = false;  // The surface has changed.
+  notify_changed();  // The surface has changed.
 }
 
 /**
@@ -564,6 +624,16 @@ void Surface::fill_with_color(const Color& color) {
  */
 void Surface::fill_with_color(const Color& color, const Rectangle& where) {
 
+  if (!software_destination && Video::is_acceleration_enabled()) {
+    // Just store the color, no surface is needed in GPU.
+    if (is_rendered) {
+      clear_subsurfaces();
+    }
+    DrawArena::add_fill(subsurfaces, color, where);
+    notify_changed();
+    return;
+  }
+
   // Create a surface with the requested size and color and draw it.
   SurfacePtr colored_surface = Surface::create(where.get_size());
   colored_surface->set_software_destination(false);
@@ -582,19 +652,12 @@ void Surface::add_subsurface(
     const Rectangle& region,
     const Point& dst_position) {
 
-  SubSurfaceNodePtr node(new SubSurfaceNode(
-      src_surface,
-      region,
-      Rectangle(dst_position),
-      src_surface->subsurfaces
-  ));
-
   // Clear the subsurface queue if the current dst_surface has already been rendered.
   if (is_rendered) {
     clear_subsurfaces();
   }
 
-  subsurfaces.push_back(node);
+  DrawArena::add(subsurfaces, src_surface, src_surface->subsurfaces, region, dst_position);
 }
 
 /**
@@ -602,7 +665,7 @@ void Surface::add_subsurface(
  */
 void Surface::clear_subsurfaces() {
 
-  subsurfaces.clear();
+  DrawArena::clear(subsurfaces);
 }
 
 /**
@@ -631,6 +694,11 @@ void Surface::raw_draw_region(
       || !Video::is_acceleration_enabled()  // The rendering is in RAM.
   ) {
 
+    if (damage_tracker != nullptr) {
+      // This surface is read: draw what was recorded on it first.
+      damage_tracker->flush();
+    }
+
     if (dst_surface.internal_surface == nullptr) {
       dst_surface.create_software_surface();
     }
@@ -638,31 +706,44 @@ void Surface::raw_draw_region(
     // First, draw subsurfaces if any.
     // They can exist if the video mode recently switched from an accelerated
     // one to a software one.
-    if (!subsurfaces.empty()) {
+    if (!DrawArena::is_empty(subsurfaces)) {
 
       if (this->internal_surface == nullptr) {
         create_software_surface();
       }
 
-      std::vector<SubSurfaceNodePtr> subsurfaces = this->subsurfaces;
-      this->subsurfaces.clear();  // Avoid infinite recursive calls if there are cycles.
-
-      for (SubSurfaceNodePtr& subsurface: subsurfaces) {
-
-        // TODO draw the subsurfaces of the whole tree recursively instead.
-        // The current version is not correct because it handles only one level
-        // (it ignores subsurface->subsurfaces).
-        // Plus it needs the workaround above to avoid a stack overflow.
-        subsurface->src_surface->raw_draw_region(
-            subsurface->src_rect,
-            *this,
-            subsurface->dst_rect.get_xy()
-        );
-        subsurface = nullptr;
+      DrawArena::List subsurfaces = this->subsurfaces;
+      clear_subsurfaces();  // Avoid infinite recursive calls if there are cycles.
+
+      int index = subsurfaces.first;
+      for (int i = 0; i < subsurfaces.size; ++i) {
+        // Copy the record: drawing it may add records and move the others.
+        const DrawArena::Record subsurface = DrawArena::get_record(index);
+        index = subsurface.next;
+
+        // Subsurfaces of subsurface are drawn by this recursive call.
+        if (subsurface.src_surface != nullptr) {
+          subsurface.src_surface->raw_draw_region(
+              subsurface.src_rect,
+              *this,
+              subsurface.dst_rect.get_xy()
+          );
+        }
+        else {
+          fill_with_color(subsurface.color, subsurface.dst_rect);
+        }
       }
       clear_subsurfaces();
     }
 
+    if (dst_surface.damage_tracker != nullptr &&
+        dst_surface.damage_tracker->is_recording()) {
+      // Only draw the regions that changed, when the frame is finished.
+      dst_surface.damage_tracker->record_draw(*this, region, dst_position);
+      return;
+    }
+
+    dst_surface.notify_changing();
     if (this->internal_surface != nullptr) {
       // The source surface is not empty: draw it onto the destination.
 
@@ -710,14 +791,14 @@ void Surface::raw_draw_region(
   }
   else {
     // The destination is a GPU surface (a texture).
-    // Do not draw anything, just store the operation in the tree instead.
+    // Do not draw anything, just store the operation in the draw arena instead.
     // The actual drawing will be done at rendering time in GPU.
 
     SurfacePtr src_surface = std::static_pointer_cast<Surface>(shared_from_this());
     dst_surface.add_subsurface(src_surface, region, dst_position);
   }
 
-  dst_surface.is_rendered = false;
+  dst_surface.notify_changed();
 }
 
 /**
@@ -755,6 +836,14 @@ void Surface::apply_pixel_filter(
   Debug::check_assertion(dst_internal_surface != nullptr,
       "Missing software destination surface for pixel filter");
 
+  if (damage_tracker != nullptr) {
+    damage_tracker->flush();
+  }
+  if (dst_surface.damage_tracker != nullptr) {
+    dst_surface.damage_tracker->flush();
+  }
+  dst_surface.notify_changing();
+
   SDL_LockSurface(src_internal_surface);
   SDL_LockSurface(dst_internal_surface);
 
@@ -767,38 +856,120 @@ void Surface::apply_pixel_filter(
   SDL_UnlockSurface(src_internal_surface);
 
   // The destination surface has changed.
-  dst_surface.is_rendered = false;
+  dst_surface.notify_changed();
 }
 
 /**
  * \brief Draws the internal texture if any, and all subtextures on the
  * renderer.
+ *
+ * The drawings recorded in the draw arena are flattened in their painter's
+ * order into a render queue, without recursion.
+ *
  * \param renderer The renderer where to draw.
  */
 void Surface::render(SDL_Renderer* renderer) {
 
   const Rectangle size(get_size());
-  render(renderer, size, size, size, 255, subsurfaces);
+  RenderQueue queue;
+  const uint8_t current_opacity = render_self(renderer, queue, size, size, size, 255);
+
+  pending_lists.clear();
+  if (!DrawArena::is_empty(subsurfaces)) {
+    pending_lists.push_back({ subsurfaces.first, subsurfaces.size, size, size, size, current_opacity });
+  }
+
+  while (!pending_lists.empty()) {
+
+    PendingList& parent = pending_lists.back();
+    if (parent.remaining == 0) {
+      pending_lists.pop_back();
+      continue;
+    }
+
+    // subsurface has to be drawn on the parent surface.
+    const DrawArena::Record& subsurface = DrawArena::get_record(parent.next);
+    parent.next = subsurface.next;
+    --parent.remaining;
+
+    // Calculate absolute destination subrectangle position on screen.
+    const Rectangle subsurface_dst_rect(
+        parent.dst_rect.get_xy() + subsurface.dst_rect.get_xy() - parent.src_rect.get_xy(),
+        subsurface.src_rect.get_size()
+    );
+
+    // Set the intersection of the subsurface destination and the parent's clip as clipping rectangle.
+    Rectangle subsurface_clip_rect;
+    if (!SDL_IntersectRect(subsurface_dst_rect.get_internal_rect(),
+        parent.clip_rect.get_internal_rect(),
+        subsurface_clip_rect.get_internal_rect())) {
+      continue;
+    }
+
+    if (subsurface.src_surface == nullptr) {
+      // A color.
+      uint8_t r, g, b, a;
+      subsurface.color.get_components(r, g, b, a);
+      queue.add_fill(r, g, b, std::min(a, parent.opacity), subsurface_clip_rect);
+      continue;
+    }
+
+    const uint8_t subsurface_opacity = subsurface.src_surface->render_self(
+        renderer,
+        queue,
+        subsurface.src_rect,
+        subsurface_dst_rect,
+        subsurface_clip_rect,
+        parent.opacity
+    );
+
+    // Then what was drawn onto it. This invalidates parent.
+    if (subsurface.children.size > 0) {
+      pending_lists.push_back({
+          subsurface.children.first,
+          subsurface.children.size,
+          subsurface.src_rect,
+          subsurface_dst_rect,
+          subsurface_clip_rect,
+          subsurface_opacity
+      });
+    }
+  }
+
+  queue.submit(renderer);
+  DrawArena::finish_frame();
 }
 
 /**
- * \brief Renders the internal texture if any, and all subsurfaces that are
- * drawn onto it.
+ * \brief Removes the pixels of this surface from the texture atlas if they
+ * are there.
+ */
+void Surface::release_atlas_area() {
+
+  if (atlas_area.texture != nullptr) {
+    TextureAtlas::remove(atlas_area);
+    is_rendered = false;
+  }
+}
+
+/**
+ * \brief Renders the internal texture if any, but not the subsurfaces that
+ * are drawn onto it.
  * \param renderer The renderer where to draw.
+ * \param queue The queue where to add drawings.
  * \param src_rect The subrectangle of the texture to draw.
  * \param dst_rect The position where to draw on the renderer.
  * \param clip_rect A portion of the renderer where to restrict the drawing.
  * \param opacity The opacity of the parent surface.
- * \param subsurfaces The subsurfaces drawn onto this texture. They will be
- * renderered recursively.
+ * \return The opacity to use for the subsurfaces.
  */
-void Surface::render(
+uint8_t Surface::render_self(
     SDL_Renderer* renderer,
+    RenderQueue& queue,
     const Rectangle& src_rect,
     const Rectangle& dst_rect,
     const Rectangle& clip_rect,
-    uint8_t opacity,
-    const std::vector<SubSurfaceNodePtr>& subsurfaces
+    uint8_t opacity
 ) {
 
   //FIXME SDL_RenderSetClipRect is buggy for now, but should be fixed soon.
@@ -808,7 +979,20 @@ void Surface::render(
   // Accelerate the internal software surface.
   if (internal_surface != nullptr) {
 
-    if (internal_texture == nullptr) {
+    if (atlas_allowed &&
+        internal_texture == nullptr &&
+        !TextureAtlas::is_valid(atlas_area) &&
+        RenderQueue::is_batching_enabled()) {
+      // Share a texture with other images.
+      if (TextureAtlas::add(renderer, *internal_surface, atlas_area)) {
+        SDL_GetSurfaceAlphaMod(internal_surface.get(), &this->opacity);
+      }
+    }
+
+    if (TextureAtlas::is_valid(atlas_area)) {
+      // Already uploaded, and the pixels do not change.
+    }
+    else if (internal_texture == nullptr) {
       create_texture_from_surface();
     }
 
@@ -816,14 +1000,34 @@ void Surface::render(
     else if (
         (software_destination || !Video::is_acceleration_enabled())
          && !is_rendered) {
-      SDL_UpdateTexture(
-          internal_texture.get(),
-          nullptr,
-          internal_surface->pixels,
-          internal_surface->pitch
-      );
+      std::vector<Rectangle> damage;
+      if (damage_tracker != nullptr && damage_tracker->get_render_damage(damage)) {
+        // Only upload the rectangles that changed.
+        const uint8_t* pixels = static_cast<const uint8_t*>(internal_surface->pixels);
+        const int bytes_per_pixel = internal_surface->format->BytesPerPixel;
+        for (const Rectangle& rectangle : damage) {
+          SDL_UpdateTexture(
+              internal_texture.get(),
+              rectangle.get_internal_rect(),
+              pixels + rectangle.get_y() * internal_surface->pitch + rectangle.get_x() * bytes_per_pixel,
+              internal_surface->pitch
+          );
+        }
+      }
+      else {
+        SDL_UpdateTexture(
+            internal_texture.get(),
+            nullptr,
+            internal_surface->pixels,
+            internal_surface->pitch
+        );
+      }
       SDL_GetSurfaceAlphaMod(internal_surface.get(), &this->opacity);
     }
+
+    if (damage_tracker != nullptr) {
+      damage_tracker->clear_render_damage();
+    }
   }
 
   const uint8_t current_opacity = std::min(this->opacity, opacity);
@@ -833,54 +1037,35 @@ void Surface::render(
     uint8_t r, g, b, a;
     internal_color->get_components(r, g, b, a);
 
-    SDL_SetRenderDrawColor(renderer, r, g, b, std::min((uint8_t) a, current_opacity));
     //SDL_RenderSetClipRect(renderer, clip_rect.get_internal_rect());
-    SDL_RenderFillRect(renderer, clip_rect.get_internal_rect());
+    queue.add_fill(r, g, b, std::min((uint8_t) a, current_opacity), clip_rect);
   }
 
   // Draw the internal texture.
-  if (internal_texture != nullptr) {
-    SDL_SetTextureAlphaMod(internal_texture.get(), current_opacity);
+  if (TextureAtlas::is_valid(atlas_area)) {
+    Rectangle atlas_src_rect(src_rect);
+    atlas_src_rect.add_xy(atlas_area.rect.get_xy());
+    queue.add_copy(
+        atlas_area.texture,
+        get_sdl_blend_mode(),
+        current_opacity,
+        atlas_src_rect,
+        dst_rect
+    );
+  }
+  else if (internal_texture != nullptr) {
     //SDL_RenderSetClipRect(renderer, clip_rect.get_internal_rect());
-
-    SDL_RenderCopy(
-        renderer,
+    queue.add_copy(
         internal_texture.get(),
-        src_rect.get_internal_rect(),
-        dst_rect.get_internal_rect()
+        get_sdl_blend_mode(),
+        current_opacity,
+        src_rect,
+        dst_rect
     );
   }
 
-  // The surface is rendered. Now draw all subtextures.
-  for (const SubSurfaceNodePtr& subsurface: subsurfaces) {
-
-    // subsurface has to be drawn on this surface
-
-    // Calculate absolute destination subrectangle position on screen.
-    Rectangle subsurface_dst_rect(
-        dst_rect.get_xy() + subsurface->dst_rect.get_xy() - src_rect.get_xy(),
-        subsurface->src_rect.get_size()
-    );
-
-    // Set the intersection of the subsurface destination and this surface's clip as clipping rectangle.
-    Rectangle superimposed_clip_rect;
-    if (SDL_IntersectRect(subsurface_dst_rect.get_internal_rect(),
-        clip_rect.get_internal_rect(),
-        superimposed_clip_rect.get_internal_rect())) {
-
-      // If there is an intersection, render the subsurface.
-      subsurface->src_surface->render(
-          renderer,
-          subsurface->src_rect,
-          subsurface_dst_rect,
-          superimposed_clip_rect,
-          current_opacity,
-          subsurface->subsurfaces
-      );
-    }
-  }
-
   is_rendered = true;
+  return current_opacity;
 }
 
 /**
@@ -1006,6 +1191,38 @@ SDL_BlendMode Surface::get_sdl_blend_mode() const {
   return SDL_BLENDMODE_BLEND;
 }
 
+/**
+ * \brief Function called before the pixels or the opacity of this surface
+ * change.
+ *
+ * Damage recordings that already use this surface as a source are flushed.
+ */
+void Surface::notify_changing() const {
+
+  DamageTracker::notify_source_changed(*this);
+}
+
+/**
+ * \brief Function called after the pixels or the opacity of this surface
+ * have changed.
+ */
+void Surface::notify_changed() {
+
+  is_rendered = false;
+  ++content_version;
+
+  if (atlas_allowed) {
+    // The texture atlas only keeps images that do not change.
+    atlas_allowed = false;
+    release_atlas_area();
+  }
+
+  if (damage_tracker != nullptr && !damage_tracker->is_replaying()) {
+    // Modified outside the damage tracking: what is displayed is unknown.
+    damage_tracker->invalidate();
+  }
+}
+
 /**
  * \brief Returns the name identifying this type in Lua.
  * \return the name identifying this type in Lua
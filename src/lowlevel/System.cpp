@@ -22,6 +22,7 @@
 #include "solarus/lowlevel/Sound.h"
 #include "solarus/lowlevel/System.h"
 #include "solarus/lowlevel/Video.h"
+#include "solarus/ResourceCache.h"
 #include "solarus/Sprite.h"
 #include <SDL.h>
 #ifdef SOLARUS_USE_APPLE_POOL
@@ -48,6 +49,9 @@ void System::initialize(const Arguments& args) {
   initial_time = get_real_time();
   ticks = 0;
 
+  // cache of loaded resources
+  ResourceCache::initialize(args);
+
   // audio
   Sound::initialize(args);
 
@@ -75,6 +79,7 @@ void System::quit() {
   Sound::quit();
   Sprite::quit();
   FontResource::quit();
+  ResourceCache::quit();
   Video::quit();
 
   SDL_Quit();
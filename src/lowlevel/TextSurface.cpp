@@ -27,10 +27,111 @@
 #include "solarus/lua/LuaTools.h"
 #include "solarus/Transition.h"
 #include <lua.hpp>
+#include <algorithm>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Decodes a UTF-8 character of a string.
+ * \param[in] text A UTF-8 string.
+ * \param[in] index Index of the first byte of the character.
+ * \param[out] code_point The character decoded.
+ * \return Number of bytes of the character, 0 if the string ends before
+ * the character is complete, or -1 if the character is not in the basic
+ * multilingual plane or is invalid.
+ */
+int decode_utf8(const std::string& text, size_t index, uint16_t& code_point) {
+
+  const uint8_t first_byte = static_cast<uint8_t>(text[index]);
+  int length = 0;
+  if ((first_byte & 0x80) == 0x00) {
+    code_point = first_byte;
+    return 1;
+  }
+  else if ((first_byte & 0xE0) == 0xC0) {
+    code_point = first_byte & 0x1F;
+    length = 2;
+  }
+  else if ((first_byte & 0xF0) == 0xE0) {
+    code_point = first_byte & 0x0F;
+    length = 3;
+  }
+  else {
+    return -1;
+  }
+
+  for (int i = 1; i < length; ++i) {
+    if (index + i >= text.size()) {
+      return 0;
+    }
+    const uint8_t next_byte = static_cast<uint8_t>(text[index + i]);
+    if ((next_byte & 0xC0) != 0x80) {
+      return -1;
+    }
+    code_point = (code_point << 6) | (next_byte & 0x3F);
+  }
+  return length;
+}
+
+/**
+ * \brief Draws a white glyph of an atlas in a color.
+ *
+ * Like when a whole text is rendered, the pixels of a glyph that overlap
+ * the previous glyph only make it more opaque.
+ *
+ * \param atlas The glyph atlas image.
+ * \param src_rect Region of the glyph in the atlas.
+ * \param dst_surface Where to draw the glyph.
+ * \param dst_xy Where to draw the glyph on the destination surface.
+ * \param color Color of the text.
+ */
+void draw_glyph(
+    SDL_Surface& atlas,
+    const Rectangle& src_rect,
+    SDL_Surface& dst_surface,
+    const Point& dst_xy,
+    const Color& color) {
+
+  // Both images have the video pixel format.
+  const SDL_PixelFormat& format = *dst_surface.format;
+  uint8_t r, g, b, a;
+  color.get_components(r, g, b, a);
+  const uint32_t rgb = SDL_MapRGBA(&format, r, g, b, 0) & ~format.Amask;
+
+  const int min_x = std::max(0, -dst_xy.x);
+  const int max_x = std::min(src_rect.get_width(), dst_surface.w - dst_xy.x);
+  const int min_y = std::max(0, -dst_xy.y);
+  const int max_y = std::min(src_rect.get_height(), dst_surface.h - dst_xy.y);
+
+  SDL_LockSurface(&atlas);
+  SDL_LockSurface(&dst_surface);
+  for (int y = min_y; y < max_y; ++y) {
+    const uint32_t* src_row = reinterpret_cast<const uint32_t*>(
+        static_cast<const uint8_t*>(atlas.pixels) + (src_rect.get_y() + y) * atlas.pitch
+    ) + src_rect.get_x();
+    uint32_t* dst_row = reinterpret_cast<uint32_t*>(
+        static_cast<uint8_t*>(dst_surface.pixels) + (dst_xy.y + y) * dst_surface.pitch
+    ) + dst_xy.x;
+    for (int x = min_x; x < max_x; ++x) {
+      const uint32_t src_alpha = (src_row[x] & format.Amask) >> format.Ashift;
+      const uint32_t alpha = src_alpha * a / 255;
+      const uint32_t dst_alpha = (dst_row[x] & format.Amask) >> format.Ashift;
+      if (alpha > dst_alpha) {
+        dst_row[x] = rgb | (alpha << format.Ashift);
+      }
+    }
+  }
+  SDL_UnlockSurface(&dst_surface);
+  SDL_UnlockSurface(&atlas);
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Creates a text to draw with the default properties.
  *
@@ -70,7 +171,12 @@ TextSurface::TextSurface(int x, int y,
   x(x),
   y(y),
   surface(nullptr),
-  text() {
+  text(),
+  text_width(0),
+  glyph_layout(false),
+  laid_out_size(0),
+  pen_x(0),
+  previous_code_point(0) {
 
   if (font_id.empty()) {
     Debug::error("This quest has no fonts");
@@ -321,6 +427,8 @@ const std::string& TextSurface::get_text() const {
  * \brief Sets the string drawn.
  *
  * If the specified string is the same than the current text, nothing is done.
+ * If the glyph cache is enabled and the specified string only adds
+ * characters to the current text, only these characters are drawn.
  *
  * \param text the text to display (cannot be nullptr)
  */
@@ -330,7 +438,17 @@ void TextSurface::set_text(const std::string& text) {
     return;
   }
 
+  const bool appended = glyph_layout &&
+      FontResource::is_glyph_cache_enabled() &&
+      text.size() > this->text.size() &&
+      text.compare(0, this->text.size(), this->text) == 0;
+
   this->text = text;
+
+  if (appended && add_glyphs()) {
+    update_text_position();
+    return;
+  }
   rebuild();
 }
 
@@ -346,7 +464,7 @@ void TextSurface::add_char(char c) {
 }
 
 /**
- * \brief Returns the width of the surface containing the text.
+ * \brief Returns the width of the text.
  * \return the width in pixels
  */
 int TextSurface::get_width() const {
@@ -355,7 +473,7 @@ int TextSurface::get_width() const {
     return 0;
   }
 
-  return surface->get_width();
+  return text_width;
 }
 
 /**
@@ -387,6 +505,11 @@ Size TextSurface::get_size() const {
 void TextSurface::rebuild() {
 
   surface = nullptr;
+  text_width = 0;
+  glyph_layout = false;
+  laid_out_size = 0;
+  pen_x = 0;
+  previous_code_point = 0;
 
   if (font_id.empty()) {
     return;
@@ -402,14 +525,37 @@ void TextSurface::rebuild() {
       std::string("No such font: '") + font_id + "'"
   );
 
+  if (FontResource::is_glyph_cache_enabled()) {
+    glyph_layout = add_glyphs();
+    if (glyph_layout) {
+      update_text_position();
+      return;
+    }
+
+    // Some characters are not supported by the glyph cache.
+    surface = nullptr;
+    laid_out_size = 0;
+    pen_x = 0;
+    previous_code_point = 0;
+  }
+
   if (FontResource::is_bitmap_font(font_id)) {
     rebuild_bitmap();
   }
   else {
     rebuild_ttf();
   }
+  text_width = surface->get_width();
+
+  update_text_position();
+}
+
+/**
+ * \brief Calculates the coordinates of the top-left corner of the text
+ * from its size and its alignment.
+ */
+void TextSurface::update_text_position() {
 
-  // calculate the coordinates of the top-left corner
   int x_left = 0, y_top = 0;
 
   switch (horizontal_alignment) {
@@ -419,11 +565,11 @@ void TextSurface::rebuild() {
     break;
 
   case HorizontalAlignment::CENTER:
-    x_left = x - surface->get_width() / 2;
+    x_left = x - get_width() / 2;
     break;
 
   case HorizontalAlignment::RIGHT:
-    x_left = x - surface->get_width();
+    x_left = x - get_width();
     break;
   }
 
@@ -434,11 +580,11 @@ void TextSurface::rebuild() {
     break;
 
   case VerticalAlignment::MIDDLE:
-    y_top = y - surface->get_height() / 2;
+    y_top = y - get_height() / 2;
     break;
 
   case VerticalAlignment::BOTTOM:
-    y_top = y - surface->get_height();
+    y_top = y - get_height();
     break;
   }
 
@@ -527,6 +673,171 @@ void TextSurface::rebuild_ttf() {
   surface = std::make_shared<Surface>(internal_surface);
 }
 
+/**
+ * \brief Draws the characters of the text that are not on the surface yet.
+ *
+ * The surface is created or enlarged if necessary. It is made larger than
+ * the text so that characters added later often fit without redrawing
+ * the previous ones.
+ *
+ * \return \c false if the text has characters that the glyph cache does
+ * not support. Nothing is drawn in this case.
+ */
+bool TextSurface::add_glyphs() {
+
+  if (FontResource::is_bitmap_font(font_id)) {
+    return add_bitmap_glyphs();
+  }
+  return add_ttf_glyphs();
+}
+
+/**
+ * \brief Draws the characters not on the surface yet in the case of a
+ * bitmap font.
+ * \return \c true.
+ */
+bool TextSurface::add_bitmap_glyphs() {
+
+  const SurfacePtr& bitmap = FontResource::get_bitmap_font(font_id);
+  const Size& bitmap_size = bitmap->get_size();
+  int char_width = bitmap_size.width / 128;
+  int char_height = bitmap_size.height / 16;
+
+  // Find the new characters.
+  std::vector<Rectangle> new_glyphs;
+  size_t size = laid_out_size;
+  while (size < text.size()) {
+    char first_byte = text[size];
+    Rectangle src_position(0, 0, char_width, char_height);
+    if ((first_byte & 0xE0) != 0xC0) {
+      // This character uses one byte.
+      src_position.set_xy(first_byte * char_width, 0);
+      ++size;
+    }
+    else {
+      // This character uses two bytes.
+      if (size + 1 >= text.size()) {
+        // Incomplete character: wait for the rest of it.
+        break;
+      }
+      char second_byte = text[size + 1];
+      uint16_t code_point = ((first_byte & 0x1F) << 6) | (second_byte & 0x3F);
+      src_position.set_xy((code_point % 128) * char_width,
+          (code_point / 128) * char_height);
+      size += 2;
+    }
+    new_glyphs.push_back(src_position);
+  }
+
+  const int width = pen_x + (char_width - 1) * static_cast<int>(new_glyphs.size()) + 1;
+  if (surface == nullptr || width > surface->get_width()) {
+    // Not enough room: draw everything again on a larger surface.
+    surface = Surface::create(laid_out_size == 0 ? width : width * 2, char_height);
+    if (laid_out_size > 0) {
+      laid_out_size = 0;
+      pen_x = 0;
+      return add_bitmap_glyphs();
+    }
+  }
+
+  Point dst_position(pen_x, 0);
+  for (const Rectangle& src_position: new_glyphs) {
+    bitmap->draw_region(src_position, surface, dst_position);
+    dst_position.x += char_width - 1;
+  }
+
+  laid_out_size = size;
+  pen_x = dst_position.x;
+  text_width = width;
+  return true;
+}
+
+/**
+ * \brief Draws the characters not on the surface yet in the case of a
+ * normal font.
+ * \return \c false if the text has characters out of the basic
+ * multilingual plane.
+ */
+bool TextSurface::add_ttf_glyphs() {
+
+  FontResource::GlyphAtlas& atlas = FontResource::get_glyph_atlas(
+      font_id, font_size, rendering_mode);
+
+  // Find the new characters and where they go.
+  std::vector<std::pair<const FontResource::Glyph*, int>> new_glyphs;
+  size_t size = laid_out_size;
+  int x = pen_x;
+  uint16_t previous = previous_code_point;
+  int width = text_width;
+  while (size < text.size()) {
+    uint16_t code_point = 0;
+    const int length = decode_utf8(text, size, code_point);
+    if (length < 0) {
+      return false;
+    }
+    if (length == 0) {
+      // Incomplete character: wait for the rest of it.
+      break;
+    }
+
+    if (previous != 0) {
+      x += atlas.get_kerning(previous, code_point);
+    }
+    const FontResource::Glyph& glyph = atlas.get_glyph(code_point);
+    if (size == 0 && glyph.bearing < 0) {
+      // Like a whole-text render, start after what exceeds on the left.
+      x = -glyph.bearing;
+    }
+    new_glyphs.emplace_back(&glyph, x + glyph.bearing);
+    width = std::max(width, x + glyph.bearing + glyph.rect.get_width());
+    x += glyph.advance;
+    width = std::max(width, x);
+    previous = code_point;
+    size += length;
+  }
+
+  const int height = atlas.get_line_height();
+  if (surface == nullptr ||
+      width > surface->get_width() ||
+      height > surface->get_height()) {
+    // Not enough room: draw everything again on a larger surface.
+    surface = Surface::create(std::max(1, laid_out_size == 0 ? width : width * 2), height);
+    surface->create_software_surface();
+    if (laid_out_size > 0) {
+      laid_out_size = 0;
+      pen_x = 0;
+      previous_code_point = 0;
+      text_width = 0;
+      return add_ttf_glyphs();
+    }
+  }
+
+  // Copy the glyphs from the atlas, which may have grown meanwhile,
+  // in the color of the text.
+  SDL_Surface* atlas_surface = atlas.get_surface();
+  surface->notify_changing();
+  for (const auto& new_glyph: new_glyphs) {
+    const Rectangle& src_rect = new_glyph.first->rect;
+    if (src_rect.is_flat()) {
+      continue;
+    }
+    draw_glyph(
+        *atlas_surface,
+        src_rect,
+        *surface->internal_surface,
+        Point(new_glyph.second, 0),
+        text_color
+    );
+  }
+  surface->notify_changed();
+
+  laid_out_size = size;
+  pen_x = x;
+  previous_code_point = previous;
+  text_width = width;
+  return true;
+}
+
 /**
  * \brief Draws the text on a surface.
  *
@@ -542,7 +853,16 @@ void TextSurface::raw_draw(Surface& dst_surface,
 
   if (surface != nullptr) {
     surface->set_blend_mode(get_blend_mode());
-    surface->raw_draw(dst_surface, dst_position + text_position);
+    if (text_width < surface->get_width()) {
+      // The surface has room for characters that may be added later.
+      surface->raw_draw_region(
+          Rectangle(0, 0, text_width, surface->get_height()),
+          dst_surface,
+          dst_position + text_position);
+    }
+    else {
+      surface->raw_draw(dst_surface, dst_position + text_position);
+    }
   }
 }
 
@@ -558,7 +878,8 @@ void TextSurface::raw_draw_region(const Rectangle& region,
   if (surface != nullptr) {
     surface->set_blend_mode(get_blend_mode());
     surface->raw_draw_region(
-        region, dst_surface,
+        region.get_intersection(Rectangle(0, 0, text_width, surface->get_height())),
+        dst_surface,
         dst_position + text_position);
   }
 }
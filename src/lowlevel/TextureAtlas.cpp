@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/TextureAtlas.h"
+#include "solarus/lowlevel/Size.h"
+#include "solarus/lowlevel/Video.h"
+#include <algorithm>
+#include <vector>
+
+namespace Solarus {
+
+namespace {
+
+  /**
+   * \brief A horizontal strip of a page where images are placed side by side.
+   */
+  struct Shelf {
+    int y;                        /**< Top of the shelf. */
+    int height;                   /**< Height of the shelf. */
+    int x;                        /**< Where the next image of the shelf goes. */
+  };
+
+  /**
+   * \brief A texture of the atlas.
+   */
+  struct Page {
+    SDL_Texture* texture;         /**< The GPU texture. */
+    std::vector<Shelf> shelves;   /**< Shelves from top to bottom. */
+    int num_areas;                /**< Number of images currently in the page. */
+  };
+
+  constexpr int max_page_size = 2048;   /**< Width and height of pages if supported. */
+  constexpr int max_num_pages = 4;      /**< Beyond this, images get their own texture. */
+  constexpr int padding = 1;            /**< Space between images to avoid filtering bleed. */
+
+  std::vector<Page> pages;              /**< The atlas pages. */
+  int page_size = 0;                    /**< Width and height of pages, 0 if not known yet. */
+  uint64_t generation = 1;              /**< Incremented when all pages are destroyed. */
+
+  /**
+   * \brief Finds space for an image in a page.
+   * \param[in] page The page.
+   * \param[in] width Width to allocate, including the padding.
+   * \param[in] height Height to allocate, including the padding.
+   * \param[out] position Top-left corner of the space found.
+   * \return \c true if there was enough space.
+   */
+  bool allocate(Page& page, int width, int height, Point& position) {
+
+    // Take the flattest shelf where the image fits.
+    Shelf* best_shelf = nullptr;
+    for (Shelf& shelf : page.shelves) {
+      if (shelf.height >= height &&
+          shelf.x + width <= page_size &&
+          (best_shelf == nullptr || shelf.height < best_shelf->height)) {
+        best_shelf = &shelf;
+      }
+    }
+
+    if (best_shelf == nullptr) {
+      // Open a new shelf below the others.
+      const int y = page.shelves.empty() ? 0 :
+          page.shelves.back().y + page.shelves.back().height;
+      if (y + height > page_size) {
+        return false;
+      }
+      page.shelves.push_back({ y, height, 0 });
+      best_shelf = &page.shelves.back();
+    }
+
+    position = Point(best_shelf->x, best_shelf->y);
+    best_shelf->x += width;
+    return true;
+  }
+
+  /**
+   * \brief Creates a new empty page.
+   * \param renderer The renderer.
+   * \return \c true in case of success.
+   */
+  bool create_page(SDL_Renderer* renderer) {
+
+    SDL_Texture* texture = SDL_CreateTexture(
+        renderer,
+        Video::get_pixel_format()->format,
+        SDL_TEXTUREACCESS_STATIC,
+        page_size,
+        page_size
+    );
+    if (texture == nullptr) {
+      return false;
+    }
+
+    // Start fully transparent so that the padding is clean.
+    const std::vector<uint32_t> transparent_pixels(page_size * page_size, 0);
+    SDL_UpdateTexture(texture, nullptr, transparent_pixels.data(), page_size * 4);
+
+    pages.push_back({ texture, {}, 0 });
+    return true;
+  }
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Destroys all pages.
+ *
+ * Areas previously returned become invalid.
+ * This must be called before the renderer is destroyed.
+ */
+void TextureAtlas::quit() {
+
+  for (Page& page : pages) {
+    SDL_DestroyTexture(page.texture);
+  }
+  pages.clear();
+  page_size = 0;
+  ++generation;
+}
+
+/**
+ * \brief Uploads an image to the atlas.
+ * \param[in] renderer The renderer that will draw the image.
+ * \param[in] surface Pixels of the image, in the video pixel format.
+ * \param[out] area Where the image was placed in case of success.
+ * \return \c true in case of success, \c false if the image is too big
+ * or if the atlas is full.
+ */
+bool TextureAtlas::add(SDL_Renderer* renderer, SDL_Surface& surface, Area& area) {
+
+  if (renderer == nullptr) {
+    return false;
+  }
+
+  if (page_size == 0) {
+    SDL_RendererInfo renderer_info;
+    page_size = max_page_size;
+    if (SDL_GetRendererInfo(renderer, &renderer_info) == 0 &&
+        renderer_info.max_texture_width > 0 &&
+        renderer_info.max_texture_height > 0) {
+      page_size = std::min(page_size, std::min(
+          renderer_info.max_texture_width, renderer_info.max_texture_height));
+    }
+  }
+
+  const int width = surface.w + padding;
+  const int height = surface.h + padding;
+  if (width > page_size / 2 || height > page_size / 2) {
+    // Big images keep their own texture.
+    return false;
+  }
+
+  Point position;
+  int page_index = -1;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    if (allocate(pages[i], width, height, position)) {
+      page_index = static_cast<int>(i);
+      break;
+    }
+  }
+
+  if (page_index == -1) {
+    if (pages.size() >= max_num_pages || !create_page(renderer)) {
+      return false;
+    }
+    page_index = static_cast<int>(pages.size()) - 1;
+    if (!allocate(pages[page_index], width, height, position)) {
+      return false;
+    }
+  }
+
+  Page& page = pages[page_index];
+  const Rectangle rect(position, Size(surface.w, surface.h));
+  SDL_UpdateTexture(page.texture, rect.get_internal_rect(), surface.pixels, surface.pitch);
+  ++page.num_areas;
+
+  area.texture = page.texture;
+  area.rect = rect;
+  area.page = page_index;
+  area.generation = generation;
+  return true;
+}
+
+/**
+ * \brief Removes an image from the atlas.
+ *
+ * The space of a page is reclaimed when it has no images anymore.
+ *
+ * \param area The area of the image. It becomes invalid.
+ */
+void TextureAtlas::remove(Area& area) {
+
+  if (is_valid(area)) {
+    Page& page = pages[area.page];
+    --page.num_areas;
+    if (page.num_areas == 0) {
+      page.shelves.clear();
+    }
+  }
+  area = Area();
+}
+
+/**
+ * \brief Returns whether an area currently refers to an image of the atlas.
+ * \param area The area to test.
+ * \return \c true if the area can be drawn.
+ */
+bool TextureAtlas::is_valid(const Area& area) {
+
+  return area.texture != nullptr && area.generation == generation;
+}
+
+/**
+ * \brief Returns the number of textures of the atlas.
+ * \return The number of pages.
+ */
+int TextureAtlas::get_num_pages() {
+
+  return static_cast<int>(pages.size());
+}
+
+}
+
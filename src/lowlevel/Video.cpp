@@ -16,15 +16,18 @@
  */
 #include "solarus/lowlevel/Color.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/DrawArena.h"
 #include "solarus/lowlevel/Hq2xFilter.h"
 #include "solarus/lowlevel/Hq3xFilter.h"
 #include "solarus/lowlevel/Hq4xFilter.h"
 #include "solarus/lowlevel/Logger.h"
 #include "solarus/lowlevel/QuestFiles.h"
 #include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/RenderQueue.h"
 #include "solarus/lowlevel/Scale2xFilter.h"
 #include "solarus/lowlevel/Size.h"
 #include "solarus/lowlevel/Surface.h"
+#include "solarus/lowlevel/TextureAtlas.h"
 #include "solarus/lowlevel/Video.h"
 #include "solarus/lowlevel/VideoMode.h"
 #include "solarus/lowlevel/shaders/ShaderContext.h"
@@ -252,6 +255,7 @@ void initialize_video_modes() {
  * Options recognized:
  *   -no-video
  *   -video-acceleration=yes|no
+ *   -render-batching=yes|no
  *   -quest-size=WIDTHxHEIGHT
  *
  * \param args Command-line arguments.
@@ -283,6 +287,8 @@ void Video::initialize(const Arguments& args) {
     acceleration_enabled = true;
   }
 
+  RenderQueue::set_batching_enabled(args.get_argument_value("-render-batching") == "yes");
+
   if (disable_window) {
     // Create a pixel format anyway to make surface and color operations work,
     // even though nothing will ever be rendered.
@@ -315,6 +321,8 @@ void Video::quit() {
     SDL_FreeFormat(pixel_format);
     pixel_format = nullptr;
   }
+  DrawArena::quit();
+  TextureAtlas::quit();
   if (main_renderer != nullptr) {
     SDL_DestroyRenderer(main_renderer);
     main_renderer = nullptr;
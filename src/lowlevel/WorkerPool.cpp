@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/WorkerPool.h"
+
+namespace Solarus {
+
+/**
+ * \brief Creates a pool and starts its threads.
+ * \param num_threads Number of worker threads, in addition to the thread
+ * that calls run(). 0 means that run() executes all tasks itself.
+ */
+WorkerPool::WorkerPool(int num_threads):
+  threads(),
+  mutex(),
+  work_available(),
+  work_done(),
+  current_task(nullptr),
+  num_tasks(0),
+  next_task(0),
+  num_tasks_running(0),
+  generation(0),
+  stopping(false) {
+
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(&WorkerPool::worker_loop, this);
+  }
+}
+
+/**
+ * \brief Stops and joins the worker threads.
+ */
+WorkerPool::~WorkerPool() {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * \brief Returns the number of worker threads.
+ * \return The number of threads, not counting the caller of run().
+ */
+int WorkerPool::get_num_threads() const {
+  return threads.size();
+}
+
+/**
+ * \brief Executes tasks in parallel and waits for all of them.
+ *
+ * Tasks may run in any order and on any thread, including the calling one.
+ * This function must not be called concurrently or from a task.
+ *
+ * \param num_tasks Number of tasks.
+ * \param task Function to call with the index of each task,
+ * between 0 and num_tasks - 1.
+ */
+void WorkerPool::run(int num_tasks, const std::function<void(int)>& task) {
+
+  if (num_tasks <= 0) {
+    return;
+  }
+
+  if (threads.empty() || num_tasks == 1) {
+    // Nothing to share.
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  current_task = &task;
+  this->num_tasks = num_tasks;
+  next_task = 0;
+  num_tasks_running = 0;
+  ++generation;
+  work_available.notify_all();
+
+  // Help the workers.
+  run_tasks(lock);
+
+  work_done.wait(lock, [this]() {
+    return next_task >= this->num_tasks && num_tasks_running == 0;
+  });
+  current_task = nullptr;
+}
+
+/**
+ * \brief Main function of a worker thread.
+ */
+void WorkerPool::worker_loop() {
+
+  std::unique_lock<std::mutex> lock(mutex);
+  unsigned last_generation = generation;
+  while (true) {
+    work_available.wait(lock, [this, last_generation]() {
+      return stopping || generation != last_generation;
+    });
+    if (stopping) {
+      return;
+    }
+    last_generation = generation;
+    run_tasks(lock);
+  }
+}
+
+/**
+ * \brief Executes tasks of the current job until none is left to start.
+ * \param lock The mutex lock, held when calling and returning.
+ */
+void WorkerPool::run_tasks(std::unique_lock<std::mutex>& lock) {
+
+  while (current_task != nullptr && next_task < num_tasks) {
+    const int index = next_task;
+    ++next_task;
+    ++num_tasks_running;
+    const std::function<void(int)>& task = *current_task;
+
+    lock.unlock();
+    task(index);
+    lock.lock();
+
+    --num_tasks_running;
+    if (next_task >= num_tasks && num_tasks_running == 0) {
+      work_done.notify_all();
+    }
+  }
+}
+
+}
+
@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lua/BinaryData.h"
+
+namespace Solarus {
+
+namespace {
+
+const char magic[] = { 'S', 'O', 'L', 'C' };  /**< First bytes of a compiled file. */
+constexpr uint32_t format_version = 1;        /**< Version of the format written. */
+constexpr size_t header_size = 24;            /**< Magic, version, source size and hash,
+                                               * string table offset and size. */
+
+/**
+ * \brief Computes the 32-bit FNV-1a hash of a buffer.
+ * \param buffer The buffer to hash.
+ * \return The hash value.
+ */
+uint32_t get_hash(const std::string& buffer) {
+
+  uint32_t hash = 2166136261u;
+  for (char c : buffer) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * \brief Appends a 32-bit value in little-endian order.
+ * \param buffer The buffer to write.
+ * \param value The value to append.
+ */
+void append_fixed(std::string& buffer, uint32_t value) {
+
+  for (int i = 0; i < 4; ++i) {
+    buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+/**
+ * \brief Reads a 32-bit value in little-endian order.
+ * \param buffer The buffer to read, with at least 4 bytes from the position.
+ * \param position Position of the value.
+ * \return The value read.
+ */
+uint32_t read_fixed(const std::string& buffer, size_t position) {
+
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(buffer[position + i])) << (8 * i);
+  }
+  return value;
+}
+
+/**
+ * \brief Appends an unsigned value with 7 bits per byte.
+ * \param buffer The buffer to write.
+ * \param value The value to append.
+ */
+void append_varint(std::string& buffer, uint32_t value) {
+
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+/**
+ * \brief Reads an unsigned value with 7 bits per byte.
+ * \param buffer The buffer to read.
+ * \param[in,out] position Position of the value, then position after it.
+ * \param end Position where reading must stop.
+ * \param[out] value The value read.
+ * \return \c false if the value is truncated or too long.
+ */
+bool read_varint(const std::string& buffer, size_t& position, size_t end, uint32_t& value) {
+
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (position >= end) {
+      return false;
+    }
+    const uint8_t byte = static_cast<uint8_t>(buffer[position]);
+    ++position;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates an empty writer.
+ */
+BinaryDataWriter::BinaryDataWriter():
+  body(),
+  strings(),
+  string_indexes() {
+
+}
+
+/**
+ * \brief Writes a signed integer.
+ * \param value The value to write.
+ */
+void BinaryDataWriter::write_int(int value) {
+
+  // Zigzag encoding to keep small negative values short.
+  const uint32_t bits = static_cast<uint32_t>(value);
+  append_varint(body, (bits << 1) ^ (value < 0 ? 0xFFFFFFFF : 0));
+}
+
+/**
+ * \brief Writes an unsigned integer.
+ * \param value The value to write.
+ */
+void BinaryDataWriter::write_uint(uint32_t value) {
+
+  append_varint(body, value);
+}
+
+/**
+ * \brief Writes a boolean.
+ * \param value The value to write.
+ */
+void BinaryDataWriter::write_bool(bool value) {
+
+  body.push_back(value ? 1 : 0);
+}
+
+/**
+ * \brief Writes a string.
+ *
+ * Only the index of the string in the string table is written in the body.
+ *
+ * \param value The value to write.
+ */
+void BinaryDataWriter::write_string(const std::string& value) {
+
+  const auto& result = string_indexes.emplace(value, strings.size());
+  if (result.second) {
+    strings.push_back(value);
+  }
+  append_varint(body, result.first->second);
+}
+
+/**
+ * \brief Returns the complete compiled file.
+ * \param source_buffer Content of the Lua data file that was compiled.
+ * Its size and hash are stored to detect outdated compiled files.
+ * \return The header, the body and the string table.
+ */
+std::string BinaryDataWriter::finish(const std::string& source_buffer) const {
+
+  std::string string_table;
+  for (const std::string& value : strings) {
+    append_varint(string_table, value.size());
+    string_table += value;
+  }
+
+  std::string buffer(magic, sizeof(magic));
+  append_fixed(buffer, format_version);
+  append_fixed(buffer, source_buffer.size());
+  append_fixed(buffer, get_hash(source_buffer));
+  append_fixed(buffer, header_size + body.size());
+  append_fixed(buffer, strings.size());
+  buffer += body;
+  buffer += string_table;
+  return buffer;
+}
+
+/**
+ * \brief Creates a reader on a compiled file.
+ *
+ * The reader is invalid if the header is incorrect or if the file was not
+ * compiled from this exact Lua data file.
+ *
+ * \param buffer Content of the compiled file.
+ * It must remain valid while the reader is used.
+ * \param source_buffer Content of the Lua data file.
+ */
+BinaryDataReader::BinaryDataReader(
+    const std::string& buffer,
+    const std::string& source_buffer
+):
+  buffer(buffer),
+  position(header_size),
+  body_end(0),
+  strings(),
+  valid(false) {
+
+  if (buffer.size() < header_size ||
+      buffer.compare(0, sizeof(magic), magic, sizeof(magic)) != 0 ||
+      read_fixed(buffer, 4) != format_version ||
+      read_fixed(buffer, 8) != source_buffer.size() ||
+      read_fixed(buffer, 12) != get_hash(source_buffer)) {
+    return;
+  }
+
+  body_end = read_fixed(buffer, 16);
+  const uint32_t num_strings = read_fixed(buffer, 20);
+  if (body_end < header_size || body_end > buffer.size()) {
+    return;
+  }
+
+  // Each string takes at least one byte: don't trust a larger count
+  // before reserving memory for it.
+  if (num_strings > buffer.size() - body_end) {
+    return;
+  }
+
+  // Locate the strings without copying them.
+  size_t string_position = body_end;
+  strings.reserve(num_strings);
+  for (uint32_t i = 0; i < num_strings; ++i) {
+    uint32_t size = 0;
+    if (!read_varint(buffer, string_position, buffer.size(), size) ||
+        size > buffer.size() - string_position) {
+      return;
+    }
+    strings.emplace_back(string_position, size);
+    string_position += size;
+  }
+
+  valid = true;
+}
+
+/**
+ * \brief Returns whether a buffer starts like a file in the binary format.
+ *
+ * This allows to tell binary files from text files that have
+ * the same name, independently of their content being valid.
+ *
+ * \param buffer The buffer to test.
+ * \return \c true if the buffer starts with the magic number.
+ */
+bool BinaryDataReader::is_binary_buffer(const std::string& buffer) {
+
+  return buffer.size() >= sizeof(magic) &&
+      buffer.compare(0, sizeof(magic), magic, sizeof(magic)) == 0;
+}
+
+/**
+ * \brief Returns whether the file is correct and all reads succeeded so far.
+ * \return \c true if the reader is valid.
+ */
+bool BinaryDataReader::is_valid() const {
+  return valid;
+}
+
+/**
+ * \brief Returns whether the whole body was read.
+ * \return \c true if there is nothing more to read.
+ */
+bool BinaryDataReader::is_at_end() const {
+  return position == body_end;
+}
+
+/**
+ * \brief Reads a signed integer.
+ * \return The value read, or 0 in case of error.
+ */
+int BinaryDataReader::read_int() {
+
+  const uint32_t bits = read_uint();
+  return static_cast<int>((bits >> 1) ^ (~(bits & 1) + 1));
+}
+
+/**
+ * \brief Reads an unsigned integer.
+ * \return The value read, or 0 in case of error.
+ */
+uint32_t BinaryDataReader::read_uint() {
+
+  uint32_t value = 0;
+  if (!valid || !read_varint(buffer, position, body_end, value)) {
+    valid = false;
+    return 0;
+  }
+  return value;
+}
+
+/**
+ * \brief Reads a boolean.
+ * \return The value read, or \c false in case of error.
+ */
+bool BinaryDataReader::read_bool() {
+
+  if (!valid || position >= body_end) {
+    valid = false;
+    return false;
+  }
+  return buffer[position++] != 0;
+}
+
+/**
+ * \brief Reads a string.
+ * \return The value read, or an empty string in case of error.
+ */
+std::string BinaryDataReader::read_string() {
+
+  const uint32_t index = read_uint();
+  if (!valid || index >= strings.size()) {
+    valid = false;
+    return "";
+  }
+  const std::pair<size_t, size_t>& string = strings[index];
+  return buffer.substr(string.first, string.second);
+}
+
+}
+
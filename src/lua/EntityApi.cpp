@@ -5070,6 +5070,7 @@ int LuaContext::enemy_api_create_enemy(lua_State* l) {
     Game& game = map.get_game();
     const EntityPtr& entity = Enemy::create(
         game,
+        map.get_entities(),
         breed,
         savegame_variable,
         name,
@@ -5622,10 +5623,7 @@ int LuaContext::custom_entity_api_set_modified_ground(lua_State* l) {
  */
 void LuaContext::entity_on_update(Entity& entity) {
 
-  // This particular method is tried so often that we want to optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (!userdata_has_field(entity, method_name)) {
+  if (!userdata_has_event(entity, TrackedEvent::ON_UPDATE)) {
     return;
   }
 
@@ -5733,7 +5731,7 @@ void LuaContext::entity_on_disabled(Entity& entity) {
  */
 void LuaContext::entity_on_pre_draw(Entity& entity) {
 
-  if (!userdata_has_field(entity, "on_pre_draw")) {
+  if (!userdata_has_event(entity, TrackedEvent::ON_PRE_DRAW)) {
     return;
   }
 
@@ -5751,7 +5749,7 @@ void LuaContext::entity_on_pre_draw(Entity& entity) {
  */
 void LuaContext::entity_on_post_draw(Entity& entity) {
 
-  if (!userdata_has_field(entity, "on_post_draw")) {
+  if (!userdata_has_event(entity, TrackedEvent::ON_POST_DRAW)) {
     return;
   }
 
@@ -5772,7 +5770,7 @@ void LuaContext::entity_on_post_draw(Entity& entity) {
 void LuaContext::entity_on_position_changed(
     Entity& entity, const Point& xy, int layer) {
 
-  if (!userdata_has_field(entity, "on_position_changed")) {
+  if (!userdata_has_event(entity, TrackedEvent::ON_POSITION_CHANGED)) {
     return;
   }
 
@@ -26,7 +26,8 @@ namespace Solarus {
 ExportableToLua::ExportableToLua():
   lua_context(nullptr),
   known_to_lua(false),
-  with_lua_table(false) {
+  with_lua_table(false),
+  lua_events(0) {
 
 }
 
@@ -96,5 +97,23 @@ void ExportableToLua::set_with_lua_table(bool with_lua_table) {
   this->with_lua_table = with_lua_table;
 }
 
+/**
+ * \brief Returns the events tracked by LuaContext that are defined in the
+ * Lua table of this userdata.
+ * \return Bits of the defined events (see LuaContext::TrackedEvent).
+ */
+uint32_t ExportableToLua::get_lua_events() const {
+  return lua_events;
 }
 
+/**
+ * \brief Sets the events tracked by LuaContext that are defined in the
+ * Lua table of this userdata.
+ * \param lua_events Bits of the defined events
+ * (see LuaContext::TrackedEvent).
+ */
+void ExportableToLua::set_lua_events(uint32_t lua_events) {
+  this->lua_events = lua_events;
+}
+
+}
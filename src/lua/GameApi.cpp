@@ -26,6 +26,7 @@
 #include "solarus/Game.h"
 #include "solarus/MainLoop.h"
 #include "solarus/Savegame.h"
+#include "solarus/SavegameWriter.h"
 
 namespace Solarus {
 
@@ -165,6 +166,9 @@ int LuaContext::game_api_exists(lua_State* l) {
       LuaTools::error(l, "Cannot check savegame: no write directory was specified in quest.dat");
     }
 
+    // Wait for saves in progress.
+    SavegameWriter::flush();
+
     bool exists = QuestFiles::data_file_exists(file_name);
 
     lua_pushboolean(l, exists);
@@ -186,6 +190,9 @@ int LuaContext::game_api_delete(lua_State* l) {
       LuaTools::error(l, "Cannot delete savegame: no write directory was specified in quest.dat");
     }
 
+    // Wait for saves in progress.
+    SavegameWriter::flush();
+
     QuestFiles::data_file_delete(file_name);
 
     return 0;
@@ -616,24 +623,25 @@ int LuaContext::game_api_get_value(lua_State* l) {
     Savegame& savegame = *check_game(l, 1);
     const std::string& key = LuaTools::check_string(l, 2);
 
-    if (!LuaTools::is_valid_lua_identifier(key)) {
-      LuaTools::arg_error(l, 3,
-          std::string("Invalid savegame variable '") + key
-          + "': the name should only contain alphanumeric characters or '_'"
-          + " and cannot start with a digit");
-    }
-
-    if (savegame.is_boolean(key)) {
-      lua_pushboolean(l, savegame.get_boolean(key));
+    // Existing values have valid keys: only check the key if it is not found.
+    const Savegame::SavedValue* value = savegame.get_saved_value(key);
+    if (value == nullptr) {
+      if (!LuaTools::is_valid_lua_identifier(key)) {
+        LuaTools::arg_error(l, 3,
+            std::string("Invalid savegame variable '") + key
+            + "': the name should only contain alphanumeric characters or '_'"
+            + " and cannot start with a digit");
+      }
+      lua_pushnil(l);
     }
-    else if (savegame.is_integer(key)) {
-      lua_pushinteger(l, savegame.get_integer(key));
+    else if (value->type == Savegame::SavedValue::VALUE_BOOLEAN) {
+      lua_pushboolean(l, value->int_data != 0);
     }
-    else if (savegame.is_string(key)) {
-      lua_pushstring(l, savegame.get_string(key).c_str());
+    else if (value->type == Savegame::SavedValue::VALUE_INTEGER) {
+      lua_pushinteger(l, value->int_data);
     }
-    else {
-      lua_pushnil(l);
+    else {  // String.
+      lua_pushstring(l, value->string_data.c_str());
     }
 
     return 1;
@@ -1599,10 +1607,7 @@ void LuaContext::game_on_finished(Game& game) {
 void LuaContext::game_on_update(Game& game) {
 
   push_game(l, game.get_savegame());
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (userdata_has_field(game.get_savegame(), method_name)) {
+  if (userdata_has_event(game.get_savegame(), TrackedEvent::ON_UPDATE)) {
     on_update();
   }
   menus_on_update(-1);
@@ -1620,7 +1625,7 @@ void LuaContext::game_on_update(Game& game) {
 void LuaContext::game_on_draw(Game& game, const SurfacePtr& dst_surface) {
 
   push_game(l, game.get_savegame());
-  if (userdata_has_field(game.get_savegame(), "on_draw")) {
+  if (userdata_has_event(game.get_savegame(), TrackedEvent::ON_DRAW)) {
     on_draw(dst_surface);
   }
   menus_on_draw(-1, dst_surface);
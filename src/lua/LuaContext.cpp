@@ -30,6 +30,7 @@
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/Logger.h"
 #include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lowlevel/StringInterner.h"
 #include "solarus/lua/ExportableToLuaPtr.h"
 #include "solarus/lua/LuaContext.h"
 #include "solarus/lua/LuaTools.h"
@@ -45,13 +46,67 @@ namespace Solarus {
 
 std::map<lua_State*, LuaContext*> LuaContext::lua_contexts;
 
+namespace {
+
+/**
+ * \brief Lua names of tracked events, in the order of
+ * LuaContext::TrackedEvent.
+ */
+const char* const tracked_event_names[] = {
+    "on_update",
+    "on_draw",
+    "on_pre_draw",
+    "on_post_draw",
+    "on_position_changed"
+};
+
+/**
+ * \brief Returns the bit representing a tracked event.
+ * \param event A tracked event.
+ * \return The corresponding bit.
+ */
+uint32_t get_event_bit(LuaContext::TrackedEvent event) {
+  return 1u << static_cast<int>(event);
+}
+
+/**
+ * \brief Returns the bit representing the tracked event with a given name.
+ * \param key_id A string key interned by StringInterner, or -1.
+ * \return The bit of the tracked event with this name,
+ * or 0 if this key is not a tracked event.
+ */
+uint32_t get_event_bit_by_key(int key_id) {
+
+  static const std::vector<int> tracked_event_ids = [] {
+    std::vector<int> ids;
+    for (const char* name: tracked_event_names) {
+      ids.push_back(StringInterner::intern(name));
+    }
+    return ids;
+  }();
+
+  if (key_id == -1) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < tracked_event_ids.size(); ++i) {
+    if (tracked_event_ids[i] == key_id) {
+      return 1u << i;
+    }
+  }
+  return 0;
+}
+
+}  // Anonymous namespace.
+
 /**
  * \brief Creates a Lua context.
  * \param main_loop The Solarus main loop manager.
  */
 LuaContext::LuaContext(MainLoop& main_loop):
   l(nullptr),
-  main_loop(main_loop) {
+  main_loop(main_loop),
+  last_timer_sequence(0) {
 
 }
 
@@ -188,6 +243,7 @@ void LuaContext::exit() {
     lua_close(l);
     lua_contexts.erase(l);
     l = nullptr;
+    metatable_events.clear();
   }
 }
 
@@ -516,7 +572,8 @@ bool LuaContext::userdata_has_field(
     return false;
   }
 
-  return it->second.find(key) != it->second.end();
+  const int key_id = StringInterner::find(key);
+  return key_id != -1 && it->second.find(key_id) != it->second.end();
 }
 
 /**
@@ -550,7 +607,81 @@ bool LuaContext::userdata_has_field(
     return false;
   }
 
-  return it->second.find(key) != it->second.end();
+  const int key_id = StringInterner::find(key);
+  return key_id != -1 && it->second.find(key_id) != it->second.end();
+}
+
+/**
+ * \brief Returns whether a userdata or its type defines an event.
+ *
+ * This is equivalent to userdata_has_field() with the name of the event,
+ * but outside Lua calls, it usually costs a bit test and no Lua lookup.
+ * The metatable of the type is only checked again after Lua code ran.
+ *
+ * \param userdata A userdata.
+ * \param event The event to test.
+ * \return \c true if this event exists on the userdata or on its metatable.
+ */
+bool LuaContext::userdata_has_event(
+    const ExportableToLua& userdata, TrackedEvent event) const {
+
+  const uint32_t event_bit = get_event_bit(event);
+
+  // Events of the userdata table are tracked exactly by our __newindex.
+  if ((userdata.get_lua_events() & event_bit) != 0) {
+    return true;
+  }
+
+  // Events of the metatable can be changed in ways that no __newindex
+  // sees, like rawset() or setmetatable() on the metatable.
+  // This only happens when Lua code runs: while a Lua function is running,
+  // look up the event, otherwise the metatable is checked again only if
+  // Lua functions were called since the last check.
+  if (LuaTools::get_call_depth() > 0) {
+    return userdata_has_metafield(
+        userdata, tracked_event_names[static_cast<int>(event)]
+    );
+  }
+
+  const std::string& type_name = userdata.get_lua_type_name();
+  MetatableEvents& events = metatable_events[type_name];
+  if (!events.checked || events.num_calls != LuaTools::get_num_calls()) {
+    events.events = get_metatable_events(type_name);
+    events.num_calls = LuaTools::get_num_calls();
+    events.checked = true;
+  }
+
+  return (events.events & event_bit) != 0;
+}
+
+/**
+ * \brief Returns the tracked events currently defined on the metatable
+ * of a type.
+ * \param type_name Name of the type.
+ * \return The bits of the tracked events that exist on this metatable.
+ */
+uint32_t LuaContext::get_metatable_events(const std::string& type_name) const {
+
+  uint32_t events = 0;
+                                  // ...
+  luaL_getmetatable(l, type_name.c_str());
+                                  // ... meta/nil
+  if (lua_istable(l, -1)) {
+    for (size_t i = 0; i < sizeof(tracked_event_names) / sizeof(tracked_event_names[0]); ++i) {
+      lua_pushstring(l, tracked_event_names[i]);
+                                  // ... meta key
+      lua_rawget(l, -2);
+                                  // ... meta field/nil
+      if (!lua_isnil(l, -1)) {
+        events |= 1u << i;
+      }
+      lua_pop(l, 1);
+                                  // ... meta
+    }
+  }
+  lua_pop(l, 1);
+                                  // ...
+  return events;
 }
 
 /**
@@ -915,6 +1046,7 @@ void LuaContext::register_type(
     lua_setfield(l, -3, "__index");
                                   // meta nil
   }
+
   lua_settop(l, 0);
                                   // --
 }
@@ -1231,6 +1363,7 @@ void LuaContext::userdata_close_lua() {
     ExportableToLua* userdata = static_cast<ExportableToLua*>(
         lua_touserdata(l, -2));
     userdata->set_lua_context(nullptr);
+    userdata->set_lua_events(0);
     lua_pop(l, 1);
   }
   lua_pop(l, 1);
@@ -1301,11 +1434,21 @@ int LuaContext::userdata_meta_newindex_as_table(lua_State* l) {
   if (lua_isstring(l, 2)) {
     if (!lua_isnil(l, 3)) {
       // Add the key to the list of existing strings keys on this userdata.
-      get_lua_context(l).userdata_fields[userdata.get()].insert(lua_tostring(l, 2));
+      const int key_id = StringInterner::intern(lua_tostring(l, 2));
+      get_lua_context(l).userdata_fields[userdata.get()].insert(key_id);
+      userdata->set_lua_events(
+          userdata->get_lua_events() | get_event_bit_by_key(key_id)
+      );
     }
     else {
       // Assigning nil: remove the key from the list.
-      get_lua_context(l).userdata_fields[userdata.get()].erase(lua_tostring(l, 2));
+      const int key_id = StringInterner::find(lua_tostring(l, 2));
+      if (key_id != -1) {
+        get_lua_context(l).userdata_fields[userdata.get()].erase(key_id);
+        userdata->set_lua_events(
+            userdata->get_lua_events() & ~get_event_bit_by_key(key_id)
+        );
+      }
     }
   }
 
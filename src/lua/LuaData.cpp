@@ -16,6 +16,7 @@
  */
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lua/BinaryData.h"
 #include "solarus/lua/LuaData.h"
 #include <lua.hpp>
 #include <cstdio>
@@ -100,9 +101,43 @@ bool LuaData::import_from_quest_file(
   const std::string& buffer = QuestFiles::data_file_read(
       quest_file_name, language_specific
   );
+
+  // Prefer the compiled file if there is one up to date.
+  const std::string& compiled_file_name = get_compiled_file_name(quest_file_name);
+  if (QuestFiles::data_file_exists(compiled_file_name, language_specific)) {
+    const std::string& compiled_buffer = QuestFiles::data_file_read(
+        compiled_file_name, language_specific
+    );
+    if (import_from_compiled_buffer(compiled_buffer, buffer)) {
+      return true;
+    }
+  }
+
   return import_from_buffer(buffer, quest_file_name);
 }
 
+/**
+ * \brief Imports a compiled data file from memory to this object.
+ *
+ * Nothing is changed in case of failure.
+ *
+ * \param[in] buffer A memory area with the content of a compiled data file.
+ * \param[in] source_buffer Content of the Lua data file it should have been
+ * compiled from.
+ * \return \c true in case of success, \c false if the compiled file is
+ * invalid or outdated, or if this type of data has no binary format.
+ */
+bool LuaData::import_from_compiled_buffer(
+    const std::string& buffer,
+    const std::string& source_buffer
+) {
+  BinaryDataReader reader(buffer, source_buffer);
+  if (!reader.is_valid()) {
+    return false;
+  }
+  return import_from_binary(reader);
+}
+
 /**
  * \brief Saves this object into memory as Lua.
  * \param[out] buffer The buffer to write.
@@ -121,6 +156,28 @@ bool LuaData::export_to_buffer(std::string& buffer) const {
   return true;
 }
 
+/**
+ * \brief Saves this object into memory in the compiled binary format.
+ * \param[out] buffer The buffer to write.
+ * \param[in] source_buffer Content of the Lua data file this object was
+ * imported from.
+ * \return \c true in case of success, \c false if this type of data has
+ * no binary format.
+ */
+bool LuaData::export_to_compiled_buffer(
+    std::string& buffer,
+    const std::string& source_buffer
+) const {
+
+  BinaryDataWriter writer;
+  if (!export_to_binary(writer)) {
+    return false;
+  }
+
+  buffer = writer.finish(source_buffer);
+  return true;
+}
+
 /**
  * \brief Saves the data into a Lua file.
  * \param[in] file_name Path of the file to save.
@@ -180,6 +237,46 @@ bool LuaData::export_to_lua(std::ostream& /* out */) const {
   return false;
 }
 
+/**
+ * \brief Loads data from a compiled data file.
+ *
+ * Implementations should only modify this object if the whole data could
+ * be read, because the Lua data file is loaded instead in case of failure.
+ *
+ * \param reader The reader of the compiled file, after its header.
+ * \return \c true in case of success, \c false if the data is invalid.
+ */
+bool LuaData::import_from_binary(BinaryDataReader& /* reader */) {
+
+  // The binary format is optional. Not implemented by default.
+  return false;
+}
+
+/**
+ * \brief Saves this data in the compiled binary format.
+ * \param writer The writer of the compiled file.
+ * \return \c true in case of success, \c false if the data
+ * could not be exported.
+ */
+bool LuaData::export_to_binary(BinaryDataWriter& /* writer */) const {
+
+  // The binary format is optional. Not implemented by default.
+  return false;
+}
+
+/**
+ * \brief Returns the name of the compiled file of a data file.
+ *
+ * Compiled files are placed next to their Lua data file.
+ *
+ * \param file_name Name of a Lua data file.
+ * \return Name of the corresponding compiled file.
+ */
+std::string LuaData::get_compiled_file_name(const std::string& file_name) {
+
+  return file_name + ".bin";
+}
+
 /**
  * \brief Protects a string so that it can safely be enclosed in double quotes.
  *
@@ -25,6 +25,13 @@
 namespace Solarus {
 namespace LuaTools {
 
+namespace {
+
+int call_depth = 0;        /**< Number of call_function() not finished yet. */
+uint32_t num_calls = 0;    /**< Number of call_function() finished so far. */
+
+}  // Anonymous namespace.
+
 /**
  * \brief For an index in the Lua stack, returns an equivalent positive index.
  *
@@ -114,7 +121,12 @@ bool call_function(
     int nb_results,
     const char* function_name
 ) {
-  if (lua_pcall(l, nb_arguments, nb_results, 0) != 0) {
+  ++call_depth;
+  const int result = lua_pcall(l, nb_arguments, nb_results, 0);
+  --call_depth;
+  ++num_calls;
+
+  if (result != 0) {
     Debug::error(std::string("In ") + function_name + ": "
         + lua_tostring(l, -1)
     );
@@ -150,6 +162,26 @@ bool do_string(
   return call_function(l, 0, 0, chunk_name.c_str());
 }
 
+/**
+ * \brief Returns the number of Lua functions being called by call_function().
+ * \return 0 if no Lua code started by call_function() is running.
+ */
+int get_call_depth() {
+  return call_depth;
+}
+
+/**
+ * \brief Returns the number of Lua functions called by call_function()
+ * so far.
+ *
+ * This allows to know whether some Lua code ran since a given moment.
+ *
+ * \return The number of finished calls. It may wrap around.
+ */
+uint32_t get_num_calls() {
+  return num_calls;
+}
+
 /**
  * \brief Similar to luaL_error() but throws a LuaException.
  *
@@ -21,7 +21,9 @@
 #include "solarus/lowlevel/System.h"
 #include "solarus/CurrentQuest.h"
 #include "solarus/QuestProperties.h"
+#include "solarus/QuestResources.h"
 #include "solarus/MainLoop.h"
+#include "solarus/ResourceCache.h"
 #include "solarus/Settings.h"
 #include <lua.hpp>
 
@@ -54,6 +56,7 @@ void LuaContext::register_main_module() {
       { "get_type", main_api_get_type },
       { "get_metatable", main_api_get_metatable },
       { "get_os", main_api_get_os },
+      { "get_resource_cache_statistics", main_api_get_resource_cache_statistics },
       { nullptr, nullptr }
   };
 
@@ -374,6 +377,50 @@ int LuaContext::main_api_get_os(lua_State* l) {
   return 1;
 }
 
+/**
+ * \brief Implementation of sol.main.get_resource_cache_statistics().
+ *
+ * Returns a table with the budget and the memory size of the resource cache,
+ * and for each type of cached resource, a table with its hits, misses,
+ * evictions, number of elements and memory size.
+ *
+ * \param l The Lua context that is calling this function.
+ * \return Number of values to return to Lua.
+ */
+int LuaContext::main_api_get_resource_cache_statistics(lua_State* l) {
+
+  return LuaTools::exception_boundary_handle(l, [&] {
+    lua_newtable(l);
+    lua_pushinteger(l, ResourceCache::get_budget());
+    lua_setfield(l, -2, "budget");
+    lua_pushinteger(l, ResourceCache::get_memory_size());
+    lua_setfield(l, -2, "memory_size");
+
+    for (ResourceType resource_type : {
+        ResourceType::TILESET,
+        ResourceType::SPRITE,
+        ResourceType::SOUND,
+        ResourceType::FONT
+    }) {
+      const ResourceCache::Statistics& statistics =
+          ResourceCache::get_statistics(resource_type);
+      lua_newtable(l);
+      lua_pushinteger(l, statistics.hits);
+      lua_setfield(l, -2, "hits");
+      lua_pushinteger(l, statistics.misses);
+      lua_setfield(l, -2, "misses");
+      lua_pushinteger(l, statistics.evictions);
+      lua_setfield(l, -2, "evictions");
+      lua_pushinteger(l, statistics.num_elements);
+      lua_setfield(l, -2, "num_elements");
+      lua_pushinteger(l, statistics.memory_size);
+      lua_setfield(l, -2, "memory_size");
+      lua_setfield(l, -2, enum_to_name(resource_type).c_str());
+    }
+    return 1;
+  });
+}
+
 /**
  * \brief Calls sol.main.on_started() if it exists.
  *
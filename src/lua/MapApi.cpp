@@ -536,7 +536,7 @@ int LuaContext::l_create_pickable(lua_State* l) {
     }
 
     const std::shared_ptr<Pickable>& entity = Pickable::create(
-        game,
+        map.get_entities(),
         data.get_name(),
         entity_creation_check_layer(l, 1, data, map),
         data.get_xy(),
@@ -709,6 +709,7 @@ int LuaContext::l_create_enemy(lua_State* l) {
     Game& game = map.get_game();
     EntityPtr entity = Enemy::create(
         game,
+        map.get_entities(),
         data.get_string("breed"),
         entity_creation_check_savegame_variable_optional(l, 1, data, "savegame_variable"),
         data.get_name(),
@@ -1170,7 +1171,7 @@ int LuaContext::l_create_custom_entity(lua_State* l) {
     EntityData& data = *(static_cast<EntityData*>(lua_touserdata(l, 2)));
 
     Game& game = map.get_game();
-    EntityPtr entity = std::make_shared<CustomEntity>(
+    EntityPtr entity = map.get_entities().make_entity<CustomEntity>(
         game,
         data.get_name(),
         data.get_integer("direction"),
@@ -1200,7 +1201,7 @@ int LuaContext::l_create_bomb(lua_State* l) {
     Map& map = *check_map(l, 1);
     EntityData& data = *(static_cast<EntityData*>(lua_touserdata(l, 2)));
 
-    EntityPtr entity = std::make_shared<Bomb>(
+    EntityPtr entity = map.get_entities().make_entity<Bomb>(
         data.get_name(),
         entity_creation_check_layer(l, 1, data, map),
         data.get_xy()
@@ -1226,7 +1227,7 @@ int LuaContext::l_create_explosion(lua_State* l) {
     EntityData& data = *(static_cast<EntityData*>(lua_touserdata(l, 2)));
 
     const bool with_damage = true;
-    EntityPtr entity = std::make_shared<Explosion>(
+    EntityPtr entity = map.get_entities().make_entity<Explosion>(
         data.get_name(),
         entity_creation_check_layer(l, 1, data, map),
         data.get_xy(),
@@ -1252,7 +1253,7 @@ int LuaContext::l_create_fire(lua_State* l) {
     Map& map = *check_map(l, 1);
     EntityData& data = *(static_cast<EntityData*>(lua_touserdata(l, 2)));
 
-    EntityPtr entity = std::make_shared<Fire>(
+    EntityPtr entity = map.get_entities().make_entity<Fire>(
         data.get_name(),
         entity_creation_check_layer(l, 1, data, map),
         data.get_xy()
@@ -2222,10 +2223,7 @@ void LuaContext::map_on_finished(Map& map) {
 void LuaContext::map_on_update(Map& map) {
 
   push_map(l, map);
-  // This particular method is tried so often that we want to save optimize
-  // the std::string construction.
-  static const std::string method_name = "on_update";
-  if (userdata_has_field(map, method_name)) {
+  if (userdata_has_event(map, TrackedEvent::ON_UPDATE)) {
     on_update();
   }
   menus_on_update(-1);
@@ -2243,7 +2241,7 @@ void LuaContext::map_on_update(Map& map) {
 void LuaContext::map_on_draw(Map& map, const SurfacePtr& dst_surface) {
 
   push_map(l, map);
-  if (userdata_has_field(map, "on_draw")) {
+  if (userdata_has_event(map, TrackedEvent::ON_DRAW)) {
     on_draw(dst_surface);
   }
   menus_on_draw(-1, dst_surface);
@@ -225,6 +225,8 @@ void LuaContext::register_movement_module() {
       { "set_target", path_finding_movement_api_set_target },
       { "get_speed", path_finding_movement_api_get_speed },
       { "set_speed", path_finding_movement_api_set_speed },
+      { "is_long_range", path_finding_movement_api_is_long_range },
+      { "set_long_range", path_finding_movement_api_set_long_range },
       { nullptr, nullptr }
   };
   register_type(
@@ -1372,6 +1374,36 @@ int LuaContext::path_finding_movement_api_set_speed(lua_State* l) {
   });
 }
 
+/**
+ * \brief Implementation of path_finding_movement:is_long_range().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::path_finding_movement_api_is_long_range(lua_State* l) {
+
+  return LuaTools::exception_boundary_handle(l, [&] {
+    const PathFindingMovement& movement = *check_path_finding_movement(l, 1);
+    lua_pushboolean(l, movement.is_long_range());
+    return 1;
+  });
+}
+
+/**
+ * \brief Implementation of path_finding_movement:set_long_range().
+ * \param l the Lua context that is calling this function
+ * \return number of values to return to Lua
+ */
+int LuaContext::path_finding_movement_api_set_long_range(lua_State* l) {
+
+  return LuaTools::exception_boundary_handle(l, [&] {
+    PathFindingMovement& movement = *check_path_finding_movement(l, 1);
+    bool long_range = LuaTools::opt_boolean(l, 2, true);
+    movement.set_long_range(long_range);
+
+    return 0;
+  });
+}
+
 /**
  * \brief Returns whether a value is a userdata of type circle movement.
  * \param l A Lua context.
@@ -1941,7 +1973,7 @@ void LuaContext::movement_on_position_changed(
   }
   lua_pop(l, 2);
                                   // ... movement
-  if (userdata_has_field(movement, "on_position_changed")) {
+  if (userdata_has_event(movement, TrackedEvent::ON_POSITION_CHANGED)) {
     on_position_changed(xy);
   }
   lua_pop(l, 1);
@@ -24,6 +24,7 @@
 #include "solarus/MainLoop.h"
 #include "solarus/Map.h"
 #include "solarus/Timer.h"
+#include <algorithm>
 #include <list>
 #include <sstream>
 
@@ -139,8 +140,13 @@ void LuaContext::add_timer(
   Debug::check_assertion(timers.find(timer) == timers.end(),
       "Duplicate timer in the system");
 
-  timers[timer].callback_ref = callback_ref;
-  timers[timer].context = context;
+  std::list<TimerPtr>& context_timers = timers_by_context[context];
+  LuaTimerData& timer_data = timers[timer];
+  timer_data.callback_ref = callback_ref;
+  timer_data.context = context;
+  timer_data.context_it = context_timers.insert(context_timers.end(), timer);
+  timer_data.scheduled_sequence = 0;
+  timer_data.scheduled_date = 0;
 
   Game* game = main_loop.get_game();
   if (game != nullptr) {
@@ -176,6 +182,8 @@ void LuaContext::add_timer(
       timer->set_suspended(initially_suspended);
     }
   }
+
+  schedule_timer(timer);
 }
 
 /**
@@ -211,10 +219,16 @@ void LuaContext::remove_timers(int context_index) {
     context = lua_topointer(l, context_index);
   }
 
-  for (auto& kvp: timers) {
-    const TimerPtr& timer = kvp.first;
-    if (kvp.second.context == context) {
-      kvp.second.callback_ref.clear();
+  const auto& context_it = timers_by_context.find(context);
+  if (context_it == timers_by_context.end()) {
+    return;
+  }
+
+  for (const TimerPtr& timer: context_it->second) {
+    const auto& it = timers.find(timer);
+    if (it != timers.end() &&
+        !it->second.callback_ref.is_empty()) {
+      it->second.callback_ref.clear();
       timers_to_remove.push_back(timer);
     }
   }
@@ -225,6 +239,9 @@ void LuaContext::remove_timers(int context_index) {
  */
 void LuaContext::destroy_timers() {
   timers.clear();
+  timers_to_remove.clear();
+  timers_by_context.clear();
+  timers_by_date.clear();
 }
 
 /**
@@ -232,17 +249,42 @@ void LuaContext::destroy_timers() {
  */
 void LuaContext::update_timers() {
 
-  // Update all timers.
-  for (const auto& kvp: timers) {
+  // Take the timers whose next update date is reached.
+  // Collect them first so that each timer is updated at most once
+  // per cycle, even if it gets scheduled again in the past.
+  const uint32_t now = System::now();
+  std::vector<TimerPtr> timers_to_update;
+  while (!timers_by_date.empty() && timers_by_date.front().date <= now) {
+
+    std::pop_heap(timers_by_date.begin(), timers_by_date.end());
+    const ScheduledTimer scheduled = timers_by_date.back();
+    timers_by_date.pop_back();
+
+    const auto& it = timers.find(scheduled.timer);
+    if (it != timers.end() &&
+        it->second.scheduled_sequence == scheduled.sequence) {
+      // The entry is not obsolete.
+      it->second.scheduled_sequence = 0;
+      timers_to_update.push_back(scheduled.timer);
+    }
+  }
 
-    const TimerPtr& timer = kvp.first;
-    const ScopedLuaRef& callback_ref = kvp.second.callback_ref;
-    if (!callback_ref.is_empty()) {
-      // The timer is not being removed: update it.
-      timer->update();
-      if (timer->is_finished()) {
-        do_timer_callback(timer);
-      }
+  // Update them.
+  for (const TimerPtr& timer: timers_to_update) {
+
+    const auto& it = timers.find(timer);
+    if (it == timers.end() ||
+        it->second.callback_ref.is_empty()) {
+      // The timer is being removed.
+      continue;
+    }
+
+    timer->update();
+    if (timer->is_finished()) {
+      do_timer_callback(timer);
+    }
+    else {
+      schedule_timer(timer);
     }
   }
 
@@ -251,6 +293,13 @@ void LuaContext::update_timers() {
 
     const auto& it = timers.find(timer);
     if (it != timers.end()) {
+      const auto& context_it = timers_by_context.find(it->second.context);
+      if (context_it != timers_by_context.end()) {
+        context_it->second.erase(it->second.context_it);
+        if (context_it->second.empty()) {
+          timers_by_context.erase(context_it);
+        }
+      }
       timers.erase(it);
 
       Debug::check_assertion(timers.find(timer) == timers.end(),
@@ -271,6 +320,7 @@ void LuaContext::notify_timers_map_suspended(bool suspended) {
     const TimerPtr& timer = kvp.first;
     if (timer->is_suspended_with_map()) {
       timer->notify_map_suspended(suspended);
+      schedule_timer(timer);
     }
   }
 }
@@ -287,11 +337,14 @@ void LuaContext::set_entity_timers_suspended(
     Entity& entity, bool suspended
 ) {
 
-  for (const auto& kvp: timers) {
-    const TimerPtr& timer = kvp.first;
-    if (kvp.second.context == &entity) {
-      timer->set_suspended(suspended);
-    }
+  const auto& context_it = timers_by_context.find(&entity);
+  if (context_it == timers_by_context.end()) {
+    return;
+  }
+
+  for (const TimerPtr& timer: context_it->second) {
+    timer->set_suspended(suspended);
+    schedule_timer(timer);
   }
 }
 
@@ -330,6 +383,9 @@ void LuaContext::do_timer_callback(const TimerPtr& timer) {
         // the main loop stepsize.
         do_timer_callback(timer);
       }
+      else {
+        schedule_timer(timer);
+      }
     }
     else {
       callback_ref.clear();
@@ -338,6 +394,62 @@ void LuaContext::do_timer_callback(const TimerPtr& timer) {
   }
 }
 
+/**
+ * \brief Schedules the next update of a timer.
+ *
+ * This must be called whenever the next update date of the timer may have
+ * changed, including when it gets resumed.
+ * Previous entries of the timer in the schedule become obsolete.
+ * Suspended timers are not scheduled until they are resumed.
+ *
+ * \param timer A timer.
+ */
+void LuaContext::schedule_timer(const TimerPtr& timer) {
+
+  const auto& it = timers.find(timer);
+  if (it == timers.end() ||
+      it->second.callback_ref.is_empty()) {
+    // Not running.
+    return;
+  }
+
+  LuaTimerData& timer_data = it->second;
+  if (timer->is_suspended()) {
+    timer_data.scheduled_sequence = 0;
+    return;
+  }
+
+  const uint32_t date = timer->get_next_update_date();
+  if (timer_data.scheduled_sequence != 0 &&
+      timer_data.scheduled_date == date) {
+    // Already scheduled at this date.
+    return;
+  }
+
+  ScheduledTimer scheduled;
+  scheduled.date = date;
+  scheduled.sequence = ++last_timer_sequence;
+  scheduled.timer = timer;
+  timer_data.scheduled_sequence = scheduled.sequence;
+  timer_data.scheduled_date = date;
+  timers_by_date.push_back(scheduled);
+  std::push_heap(timers_by_date.begin(), timers_by_date.end());
+
+  if (timers_by_date.size() > 2 * timers.size() + 64) {
+    // Too many obsolete entries: rebuild the heap without them.
+    const auto& obsolete = [&](const ScheduledTimer& entry) {
+      const auto& entry_it = timers.find(entry.timer);
+      return entry_it == timers.end() ||
+          entry_it->second.scheduled_sequence != entry.sequence;
+    };
+    timers_by_date.erase(
+        std::remove_if(timers_by_date.begin(), timers_by_date.end(), obsolete),
+        timers_by_date.end()
+    );
+    std::make_heap(timers_by_date.begin(), timers_by_date.end());
+  }
+}
+
 /**
  * \brief Implementation of sol.timer.start().
  * \param l the Lua context that is calling this function
@@ -453,6 +565,7 @@ int LuaContext::timer_api_set_with_sound(lua_State* l) {
     bool with_sound = LuaTools::opt_boolean(l, 2, true);
 
     timer->set_with_sound(with_sound);
+    get_lua_context(l).schedule_timer(timer);
 
     return 0;
   });
@@ -485,6 +598,7 @@ int LuaContext::timer_api_set_suspended(lua_State* l) {
     bool suspended = LuaTools::opt_boolean(l, 2, true);
 
     timer->set_suspended(suspended);
+    get_lua_context(l).schedule_timer(timer);
 
     return 0;
   });
@@ -525,6 +639,7 @@ int LuaContext::timer_api_set_suspended_with_map(lua_State* l) {
       // If the game is running, suspend/resume the timer like the map.
       timer->notify_map_suspended(game->get_current_map().is_suspended());
     }
+    lua_context.schedule_timer(timer);
 
     return 0;
   });
@@ -581,6 +696,9 @@ int LuaContext::timer_api_set_remaining_time(lua_State* l) {
         // Execute the callback now.
         lua_context.do_timer_callback(timer);
       }
+      else {
+        lua_context.schedule_timer(timer);
+      }
     }
 
     return 0;
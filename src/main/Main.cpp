@@ -57,6 +57,8 @@ void print_help(const Arguments& args) {
     << std::endl
     << "  -video-acceleration=yes|no    enables or disables accelerated graphics (default yes)"
     << std::endl
+    << "  -render-batching=yes|no       packs images into texture atlases and groups accelerated drawings (default no)"
+    << std::endl
     << "  -quest-size=<width>x<height>  sets the size of the drawing area (if compatible with the quest)"
     << std::endl
     << "  -lua-console=yes|no           accepts standard input lines as Lua commands (default yes)"
@@ -64,6 +66,30 @@ void print_help(const Arguments& args) {
     << "  -turbo=yes|no                 runs as fast as possible rather than simulating real time (default no)"
     << std::endl
     << "  -lag=X                        slows down each frame of X milliseconds to simulate slower systems for debugging (default 0)"
+    << std::endl
+    << "  -simulation-frames=N          runs N cycles as fast as possible without window nor audio, then exits"
+    << std::endl
+    << "  -profile=<file>               writes the time spent in each phase of each cycle to a CSV or JSON file"
+    << std::endl
+    << "  -collision-batching=yes|no    checks sprite collisions of still entities once per cycle in a single pass (default no)"
+    << std::endl
+    << "  -swept-movements=yes|no       notifies the steps a movement makes in the same cycle at once (default no)"
+    << std::endl
+    << "  -incremental-draw-order=yes|no keeps entities sorted in drawing order instead of sorting them at each cycle (default no)"
+    << std::endl
+    << "  -entity-pool=yes|no           allocates entities created in bursts like pickables and explosions in a per-map pool (default no)"
+    << std::endl
+    << "  -damage-tracking=yes|no       only redraws the regions of the map and of the screen that change (default no)"
+    << std::endl
+    << "  -glyph-cache=yes|no           renders each character of texts once and only draws characters added to texts (default no)"
+    << std::endl
+    << "  -resource-cache-size=N        frees unused resources when loaded ones exceed N megabytes (default 128)"
+    << std::endl
+    << "  -compile-data                 writes a binary form of map, tileset and sprite data files next to them, then exits"
+    << std::endl
+    << "  -savegame-format=lua|binary   writes savegames as Lua text or in a compact binary format (default lua)"
+    << std::endl
+    << "  -mono-sounds=yes|no           no converts mono sound effects to stereo for audio drivers that play them silently (default yes)"
     << std::endl;
 }
 
@@ -90,11 +116,30 @@ void print_help(const Arguments& args) {
  *   -no-audio                         Disables sounds and musics.
  *   -no-video                         Disables displaying (used for unit tests).
  *   -video-acceleration=yes|no        Enables or disables 2D accelerated graphics if available (default: yes).
+ *   -render-batching=yes|no           Packs images into texture atlases and submits accelerated drawings
+ *                                     grouped by texture (default: no).
  *   -quest-size=<width>x<height>      Sets the size of the drawing area (if compatible with the quest).
  *   -lua-console=yes|no               Accepts lines from standard input as Lua commands (default: yes).
  *   -turbo=yes|no                     Runs as fast as possible rather than simulating real time (default: no).
  *   -lag=X                            (Advanced) Artificially slows down each frame of X milliseconds
  *                                     to simulate slower systems for debugging (default: 0).
+ *   -simulation-frames=N              (Advanced) Runs N cycles as fast as possible without window
+ *                                     nor audio device, then exits. Useful for batch testing and profiling.
+ *   -profile=FILE                     (Advanced) Writes the real time spent in each phase of each cycle
+ *                                     to FILE, as JSON if it ends with ".json" or as CSV otherwise.
+ *   -resource-cache-size=N            (Advanced) Memory budget in megabytes of loaded resources
+ *                                     like tilesets, sprites and sounds (default: 128).
+ *   -damage-tracking=yes|no           (Advanced) Only redraws the regions of the map and of the screen
+ *                                     that change between frames. The whole screen is still redrawn
+ *                                     when 2D acceleration is enabled (default: no).
+ *   -compile-data                     (Advanced) Writes a compiled binary form of each map, tileset and sprite
+ *                                     data file next to it ("<file>.dat.bin") and exits without running the quest.
+ *                                     Compiled files are loaded instead of the Lua ones while they are up to date.
+ *   -savegame-format=lua|binary       (Advanced) Writes savegames as Lua text or in a compact binary format
+ *                                     (default: lua). Savegames in both formats can always be loaded.
+ *   -mono-sounds=yes|no               (Advanced) Keeps mono sound effects mono (default: yes).
+ *                                     Use no with audio drivers that play them silently: they are
+ *                                     then converted to stereo, which takes twice the memory.
  *
  * \param argc Number of command-line arguments.
  * \param argv Command-line arguments.
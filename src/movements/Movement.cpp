@@ -25,6 +25,12 @@
 
 namespace Solarus {
 
+namespace {
+
+  bool swept_steps_enabled = false;  /**< Whether steps of an update are notified at once. */
+
+}  // Anonymous namespace.
+
 /**
  * \brief Constructor.
  */
@@ -52,7 +58,9 @@ Movement::Movement(bool ignore_obstacles):
   last_collision_box_on_obstacle(-1, -1),
   default_ignore_obstacles(ignore_obstacles),
   current_ignore_obstacles(ignore_obstacles),
-  finished_callback_ref() {
+  finished_callback_ref(),
+  sweeping(false),
+  swept_positions() {
 
 }
 
@@ -62,6 +70,32 @@ Movement::Movement(bool ignore_obstacles):
 Movement::~Movement() {
 }
 
+/**
+ * \brief Returns whether movements notify the steps of an update at once.
+ * \return \c true if swept steps are enabled.
+ */
+bool Movement::is_swept_steps_enabled() {
+  return swept_steps_enabled;
+}
+
+/**
+ * \brief Sets whether movements notify the steps of an update at once.
+ *
+ * When a movement makes several steps during the same update,
+ * its entity normally checks its collisions, its ground and calls Lua
+ * events after each step.
+ * With swept steps, the positions are only recorded during the update.
+ * Then detectors are checked at each of them with a single spatial query,
+ * and everything else is done once at the final position.
+ *
+ * This is disabled by default.
+ *
+ * \param swept_steps_enabled \c true to enable swept steps.
+ */
+void Movement::set_swept_steps_enabled(bool swept_steps_enabled) {
+  Solarus::swept_steps_enabled = swept_steps_enabled;
+}
+
 /**
  * \brief Returns the entity controlled by this movement (if any).
  * \return the entity controlled by this movement, or nullptr if this movement
@@ -263,6 +297,12 @@ void Movement::translate_xy(const Point& dxy) {
  */
 void Movement::notify_position_changed() {
 
+  if (sweeping) {
+    // Notified by finish_sweep().
+    swept_positions.push_back(get_xy());
+    return;
+  }
+
   LuaContext* lua_context = get_lua_context();
   if (lua_context != nullptr && are_lua_notifications_enabled()) {
     lua_context->movement_on_position_changed(*this, get_xy());
@@ -275,6 +315,92 @@ void Movement::notify_position_changed() {
   }
 }
 
+/**
+ * \brief Starts recording the position changes instead of notifying them.
+ *
+ * Subclasses call this before making several steps in a row.
+ * Does nothing if swept steps are disabled or if the movement is not
+ * applied to a map entity.
+ * The hero is excluded too because its states react to each step.
+ */
+void Movement::start_sweep() {
+
+  if (!swept_steps_enabled ||
+      entity == nullptr ||
+      !entity->is_on_map() ||
+      entity->get_type() == EntityType::HERO) {
+    return;
+  }
+
+  sweeping = true;
+  swept_positions.clear();
+}
+
+/**
+ * \brief Notifies the position changes recorded since start_sweep().
+ *
+ * The Lua event of the movement is called once.
+ * The entity checks detectors at each recorded position and then notifies
+ * its final position.
+ */
+void Movement::finish_sweep() {
+
+  if (!sweeping) {
+    return;
+  }
+
+  sweeping = false;
+  if (swept_positions.empty()) {
+    return;
+  }
+
+  // Detectors may replace this movement while the entity is notified.
+  std::vector<Point> positions;
+  positions.swap(swept_positions);
+
+  if (entity != nullptr && !entity->is_being_removed()) {
+    entity->notify_position_swept(*this, positions);
+    return;
+  }
+
+  LuaContext* lua_context = get_lua_context();
+  if (lua_context != nullptr && are_lua_notifications_enabled()) {
+    lua_context->movement_on_position_changed(*this, get_xy());
+  }
+}
+
+/**
+ * \brief Notifies the position changes recorded so far, before this
+ * movement notifies something else.
+ *
+ * Subclasses call this before reaching an obstacle or finishing, so that
+ * detectors of the previous steps are checked first, like without sweeping.
+ * Recording goes on afterwards.
+ *
+ * \return \c false if detectors stopped, finished or replaced this movement:
+ * what it was about to notify would not have happened without sweeping.
+ */
+bool Movement::notify_swept_steps() {
+
+  if (!sweeping) {
+    return true;
+  }
+
+  const bool was_stopped = is_stopped();
+  const bool was_finished = is_finished();
+  finish_sweep();
+
+  if (entity == nullptr ||
+      entity->get_movement().get() != this ||
+      (!was_stopped && is_stopped()) ||
+      (!was_finished && is_finished())) {
+    return false;
+  }
+
+  start_sweep();
+  return true;
+}
+
 /**
  * \brief Notifies this movement that it just failed to apply
  * because of obstacles.
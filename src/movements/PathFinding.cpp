@@ -15,14 +15,37 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "solarus/movements/PathFinding.h"
+#include "solarus/movements/PathFindingClusters.h"
+#include "solarus/movements/PathFindingGrid.h"
 #include "solarus/entities/Entity.h"
+#include "solarus/entities/GroundInfo.h"
 #include "solarus/lowlevel/Geometry.h"
+#include "solarus/lowlevel/System.h"
 #include "solarus/Map.h"
 #include "solarus/lowlevel/Debug.h"
+#include <algorithm>
 #include <limits>
 
 namespace Solarus {
 
+namespace {
+
+/**
+ * \brief Maximum Manhattan distance in pixels to the target of a normal search.
+ */
+const int max_short_distance = 200;
+
+/**
+ * \brief Maximum number of nodes explored by a search of a long path
+ * in the whole map.
+ *
+ * When this budget runs out, the path to the closest node found is
+ * returned instead: paths are recomputed regularly anyway.
+ */
+const int max_long_search_nodes = 4096;
+
+}  // Anonymous namespace.
+
 const Point PathFinding::neighbours_locations[] = {
   {  8,  0 },
   {  8, -8 },
@@ -58,12 +81,41 @@ PathFinding::PathFinding(
     Entity& target_entity):
   map(map),
   source_entity(source_entity),
-  target_entity(target_entity) {
+  target_entity(target_entity),
+  grid(map.get_path_finding_grid()),
+  long_range(false),
+  ground_cache(-1) {
 
   Debug::check_assertion(source_entity.is_aligned_to_grid(),
       "The source must be aligned on the map grid");
 }
 
+/**
+ * \brief Returns whether targets far from the source can be reached.
+ * \return \c true if long paths are computed.
+ */
+bool PathFinding::is_long_range() const {
+  return long_range;
+}
+
+/**
+ * \brief Sets whether targets far from the source can be reached.
+ *
+ * By default, no path is computed when the target is more than
+ * 200 pixels away.
+ * In long range mode, such paths are computed in an abstract graph of the
+ * map first, and then refined step by step.
+ * Entities that modify the ground see a terrain of their own, which has
+ * no abstract graph: their long paths are searched in the whole map,
+ * which is slower. This search has a budget: when it runs out, the entity
+ * only goes as close as possible to the target.
+ *
+ * \param long_range \c true to compute long paths.
+ */
+void PathFinding::set_long_range(bool long_range) {
+  this->long_range = long_range;
+}
+
 /**
  * \brief Tries to find a path between the source point and the target point.
  * \return the path found, or an empty string if no path was found
@@ -109,202 +161,303 @@ std::string PathFinding::compute_path(const Point& offset) {
   Point source = source_entity.get_bounding_box().get_xy();
   Point target = target_entity.get_bounding_box().get_xy() + offset;
 
-  // std::cout << "will compute a path from " << source << " to " << target << std::endl;
-
   target.x += 4;
   target.x += -target.x % 8;
   target.y += 4;
   target.y += -target.y % 8;
-  const int target_index = get_square_index(target);
 
   Debug::check_assertion(target.x % 8 == 0 && target.y % 8 == 0,
       "Could not snap the target to the map grid");
 
   const int total_mdistance = Geometry::get_manhattan_distance(source, target);
-  if (total_mdistance > 200 || target_entity.get_layer() != source_entity.get_layer()) {
-    //std::cout << "too far, not computing a path\n";
+  const bool far = total_mdistance > max_short_distance;
+  if ((far && !long_range) || target_entity.get_layer() != source_entity.get_layer()) {
     return ""; // too far to compute a path
   }
 
-  std::string path = "";
+  if (!grid.is_in_grid(source) || !grid.is_in_grid(target)) {
+    return "";  // The source or the target is outside the map.
+  }
+  const int target_index = grid.get_square_index(target);
+  const int source_index = grid.get_square_index(source);
+
+  // The terrain seen by an entity that modifies the ground is specific
+  // to this entity: only use the shared caches for other entities.
+  const bool use_caches = !source_entity.is_ground_modifier();
+  PathFindingGrid::PathKey key;
+  const uint32_t now = System::now();
+  if (use_caches) {
+    key.layer = source_entity.get_layer();
+    key.obstacle_grounds = get_obstacle_grounds();
+    key.source_type = source_entity.get_type();
+    key.source_size = source_entity.get_size();
+    key.obstacle_traits = source_entity.get_obstacle_traits();
+    key.source_entity = key.obstacle_traits == -1 ? &source_entity : nullptr;
+    key.source_index = source_index;
+    key.target_index = target_index;
+
+    std::string path;
+    if (grid.get_cached_path(key, now, path)) {
+      return path;
+    }
+    ground_cache = grid.get_ground_cache(key.layer, key.obstacle_grounds);
+  }
+  else {
+    ground_cache = -1;
+  }
 
-  Node starting_node;
-  const int index = get_square_index(source);
-  starting_node.location = source;
-  starting_node.index = index;
-  starting_node.previous_cost = 0;
-  starting_node.heuristic = total_mdistance;
-  starting_node.total_cost = total_mdistance;
-  starting_node.direction = ' ';
-  starting_node.parent_index = -1;
+  const std::string& path = far ?
+      compute_long_path(source_index, target_index) :
+      search(source_index, target_index, total_mdistance, max_short_distance,
+          std::numeric_limits<int>::max());
+  if (use_caches) {
+    grid.add_cached_path(key, now, path);
+  }
+  return path;
+}
 
-  open_list.clear();
-  closed_list.clear();
-  open_list_indices.clear();
+/**
+ * \brief Computes a path to a far target.
+ *
+ * The path is searched in the clusters of the map (HPA*) and each step
+ * of the abstract path is refined with the usual A* algorithm.
+ *
+ * \param source_index Index of the starting node.
+ * \param target_index Index of the node to reach.
+ * \return The path, or only its beginning if some step cannot be refined
+ * or if the search runs out of budget, or an empty string if there is
+ * no path.
+ */
+std::string PathFinding::compute_long_path(int source_index, int target_index) {
+
+  if (ground_cache == -1) {
+    // The abstract graph is only maintained with shared terrain caches:
+    // search the whole map instead.
+    return search(
+        source_index,
+        target_index,
+        Geometry::get_manhattan_distance(
+            grid.get_square_location(source_index),
+            grid.get_square_location(target_index)
+        ),
+        std::numeric_limits<int>::max(),
+        max_long_search_nodes
+    );
+  }
 
-  open_list[index] = starting_node;
-  open_list_indices.push_front(index);
+  PathFindingClusters& clusters = grid.get_clusters(ground_cache);
+  const std::vector<int>& abstract_path = clusters.find_path(
+      grid,
+      source_index,
+      target_index,
+      [this](int index, int direction) {
+        return !is_ground_obstacle(grid.get_square_location(index), direction);
+      }
+  );
+
+  std::string path;
+  for (size_t i = 1; i < abstract_path.size(); ++i) {
+    const int step_source_index = abstract_path[i - 1];
+    const int step_target_index = abstract_path[i];
+    const std::string& step_path = search(
+        step_source_index,
+        step_target_index,
+        Geometry::get_manhattan_distance(
+            grid.get_square_location(step_source_index),
+            grid.get_square_location(step_target_index)
+        ),
+        max_short_distance,
+        std::numeric_limits<int>::max()
+    );
+    if (step_path.empty()) {
+      // Dynamic obstacles block this step: go as far as possible.
+      break;
+    }
+    path += step_path;
+  }
+  return path;
+}
 
-  bool finished = false;
-  while (!finished) {
+/**
+ * \brief Runs the A* algorithm between two nodes.
+ * \param source_index Index of the starting node.
+ * \param target_index Index of the node to reach.
+ * \param total_mdistance Manhattan distance between both nodes.
+ * \param max_distance Nodes at this Manhattan distance from the target
+ * or further are not explored.
+ * \param max_nodes Maximum number of nodes to explore. When they are all
+ * explored, the path to the one closest to the target is returned.
+ * \return The path found, or an empty string if there is no path
+ * or if the target is too far.
+ */
+std::string PathFinding::search(
+    int source_index,
+    int target_index,
+    int total_mdistance,
+    int max_distance,
+    int max_nodes) {
 
-    // pick the node with the lowest total cost in the open list
-    const int index = open_list_indices.front();
-    Node* current_node = &open_list[index];
-    open_list_indices.pop_front();
-    closed_list[index] = *current_node;
-    open_list.erase(index);
-    current_node = &closed_list[index];
+  const Point target = grid.get_square_location(target_index);
 
-    //std::cout << System::now() << " picking the lowest cost node in the open list ("
-    //  << (open_list_indices.size() + 1) << " elements): "
-    //  << current_node->location << ", index = " << current_node->index
-    //  << ", cost = " << current_node->previous_cost << " + " << current_node->heuristic << "\n";
+  grid.start_search();
 
+  PathFindingGrid::Node& starting_node = grid.get_node(source_index);
+  starting_node.previous_cost = 0;
+  starting_node.total_cost = total_mdistance;
+  starting_node.direction = ' ';
+  starting_node.parent_index = -1;
+  grid.open(source_index);
+
+  int closest_index = source_index;
+  int closest_distance = total_mdistance;
+  int num_nodes = 0;
+  while (grid.has_open_nodes()) {
+
+    // Pick the node with the lowest total cost in the open heap.
+    const int index = grid.close_best_node();
     if (index == target_index) {
-      //std::cout << "target node was added to the closed list\n";
-      finished = true;
-      path = rebuild_path(current_node);
-      //std::cout << "rebuild done\n";
+      return rebuild_path(index);
     }
-    else {
-      // look at the accessible nodes from it
-      //std::cout << System::now() << " looking for accessible states\n";
-      for (int i = 0; i < 8; i++) {
-
-        Node new_node;
-        const int immediate_cost = (i & 1) ? 11 : 8;
-        new_node.previous_cost = current_node->previous_cost + immediate_cost;
-        new_node.location = current_node->location;
-        new_node.location += neighbours_locations[i];
-        new_node.index = get_square_index(new_node.location);
-        //std::cout << "  node in direction " << i << ": index = " << new_node.index << std::endl;
-
-        const bool in_closed_list = (closed_list.find(new_node.index) != closed_list.end());
-        if (!in_closed_list && Geometry::get_manhattan_distance(new_node.location, target) < 200
-            && is_node_transition_valid(*current_node, i)) {
-          //std::cout << "  node in direction " << i << " is not in the closed list\n";
-          // not in the closed list: look in the open list
-
-          const bool in_open_list = open_list.find(new_node.index) != open_list.end();
-
-          if (!in_open_list) {
-            // not in the open list: add it
-            new_node.heuristic = Geometry::get_manhattan_distance(new_node.location, target);
-            new_node.total_cost = new_node.previous_cost + new_node.heuristic;
-            new_node.parent_index = index;
-            new_node.direction = '0' + i;
-            open_list[new_node.index] = new_node;
-            add_index_sorted(&open_list[new_node.index]);
-            //std::cout << "  node in direction " << i << " is not in the open list, adding it with cost "
-            //  << new_node.previous_cost << " (" << current_node->previous_cost << " + "
-            //  << immediate_cost << ") + " << new_node.heuristic << " and parent " << new_node.parent_index << "\n";
-          }
-          else {
-            //std::cout << "  node in direction " << i << " is already in the open list\n";
-            Node* existing_node = &open_list[new_node.index];
-            // already in the open list: see if the current path is better
-            if (new_node.previous_cost < existing_node->previous_cost) {
-              existing_node->previous_cost = new_node.previous_cost;
-              existing_node->total_cost = existing_node->previous_cost + existing_node->heuristic;
-              existing_node->parent_index = index;
-              open_list_indices.sort();
-            }
-          }
-        }
-        else {
-          //std::cout << "skipping node in direction " << i << ": already in closed list = "
-          //  << in_closed_list << ", too far from target = "
-          //  << (get_manhattan_distance(new_node.location, target) >= 200) << ", invalid transition = "
-          //  << (!is_node_transition_valid(*current_node, i)) << std::endl;
-        }
-      }
-      if (open_list_indices.empty()) {
-        finished = true;
-      }
+
+    const Point location = grid.get_square_location(index);
+    const int distance = Geometry::get_manhattan_distance(location, target);
+    if (distance < closest_distance) {
+      closest_index = index;
+      closest_distance = distance;
+    }
+    if (++num_nodes >= max_nodes) {
+      // Out of budget: go as close as possible.
+      return rebuild_path(closest_index);
     }
-  }
 
-  //std::cout << "path found: " << path << ", open nodes: " << open_list.size() << ", closed nodes: " << closed_list.size() << std::endl;
-  return path;
-}
+    // Look at the accessible nodes from it.
+    const int previous_cost = grid.get_node(index).previous_cost;
+    for (int i = 0; i < 8; ++i) {
 
-/**
- * \brief Returns the index of the 8*8 square in the map
- * corresponding to the specified location.
- * \param location location of a node on the map
- * \return index of the square corresponding to the top-left part of the location
- */
-int PathFinding::get_square_index(const Point& location) const {
+      const Point new_location = location + neighbours_locations[i];
+      if (!grid.is_in_grid(new_location)) {
+        continue;
+      }
 
-  const int x8 = location.x / 8;
-  const int y8 = location.y / 8;
-  return y8 * map.get_width8() + x8;
-}
+      const int new_index = grid.get_square_index(new_location);
+      if (grid.is_closed(new_index)) {
+        continue;
+      }
 
-/**
- * \brief Compares two nodes according to their total estimated cost.
- * \param other the other node
- */
-bool PathFinding::Node::operator<(const Node& other) const {
-  return total_cost < other.total_cost;
-}
+      const int heuristic = Geometry::get_manhattan_distance(new_location, target);
+      if (heuristic >= max_distance || !is_node_transition_valid(location, i)) {
+        continue;
+      }
 
-/**
- * \brief Adds the index of a node to the sorted list of indices of the open
- * list, making sure that the list remains sorted.
- * \param node The node.
- */
-void PathFinding::add_index_sorted(Node* node) {
-
-  bool inserted = false;
-  for (auto it = open_list_indices.begin();
-      it != open_list_indices.end() && !inserted;
-      ++it) {
-    const int index = *it;
-    const Node* current_node = &open_list[index];
-    if (current_node->total_cost >= node->total_cost) {
-      open_list_indices.insert(it, node->index);
-      inserted = true;
+      const int immediate_cost = (i & 1) ? 11 : 8;
+      const int new_previous_cost = previous_cost + immediate_cost;
+      PathFindingGrid::Node& new_node = grid.get_node(new_index);
+      if (!grid.is_reached(new_index)) {
+        // Not in the open heap: add it.
+        new_node.previous_cost = new_previous_cost;
+        new_node.total_cost = new_previous_cost + heuristic;
+        new_node.parent_index = index;
+        new_node.direction = '0' + i;
+        grid.open(new_index);
+      }
+      else if (new_previous_cost < new_node.previous_cost) {
+        // Already in the open heap: the current path is better.
+        new_node.previous_cost = new_previous_cost;
+        new_node.total_cost = new_previous_cost + heuristic;
+        new_node.parent_index = index;
+        new_node.direction = '0' + i;
+        grid.notify_cost_decreased(new_index);
+      }
     }
   }
 
-  if (!inserted) {
-    open_list_indices.push_back(node->index);
-  }
+  return "";  // No path.
 }
 
 /**
  * \brief Builds the string representation of the path found by the algorithm.
- * \param closed_list The closed list of A*.
- * \return final_node The final node of the path.
+ * \param final_index Index of the final node of the path.
+ * \return The path.
  */
-std::string PathFinding::rebuild_path(const Node* final_node) {
-
-  const Node* current_node = final_node;
-  std::string path = "";
-  while (current_node->direction != ' ') {
-    path = current_node->direction + path;
-    current_node = &closed_list[current_node->parent_index];
-    //std::cout << "current_node: " << current_node->index << ", path = " << path << std::endl;
+std::string PathFinding::rebuild_path(int final_index) const {
+
+  std::string path;
+  int index = final_index;
+  while (grid.get_node(index).parent_index != -1) {
+    const PathFindingGrid::Node& node = grid.get_node(index);
+    path += node.direction;
+    index = node.parent_index;
   }
+  std::reverse(path.begin(), path.end());
   return path;
 }
 
 /**
  * \brief Returns whether a transition between two nodes is valid, i.e.
  * whether there is no collision with the map.
- * \param initial_node the first node
+ * \param location location of the first node
  * \param direction the direction to take (0 to 7)
  * \return true if there is no collision for this transition
  */
 bool PathFinding::is_node_transition_valid(
-    const Node& initial_node, int direction) const {
+    const Point& location, int direction) const {
 
   Rectangle collision_box = transition_collision_boxes[direction];
-  collision_box.add_xy(initial_node.location);
+  collision_box.add_xy(location);
+  const int layer = source_entity.get_layer();
+
+  if (ground_cache == -1) {
+    return !map.test_collision_with_obstacles(layer, collision_box, source_entity);
+  }
 
-  return !map.test_collision_with_obstacles(source_entity.get_layer(), collision_box, source_entity);
+  return !is_ground_obstacle(location, direction) &&
+      !map.test_collision_with_entities(layer, collision_box, source_entity);
+}
+
+/**
+ * \brief Returns whether the terrain prevents a transition between two nodes.
+ *
+ * The result is shared with other searches through the terrain cache
+ * of the grid.
+ *
+ * \param location Location of the first node.
+ * \param direction The direction to take (0 to 7).
+ * \return \c true if the terrain blocks this transition.
+ */
+bool PathFinding::is_ground_obstacle(const Point& location, int direction) const {
+
+  const int index = grid.get_square_index(location);
+  bool ground_obstacle = false;
+  if (!grid.get_ground_obstacle(ground_cache, index, direction, ground_obstacle)) {
+    Rectangle collision_box = transition_collision_boxes[direction];
+    collision_box.add_xy(location);
+    ground_obstacle = map.test_collision_with_ground(
+        source_entity.get_layer(), collision_box, source_entity);
+    grid.set_ground_obstacle(ground_cache, index, direction, ground_obstacle);
+  }
+  return ground_obstacle;
+}
+
+/**
+ * \brief Returns the grounds that are obstacles for the source entity.
+ *
+ * Diagonal grounds are not included because they do not depend
+ * on the entity.
+ *
+ * \return Bit field where bit \c n is set if <tt>Ground(n)</tt>
+ * is an obstacle.
+ */
+uint32_t PathFinding::get_obstacle_grounds() const {
+
+  uint32_t obstacle_grounds = 0;
+  for (const auto& kvp : EnumInfoTraits<Ground>::names) {
+    const Ground ground = kvp.first;
+    if (!GroundInfo::is_ground_diagonal(ground) &&
+        source_entity.is_ground_obstacle(ground)) {
+      obstacle_grounds |= 1 << static_cast<int>(ground);
+    }
+  }
+  return obstacle_grounds;
 }
 
 }
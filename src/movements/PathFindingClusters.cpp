@@ -0,0 +1,522 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/movements/PathFindingClusters.h"
+#include "solarus/movements/PathFindingGrid.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Geometry.h"
+#include <algorithm>
+#include <queue>
+
+namespace Solarus {
+
+namespace {
+
+/**
+ * \brief Width and height of a cluster in nodes.
+ *
+ * The Manhattan distance between two nodes of a cluster stays below
+ * the limit of the usual A* search, so that abstract steps can be refined.
+ */
+const int cluster_size = 8;
+
+/**
+ * \brief Minimum length of a border opening to get two entrances
+ * (one at each end) instead of one in the middle.
+ */
+const int min_wide_opening = 6;
+
+/**
+ * \brief Node offsets of the 8 directions.
+ */
+const int direction_dx[] = { 1,  1,  0, -1, -1, -1, 0, 1 };
+const int direction_dy[] = { 0, -1, -1, -1,  0,  1, 1, 1 };
+
+/**
+ * \brief Returns the cost of a transition in a direction.
+ * \param direction A direction (0 to 7).
+ * \return The cost, the same as in PathFinding.
+ */
+int get_transition_cost(int direction) {
+  return (direction & 1) ? 11 : 8;
+}
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates the clusters of a map.
+ *
+ * Clusters are all dirty at first: the abstract graph is built
+ * the first time a path is requested.
+ *
+ * \param width8 Width of the map in 8x8 squares.
+ * \param height8 Height of the map in 8x8 squares.
+ */
+PathFindingClusters::PathFindingClusters(int width8, int height8):
+  width8(width8),
+  height8(height8),
+  num_columns((width8 + cluster_size - 1) / cluster_size),
+  num_rows((height8 + cluster_size - 1) / cluster_size),
+  clusters(num_columns * num_rows),
+  dirty(true) {
+
+  for (Cluster& cluster : clusters) {
+    cluster.dirty = true;
+  }
+}
+
+/**
+ * \brief Marks dirty the clusters containing a rectangle of nodes.
+ *
+ * Their entrances will be recomputed the next time a path is requested.
+ *
+ * \param x8_min First column of nodes to invalidate.
+ * \param y8_min First row of nodes to invalidate.
+ * \param x8_max Last column of nodes to invalidate.
+ * \param y8_max Last row of nodes to invalidate.
+ */
+void PathFindingClusters::invalidate(int x8_min, int y8_min, int x8_max, int y8_max) {
+
+  const int column_min = std::max(0, x8_min / cluster_size);
+  const int row_min = std::max(0, y8_min / cluster_size);
+  const int column_max = std::min(num_columns - 1, x8_max / cluster_size);
+  const int row_max = std::min(num_rows - 1, y8_max / cluster_size);
+
+  for (int row = row_min; row <= row_max; ++row) {
+    for (int column = column_min; column <= column_max; ++column) {
+      clusters[row * num_columns + column].dirty = true;
+      dirty = true;
+    }
+  }
+}
+
+/**
+ * \brief Returns the cluster containing a node.
+ * \param node_index Index of a node.
+ * \return Index of its cluster.
+ */
+int PathFindingClusters::get_cluster_index(int node_index) const {
+
+  const int x8 = node_index % width8;
+  const int y8 = node_index / width8;
+  return (y8 / cluster_size) * num_columns + x8 / cluster_size;
+}
+
+/**
+ * \brief Returns the position of a node inside its cluster.
+ * \param cluster_index Index of the cluster containing the node.
+ * \param node_index Index of a node.
+ * \return Index of the node relative to the cluster.
+ */
+int PathFindingClusters::get_local_index(int cluster_index, int node_index) const {
+
+  const int x8 = node_index % width8 - (cluster_index % num_columns) * cluster_size;
+  const int y8 = node_index / width8 - (cluster_index / num_columns) * cluster_size;
+  return y8 * cluster_size + x8;
+}
+
+/**
+ * \brief Rebuilds the abstract graph where clusters are dirty.
+ *
+ * The borders of a dirty cluster are recomputed.
+ * Then the entrances and internal costs of dirty clusters and of their
+ * neighbors are recomputed, since their borders may have changed.
+ *
+ * \param is_transition_valid Tells whether the terrain allows a transition.
+ */
+void PathFindingClusters::update(const TransitionTest& is_transition_valid) {
+
+  if (!dirty) {
+    return;
+  }
+
+  std::vector<bool> to_rebuild(clusters.size(), false);
+  for (size_t i = 0; i < clusters.size(); ++i) {
+
+    if (!clusters[i].dirty) {
+      continue;
+    }
+
+    const int column = i % num_columns;
+    const int row = i / num_columns;
+    compute_border(i, false, is_transition_valid);
+    compute_border(i, true, is_transition_valid);
+    to_rebuild[i] = true;
+    if (column > 0) {
+      compute_border(i - 1, false, is_transition_valid);
+      to_rebuild[i - 1] = true;
+    }
+    if (column < num_columns - 1) {
+      to_rebuild[i + 1] = true;
+    }
+    if (row > 0) {
+      compute_border(i - num_columns, true, is_transition_valid);
+      to_rebuild[i - num_columns] = true;
+    }
+    if (row < num_rows - 1) {
+      to_rebuild[i + num_columns] = true;
+    }
+  }
+
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    if (to_rebuild[i]) {
+      compute_entrances(i, is_transition_valid);
+    }
+    clusters[i].dirty = false;
+  }
+  dirty = false;
+}
+
+/**
+ * \brief Finds where the terrain allows to cross the east or south border
+ * of a cluster.
+ *
+ * Each contiguous opening of the border gives one entrance in its middle,
+ * or two entrances at its ends if it is wide.
+ *
+ * \param cluster_index Index of a cluster.
+ * \param south \c true for the south border, \c false for the east one.
+ * \param is_transition_valid Tells whether the terrain allows a transition.
+ */
+void PathFindingClusters::compute_border(
+    int cluster_index,
+    bool south,
+    const TransitionTest& is_transition_valid) {
+
+  Cluster& cluster = clusters[cluster_index];
+  std::vector<std::pair<int, int>>& border = south ? cluster.south_border : cluster.east_border;
+  border.clear();
+
+  const int column = cluster_index % num_columns;
+  const int row = cluster_index / num_columns;
+  if ((!south && column == num_columns - 1) ||
+      (south && row == num_rows - 1)) {
+    // No neighbor on this side.
+    return;
+  }
+
+  // Nodes of this cluster along the border.
+  int first_index;
+  int length;
+  int step;
+  int crossing;
+  int direction;
+  if (south) {
+    first_index = ((row + 1) * cluster_size - 1) * width8 + column * cluster_size;
+    length = std::min(cluster_size, width8 - column * cluster_size);
+    step = 1;
+    crossing = width8;
+    direction = 6;
+  }
+  else {
+    first_index = row * cluster_size * width8 + (column + 1) * cluster_size - 1;
+    length = std::min(cluster_size, height8 - row * cluster_size);
+    step = width8;
+    crossing = 1;
+    direction = 0;
+  }
+  const int opposite_direction = (direction + 4) % 8;
+
+  // Direction to follow the border.
+  const int along_direction = south ? 0 : 6;
+  const int back_direction = (along_direction + 4) % 8;
+
+  const auto& add_opening = [&](int opening_start, int opening_end) {
+    const int opening_length = opening_end - opening_start;
+    if (opening_length >= min_wide_opening) {
+      const int start_index = first_index + opening_start * step;
+      const int end_index = first_index + (opening_end - 1) * step;
+      border.emplace_back(start_index, start_index + crossing);
+      border.emplace_back(end_index, end_index + crossing);
+    }
+    else {
+      const int middle_index = first_index + (opening_start + opening_length / 2) * step;
+      border.emplace_back(middle_index, middle_index + crossing);
+    }
+  };
+
+  int opening_start = -1;
+  for (int i = 0; i <= length; ++i) {
+
+    const int index = first_index + i * step;
+    const bool open = i < length &&
+        is_transition_valid(index, direction) &&
+        is_transition_valid(index + crossing, opposite_direction);
+
+    if (open && opening_start != -1) {
+      // The opening continues only if the entity can also move along it
+      // on both sides, otherwise its nodes may not be connected.
+      const int previous_index = index - step;
+      const bool connected =
+          is_transition_valid(previous_index, along_direction) &&
+          is_transition_valid(index, back_direction) &&
+          is_transition_valid(previous_index + crossing, along_direction) &&
+          is_transition_valid(index + crossing, back_direction);
+      if (!connected) {
+        add_opening(opening_start, i);
+        opening_start = i;
+      }
+    }
+    else if (open) {
+      opening_start = i;
+    }
+    else if (opening_start != -1) {
+      add_opening(opening_start, i);
+      opening_start = -1;
+    }
+  }
+}
+
+/**
+ * \brief Collects the entrances of a cluster from its four borders and
+ * computes the cost between each pair of them.
+ * \param cluster_index Index of a cluster.
+ * \param is_transition_valid Tells whether the terrain allows a transition.
+ */
+void PathFindingClusters::compute_entrances(
+    int cluster_index,
+    const TransitionTest& is_transition_valid) {
+
+  Cluster& cluster = clusters[cluster_index];
+  cluster.entrances.clear();
+  cluster.links.clear();
+
+  const auto add_link = [&cluster](int index, int other_index) {
+    const auto& it = std::find(cluster.entrances.begin(), cluster.entrances.end(), index);
+    const int position = it - cluster.entrances.begin();
+    if (it == cluster.entrances.end()) {
+      cluster.entrances.push_back(index);
+    }
+    cluster.links.emplace_back(position, other_index);
+  };
+
+  for (const std::pair<int, int>& crossing : cluster.east_border) {
+    add_link(crossing.first, crossing.second);
+  }
+  for (const std::pair<int, int>& crossing : cluster.south_border) {
+    add_link(crossing.first, crossing.second);
+  }
+  const int column = cluster_index % num_columns;
+  const int row = cluster_index / num_columns;
+  if (column > 0) {
+    for (const std::pair<int, int>& crossing : clusters[cluster_index - 1].east_border) {
+      add_link(crossing.second, crossing.first);
+    }
+  }
+  if (row > 0) {
+    for (const std::pair<int, int>& crossing : clusters[cluster_index - num_columns].south_border) {
+      add_link(crossing.second, crossing.first);
+    }
+  }
+
+  // Shortest paths between entrances inside the cluster.
+  const int num_entrances = cluster.entrances.size();
+  cluster.costs.assign(num_entrances * num_entrances, -1);
+  std::vector<int> local_costs;
+  for (int i = 0; i < num_entrances; ++i) {
+    compute_local_costs(cluster_index, cluster.entrances[i], false, is_transition_valid, local_costs);
+    for (int j = 0; j < num_entrances; ++j) {
+      cluster.costs[i * num_entrances + j] =
+          local_costs[get_local_index(cluster_index, cluster.entrances[j])];
+    }
+  }
+}
+
+/**
+ * \brief Computes the cost of the shortest paths from a node to all
+ * nodes of its cluster, without leaving the cluster (Dijkstra).
+ * \param cluster_index Index of the cluster.
+ * \param source_index Index of a node of this cluster.
+ * \param reverse \c true to compute the cost of paths from all nodes
+ * to this node instead.
+ * \param is_transition_valid Tells whether the terrain allows a transition.
+ * \param[out] costs Cost to reach each node of the cluster
+ * (by local index), or -1 if it cannot be reached.
+ */
+void PathFindingClusters::compute_local_costs(
+    int cluster_index,
+    int source_index,
+    bool reverse,
+    const TransitionTest& is_transition_valid,
+    std::vector<int>& costs) const {
+
+  const int x8_min = (cluster_index % num_columns) * cluster_size;
+  const int y8_min = (cluster_index / num_columns) * cluster_size;
+  const int x8_max = std::min(width8, x8_min + cluster_size) - 1;
+  const int y8_max = std::min(height8, y8_min + cluster_size) - 1;
+
+  costs.assign(cluster_size * cluster_size, -1);
+
+  using QueueEntry = std::pair<int, int>;  // Cost and node index.
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+  costs[get_local_index(cluster_index, source_index)] = 0;
+  queue.emplace(0, source_index);
+
+  while (!queue.empty()) {
+
+    const int cost = queue.top().first;
+    const int index = queue.top().second;
+    queue.pop();
+    if (cost > costs[get_local_index(cluster_index, index)]) {
+      continue;  // Already reached with a lower cost.
+    }
+
+    const int x8 = index % width8;
+    const int y8 = index / width8;
+    for (int direction = 0; direction < 8; ++direction) {
+
+      const int new_x8 = x8 + direction_dx[direction];
+      const int new_y8 = y8 + direction_dy[direction];
+      if (new_x8 < x8_min || new_x8 > x8_max ||
+          new_y8 < y8_min || new_y8 > y8_max) {
+        continue;
+      }
+
+      const int new_index = new_y8 * width8 + new_x8;
+      const int new_cost = cost + get_transition_cost(direction);
+      int& known_cost = costs[get_local_index(cluster_index, new_index)];
+      const bool valid = reverse ?
+          is_transition_valid(new_index, (direction + 4) % 8) :
+          is_transition_valid(index, direction);
+      if ((known_cost != -1 && known_cost <= new_cost) || !valid) {
+        continue;
+      }
+      known_cost = new_cost;
+      queue.emplace(new_cost, new_index);
+    }
+  }
+}
+
+/**
+ * \brief Searches a path in the abstract graph.
+ *
+ * The source and target nodes are temporarily connected to the entrances
+ * of their clusters.
+ * The search uses the nodes and the open heap of the grid, so it cannot
+ * run at the same time as another search on the same grid.
+ *
+ * \param grid The node storage of the map.
+ * \param source_index Index of the starting node.
+ * \param target_index Index of the node to reach.
+ * \param is_transition_valid Tells whether the terrain allows a transition.
+ * \return The nodes of the abstract path, including the source and the
+ * target, or an empty list if the terrain allows no path.
+ */
+std::vector<int> PathFindingClusters::find_path(
+    PathFindingGrid& grid,
+    int source_index,
+    int target_index,
+    const TransitionTest& is_transition_valid) {
+
+  Debug::check_assertion(grid.get_width8() == width8 && grid.get_height8() == height8,
+      "Clusters do not match the path finding grid");
+
+  update(is_transition_valid);
+
+  const int source_cluster = get_cluster_index(source_index);
+  const int target_cluster = get_cluster_index(target_index);
+  std::vector<int> source_costs;
+  std::vector<int> target_costs;
+  compute_local_costs(source_cluster, source_index, false, is_transition_valid, source_costs);
+  compute_local_costs(target_cluster, target_index, true, is_transition_valid, target_costs);
+
+  const Point target = grid.get_square_location(target_index);
+  const auto& relax = [&](int parent_index, int index, int cost) {
+    if (cost == -1 || grid.is_closed(index)) {
+      return;
+    }
+    const int previous_cost = grid.get_node(parent_index).previous_cost + cost;
+    PathFindingGrid::Node& node = grid.get_node(index);
+    if (!grid.is_reached(index)) {
+      node.previous_cost = previous_cost;
+      node.total_cost = previous_cost +
+          Geometry::get_manhattan_distance(grid.get_square_location(index), target);
+      node.parent_index = parent_index;
+      node.direction = ' ';
+      grid.open(index);
+    }
+    else if (previous_cost < node.previous_cost) {
+      node.total_cost -= node.previous_cost - previous_cost;
+      node.previous_cost = previous_cost;
+      node.parent_index = parent_index;
+      grid.notify_cost_decreased(index);
+    }
+  };
+
+  grid.start_search();
+  PathFindingGrid::Node& source_node = grid.get_node(source_index);
+  source_node.previous_cost = 0;
+  source_node.total_cost = Geometry::get_manhattan_distance(
+      grid.get_square_location(source_index), target);
+  source_node.parent_index = -1;
+  source_node.direction = ' ';
+  grid.open(source_index);
+
+  while (grid.has_open_nodes()) {
+
+    const int index = grid.close_best_node();
+    if (index == target_index) {
+      std::vector<int> path;
+      for (int i = index; i != -1; i = grid.get_node(i).parent_index) {
+        path.push_back(i);
+      }
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+
+    const int cluster_index = get_cluster_index(index);
+    const Cluster& cluster = clusters[cluster_index];
+
+    if (index == source_index) {
+      // Leave the source cluster or go directly to the target.
+      for (int entrance : cluster.entrances) {
+        relax(index, entrance, source_costs[get_local_index(cluster_index, entrance)]);
+      }
+      if (cluster_index == target_cluster) {
+        relax(index, target_index, source_costs[get_local_index(cluster_index, target_index)]);
+      }
+    }
+
+    const auto& it = std::find(cluster.entrances.begin(), cluster.entrances.end(), index);
+    if (it == cluster.entrances.end()) {
+      continue;
+    }
+
+    // Move inside the cluster.
+    const int position = it - cluster.entrances.begin();
+    const int num_entrances = cluster.entrances.size();
+    for (int i = 0; i < num_entrances; ++i) {
+      if (i != position) {
+        relax(index, cluster.entrances[i], cluster.costs[position * num_entrances + i]);
+      }
+    }
+    if (cluster_index == target_cluster) {
+      relax(index, target_index, target_costs[get_local_index(cluster_index, index)]);
+    }
+
+    // Cross to a neighbor cluster.
+    for (const std::pair<int, int>& link : cluster.links) {
+      if (link.first == position) {
+        relax(index, link.second, get_transition_cost(0));
+      }
+    }
+  }
+
+  return std::vector<int>();  // No path.
+}
+
+}
+
@@ -0,0 +1,554 @@
+/*
+ * Copyright (C) 2006-2016 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/movements/PathFindingGrid.h"
+#include "solarus/entities/Entity.h"
+#include "solarus/lowlevel/Debug.h"
+#include <algorithm>
+
+namespace Solarus {
+
+namespace {
+
+/**
+ * \brief Delay in milliseconds before a cached path expires.
+ *
+ * Dynamic obstacles are not part of the ground caches,
+ * so a path is only reused for a short time.
+ */
+const uint32_t path_lifetime = 300;
+
+/**
+ * \brief Maximum number of paths remembered.
+ */
+const size_t max_cached_paths = 32;
+
+/**
+ * \brief Translation in 8x8 squares of each direction of a path.
+ */
+const Point direction_steps[] = {
+  {  1,  0 },
+  {  1, -1 },
+  {  0, -1 },
+  { -1, -1 },
+  { -1,  0 },
+  { -1,  1 },
+  {  0,  1 },
+  {  1,  1 }
+};
+
+/**
+ * \brief Returns whether two keys identify the same search.
+ * \param key_1 A search.
+ * \param key_2 Another search.
+ * \return \c true if both searches give the same result.
+ */
+bool is_same_search(
+    const PathFindingGrid::PathKey& key_1,
+    const PathFindingGrid::PathKey& key_2) {
+
+  return key_1.source_index == key_2.source_index &&
+      key_1.target_index == key_2.target_index &&
+      key_1.layer == key_2.layer &&
+      key_1.obstacle_grounds == key_2.obstacle_grounds &&
+      key_1.source_type == key_2.source_type &&
+      key_1.source_size == key_2.source_size &&
+      key_1.obstacle_traits == key_2.obstacle_traits &&
+      key_1.source_entity == key_2.source_entity;
+}
+
+}  // Anonymous namespace.
+
+/**
+ * \brief Creates the nodes of a map.
+ * \param width8 Width of the map in 8x8 squares.
+ * \param height8 Height of the map in 8x8 squares.
+ */
+PathFindingGrid::PathFindingGrid(int width8, int height8):
+  width8(width8),
+  height8(height8),
+  nodes(width8 * height8),
+  open_heap(),
+  generation(0),
+  next_order(0),
+  ground_caches(),
+  ground_modifiers(),
+  cached_paths(),
+  next_cached_path(0) {
+
+  Debug::check_assertion(width8 > 0 && height8 > 0, "Invalid path finding grid size");
+
+  for (Node& node : nodes) {
+    node.generation = 0;
+  }
+}
+
+/**
+ * \brief Returns the number of columns of the grid.
+ * \return The map width in 8x8 squares.
+ */
+int PathFindingGrid::get_width8() const {
+  return width8;
+}
+
+/**
+ * \brief Returns the number of rows of the grid.
+ * \return The map height in 8x8 squares.
+ */
+int PathFindingGrid::get_height8() const {
+  return height8;
+}
+
+/**
+ * \brief Returns whether a location is inside the map.
+ * \param location A location on the map.
+ * \return \c true if a node exists at this location.
+ */
+bool PathFindingGrid::is_in_grid(const Point& location) const {
+
+  return location.x >= 0 && location.y >= 0 &&
+      location.x < width8 * 8 && location.y < height8 * 8;
+}
+
+/**
+ * \brief Returns the index of the 8x8 square containing a location.
+ * \param location A location inside the map.
+ * \return Index of the corresponding node.
+ */
+int PathFindingGrid::get_square_index(const Point& location) const {
+
+  return (location.y / 8) * width8 + location.x / 8;
+}
+
+/**
+ * \brief Returns the top-left corner of an 8x8 square.
+ * \param index Index of a node.
+ * \return Location of the node on the map.
+ */
+Point PathFindingGrid::get_square_location(int index) const {
+
+  return Point((index % width8) * 8, (index / width8) * 8);
+}
+
+/**
+ * \brief Forgets the previous search and prepares a new one.
+ *
+ * This is done in constant time: nodes are not cleared.
+ */
+void PathFindingGrid::start_search() {
+
+  open_heap.clear();
+  next_order = 0;
+  ++generation;
+
+  if (generation == 0) {
+    // The counter wrapped: old values could be mistaken for the new search.
+    for (Node& node : nodes) {
+      node.generation = 0;
+    }
+    generation = 1;
+  }
+}
+
+/**
+ * \brief Adds a node to the open heap of the current search.
+ *
+ * The costs of the node must be already set.
+ *
+ * \param index Index of a node not reached yet by the current search.
+ */
+void PathFindingGrid::open(int index) {
+
+  Node& node = nodes[index];
+  node.generation = generation;
+  node.order = next_order++;
+  open_heap.push_back(index);
+  place_in_heap(index, open_heap.size() - 1);
+  sift_up(node.heap_position);
+}
+
+/**
+ * \brief Restores the heap order after the cost of an open node decreased.
+ * \param index Index of an open node.
+ */
+void PathFindingGrid::notify_cost_decreased(int index) {
+
+  SOLARUS_ASSERT(is_open(index), "This node is not open");
+  sift_up(nodes[index].heap_position);
+}
+
+/**
+ * \brief Returns whether there are nodes left to explore.
+ * \return \c true if the open heap is not empty.
+ */
+bool PathFindingGrid::has_open_nodes() const {
+  return !open_heap.empty();
+}
+
+/**
+ * \brief Removes the open node with the lowest total cost and closes it.
+ *
+ * When several nodes have the same cost, the one opened last is chosen.
+ *
+ * \return Index of the node closed.
+ */
+int PathFindingGrid::close_best_node() {
+
+  SOLARUS_ASSERT(has_open_nodes(), "No open nodes");
+
+  const int best_index = open_heap.front();
+  const int last_index = open_heap.back();
+  open_heap.pop_back();
+  if (!open_heap.empty()) {
+    place_in_heap(last_index, 0);
+    sift_down(0);
+  }
+  nodes[best_index].heap_position = -1;
+  return best_index;
+}
+
+/**
+ * \brief Returns the terrain cache of a layer for a set of obstacle grounds.
+ *
+ * The cache is created empty the first time.
+ *
+ * \param layer A layer of the map.
+ * \param obstacle_grounds Bit field of the grounds that are obstacles
+ * (bit \c n set means that <tt>Ground(n)</tt> is an obstacle).
+ * \return Index of the cache.
+ */
+int PathFindingGrid::get_ground_cache(int layer, uint32_t obstacle_grounds) {
+
+  for (size_t i = 0; i < ground_caches.size(); ++i) {
+    const GroundCache& cache = ground_caches[i];
+    if (cache.layer == layer && cache.obstacle_grounds == obstacle_grounds) {
+      return i;
+    }
+  }
+
+  GroundCache cache;
+  cache.layer = layer;
+  cache.obstacle_grounds = obstacle_grounds;
+  cache.known.assign(nodes.size(), 0);
+  cache.obstacles.assign(nodes.size(), 0);
+  ground_caches.push_back(std::move(cache));
+  return ground_caches.size() - 1;
+}
+
+/**
+ * \brief Returns whether the terrain blocks a transition, if known.
+ * \param cache Index of a terrain cache.
+ * \param index Index of the node where the transition starts.
+ * \param direction Direction of the transition (0 to 7).
+ * \param[out] obstacle Whether the terrain blocks the transition.
+ * Unchanged if the transition was never tested.
+ * \return \c true if the result is known.
+ */
+bool PathFindingGrid::get_ground_obstacle(
+    int cache, int index, int direction, bool& obstacle) const {
+
+  const GroundCache& ground_cache = ground_caches[cache];
+  const uint8_t mask = 1 << direction;
+  if ((ground_cache.known[index] & mask) == 0) {
+    return false;
+  }
+  obstacle = (ground_cache.obstacles[index] & mask) != 0;
+  return true;
+}
+
+/**
+ * \brief Stores whether the terrain blocks a transition.
+ * \param cache Index of a terrain cache.
+ * \param index Index of the node where the transition starts.
+ * \param direction Direction of the transition (0 to 7).
+ * \param obstacle Whether the terrain blocks the transition.
+ */
+void PathFindingGrid::set_ground_obstacle(
+    int cache, int index, int direction, bool obstacle) {
+
+  GroundCache& ground_cache = ground_caches[cache];
+  const uint8_t mask = 1 << direction;
+  ground_cache.known[index] |= mask;
+  if (obstacle) {
+    ground_cache.obstacles[index] |= mask;
+  }
+  else {
+    ground_cache.obstacles[index] &= ~mask;
+  }
+}
+
+/**
+ * \brief Returns the abstract graph used to compute long paths with a
+ * terrain cache.
+ *
+ * It is created the first time and then kept up to date when
+ * the terrain changes.
+ *
+ * \param cache Index of a terrain cache.
+ * \return The clusters of this terrain cache.
+ */
+PathFindingClusters& PathFindingGrid::get_clusters(int cache) {
+
+  GroundCache& ground_cache = ground_caches[cache];
+  if (ground_cache.clusters == nullptr) {
+    ground_cache.clusters = std::unique_ptr<PathFindingClusters>(
+        new PathFindingClusters(width8, height8)
+    );
+  }
+  return *ground_cache.clusters;
+}
+
+/**
+ * \brief Forgets what is known about the terrain of a rectangle.
+ *
+ * This function should be called when the ground changes there.
+ * Cached paths that cross it are forgotten too.
+ *
+ * \param layer The layer where the ground changed.
+ * \param area The rectangle where the ground changed.
+ */
+void PathFindingGrid::notify_ground_changed(int layer, const Rectangle& area) {
+
+  invalidate_ground(area, false, layer);
+}
+
+/**
+ * \brief Forgets what is known about the terrain around an entity that
+ * modifies the ground or just stopped modifying it.
+ *
+ * This function should be called when such an entity appears, moves,
+ * changes its ground, gets enabled or disabled, or disappears.
+ * Both its previous and its current bounding boxes are invalidated.
+ *
+ * \param entity An entity that modifies the ground or just stopped
+ * modifying it.
+ */
+void PathFindingGrid::notify_ground_modifier_changed(const Entity& entity) {
+
+  // Where the entity was.
+  const auto& it = ground_modifiers.find(&entity);
+  if (it != ground_modifiers.end()) {
+    invalidate_ground(it->second, true, 0);
+    ground_modifiers.erase(it);
+  }
+
+  // Where it is now.
+  if (entity.is_ground_modifier() &&
+      entity.is_enabled() &&
+      !entity.is_being_removed()) {
+    const Rectangle& box = entity.get_bounding_box();
+    ground_modifiers[&entity] = box;
+    invalidate_ground(box, true, 0);
+  }
+}
+
+/**
+ * \brief Forgets the paths recently found for an entity that is being removed.
+ *
+ * This only concerns entities whose obstacle rules are specific to them:
+ * another entity created later at the same address must not reuse them.
+ *
+ * \param entity The entity being removed.
+ */
+void PathFindingGrid::notify_entity_removed(const Entity& entity) {
+
+  cached_paths.erase(std::remove_if(cached_paths.begin(), cached_paths.end(),
+      [&](const CachedPath& cached_path) {
+    return cached_path.key.source_entity == &entity;
+  }), cached_paths.end());
+  next_cached_path = cached_paths.size() % max_cached_paths;
+}
+
+/**
+ * \brief Forgets the terrain transitions that may overlap a rectangle.
+ * \param area The rectangle where the ground changed.
+ * \param all_layers \c true to invalidate all layers.
+ * \param layer The layer to invalidate if \c all_layers is \c false.
+ */
+void PathFindingGrid::invalidate_ground(
+    const Rectangle& area, bool all_layers, int layer) {
+
+  // The transitions from a node at (x,y) are all inside
+  // the rectangle (x - 8, y - 8, 32, 32).
+  const int x8_min = std::max(0, area.get_x() - 24) / 8;
+  const int y8_min = std::max(0, area.get_y() - 24) / 8;
+  const int x8_max = std::min(width8 - 1, (area.get_x() + area.get_width() + 8) / 8);
+  const int y8_max = std::min(height8 - 1, (area.get_y() + area.get_height() + 8) / 8);
+  if (x8_min > x8_max || y8_min > y8_max) {
+    return;
+  }
+
+  // Forget the paths that have a node there.
+  const size_t num_cached_paths = cached_paths.size();
+  cached_paths.erase(std::remove_if(cached_paths.begin(), cached_paths.end(),
+      [&](const CachedPath& cached_path) {
+    return (all_layers || cached_path.key.layer == layer) &&
+        cached_path.x8_min <= x8_max && x8_min <= cached_path.x8_max &&
+        cached_path.y8_min <= y8_max && y8_min <= cached_path.y8_max;
+  }), cached_paths.end());
+  if (cached_paths.size() != num_cached_paths) {
+    next_cached_path = cached_paths.size() % max_cached_paths;
+  }
+
+  for (GroundCache& cache : ground_caches) {
+    if (!all_layers && cache.layer != layer) {
+      continue;
+    }
+    for (int y8 = y8_min; y8 <= y8_max; ++y8) {
+      const int row = y8 * width8;
+      std::fill(cache.known.begin() + row + x8_min, cache.known.begin() + row + x8_max + 1, 0);
+    }
+    if (cache.clusters != nullptr) {
+      cache.clusters->invalidate(x8_min, y8_min, x8_max, y8_max);
+    }
+  }
+}
+
+/**
+ * \brief Returns the result of a recent search, if any.
+ * \param key The search to look for.
+ * \param now The current simulated time.
+ * \param[out] path The path found by this search, possibly empty.
+ * Unchanged if the search is not in the cache.
+ * \return \c true if a recent result was found.
+ */
+bool PathFindingGrid::get_cached_path(
+    const PathKey& key, uint32_t now, std::string& path) const {
+
+  for (const CachedPath& cached_path : cached_paths) {
+    if (is_same_search(cached_path.key, key) &&
+        now - cached_path.date < path_lifetime) {
+      path = cached_path.path;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief Remembers the result of a search.
+ *
+ * The oldest path is replaced if the cache is full.
+ *
+ * \param key The search.
+ * \param now The current simulated time.
+ * \param path The path found, possibly empty.
+ */
+void PathFindingGrid::add_cached_path(
+    const PathKey& key, uint32_t now, const std::string& path) {
+
+  CachedPath cached_path = { key, now, path, 0, 0, width8 - 1, height8 - 1 };
+  if (!path.empty()) {
+    // Remember the nodes crossed to know when the ground changes there.
+    // A failed search depends on the whole map.
+    int x8 = key.source_index % width8;
+    int y8 = key.source_index / width8;
+    cached_path.x8_min = cached_path.x8_max = x8;
+    cached_path.y8_min = cached_path.y8_max = y8;
+    for (char direction : path) {
+      const Point& step = direction_steps[direction - '0'];
+      x8 += step.x;
+      y8 += step.y;
+      cached_path.x8_min = std::min(cached_path.x8_min, x8);
+      cached_path.y8_min = std::min(cached_path.y8_min, y8);
+      cached_path.x8_max = std::max(cached_path.x8_max, x8);
+      cached_path.y8_max = std::max(cached_path.y8_max, y8);
+    }
+  }
+  if (cached_paths.size() < max_cached_paths) {
+    cached_paths.push_back(std::move(cached_path));
+  }
+  else {
+    cached_paths[next_cached_path] = std::move(cached_path);
+  }
+  next_cached_path = (next_cached_path + 1) % max_cached_paths;
+}
+
+/**
+ * \brief Returns whether a node should be explored before another one.
+ * \param index_1 Index of an open node.
+ * \param index_2 Index of another open node.
+ * \return \c true if the first node has priority.
+ */
+bool PathFindingGrid::is_better(int index_1, int index_2) const {
+
+  const Node& node_1 = nodes[index_1];
+  const Node& node_2 = nodes[index_2];
+  if (node_1.total_cost != node_2.total_cost) {
+    return node_1.total_cost < node_2.total_cost;
+  }
+  return node_1.order > node_2.order;
+}
+
+/**
+ * \brief Stores a node at a position of the heap.
+ * \param index Index of the node.
+ * \param position Position in the heap.
+ */
+void PathFindingGrid::place_in_heap(int index, int position) {
+
+  open_heap[position] = index;
+  nodes[index].heap_position = position;
+}
+
+/**
+ * \brief Moves a node up in the heap until its parent has priority.
+ * \param position Current position of the node in the heap.
+ */
+void PathFindingGrid::sift_up(int position) {
+
+  const int index = open_heap[position];
+  while (position > 0) {
+    const int parent_position = (position - 1) / 2;
+    const int parent_index = open_heap[parent_position];
+    if (!is_better(index, parent_index)) {
+      break;
+    }
+    place_in_heap(parent_index, position);
+    position = parent_position;
+  }
+  place_in_heap(index, position);
+}
+
+/**
+ * \brief Moves a node down in the heap until it has priority over its children.
+ * \param position Current position of the node in the heap.
+ */
+void PathFindingGrid::sift_down(int position) {
+
+  const int size = open_heap.size();
+  const int index = open_heap[position];
+  while (true) {
+    int child_position = 2 * position + 1;
+    if (child_position >= size) {
+      break;
+    }
+    if (child_position + 1 < size &&
+        is_better(open_heap[child_position + 1], open_heap[child_position])) {
+      ++child_position;
+    }
+    const int child_index = open_heap[child_position];
+    if (!is_better(child_index, index)) {
+      break;
+    }
+    place_in_heap(child_index, position);
+    position = child_position;
+  }
+  place_in_heap(index, position);
+}
+
+}
+
@@ -31,7 +31,8 @@ namespace Solarus {
 PathFindingMovement::PathFindingMovement(int speed):
   PathMovement("", speed, false, false, true),
   target(),
-  next_recomputation_date(0) {
+  next_recomputation_date(0),
+  long_range(false) {
 
 }
 
@@ -44,6 +45,26 @@ void PathFindingMovement::set_target(const EntityPtr& target) {
   next_recomputation_date = System::now() + 100;
 }
 
+/**
+ * \brief Returns whether targets far from the entity are searched.
+ * \return \c true if the movement is in long range mode.
+ */
+bool PathFindingMovement::is_long_range() const {
+  return long_range;
+}
+
+/**
+ * \brief Sets whether targets far from the entity are searched.
+ *
+ * By default, the movement is a random walk when the target is more than
+ * 200 pixels away.
+ *
+ * \param long_range \c true to search paths to far targets too.
+ */
+void PathFindingMovement::set_long_range(bool long_range) {
+  this->long_range = long_range;
+}
+
 /**
  * \brief Updates the position.
  */
@@ -81,6 +102,7 @@ void PathFindingMovement::recompute_movement() {
 
   if (target != nullptr) {
     PathFinding path_finding(get_entity()->get_map(), *get_entity(), *target);
+    path_finding.set_long_range(long_range);
     std::string path = path_finding.compute_path();
 
     uint32_t min_delay;
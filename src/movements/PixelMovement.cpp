@@ -19,6 +19,7 @@
 #include "solarus/lua/LuaContext.h"
 #include "solarus/lowlevel/System.h"
 #include "solarus/lowlevel/Debug.h"
+#include <iterator>
 #include <sstream>
 
 namespace Solarus {
@@ -171,19 +172,24 @@ void PixelMovement::update() {
 
   uint32_t now = System::now();
 
+  start_sweep();
   while (now >= next_move_date &&
       !is_suspended() &&
       !finished &&
       (get_entity() == nullptr || get_entity()->get_movement().get() == this)
   ) {
     Point old_xy = get_xy();
-    make_next_step();
+    if (!make_next_step()) {
+      // Detectors of the previous steps stopped this movement.
+      break;
+    }
 
     bool success = (get_xy() != old_xy);
     if (!success) {
       notify_obstacle_reached();
     }
   }
+  finish_sweep();
 
   // Do this at last so that Movement::update() knows whether we are finished.
   Movement::update();
@@ -208,8 +214,18 @@ void PixelMovement::set_suspended(bool suspended) {
  * \brief Makes a move in the trajectory.
  *
  * This function must be called only when the trajectory is not finished yet.
+ *
+ * \return \c false if the step was not made because detectors of the
+ * previous steps stopped this movement.
  */
-void PixelMovement::make_next_step() {
+bool PixelMovement::make_next_step() {
+
+  if (!loop &&
+      std::next(trajectory_iterator) == trajectory.end() &&
+      !notify_swept_steps()) {
+    // This step finishes the movement: the previous ones come first.
+    return false;
+  }
 
   bool success = false;
   const Point& dxy = *trajectory_iterator;
@@ -218,6 +234,10 @@ void PixelMovement::make_next_step() {
     translate_xy(dxy);
     success = true;
   }
+  else if (!notify_swept_steps()) {
+    // The obstacle comes after the previous steps.
+    return false;
+  }
 
   ++trajectory_iterator;
 
@@ -238,6 +258,7 @@ void PixelMovement::make_next_step() {
   int step_index = nb_steps_done;
   nb_steps_done++;
   notify_step_done(step_index, success);
+  return true;
 }
 
 /**
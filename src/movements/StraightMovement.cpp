@@ -403,7 +403,8 @@ void StraightMovement::update_smooth_xy() {
     bool success = (get_xy() != old_xy)
         && (x_move != 0 || y_move != 0);
 
-    if (!success) {
+    if (!success && notify_swept_steps()) {
+      // Detectors of the previous steps did not stop the movement.
       notify_obstacle_reached();
     }
   }
@@ -633,7 +634,8 @@ void StraightMovement::update_non_smooth_xy() {
     bool success = (get_xy() != old_xy)
         && (x_move != 0 || y_move != 0);
 
-    if (!success) {
+    if (!success && notify_swept_steps()) {
+      // Detectors of the previous steps did not stop the movement.
       notify_obstacle_reached();
     }
   }
@@ -653,6 +655,8 @@ void StraightMovement::update() {
     bool x_move_now = x_move != 0 && now >= next_move_date_x;
     bool y_move_now = y_move != 0 && now >= next_move_date_y;
 
+    Entity* entity = get_entity();
+    start_sweep();
     while (x_move_now || y_move_now) { // while it's time to move
 
       if (is_smooth()) {
@@ -662,10 +666,19 @@ void StraightMovement::update() {
         update_non_smooth_xy();
       }
 
+      if (entity != nullptr && get_entity() != entity) {
+        // A detector replaced this movement.
+        break;
+      }
+
       now = System::now();
 
       if (!finished && max_distance != 0
           && Geometry::get_distance(initial_xy, get_xy()) >= max_distance) {
+        // Detectors of the previous steps may stop the movement before.
+        if (!notify_swept_steps()) {
+          break;
+        }
         set_finished();
       }
       else {
@@ -673,6 +686,7 @@ void StraightMovement::update() {
         y_move_now = y_move != 0 && now >= next_move_date_y;
       }
     }
+    finish_sweep();
   }
 
   // Do this at last so that Movement::update() knows whether we are finished.
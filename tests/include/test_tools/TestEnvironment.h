@@ -23,6 +23,7 @@
 #include "solarus/lowlevel/Point.h"
 #include <cstdint>
 #include <memory>
+#include <string>
 
 namespace Solarus {
 
@@ -71,6 +72,10 @@ class TestEnvironment {
     uint32_t now();
     void step();
 
+    // Lua.
+    void run_lua(const std::string& code);
+    int get_lua_integer(const std::string& name);
+
   private:
 
     Arguments arguments;
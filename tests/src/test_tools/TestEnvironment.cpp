@@ -19,10 +19,12 @@
 #include "solarus/entities/Npc.h"
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/System.h"
+#include "solarus/lua/LuaContext.h"
 #include "solarus/Map.h"
 #include "solarus/Game.h"
 #include "solarus/Savegame.h"
 #include "test_tools/TestEnvironment.h"
+#include <lua.hpp>
 
 namespace Solarus {
 
@@ -182,5 +184,32 @@ void TestEnvironment::step() {
   get_main_loop().step();
 }
 
+/**
+ * \brief Runs some Lua code and stops the test if there is an error.
+ * \param code The code to run.
+ */
+void TestEnvironment::run_lua(const std::string& code) {
+
+  lua_State* l = get_main_loop().get_lua_context().get_internal_state();
+  if (luaL_dostring(l, code.c_str()) != 0) {
+    const std::string error = lua_tostring(l, -1);
+    lua_pop(l, 1);
+    Debug::die("Lua error: " + error);
+  }
+}
+
+/**
+ * \brief Returns the value of an integer global variable of Lua.
+ * \param name Name of the global variable.
+ * \return Its value.
+ */
+int TestEnvironment::get_lua_integer(const std::string& name) {
+
+  lua_State* l = get_main_loop().get_lua_context().get_internal_state();
+  lua_getglobal(l, name.c_str());
+  const int value = static_cast<int>(lua_tointeger(l, -1));
+  lua_pop(l, 1);
+  return value;
 }
 
+}
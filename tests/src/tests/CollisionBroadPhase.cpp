@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/CollisionBroadPhase.h"
+#include "solarus/entities/Entities.h"
+#include "solarus/entities/Hero.h"
+#include "solarus/entities/Npc.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/Map.h"
+#include "solarus/Sprite.h"
+#include "test_tools/TestEnvironment.h"
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Checks that collision checks of entities that move are never
+ * postponed.
+ */
+void moving_entity_test(TestEnvironment& env) {
+
+  Hero& hero = env.get_hero();
+  CollisionBroadPhase& broad_phase = env.get_entities().get_collision_broad_phase();
+
+  // An NPC whose bounding box is (160,96) to (176,112), and another one far away.
+  std::shared_ptr<Npc> npc = env.make_entity<Npc>(Point(168, 109));
+  env.make_entity<Npc>(Point(264, 205));
+  hero.set_animation_direction(1);
+
+  // Move the hero just below the NPC while recording.
+  broad_phase.start();
+  Debug::check_assertion(broad_phase.is_recording(), "Collision checks are not batched");
+  hero.set_top_left_xy(160, 112);
+  hero.notify_position_changed();
+  Debug::check_assertion(hero.get_facing_entity() == npc.get(),
+      "Collision check of a moving entity was postponed");
+  broad_phase.finish();
+  Debug::check_assertion(!broad_phase.is_recording(), "Collision checks are still batched");
+
+  hero.set_top_left_xy(16, 16);
+  hero.notify_position_changed();
+}
+
+/**
+ * \brief Creates an entity that does not move and a detector
+ * whose sprites overlap, and another detector far from them.
+ *
+ * The detectors append a digit to the global variable collisions when
+ * they detect an entity: 1 for the entity that does not move, 2 for
+ * another entity named mover.
+ *
+ * \param env The test environment.
+ * \return The entity that does not move.
+ */
+Entity& create_sprite_entities(TestEnvironment& env) {
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "still = map:create_custom_entity({ name = 'still', x = 56, y = 93, layer = 0, width = 16, height = 16, direction = 0, sprite = 'entities/bomb' })\n"
+      "sprite_trap = map:create_custom_entity({ x = 56, y = 93, layer = 0, width = 16, height = 16, direction = 0, sprite = 'entities/bomb' })\n"
+      "mover = map:create_custom_entity({ x = 120, y = 93, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "trap = map:create_custom_entity({ x = 200, y = 93, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "sprite_trap:add_collision_test('sprite', function(sprite_trap, other)\n"
+      "  if other == still then\n"
+      "    collisions = collisions * 10 + 1\n"
+      "  end\n"
+      "end)\n"
+      "trap:add_collision_test('overlapping', function(trap, other)\n"
+      "  if other == mover then\n"
+      "    collisions = collisions * 10 + 2\n"
+      "  end\n"
+      "end)\n"
+      "collisions = 0\n"
+  );
+  return *env.get_entities().get_entity("still");
+}
+
+/**
+ * \brief Removes the entities of create_sprite_entities().
+ * \param env The test environment.
+ */
+void remove_sprite_entities(TestEnvironment& env) {
+
+  env.run_lua(
+      "still:remove()\n"
+      "sprite_trap:remove()\n"
+      "mover:remove()\n"
+      "trap:remove()\n"
+  );
+}
+
+/**
+ * \brief Checks that sprite checks of entities that do not move are
+ * postponed, and done before any later check that is not postponed.
+ */
+void still_entity_test(TestEnvironment& env) {
+
+  Map& map = env.get_map();
+  CollisionBroadPhase& broad_phase = env.get_entities().get_collision_broad_phase();
+  Entity& still = create_sprite_entities(env);
+
+  broad_phase.start();
+  map.check_collision_with_detectors(still, *still.get_sprites()[0]);
+  Debug::check_assertion(env.get_lua_integer("collisions") == 0,
+      "Sprite check of an entity that does not move was not postponed");
+
+  // The mover is checked immediately, after the postponed check.
+  env.run_lua("mover:set_position(200, 93)\n");
+  Debug::check_assertion(env.get_lua_integer("collisions") == 12,
+      "Collision checks were not done in the order they were requested");
+
+  broad_phase.finish();
+  Debug::check_assertion(env.get_lua_integer("collisions") == 12,
+      "Unexpected collisions at the end of the cycle");
+
+  remove_sprite_entities(env);
+}
+
+/**
+ * \brief Checks that batched collision checks interrupted by a suspension
+ * of the map are done when the map is resumed.
+ */
+void suspended_test(TestEnvironment& env) {
+
+  Map& map = env.get_map();
+  CollisionBroadPhase& broad_phase = env.get_entities().get_collision_broad_phase();
+  Entity& still = create_sprite_entities(env);
+
+  broad_phase.start();
+  map.check_collision_with_detectors(still, *still.get_sprites()[0]);
+  map.set_suspended(true);
+  broad_phase.finish();
+  Debug::check_assertion(env.get_lua_integer("collisions") == 0,
+      "Collision checked while the map is suspended");
+
+  map.set_suspended(false);
+  Debug::check_assertion(env.get_lua_integer("collisions") == 1,
+      "Collision check lost when the map was resumed");
+
+  remove_sprite_entities(env);
+}
+
+/**
+ * \brief Moves a detector from a collision callback and returns how many
+ * times it then detects another entity that moves in the same cycle.
+ * \param env The test environment.
+ * \param batched Whether to batch collision checks.
+ * \return The number of collisions detected.
+ */
+int get_moved_detector_hits(TestEnvironment& env, bool batched) {
+
+  CollisionBroadPhase& broad_phase = env.get_entities().get_collision_broad_phase();
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "num_hits = 0\n"
+      "trap = map:create_custom_entity({ x = 40, y = 45, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "mover = map:create_custom_entity({ x = 72, y = 45, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "probe = map:create_custom_entity({ x = 120, y = 45, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "target = map:create_custom_entity({ x = 200, y = 45, layer = 0, width = 16, height = 16, direction = 0 })\n"
+      "trap:add_collision_test('overlapping', function(trap, other)\n"
+      "  if other == mover then\n"
+      "    target:set_position(probe:get_position())\n"
+      "  end\n"
+      "end)\n"
+      "target:add_collision_test('overlapping', function(target, other)\n"
+      "  if other == probe then\n"
+      "    num_hits = num_hits + 1\n"
+      "  end\n"
+      "end)\n"
+  );
+
+  if (batched) {
+    broad_phase.start();
+  }
+  env.run_lua(
+      "mover:set_position(40, 45)\n"
+      "probe:set_position(121, 45)\n"
+  );
+  if (batched) {
+    broad_phase.finish();
+  }
+
+  const int num_hits = env.get_lua_integer("num_hits");
+  env.run_lua(
+      "trap:remove()\n"
+      "mover:remove()\n"
+      "probe:remove()\n"
+      "target:remove()\n"
+  );
+  return num_hits;
+}
+
+/**
+ * \brief Checks that batched collision checks see entities moved by
+ * collision callbacks of the same cycle.
+ */
+void moved_detector_test(TestEnvironment& env) {
+
+  const int immediate_hits = get_moved_detector_hits(env, false);
+  const int batched_hits = get_moved_detector_hits(env, true);
+
+  Debug::check_assertion(immediate_hits == 2, "Wrong number of immediate collisions");
+  Debug::check_assertion(batched_hits == immediate_hits,
+      "Batched checks used positions from before the collision callbacks");
+}
+
+/**
+ * \brief Checks that a full cycle works with batched collision checks.
+ */
+void update_test(TestEnvironment& env) {
+
+  env.step();
+  Debug::check_assertion(!env.get_entities().get_collision_broad_phase().is_recording(),
+      "Collision checks are still batched after a cycle");
+}
+
+}
+
+/**
+ * \brief Tests for the collision broad phase.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+  CollisionBroadPhase::set_enabled(true);
+
+  moving_entity_test(env);
+  still_entity_test(env);
+  suspended_test(env);
+  moved_detector_test(env);
+  update_test(env);
+
+  return 0;
+}
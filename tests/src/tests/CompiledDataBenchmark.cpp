@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/TilesetData.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/CurrentQuest.h"
+#include "solarus/MapData.h"
+#include "solarus/QuestResources.h"
+#include "solarus/ResourceType.h"
+#include "solarus/SpriteData.h"
+#include "test_tools/TestEnvironment.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Loads all data files of a resource type from Lua and from their
+ * compiled form, checks that the results are identical and compares
+ * the durations.
+ */
+template<typename Data>
+void benchmark_resource_type(
+    TestEnvironment& /* env */,
+    ResourceType resource_type,
+    const std::string& dir_name) {
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration lua_duration = Clock::duration::zero();
+  Clock::duration compiled_duration = Clock::duration::zero();
+  const int num_loads = 20;
+  int num_files = 0;
+  size_t lua_size = 0;
+  size_t compiled_size = 0;
+
+  const std::map<std::string, std::string>& elements =
+      CurrentQuest::get_resources().get_elements(resource_type);
+  for (const auto& kvp : elements) {
+
+    const std::string& file_name = dir_name + "/" + kvp.first + ".dat";
+    if (!QuestFiles::data_file_exists(file_name)) {
+      continue;
+    }
+    const std::string& buffer = QuestFiles::data_file_read(file_name);
+
+    Data lua_data;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < num_loads; ++i) {
+      lua_data = Data();
+      Debug::check_assertion(lua_data.import_from_buffer(buffer, file_name),
+          "Failed to load '" + file_name + "'");
+    }
+    lua_duration += Clock::now() - start;
+
+    std::string compiled_buffer;
+    Debug::check_assertion(lua_data.export_to_compiled_buffer(compiled_buffer, buffer),
+        "Failed to compile '" + file_name + "'");
+
+    Data compiled_data;
+    start = Clock::now();
+    for (int i = 0; i < num_loads; ++i) {
+      compiled_data = Data();
+      Debug::check_assertion(compiled_data.import_from_compiled_buffer(compiled_buffer, buffer),
+          "Failed to load compiled '" + file_name + "'");
+    }
+    compiled_duration += Clock::now() - start;
+
+    // Both forms must give the same data.
+    std::string lua_export;
+    std::string compiled_export;
+    Debug::check_assertion(lua_data.export_to_buffer(lua_export), "Export failed");
+    Debug::check_assertion(compiled_data.export_to_buffer(compiled_export), "Export failed");
+    Debug::check_assertion(compiled_export == lua_export,
+        "Compiled '" + file_name + "' differs from the Lua data file");
+
+    // A compiled file is ignored once the Lua data file changes.
+    Data outdated_data;
+    Debug::check_assertion(
+        !outdated_data.import_from_compiled_buffer(compiled_buffer, buffer + "\n"),
+        "Outdated compiled '" + file_name + "' was accepted");
+
+    // So is a truncated one.
+    Debug::check_assertion(
+        !outdated_data.import_from_compiled_buffer(
+            compiled_buffer.substr(0, compiled_buffer.size() / 2), buffer),
+        "Truncated compiled '" + file_name + "' was accepted");
+
+    // And one with a corrupt number of strings.
+    std::string corrupt_buffer = compiled_buffer;
+    corrupt_buffer.replace(20, 4, "\xFF\xFF\xFF\x7F", 4);
+    Debug::check_assertion(
+        !outdated_data.import_from_compiled_buffer(corrupt_buffer, buffer),
+        "Compiled '" + file_name + "' with a corrupt string count was accepted");
+
+    ++num_files;
+    lua_size += buffer.size();
+    compiled_size += compiled_buffer.size();
+  }
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << dir_name << ": " << num_files << " files loaded " << num_loads
+      << " times, Lua: " << lua_size << " bytes, "
+      << duration_cast<microseconds>(lua_duration).count() << " us, compiled: "
+      << compiled_size << " bytes, "
+      << duration_cast<microseconds>(compiled_duration).count() << " us" << std::endl;
+}
+
+}
+
+/**
+ * \brief Compares loading data files from Lua and from their compiled form
+ * on the testing quest.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  benchmark_resource_type<MapData>(env, ResourceType::MAP, "maps");
+  benchmark_resource_type<TilesetData>(env, ResourceType::TILESET, "tilesets");
+  benchmark_resource_type<SpriteData>(env, ResourceType::SPRITE, "sprites");
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Color.h"
+#include "solarus/lowlevel/DamageTracker.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/Surface.h"
+#include "test_tools/TestEnvironment.h"
+#include <iostream>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief A source surface drawn somewhere during a frame.
+ */
+struct Item {
+  int source;
+  Rectangle region;
+  Point position;
+};
+
+/**
+ * \brief Creates source surfaces with opaque and semi-transparent parts.
+ */
+std::vector<SurfacePtr> make_sources() {
+
+  std::vector<SurfacePtr> sources;
+  for (int i = 0; i < 4; ++i) {
+    SurfacePtr source = Surface::create(24, 24);
+    source->fill_with_color(Color(40 * i, 200, 255 - 40 * i), Rectangle(0, 0, 16, 16));
+    source->fill_with_color(Color(255, 60 * i, 0, 128), Rectangle(8, 8, 16, 16));
+    sources.push_back(source);
+  }
+  return sources;
+}
+
+/**
+ * \brief Draws a frame of the scene on a surface.
+ */
+void draw_frame(
+    const SurfacePtr& dst_surface,
+    const std::vector<SurfacePtr>& sources,
+    const std::vector<Item>& items
+) {
+  dst_surface->start_damage_recording();
+  dst_surface->fill_with_color(Color(20, 30, 40));
+  for (const Item& item : items) {
+    sources[item.source]->draw_region(item.region, dst_surface, item.position);
+  }
+  dst_surface->finish_damage_recording();
+}
+
+/**
+ * \brief Checks that a damage tracking surface shows the same pixels as a
+ * normal one while the scene changes, and redraws less.
+ */
+void test_same_pixels(TestEnvironment& /* env */) {
+
+  DamageTracker::set_enabled(true);
+  Profiler::set_enabled(true);
+
+  const int width = 160;
+  const int height = 120;
+  SurfacePtr tracked_surface = Surface::create(width, height);
+  tracked_surface->set_damage_tracked(true);
+  SurfacePtr reference_surface = Surface::create(width, height);
+
+  const std::vector<SurfacePtr> tracked_sources = make_sources();
+  const std::vector<SurfacePtr> reference_sources = make_sources();
+  std::vector<Item> items;
+  for (int i = 0; i < 10; ++i) {
+    items.push_back({ i % 4, Rectangle(0, 0, 24, 24), Point(15 * i, 11 * i) });
+  }
+
+  uint64_t num_pixels_redrawn = 0;
+  const int num_frames = 60;
+  for (int frame = 0; frame < num_frames; ++frame) {
+
+    // Move an item, animate another one and reorder sometimes.
+    items[frame % items.size()].position += Point(1, frame % 3 - 1);
+    items[3].region.set_x((frame / 4) % 2 * 8);
+    if (frame % 10 == 5) {
+      std::swap(items[1], items[2]);
+    }
+    if (frame % 15 == 7) {
+      // A source changes.
+      for (const std::vector<SurfacePtr>* sources : { &tracked_sources, &reference_sources }) {
+        (*sources)[2]->fill_with_color(Color(0, 0, frame * 4), Rectangle(4, 4, 6, 6));
+      }
+    }
+
+    Profiler::start_frame();
+    draw_frame(tracked_surface, tracked_sources, items);
+    draw_frame(reference_surface, reference_sources, items);
+    num_pixels_redrawn += Profiler::get_counter(frame, Profiler::Counter::PIXELS_REDRAWN);
+
+    Debug::check_assertion(tracked_surface->get_pixels() == reference_surface->get_pixels(),
+        "Damage tracking surface differs from the reference");
+  }
+
+  const uint64_t num_pixels = static_cast<uint64_t>(width) * height * num_frames;
+  std::cout << "Pixels redrawn: " << num_pixels_redrawn << " of " << num_pixels << std::endl;
+  Debug::check_assertion(num_pixels_redrawn < num_pixels / 2,
+      "Damage tracking redraws too much");
+
+  Profiler::quit();
+  DamageTracker::set_enabled(false);
+}
+
+/**
+ * \brief Checks that modifying a source already drawn during the frame
+ * gives the same result as immediate drawing.
+ */
+void test_source_modified(TestEnvironment& /* env */) {
+
+  DamageTracker::set_enabled(true);
+
+  SurfacePtr tracked_surface = Surface::create(64, 64);
+  tracked_surface->set_damage_tracked(true);
+  SurfacePtr reference_surface = Surface::create(64, 64);
+
+  for (int frame = 0; frame < 3; ++frame) {
+    for (const SurfacePtr& dst_surface : { tracked_surface, reference_surface }) {
+      SurfacePtr source = Surface::create(16, 16);
+      source->fill_with_color(Color::red);
+
+      dst_surface->start_damage_recording();
+      dst_surface->fill_with_color(Color::black);
+      source->draw(dst_surface, Point(4, 4));
+      source->fill_with_color(Color::blue, Rectangle(0, 0, 8, 8));
+      source->draw(dst_surface, Point(40, 40));
+      dst_surface->finish_damage_recording();
+    }
+
+    Debug::check_assertion(tracked_surface->get_pixels() == reference_surface->get_pixels(),
+        "Damage tracking surface differs after a source was modified");
+  }
+
+  DamageTracker::set_enabled(false);
+}
+
+}
+
+/**
+ * \brief Tests the damage tracking of surfaces.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_same_pixels(env);
+  test_source_modified(env);
+
+  return 0;
+}
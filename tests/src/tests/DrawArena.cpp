@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/DrawArena.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Surface.h"
+#include "test_tools/TestEnvironment.h"
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Checks that a drawing keeps what was drawn on its source surface
+ * at that time.
+ */
+void test_snapshot(TestEnvironment& /* env */) {
+
+  SurfacePtr surface = Surface::create(16, 16);
+  DrawArena::List dst_list;
+  DrawArena::List src_list;
+
+  DrawArena::add(src_list, surface, DrawArena::List(), Rectangle(0, 0, 16, 16), Point(0, 0));
+  DrawArena::add(src_list, surface, DrawArena::List(), Rectangle(0, 0, 16, 16), Point(8, 8));
+  DrawArena::add(dst_list, surface, src_list, Rectangle(0, 0, 16, 16), Point(0, 0));
+
+  // Changing the source list afterwards has no effect on the drawing.
+  DrawArena::add_fill(src_list, Color::red, Rectangle(0, 0, 4, 4));
+  Debug::check_assertion(src_list.size == 3, "Wrong source list size");
+  const DrawArena::Record& record = DrawArena::get_record(dst_list.first);
+  Debug::check_assertion(record.children.size == 2, "The drawing lost its snapshot");
+  DrawArena::clear(src_list);
+  Debug::check_assertion(DrawArena::is_empty(src_list), "The source list was not cleared");
+  Debug::check_assertion(DrawArena::get_record(dst_list.first).children.size == 2,
+      "Clearing the source list changed the drawing");
+}
+
+/**
+ * \brief Checks that the source region is clipped to the source surface.
+ */
+void test_clipping(TestEnvironment& /* env */) {
+
+  SurfacePtr surface = Surface::create(16, 16);
+  DrawArena::List list;
+  DrawArena::add(list, surface, DrawArena::List(), Rectangle(-4, 8, 32, 32), Point(10, 10));
+
+  const DrawArena::Record& record = DrawArena::get_record(list.last);
+  Debug::check_assertion(record.src_rect == Rectangle(0, 8, 16, 8), "Wrong clipped source region");
+  Debug::check_assertion(record.dst_rect.get_xy() == Point(14, 10), "Wrong clipped destination");
+}
+
+/**
+ * \brief Checks that a new frame empties all lists and reuses the memory.
+ */
+void test_frames(TestEnvironment& /* env */) {
+
+  SurfacePtr surface = Surface::create(16, 16);
+  DrawArena::List list;
+  DrawArena::List other_list;
+  DrawArena::add(other_list, surface, DrawArena::List(), Rectangle(0, 0, 16, 16), Point(0, 0));
+
+  int num_allocations = 0;
+  for (int frame = 0; frame < 3; ++frame) {
+    DrawArena::finish_frame();
+    for (int i = 0; i < 100; ++i) {
+      DrawArena::add(list, surface, DrawArena::List(), Rectangle(0, 0, 16, 16), Point(i, 0));
+    }
+    Debug::check_assertion(list.size == 100, "Previous frame not released");
+    Debug::check_assertion(DrawArena::get_num_records() == 100, "Wrong number of records");
+    Debug::check_assertion(DrawArena::is_empty(other_list), "Old list still visible");
+    if (frame == 0) {
+      num_allocations = DrawArena::get_num_allocations();
+    }
+    else {
+      Debug::check_assertion(DrawArena::get_num_allocations() == num_allocations,
+          "The memory of previous frames was not reused");
+    }
+  }
+}
+
+}
+
+/**
+ * \brief Tests the storage of accelerated drawings.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_snapshot(env);
+  test_clipping(env);
+  test_frames(env);
+
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/Entities.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/LuaContext.h"
+#include "solarus/MainLoop.h"
+#include "test_tools/TestEnvironment.h"
+#include <lua.hpp>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Draws the map entities and returns the names of the test entities
+ * in the order they were drawn.
+ * \param env The test environment.
+ * \param incremental Whether to enable the incremental draw order.
+ * \return The names of the entities drawn, separated by spaces.
+ */
+std::string get_drawing_order(TestEnvironment& env, bool incremental) {
+
+  lua_State* l = env.get_main_loop().get_lua_context().get_internal_state();
+
+  Entities::set_incremental_draw_order_enabled(incremental);
+  env.run_lua("drawn = {}\n");
+  env.get_entities().draw();
+  env.run_lua("drawn_order = table.concat(drawn, ' ')\n");
+
+  lua_getglobal(l, "drawn_order");
+  const std::string order = lua_tostring(l, -1);
+  lua_pop(l, 1);
+  return order;
+}
+
+/**
+ * \brief Checks that both ways of ordering entities draw them in the same
+ * order.
+ * \param env The test environment.
+ * \param message Error message to show if the orders are different.
+ */
+void check_same_order(TestEnvironment& env, const std::string& message) {
+
+  // Entities to draw are searched again after an update.
+  env.step();
+  const std::string sorted_order = get_drawing_order(env, false);
+  const std::string incremental_order = get_drawing_order(env, true);
+  Debug::check_assertion(!sorted_order.empty(), "No entity was drawn");
+  Debug::check_assertion(incremental_order == sorted_order,
+      message + ": '" + incremental_order + "' instead of '" + sorted_order + "'");
+}
+
+}
+
+/**
+ * \brief Checks that the incremental draw order draws entities in the same
+ * order as sorting them at each cycle, after various changes.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+  env.get_map();
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "x, y = map:get_hero():get_position()\n"
+      "entities = {}\n"
+      "for i = 1, 12 do\n"
+      "  local entity = map:create_custom_entity({\n"
+      "    name = 'draw_order_' .. i,\n"
+      "    x = x + i * 8,\n"
+      "    y = y + (i * 7) % 40,\n"
+      "    layer = 0,\n"
+      "    width = 16,\n"
+      "    height = 16,\n"
+      "    direction = 0,\n"
+      "  })\n"
+      "  entity:set_drawn_in_y_order(i % 3 ~= 0)\n"
+      "  function entity:on_pre_draw()\n"
+      "    drawn[#drawn + 1] = self:get_name()\n"
+      "  end\n"
+      "  entities[i] = entity\n"
+      "end\n"
+  );
+  check_same_order(env, "Wrong initial order");
+
+  // Entities drawn in Y order overtake others.
+  env.run_lua(
+      "entities[1]:set_position(x + 8, y + 45)\n"
+      "entities[5]:set_position(x + 40, y - 3)\n"
+      "entities[8]:set_position(x + 64, y + 18)\n"
+  );
+  check_same_order(env, "Wrong order after moving entities");
+
+  // Z order changes.
+  env.run_lua(
+      "entities[3]:bring_to_front()\n"
+      "entities[9]:bring_to_back()\n"
+  );
+  check_same_order(env, "Wrong order after changing the Z order");
+
+  // Drawing mode changes.
+  env.run_lua(
+      "entities[2]:set_drawn_in_y_order(false)\n"
+      "entities[12]:set_drawn_in_y_order(true)\n"
+  );
+  check_same_order(env, "Wrong order after changing drawing modes");
+
+  // Entities hidden, removed, created or moved to another layer.
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "entities[4]:set_enabled(false)\n"
+      "entities[7]:set_visible(false)\n"
+      "entities[10]:remove()\n"
+      "if map:get_max_layer() > 0 then\n"
+      "  entities[11]:set_layer(1)\n"
+      "end\n"
+      "local entity = map:create_custom_entity({\n"
+      "  name = 'draw_order_13',\n"
+      "  x = x + 20,\n"
+      "  y = y + 10,\n"
+      "  layer = 0,\n"
+      "  width = 16,\n"
+      "  height = 16,\n"
+      "  direction = 0,\n"
+      "})\n"
+      "function entity:on_pre_draw()\n"
+      "  drawn[#drawn + 1] = self:get_name()\n"
+      "end\n"
+      "entities[13] = entity\n"
+  );
+  check_same_order(env, "Wrong order after adding and removing entities");
+
+  Entities::set_incremental_draw_order_enabled(false);
+  env.run_lua(
+      "for _, entity in pairs(entities) do\n"
+      "  if entity:exists() then\n"
+      "    entity:remove()\n"
+      "  end\n"
+      "end\n"
+  );
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/Entities.h"
+#include "solarus/entities/EntityPool.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lua/LuaContext.h"
+#include "solarus/MainLoop.h"
+#include "test_tools/TestEnvironment.h"
+#include <lua.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Creates a burst of short-lived entities at each cycle and removes
+ * the ones of the previous cycle.
+ * \param env The test environment.
+ * \param num_frames Number of cycles to run.
+ * \return The time spent.
+ */
+std::chrono::steady_clock::duration churn(TestEnvironment& env, int num_frames) {
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "local x, y = map:get_hero():get_position()\n"
+      "burst = {}\n"
+      "function create_burst()\n"
+      "  for _, entity in ipairs(burst) do\n"
+      "    entity:remove()\n"
+      "  end\n"
+      "  burst = {}\n"
+      "  for i = 1, num_burst_entities do\n"
+      "    burst[i] = map:create_custom_entity({\n"
+      "      x = x + (i % 16) * 8,\n"
+      "      y = y + math.floor(i / 16) * 8,\n"
+      "      layer = 0,\n"
+      "      width = 8,\n"
+      "      height = 8,\n"
+      "      direction = 0,\n"
+      "    })\n"
+      "  end\n"
+      "end\n"
+  );
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_frames; ++i) {
+    env.run_lua("create_burst()\n");
+    env.step();
+  }
+  env.run_lua(
+      "for _, entity in ipairs(burst) do\n"
+      "  entity:remove()\n"
+      "end\n"
+      "burst = {}\n"
+  );
+  env.step();
+  return Clock::now() - start;
+}
+
+}
+
+/**
+ * \brief Creates and removes many entities with and without the entity
+ * pool, and checks that the pool reuses the memory of removed entities.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+  env.get_map();
+
+  lua_State* l = env.get_main_loop().get_lua_context().get_internal_state();
+
+  const int num_burst_entities = 64;
+  const int num_frames = 500;
+  lua_pushinteger(l, num_burst_entities);
+  lua_setglobal(l, "num_burst_entities");
+
+  env.run_lua(
+      "function count_custom_entities()\n"
+      "  local count = 0\n"
+      "  for _ in sol.main.get_game():get_map():get_entities_by_type('custom_entity') do\n"
+      "    count = count + 1\n"
+      "  end\n"
+      "  return count\n"
+      "end\n"
+      "num_custom_entities = count_custom_entities()\n"
+  );
+  const int num_entities_before = env.get_lua_integer("num_custom_entities");
+
+  EntityPool::set_enabled(false);
+  const std::chrono::steady_clock::duration system_duration = churn(env, num_frames);
+
+  EntityPool::set_enabled(true);
+  const std::shared_ptr<EntityPool>& pool = env.get_entities().get_entity_pool();
+  const std::chrono::steady_clock::duration pool_duration = churn(env, num_frames);
+
+  // Entities removed from the map remain usable from Lua.
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "kept = map:create_custom_entity({ name = 'kept', x = 16, y = 16, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "kept:remove()\n"
+  );
+  env.step();
+  env.run_lua(
+      "kept_exists = kept:exists() and 1 or 0\n"
+      "kept_name_ok = kept:get_name() == 'kept' and 1 or 0\n"
+      "kept = nil\n"
+      "collectgarbage()\n"
+      "num_custom_entities = count_custom_entities()\n"
+  );
+  EntityPool::set_enabled(false);
+
+  Debug::check_assertion(env.get_lua_integer("kept_exists") == 0,
+      "Removed entity still exists");
+  Debug::check_assertion(env.get_lua_integer("kept_name_ok") == 1,
+      "Removed entity is no longer usable");
+  Debug::check_assertion(env.get_lua_integer("num_custom_entities") == num_entities_before,
+      "Wrong number of entities after the churn");
+
+  // Removed entities give their memory back to the pool,
+  // so the pool only holds about two bursts.
+  const int num_pool_entities = num_frames * num_burst_entities;
+  Debug::check_assertion(pool->get_num_chunks() > 0, "Entity pool not used");
+  Debug::check_assertion(pool->get_num_chunks() < num_pool_entities / 100,
+      "Memory of removed entities was not reused");
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << num_frames << " cycles creating and removing " << num_burst_entities
+      << " entities, system allocator: "
+      << duration_cast<microseconds>(system_duration).count() << " us, entity pool: "
+      << duration_cast<microseconds>(pool_duration).count() << " us ("
+      << pool->get_num_chunks() << " chunks, "
+      << pool->get_num_blocks_used() << " blocks still used)" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/GroundGrid.h"
+#include "solarus/entities/GroundInfo.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "test_tools/TestEnvironment.h"
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief The previous per-point ground test, used as a reference.
+ */
+bool is_point_obstacle(
+    const GroundGrid& grid,
+    int x,
+    int y,
+    uint32_t obstacle_grounds) {
+
+  const Ground ground = grid.get_ground(x, y);
+  const int x_in_tile = x & 7;
+  const int y_in_tile = y & 7;
+  switch (ground) {
+
+  case Ground::WALL_TOP_RIGHT:
+  case Ground::WALL_TOP_RIGHT_WATER:
+    return y_in_tile <= x_in_tile;
+
+  case Ground::WALL_TOP_LEFT:
+  case Ground::WALL_TOP_LEFT_WATER:
+    return y_in_tile <= 7 - x_in_tile;
+
+  case Ground::WALL_BOTTOM_LEFT:
+  case Ground::WALL_BOTTOM_LEFT_WATER:
+    return y_in_tile >= x_in_tile;
+
+  case Ground::WALL_BOTTOM_RIGHT:
+  case Ground::WALL_BOTTOM_RIGHT_WATER:
+    return y_in_tile >= 7 - x_in_tile;
+
+  default:
+    return (obstacle_grounds & (1 << static_cast<int>(ground))) != 0;
+  }
+}
+
+/**
+ * \brief Tests every pixel of the border of a box with the reference.
+ */
+bool is_border_obstacle(
+    const GroundGrid& grid,
+    const Rectangle& box,
+    uint32_t obstacle_grounds) {
+
+  const int x1 = box.get_x();
+  const int x2 = x1 + box.get_width() - 1;
+  const int y1 = box.get_y();
+  const int y2 = y1 + box.get_height() - 1;
+  for (int x = x1; x <= x2; ++x) {
+    if (is_point_obstacle(grid, x, y1, obstacle_grounds) ||
+        is_point_obstacle(grid, x, y2, obstacle_grounds)) {
+      return true;
+    }
+  }
+  for (int y = y1; y <= y2; ++y) {
+    if (is_point_obstacle(grid, x1, y, obstacle_grounds) ||
+        is_point_obstacle(grid, x2, y, obstacle_grounds)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief Compares border tests of random boxes with the per-pixel reference.
+ */
+void test_against_reference(TestEnvironment& /* env */) {
+
+  uint32_t seed = 42;
+  const auto random = [&seed](int max) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<int>((seed >> 8) % max);
+  };
+
+  // Wider and higher than 64 squares to have several words per bitset.
+  const int width8 = 150;
+  const int height8 = 90;
+  GroundGrid grid(width8, height8, Ground::TRAVERSABLE);
+  Debug::check_assertion(grid.get_width8() == width8, "Wrong width");
+  Debug::check_assertion(grid.get_height8() == height8, "Wrong height");
+
+  int num_collisions = 0;
+  int num_checks = 0;
+  for (int round = 0; round < 20; ++round) {
+
+    // Mostly traversable terrain with some obstacles and diagonal walls.
+    const int num_changes = 200 + random(2000);
+    for (int i = 0; i < num_changes; ++i) {
+      const Ground ground = random(3) == 0 ?
+          Ground::TRAVERSABLE :
+          static_cast<Ground>(random(GroundGrid::num_grounds));
+      const int x8 = random(width8);
+      const int y8 = random(height8);
+      grid.set_ground8(x8, y8, ground);
+      Debug::check_assertion(grid.get_ground8(x8, y8) == ground,
+          "Ground not set");
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+      const uint32_t obstacle_grounds = static_cast<uint32_t>(random(1 << 20));
+      const int width = random(3) == 0 ? 1 + random(40) : 8 * (1 + random(64));
+      const int height = random(3) == 0 ? 1 + random(40) : 8 * (1 + random(64));
+      const int x = random(width8 * 8 - width + 1);
+      const int y = random(height8 * 8 - height + 1);
+      const Rectangle box(x, y, width, height);
+
+      const bool expected = is_border_obstacle(grid, box, obstacle_grounds);
+      const bool actual = grid.has_obstacle_on_border(box, obstacle_grounds);
+      Debug::check_assertion(actual == expected,
+          "Wrong ground collision for box " + std::to_string(x) + "," +
+          std::to_string(y) + " " + std::to_string(width) + "x" +
+          std::to_string(height));
+      if (expected) {
+        ++num_collisions;
+      }
+      ++num_checks;
+    }
+  }
+
+  Debug::check_assertion(num_collisions > 0, "No collision detected");
+  Debug::check_assertion(num_collisions < num_checks, "Only collisions detected");
+}
+
+/**
+ * \brief Checks the obstacle pixels of a single diagonal square.
+ */
+void test_diagonal_square(TestEnvironment& /* env */) {
+
+  GroundGrid grid(3, 3, Ground::TRAVERSABLE);
+  grid.set_ground8(1, 1, Ground::WALL_TOP_RIGHT);
+
+  // The top-right pixel of the square is an obstacle,
+  // the bottom-left one is not.
+  Debug::check_assertion(
+      grid.has_obstacle_on_border(Rectangle(15, 8, 1, 1), 0),
+      "Top-right pixel should be an obstacle");
+  Debug::check_assertion(
+      !grid.has_obstacle_on_border(Rectangle(8, 15, 1, 1), 0),
+      "Bottom-left pixel should not be an obstacle");
+
+  // A box whose border only crosses the traversable half.
+  Debug::check_assertion(
+      !grid.has_obstacle_on_border(Rectangle(4, 12, 8, 8), 0),
+      "Traversable half should not be an obstacle");
+
+  // Same box, but traversable ground is now an obstacle.
+  Debug::check_assertion(
+      grid.has_obstacle_on_border(Rectangle(4, 12, 8, 8),
+          1 << static_cast<int>(Ground::TRAVERSABLE)),
+      "Traversable ground should be an obstacle");
+}
+
+}
+
+/**
+ * \brief Tests the grid of tile grounds.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_against_reference(env);
+  test_diagonal_square(env);
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/CustomEntity.h"
+#include "solarus/entities/Entities.h"
+#include "solarus/entities/Hero.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "test_tools/TestEnvironment.h"
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Returns the value of a counter in the current profiling frame.
+ */
+uint64_t get_counter(Profiler::Counter counter) {
+
+  return Profiler::get_counter(Profiler::get_num_frames() - 1, counter);
+}
+
+/**
+ * \brief Checks that the ground below the hero is reused while its
+ * 8x8 square does not change and determined again when a ground modifier
+ * moves there.
+ */
+void ground_versions_test(TestEnvironment& env) {
+
+  Hero& hero = env.get_hero();
+  hero.set_xy(Point(88, 77));  // Ground point: (88, 75).
+  hero.notify_position_changed();
+  const Ground tile_ground = hero.get_ground_below();
+  const Ground modified_ground = (tile_ground == Ground::GRASS) ?
+      Ground::SHALLOW_WATER : Ground::GRASS;
+
+  Profiler::set_enabled(true);
+  Profiler::start_frame();
+
+  // Nothing changed.
+  const uint32_t version = env.get_entities().get_ground_version(hero.get_layer(), Point(88, 75));
+  hero.notify_position_changed();  // Updates the ground below.
+  const uint64_t hits = get_counter(Profiler::Counter::GROUND_BELOW_HITS);
+  Debug::check_assertion(hits >= 1, "The ground below was determined again");
+  Debug::check_assertion(get_counter(Profiler::Counter::GROUND_BELOW_MISSES) == 0,
+      "Unexpected ground miss");
+
+  // A ground modifier far away does not change the square of the hero.
+  std::shared_ptr<CustomEntity> platform =
+      env.make_entity<CustomEntity>(Point(248, 205), hero.get_layer());
+  platform->set_modified_ground(modified_ground);
+  hero.notify_position_changed();
+  Debug::check_assertion(
+      env.get_entities().get_ground_version(hero.get_layer(), Point(88, 75)) == version,
+      "Ground version changed far from the modifier");
+  Debug::check_assertion(get_counter(Profiler::Counter::GROUND_BELOW_HITS) > hits,
+      "The ground below was determined again");
+  Debug::check_assertion(get_counter(Profiler::Counter::GROUND_BELOW_MISSES) == 0,
+      "Unexpected ground miss");
+
+  // Moving the modifier below the hero changes its ground.
+  platform->set_xy(Point(88, 85));  // Bounding box: (80, 72) to (96, 88).
+  platform->notify_position_changed();
+  Debug::check_assertion(
+      env.get_entities().get_ground_version(hero.get_layer(), Point(88, 75)) != version,
+      "Ground version not changed below the modifier");
+  Debug::check_assertion(hero.get_ground_below() == modified_ground,
+      "Modified ground not detected");
+  const uint64_t misses = get_counter(Profiler::Counter::GROUND_BELOW_MISSES);
+  Debug::check_assertion(misses >= 1, "The ground below was not determined again");
+
+  // And moving it away restores the ground of tiles.
+  platform->set_xy(Point(248, 205));
+  platform->notify_position_changed();
+  Debug::check_assertion(hero.get_ground_below() == tile_ground,
+      "Ground of tiles not restored");
+  Debug::check_assertion(get_counter(Profiler::Counter::GROUND_BELOW_MISSES) > misses,
+      "The ground below was not determined again");
+
+  Profiler::set_enabled(false);
+}
+
+}
+
+/**
+ * \brief Tests for caching the ground below entities.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  ground_versions_test(env);
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/String.h"
+#include "solarus/lowlevel/System.h"
+#include "test_tools/TestEnvironment.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+const int num_frames = 50;
+const std::string profiling_file = "headless_simulation_profile.csv";
+
+/**
+ * \brief Checks that a headless run simulates exactly the requested cycles.
+ */
+void test_simulation(TestEnvironment& env) {
+
+  env.run_map("traversable");  // Returns after the simulated cycles.
+
+  Debug::check_assertion(Profiler::get_num_frames() == num_frames,
+      "Wrong number of profiled frames");
+
+  // The game was started one cycle before the simulation.
+  Debug::check_assertion(env.now() == (num_frames + 1) * System::timestep,
+      "Simulated time is not deterministic");
+}
+
+/**
+ * \brief Checks the timings exported to the profiling file.
+ */
+void test_profiling_file(TestEnvironment& /* env */) {
+
+  std::ifstream in(profiling_file.c_str());
+  Debug::check_assertion(static_cast<bool>(in), "Missing profiling file");
+
+  std::string line;
+  std::getline(in, line);
+  Debug::check_assertion(line == "frame,simulated_time,input,game_update,lua_update,entities_draw",
+      "Wrong profiling file header: '" + line + "'");
+
+  int num_lines = 0;
+  while (std::getline(in, line)) {
+    ++num_lines;
+  }
+  Debug::check_assertion(num_lines == num_frames, "Wrong number of profiled lines");
+}
+
+}
+
+/**
+ * \brief Tests the headless simulation mode and its profiling output.
+ */
+int main(int argc, char** argv) {
+
+  // Add the headless options before the quest path, which must remain last.
+  std::vector<std::string> arguments(argv, argv + argc);
+  arguments.insert(arguments.end() - 1, {
+      "-simulation-frames=" + String::to_string(num_frames),
+      "-profile=" + profiling_file
+  });
+  std::vector<char*> new_argv;
+  for (std::string& argument : arguments) {
+    new_argv.push_back(&argument[0]);
+  }
+
+  TestEnvironment env(static_cast<int>(new_argv.size()), new_argv.data());
+
+  test_simulation(env);
+  test_profiling_file(env);
+
+  return 0;
+}
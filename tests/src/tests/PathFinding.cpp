@@ -15,13 +15,19 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "solarus/entities/CustomEntity.h"
+#include "solarus/entities/Entities.h"
 #include "solarus/entities/EntityPtr.h"
+#include "solarus/entities/Ground.h"
 #include "solarus/entities/Hero.h"
 #include "solarus/entities/Npc.h"
 #include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Geometry.h"
+#include "solarus/lowlevel/Rectangle.h"
 #include "solarus/movements/PathFinding.h"
 #include "solarus/Game.h"
+#include "solarus/Map.h"
 #include "test_tools/TestEnvironment.h"
+#include <string>
 
 using namespace Solarus;
 
@@ -69,6 +75,153 @@ void npc_test(TestEnvironment& env) {
   test_path_to_hero(env, entity);
 }
 
+/**
+ * \brief Checks that paths take into account ground changes
+ * even after previous results were cached.
+ */
+void ground_change_test(TestEnvironment& env) {
+
+  CustomEntity& entity = *env.make_entity<CustomEntity>();
+  test_path_to_hero(env, entity);
+  const std::string& initial_path = PathFinding(env.get_map(), entity, env.get_hero()).compute_path();
+
+  // Surround the entity with a wall.
+  CustomEntity& wall = *env.make_entity<CustomEntity>();
+  wall.set_size(32, 32);
+  wall.set_top_left_xy(136, 96);
+  wall.notify_position_changed();
+  wall.set_modified_ground(Ground::WALL);
+
+  std::string path = PathFinding(env.get_map(), entity, env.get_hero()).compute_path();
+  Debug::check_assertion(path.empty(),
+      std::string("Unexpected path through a wall: '") + path + "'");
+
+  // Remove the wall.
+  env.get_map().get_entities().remove_entity(wall);
+  path = PathFinding(env.get_map(), entity, env.get_hero()).compute_path();
+  Debug::check_assertion(path == initial_path,
+      std::string("Unexpected path: '") + path + "', expected '" + initial_path + "'");
+}
+
+/**
+ * \brief Checks that a path found for an entity is not reused by another
+ * entity of the same type that has different obstacles.
+ */
+void entity_specific_obstacles_test(TestEnvironment& env) {
+
+  CustomEntity& blocked_entity = *env.make_entity<CustomEntity>();
+  blocked_entity.set_can_traverse_entities(EntityType::HERO, false);
+  test_path_to_hero(env, blocked_entity);
+
+  // Same type, same source and same target, but the hero is not an obstacle.
+  CustomEntity& traversing_entity = *env.make_entity<CustomEntity>();
+  traversing_entity.set_can_traverse_entities(EntityType::HERO, true);
+  test_path_to_hero(env, traversing_entity);
+}
+
+/**
+ * \brief Checks that a path found for an entity is reused by another
+ * entity with the same obstacles, until the ground changes on the path.
+ */
+void shared_path_test(TestEnvironment& env) {
+
+  Npc& first_npc = *env.make_entity<Npc>();
+  test_path_to_hero(env, first_npc);
+  const std::string& initial_path = PathFinding(env.get_map(), first_npc, env.get_hero()).compute_path();
+
+  // Block the path with an entity: only a new search can notice it.
+  CustomEntity& obstacle = *env.make_entity<CustomEntity>();
+  obstacle.set_traversable_by_entities(false);
+  obstacle.set_size(16, 16);
+  obstacle.set_top_left_xy(160, 120);
+  obstacle.notify_position_changed();
+
+  // Another NPC at the same place reuses the path of the first one.
+  Npc& second_npc = *env.make_entity<Npc>();
+  test_path_to_hero(env, second_npc);
+
+  // The ground changes far from the path: the path is still reused.
+  CustomEntity& wall = *env.make_entity<CustomEntity>();
+  wall.set_size(16, 16);
+  wall.set_top_left_xy(16, 16);
+  wall.notify_position_changed();
+  wall.set_modified_ground(Ground::WALL);
+  test_path_to_hero(env, second_npc);
+
+  // The ground changes on the path: a new search finds the obstacle.
+  env.get_map().notify_ground_changed(second_npc.get_layer(), obstacle.get_bounding_box());
+  const std::string& path = PathFinding(env.get_map(), second_npc, env.get_hero()).compute_path();
+  Debug::check_assertion(path != initial_path,
+      std::string("Unexpected path through an obstacle: '") + path + "'");
+
+  env.get_map().get_entities().remove_entity(obstacle);
+  env.get_map().get_entities().remove_entity(wall);
+}
+
+/**
+ * \brief Makes the testing quest go to another map.
+ */
+void go_to_map(TestEnvironment& env, const std::string& map_id) {
+
+  Game& game = env.get_game();
+  if (game.get_current_map().get_id() != map_id) {
+    game.set_current_map(map_id, "", Transition::Style::IMMEDIATE);
+    for (int i = 0; i < 100 && game.get_current_map().get_id() != map_id; ++i) {
+      env.step();
+    }
+  }
+  Debug::check_assertion(game.get_current_map().get_id() == map_id,
+      "Failed to go to map '" + map_id + "'");
+}
+
+/**
+ * \brief Checks that far targets are only reached in long range mode,
+ * through the only corridor of a wall that separates them.
+ */
+void long_range_test(TestEnvironment& env) {
+
+  go_to_map(env, "path_finding_corridor");
+  const Rectangle wall(0, 96, 320, 48);
+  const Rectangle corridor(256, 96, 32, 48);
+
+  Hero& hero = env.get_hero();
+  CustomEntity& entity = *env.make_entity<CustomEntity>();
+  entity.set_top_left_xy(16, 16);
+  entity.notify_position_changed();
+  hero.set_top_left_xy(40, 216);
+  hero.notify_position_changed();
+
+  PathFinding path_finder(env.get_map(), entity, hero);
+  std::string path = path_finder.compute_path();
+  Debug::check_assertion(path.empty(),
+      std::string("Unexpected path to a far target: '") + path + "'");
+
+  path_finder.set_long_range(true);
+  path = path_finder.compute_path();
+  Debug::check_assertion(!path.empty(), "Missing long range path");
+
+  // The whole path leads to the hero and only crosses the wall
+  // through the corridor.
+  Point xy = entity.get_top_left_xy();
+  bool through_corridor = false;
+  for (char direction : path) {
+    xy += Entity::direction_to_xy_move(direction - '0') * 8;
+    const Rectangle box(xy, entity.get_size());
+    if (box.overlaps(wall)) {
+      Debug::check_assertion(corridor.contains(box),
+          std::string("Long range path goes through the wall: '") + path + "'");
+      through_corridor = true;
+    }
+  }
+  Debug::check_assertion(through_corridor,
+      std::string("Long range path does not take the corridor: '") + path + "'");
+
+  const int expected_distance = hero.is_obstacle_for(entity) ? 16 : 0;
+  Debug::check_assertion(
+      Geometry::get_manhattan_distance(xy, hero.get_top_left_xy()) == expected_distance,
+      std::string("Long range path does not reach the target: '") + path + "'");
+}
+
 }
 
 /**
@@ -80,6 +233,10 @@ int main(int argc, char** argv) {
 
   custom_entity_test(env);
   npc_test(env);
+  ground_change_test(env);
+  entity_specific_obstacles_test(env);
+  shared_path_test(env);
+  long_range_test(env);
 
   return 0;
 }
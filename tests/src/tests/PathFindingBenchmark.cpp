@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/entities/CustomEntity.h"
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Geometry.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/movements/PathFinding.h"
+#include "solarus/Game.h"
+#include "solarus/Map.h"
+#include "test_tools/TestEnvironment.h"
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <map>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief The A* implementation used before PathFindingGrid, kept as a
+ * reference for comparisons.
+ *
+ * Nodes are stored in std::map objects and the open list is a sorted
+ * std::list.
+ */
+class LegacyPathFinding {
+
+  public:
+
+    LegacyPathFinding(Map& map, Entity& source_entity, Entity& target_entity):
+      map(map),
+      source_entity(source_entity),
+      target_entity(target_entity) {
+    }
+
+    std::string compute_path() {
+
+      if (!target_entity.is_obstacle_for(source_entity)) {
+        return compute_path(Point());
+      }
+
+      const std::vector<Point> offsets = {
+          Point(target_entity.get_width(), 0),
+          Point(0, -target_entity.get_height()),
+          Point(-target_entity.get_width(), 0),
+          Point(0, target_entity.get_height())
+      };
+
+      std::string best_path;
+      for (const Point& offset : offsets) {
+        std::string path = compute_path(offset);
+        if (!path.empty() && (best_path.empty() || path.size() < best_path.size())) {
+          best_path = path;
+        }
+      }
+      return best_path;
+    }
+
+  private:
+
+    struct Node {
+      Point location;
+      int index;
+      int previous_cost;
+      int heuristic;
+      int total_cost;
+      int parent_index;
+      char direction;
+    };
+
+    std::string compute_path(const Point& offset) {
+
+      Point source = source_entity.get_bounding_box().get_xy();
+      Point target = target_entity.get_bounding_box().get_xy() + offset;
+      target.x += 4;
+      target.x += -target.x % 8;
+      target.y += 4;
+      target.y += -target.y % 8;
+      const int target_index = get_square_index(target);
+
+      const int total_mdistance = Geometry::get_manhattan_distance(source, target);
+      if (total_mdistance > 200 || target_entity.get_layer() != source_entity.get_layer()) {
+        return "";
+      }
+
+      Node starting_node;
+      const int source_index = get_square_index(source);
+      starting_node.location = source;
+      starting_node.index = source_index;
+      starting_node.previous_cost = 0;
+      starting_node.heuristic = total_mdistance;
+      starting_node.total_cost = total_mdistance;
+      starting_node.direction = ' ';
+      starting_node.parent_index = -1;
+
+      open_list.clear();
+      closed_list.clear();
+      open_list_indices.clear();
+      open_list[source_index] = starting_node;
+      open_list_indices.push_front(source_index);
+
+      while (!open_list_indices.empty()) {
+
+        const int index = open_list_indices.front();
+        open_list_indices.pop_front();
+        closed_list[index] = open_list[index];
+        open_list.erase(index);
+        Node* current_node = &closed_list[index];
+
+        if (index == target_index) {
+          std::string path;
+          while (current_node->direction != ' ') {
+            path = current_node->direction + path;
+            current_node = &closed_list[current_node->parent_index];
+          }
+          return path;
+        }
+
+        for (int i = 0; i < 8; i++) {
+          Node new_node;
+          new_node.previous_cost = current_node->previous_cost + ((i & 1) ? 11 : 8);
+          new_node.location = current_node->location + neighbours_locations[i];
+          new_node.index = get_square_index(new_node.location);
+
+          if (closed_list.find(new_node.index) == closed_list.end() &&
+              Geometry::get_manhattan_distance(new_node.location, target) < 200 &&
+              is_node_transition_valid(*current_node, i)) {
+
+            if (open_list.find(new_node.index) == open_list.end()) {
+              new_node.heuristic = Geometry::get_manhattan_distance(new_node.location, target);
+              new_node.total_cost = new_node.previous_cost + new_node.heuristic;
+              new_node.parent_index = index;
+              new_node.direction = '0' + i;
+              open_list[new_node.index] = new_node;
+              add_index_sorted(open_list[new_node.index]);
+            }
+            else {
+              Node& existing_node = open_list[new_node.index];
+              if (new_node.previous_cost < existing_node.previous_cost) {
+                existing_node.previous_cost = new_node.previous_cost;
+                existing_node.total_cost = existing_node.previous_cost + existing_node.heuristic;
+                existing_node.parent_index = index;
+                open_list_indices.sort();
+              }
+            }
+          }
+        }
+      }
+      return "";
+    }
+
+    int get_square_index(const Point& location) const {
+      return (location.y / 8) * map.get_width8() + location.x / 8;
+    }
+
+    void add_index_sorted(const Node& node) {
+      for (auto it = open_list_indices.begin(); it != open_list_indices.end(); ++it) {
+        if (open_list[*it].total_cost >= node.total_cost) {
+          open_list_indices.insert(it, node.index);
+          return;
+        }
+      }
+      open_list_indices.push_back(node.index);
+    }
+
+    bool is_node_transition_valid(const Node& node, int direction) const {
+      Rectangle collision_box = transition_collision_boxes[direction];
+      collision_box.add_xy(node.location);
+      return !map.test_collision_with_obstacles(source_entity.get_layer(), collision_box, source_entity);
+    }
+
+    static const Point neighbours_locations[];
+    static const Rectangle transition_collision_boxes[];
+
+    Map& map;
+    Entity& source_entity;
+    Entity& target_entity;
+    std::map<int, Node> closed_list;
+    std::map<int, Node> open_list;
+    std::list<int> open_list_indices;
+};
+
+const Point LegacyPathFinding::neighbours_locations[] = {
+  {  8,  0 }, {  8, -8 }, {  0, -8 }, { -8, -8 },
+  { -8,  0 }, { -8,  8 }, {  0,  8 }, {  8,  8 }
+};
+
+const Rectangle LegacyPathFinding::transition_collision_boxes[] = {
+  Rectangle(16,  0,  8, 16 ),
+  Rectangle( 0, -8, 24, 24 ),
+  Rectangle( 0, -8, 16,  8 ),
+  Rectangle(-8, -8, 24, 24 ),
+  Rectangle(-8,  0,  8, 16 ),
+  Rectangle(-8,  0, 24, 24 ),
+  Rectangle( 0, 16, 16,  8 ),
+  Rectangle( 0,  0, 24, 24 )
+};
+
+/**
+ * \brief Makes the testing quest go to another map.
+ */
+void go_to_map(TestEnvironment& env, const std::string& map_id) {
+
+  Game& game = env.get_game();
+  if (game.get_current_map().get_id() != map_id) {
+    game.set_current_map(map_id, "", Transition::Style::IMMEDIATE);
+    for (int i = 0; i < 100 && game.get_current_map().get_id() != map_id; ++i) {
+      env.step();
+    }
+  }
+  Debug::check_assertion(game.get_current_map().get_id() == map_id,
+      "Failed to go to map '" + map_id + "'");
+}
+
+/**
+ * \brief Computes paths between many pairs of squares of the current map
+ * with both implementations, and compares their results and durations.
+ */
+void benchmark_map(TestEnvironment& env, const std::string& map_id) {
+
+  go_to_map(env, map_id);
+  Map& map = env.get_map();
+  CustomEntity& source = *env.make_entity<CustomEntity>();
+  CustomEntity& target = *env.make_entity<CustomEntity>();
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration legacy_duration = Clock::duration::zero();
+  Clock::duration new_duration = Clock::duration::zero();
+  int num_searches = 0;
+  int num_paths = 0;
+
+  // Deterministic pseudo-random pairs of squares,
+  // far enough from the borders to keep targets with offsets inside the map.
+  uint32_t seed = 12345;
+  const auto next_square = [&](int size) {
+    seed = seed * 1103515245 + 12345;
+    return 32 + static_cast<int>((seed >> 16) % ((size - 80) / 8)) * 8;
+  };
+
+  for (int i = 0; i < 300; ++i) {
+    source.set_top_left_xy(next_square(map.get_width()), next_square(map.get_height()));
+    source.notify_position_changed();
+    target.set_top_left_xy(next_square(map.get_width()), next_square(map.get_height()));
+    target.notify_position_changed();
+
+    Clock::time_point start = Clock::now();
+    LegacyPathFinding legacy_path_finding(map, source, target);
+    const std::string legacy_path = legacy_path_finding.compute_path();
+    legacy_duration += Clock::now() - start;
+
+    start = Clock::now();
+    PathFinding path_finding(map, source, target);
+    const std::string path = path_finding.compute_path();
+    new_duration += Clock::now() - start;
+
+    // Both are complete searches on the same graph:
+    // they must agree on whether a path exists.
+    Debug::check_assertion(path.empty() == legacy_path.empty(),
+        "Implementations disagree on path existence: '" + legacy_path + "' / '" + path + "'");
+    ++num_searches;
+    if (!path.empty()) {
+      ++num_paths;
+    }
+  }
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << "Map '" << map_id << "': " << num_searches << " searches, "
+      << num_paths << " paths found, legacy: "
+      << duration_cast<microseconds>(legacy_duration).count() << " us, new: "
+      << duration_cast<microseconds>(new_duration).count() << " us" << std::endl;
+}
+
+}
+
+/**
+ * \brief Compares the performance of the path finding algorithm with its
+ * previous implementation on maps of the testing quest.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  benchmark_map(env, "traversable");
+  benchmark_map(env, "all_entities");
+
+  return 0;
+}
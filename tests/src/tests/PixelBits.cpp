@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/PixelBits.h"
+#include "solarus/lowlevel/Point.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/Surface.h"
+#include "test_tools/TestEnvironment.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief The previous pixel collision implementation, used as a reference.
+ *
+ * One vector of 32-bit masks per row.
+ */
+class LegacyPixelBits {
+
+  public:
+
+    LegacyPixelBits(const std::string& pixels, int surface_width, const Rectangle& image_position):
+      width(image_position.get_width()),
+      height(image_position.get_height()),
+      bits(height, std::vector<uint32_t>((width + 31) / 32, 0)) {
+
+      for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+          const int index = (image_position.get_y() + i) * surface_width + image_position.get_x() + j;
+          const bool opaque = pixels[index * 4 + 3] != 0;  // RGBA.
+          if (opaque) {
+            bits[i][j >> 5] |= 0x80000000 >> (j & 31);
+          }
+        }
+      }
+    }
+
+    bool test_collision(
+        const LegacyPixelBits& other,
+        const Point& location1,
+        const Point& location2
+    ) const {
+
+      const Rectangle bounding_box1(location1.x, location1.y, width, height);
+      const Rectangle bounding_box2(location2.x, location2.y, other.width, other.height);
+      if (!bounding_box1.overlaps(bounding_box2)) {
+        return false;
+      }
+
+      const Rectangle intersection = bounding_box1.get_intersection(bounding_box2);
+      const Point offset1 = intersection.get_xy() - bounding_box1.get_xy();
+      const Point offset2 = intersection.get_xy() - bounding_box2.get_xy();
+
+      const std::vector<std::vector<uint32_t>>* rows_a = &bits;
+      const std::vector<std::vector<uint32_t>>* rows_b = &other.bits;
+      int row_a = offset1.y;
+      int row_b = offset2.y;
+      int unused_x = offset2.x;
+      if (bounding_box1.get_x() <= bounding_box2.get_x()) {
+        std::swap(rows_a, rows_b);
+        std::swap(row_a, row_b);
+        unused_x = offset1.x;
+      }
+      const int nb_unused_masks_row_b = unused_x >> 5;
+      const int nb_unused_bits_row_b = unused_x & 31;
+      const int nb_used_bits_row_b = 32 - nb_unused_bits_row_b;
+      const int nb_masks_per_row_a = (intersection.get_width() + 31) / 32;
+      const int nb_masks_per_row_b = (intersection.get_width() + nb_unused_bits_row_b + 31) / 32;
+
+      for (int i = 0; i < intersection.get_height(); ++i) {
+        const std::vector<uint32_t>& bits_a = (*rows_a)[row_a + i];
+        const std::vector<uint32_t>& bits_b = (*rows_b)[row_b + i];
+        for (int j = 0; j < nb_masks_per_row_a; ++j) {
+          const uint32_t mask_a = bits_a[j];
+          const uint32_t mask_b = bits_b[j + nb_unused_masks_row_b];
+          const uint32_t mask_a_left = mask_a >> nb_unused_bits_row_b;
+          uint32_t next_mask_b_left = 0;
+          if (j + 1 < nb_masks_per_row_a || nb_masks_per_row_b > nb_masks_per_row_a) {
+            // The shift by 32 of the original code is avoided here.
+            next_mask_b_left = nb_unused_bits_row_b == 0 ?
+                0 : bits_b[j + nb_unused_masks_row_b + 1] >> nb_used_bits_row_b;
+          }
+          if (((mask_a_left & mask_b) | (mask_a & next_mask_b_left)) != 0) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+  private:
+
+    int width;
+    int height;
+    std::vector<std::vector<uint32_t>> bits;
+};
+
+/**
+ * \brief A frame of a sprite image in both implementations.
+ */
+struct Frame {
+  Rectangle position;
+  std::shared_ptr<PixelBits> pixel_bits;
+  std::shared_ptr<LegacyPixelBits> legacy_pixel_bits;
+};
+
+/**
+ * \brief Cuts an image into frames of the given size.
+ */
+void add_frames(
+    const std::string& file_name,
+    const Size& frame_size,
+    std::vector<Frame>& frames
+) {
+  SurfacePtr surface = Surface::create(file_name);
+  Debug::check_assertion(surface != nullptr, "Cannot load image " + file_name);
+  const std::string& pixels = surface->get_pixels();
+  Debug::check_assertion(
+      pixels.size() == static_cast<size_t>(surface->get_width() * surface->get_height() * 4),
+      "Cannot read the pixels of " + file_name);
+
+  for (int y = 0; y + frame_size.height <= surface->get_height(); y += frame_size.height) {
+    for (int x = 0; x + frame_size.width <= surface->get_width(); x += frame_size.width) {
+      Frame frame;
+      frame.position = Rectangle(Point(x, y), frame_size);
+      frame.pixel_bits = std::make_shared<PixelBits>(*surface, frame.position);
+      frame.legacy_pixel_bits = std::make_shared<LegacyPixelBits>(pixels, surface->get_width(), frame.position);
+      frames.push_back(frame);
+    }
+  }
+}
+
+/**
+ * \brief Checks that both implementations detect the same collisions and
+ * compares their speed.
+ */
+void test_against_legacy(TestEnvironment& /* env */) {
+
+  std::vector<Frame> frames;
+  add_frames("hero/walking.tunic.png", Size(24, 32), frames);
+  add_frames("hero/sword.sword1.png", Size(32, 32), frames);
+  add_frames("menus/solarus_logo.png", Size(201, 91), frames);  // Wider than 64 pixels.
+  add_frames("menus/solarus_logo.png", Size(67, 45), frames);
+  Debug::check_assertion(frames.size() > 10, "Not enough frames");
+
+  // Build a deterministic list of frame pairs with overlapping boxes.
+  struct Pair {
+    const Frame* frame1;
+    const Frame* frame2;
+    Point location2;
+  };
+  std::vector<Pair> pairs;
+  uint32_t seed = 42;
+  const auto random = [&seed](int max) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<int>((seed >> 8) % max);
+  };
+  for (int i = 0; i < 20000; ++i) {
+    const Frame& frame1 = frames[random(frames.size())];
+    const Frame& frame2 = frames[random(frames.size())];
+    const Size& size1 = frame1.position.get_size();
+    const Size& size2 = frame2.position.get_size();
+    pairs.push_back({
+        &frame1,
+        &frame2,
+        Point(random(size1.width + size2.width) - size2.width,
+              random(size1.height + size2.height) - size2.height)
+    });
+  }
+
+  // Same results.
+  int num_collisions = 0;
+  for (const Pair& pair : pairs) {
+    const bool result = pair.frame1->pixel_bits->test_collision(
+        *pair.frame2->pixel_bits, Point(0, 0), pair.location2);
+    const bool expected = pair.frame1->legacy_pixel_bits->test_collision(
+        *pair.frame2->legacy_pixel_bits, Point(0, 0), pair.location2);
+    if (result != expected) {
+      std::ostringstream oss;
+      oss << "Wrong pixel collision result between " << pair.frame1->position
+          << " and " << pair.frame2->position << " at " << pair.location2
+          << ": expected " << expected << ", got " << result;
+      Debug::die(oss.str());
+    }
+    num_collisions += result ? 1 : 0;
+  }
+  Debug::check_assertion(num_collisions > 0, "No collision detected");
+  Debug::check_assertion(num_collisions < static_cast<int>(pairs.size()), "Only collisions detected");
+
+  // Compare timings.
+  using Clock = std::chrono::steady_clock;
+  using std::chrono::microseconds;
+  const int num_iterations = 20;
+  int checksum = 0;
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_iterations; ++i) {
+    for (const Pair& pair : pairs) {
+      checksum += pair.frame1->legacy_pixel_bits->test_collision(
+          *pair.frame2->legacy_pixel_bits, Point(0, 0), pair.location2) ? 1 : 0;
+    }
+  }
+  const Clock::duration legacy_time = Clock::now() - start;
+
+  start = Clock::now();
+  for (int i = 0; i < num_iterations; ++i) {
+    for (const Pair& pair : pairs) {
+      checksum -= pair.frame1->pixel_bits->test_collision(
+          *pair.frame2->pixel_bits, Point(0, 0), pair.location2) ? 1 : 0;
+    }
+  }
+  const Clock::duration time = Clock::now() - start;
+  Debug::check_assertion(checksum == 0, "Inconsistent pixel collision results");
+
+  std::cout << pairs.size() * num_iterations << " pixel collision tests: "
+      << std::chrono::duration_cast<microseconds>(legacy_time).count() << " us before, "
+      << std::chrono::duration_cast<microseconds>(time).count() << " us now" << std::endl;
+}
+
+}
+
+/**
+ * \brief Tests for pixel-precise collisions.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_against_legacy(env);
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Hq2xFilter.h"
+#include "solarus/lowlevel/Hq3xFilter.h"
+#include "solarus/lowlevel/Hq4xFilter.h"
+#include "solarus/lowlevel/Scale2xFilter.h"
+#include "solarus/third_party/hqx/hqx.h"
+#include "test_tools/TestEnvironment.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief The previous single-threaded Scale2x implementation, used as a reference.
+ */
+void legacy_scale2x(const uint32_t* src, int src_width, int src_height, uint32_t* dst) {
+
+  const int dst_width = src_width * 2;
+  int e1 = 0;
+  int e = 0;
+  for (int row = 0; row < src_height; row++) {
+    for (int col = 0; col < src_width; col++) {
+      int b = (row == 0) ? e : e - src_width;
+      int h = (row == src_height - 1) ? e : e + src_width;
+      int d = (col == 0) ? e : e - 1;
+      int f = (col == src_width - 1) ? e : e + 1;
+      int e2 = e1 + 1;
+      int e3 = e1 + dst_width;
+      int e4 = e3 + 1;
+      if (src[b] != src[h] && src[d] != src[f]) {
+        dst[e1] = src[(src[d] == src[b]) ? d : e];
+        dst[e2] = src[(src[b] == src[f]) ? f : e];
+        dst[e3] = src[(src[d] == src[h]) ? d : e];
+        dst[e4] = src[(src[h] == src[f]) ? f : e];
+      }
+      else {
+        dst[e1] = dst[e2] = dst[e3] = dst[e4] = src[e];
+      }
+      e1 += 2;
+      e++;
+    }
+    e1 += dst_width;
+  }
+}
+
+/**
+ * \brief Creates a test image that looks like pixel art:
+ * flat areas of a few colors with some noise.
+ */
+std::vector<uint32_t> make_image(int width, int height) {
+
+  const uint32_t palette[] = {
+      0xFF000000, 0xFFFFFFFF, 0xFF20A040, 0xFF3050D0,
+      0xFFD0A060, 0x00000000, 0x80FF0000, 0xFF808080
+  };
+  std::vector<uint32_t> image(width * height);
+  uint32_t seed = 1;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      seed = seed * 1103515245 + 12345;
+      int color = ((x / 8) * 3 + (y / 5) + ((x * y) / 37)) % 8;
+      if (((seed >> 16) & 15) == 0) {
+        color = (seed >> 20) % 8;
+      }
+      image[y * width + x] = palette[color];
+    }
+  }
+  return image;
+}
+
+/**
+ * \brief Checks that a filter gives the same result as its reference
+ * and prints the time of both.
+ */
+void check_filter(
+    const std::string& name,
+    const PixelFilter& filter,
+    const std::function<void(const uint32_t*, int, int, uint32_t*)>& reference,
+    int width,
+    int height
+) {
+  const std::vector<uint32_t> src = make_image(width, height);
+  const int factor = filter.get_scaling_factor();
+  std::vector<uint32_t> expected(width * height * factor * factor, 0x12345678);
+  std::vector<uint32_t> result(width * height * factor * factor, 0x87654321);
+
+  filter.filter(src.data(), width, height, result.data());  // Also initializes hqx.
+  reference(src.data(), width, height, expected.data());
+  Debug::check_assertion(result == expected, name + ": result differs from the reference");
+
+  using Clock = std::chrono::steady_clock;
+  using std::chrono::microseconds;
+  const int num_frames = 20;
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_frames; ++i) {
+    reference(src.data(), width, height, expected.data());
+  }
+  const Clock::duration reference_time = Clock::now() - start;
+
+  start = Clock::now();
+  for (int i = 0; i < num_frames; ++i) {
+    filter.filter(src.data(), width, height, result.data());
+  }
+  const Clock::duration time = Clock::now() - start;
+
+  std::cout << name << " " << width << "x" << height << ": "
+      << std::chrono::duration_cast<microseconds>(reference_time).count() / num_frames
+      << " us per frame before, "
+      << std::chrono::duration_cast<microseconds>(time).count() / num_frames
+      << " us now" << std::endl;
+}
+
+/**
+ * \brief Checks each filter on a quest-sized image and on small odd sizes.
+ */
+void test_filters(TestEnvironment& /* env */) {
+
+  const std::vector<std::pair<int, int>> sizes = {
+      { 320, 240 }, { 1, 1 }, { 1, 40 }, { 5, 3 }, { 37, 61 }
+  };
+
+  for (const std::pair<int, int>& size : sizes) {
+    const int width = size.first;
+    const int height = size.second;
+
+    check_filter("scale2x", Scale2xFilter(), legacy_scale2x, width, height);
+    check_filter("hq2x", Hq2xFilter(), [](const uint32_t* src, int width, int height, uint32_t* dst) {
+      hq2x_32(const_cast<uint32_t*>(src), dst, width, height);
+    }, width, height);
+    check_filter("hq3x", Hq3xFilter(), [](const uint32_t* src, int width, int height, uint32_t* dst) {
+      hq3x_32(const_cast<uint32_t*>(src), dst, width, height);
+    }, width, height);
+    check_filter("hq4x", Hq4xFilter(), [](const uint32_t* src, int width, int height, uint32_t* dst) {
+      hq4x_32(const_cast<uint32_t*>(src), dst, width, height);
+    }, width, height);
+  }
+}
+
+}
+
+/**
+ * \brief Tests and benchmarks for the software pixel filters.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_filters(env);
+
+  return 0;
+}
@@ -18,6 +18,9 @@
 #include "solarus/lowlevel/Debug.h"
 #include "solarus/lowlevel/Rectangle.h"
 #include "test_tools/TestEnvironment.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <memory>
 #include <sstream>
 
@@ -232,6 +235,92 @@ void test_move_limit(TestEnvironment& /* env */, Quadtree<ElementPtr>& quadtree)
   Debug::check_assertion(quadtree.get_num_elements() == num_elements, "Wrong number of elements");
 }
 
+/**
+ * \brief Tests a big quadtree of raw pointers whose elements move every frame.
+ *
+ * Query results are compared to a brute force search, and the time spent
+ * in the quadtree is printed.
+ */
+void test_many_moving_elements(TestEnvironment& /* env */) {
+
+  const int num_elements = 10000;
+  const int num_frames = 30;
+  const int num_queries = 1000;
+  const Rectangle space(0, 0, 8192, 8192);
+
+  // Simple deterministic generator to make the test reproducible.
+  uint32_t seed = 42;
+  const auto random = [&seed](int max) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<int>((seed >> 8) % max);
+  };
+
+  Quadtree<Element*> quadtree(space);
+  std::vector<std::unique_ptr<Element>> elements;
+  elements.reserve(num_elements);
+  for (int i = 0; i < num_elements; ++i) {
+    elements.emplace_back(new Element(Rectangle(
+        random(space.get_width() - 32),
+        random(space.get_height() - 32),
+        16 + random(16),
+        16 + random(16)
+    )));
+    quadtree.add(elements.back().get(), elements.back()->get_bounding_box());
+  }
+  Debug::check_assertion(quadtree.get_num_elements() == num_elements, "Wrong number of elements");
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration move_time = Clock::duration::zero();
+  Clock::duration query_time = Clock::duration::zero();
+  std::vector<Element*> found_elements;
+  std::vector<Element*> expected_elements;
+
+  for (int frame = 0; frame < num_frames; ++frame) {
+
+    // Move everything a bit.
+    Clock::time_point start = Clock::now();
+    for (const std::unique_ptr<Element>& element : elements) {
+      Rectangle& box = element->get_bounding_box();
+      box.set_xy(
+          std::max(0, std::min(space.get_width() - 32, box.get_x() + random(9) - 4)),
+          std::max(0, std::min(space.get_height() - 32, box.get_y() + random(9) - 4))
+      );
+      quadtree.move(element.get(), box);
+    }
+    move_time += Clock::now() - start;
+
+    // Make queries of the size of a typical collision check.
+    for (int i = 0; i < num_queries; ++i) {
+      const Rectangle region(random(space.get_width()), random(space.get_height()), 48, 48);
+
+      found_elements.clear();
+      start = Clock::now();
+      quadtree.get_elements(region, found_elements);
+      query_time += Clock::now() - start;
+
+      if (i % 50 == 0) {
+        expected_elements.clear();
+        for (const std::unique_ptr<Element>& element : elements) {
+          if (element->get_bounding_box().overlaps(region)) {
+            expected_elements.push_back(element.get());
+          }
+        }
+        std::sort(found_elements.begin(), found_elements.end());
+        std::sort(expected_elements.begin(), expected_elements.end());
+        Debug::check_assertion(found_elements == expected_elements,
+            "Quadtree query differs from brute force search");
+      }
+    }
+  }
+
+  using std::chrono::microseconds;
+  std::cout << num_elements << " elements, " << num_frames << " frames: "
+      << std::chrono::duration_cast<microseconds>(move_time).count() / num_frames
+      << " us moving per frame, "
+      << std::chrono::duration_cast<microseconds>(query_time).count() / num_frames
+      << " us for " << num_queries << " queries per frame" << std::endl;
+}
+
 }
 
 /**
@@ -253,6 +342,7 @@ int main(int argc, char** argv) {
   test_remove(env, quadtree);
   test_move(env, quadtree);
   test_move_limit(env, quadtree);
+  test_many_moving_elements(env);
 
   return 0;
 }
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Rectangle.h"
+#include "solarus/lowlevel/RenderQueue.h"
+#include "test_tools/TestEnvironment.h"
+
+using namespace Solarus;
+
+namespace {
+
+// Textures are only compared, never dereferenced, as long as nothing is submitted.
+int texture_a_storage = 0;
+int texture_b_storage = 0;
+SDL_Texture* const texture_a = reinterpret_cast<SDL_Texture*>(&texture_a_storage);
+SDL_Texture* const texture_b = reinterpret_cast<SDL_Texture*>(&texture_b_storage);
+
+/**
+ * \brief Adds a 16x16 copy of a texture at the given position.
+ */
+void add_copy(RenderQueue& queue, SDL_Texture* texture, int x, int y) {
+
+  queue.add_copy(texture, SDL_BLENDMODE_BLEND, 255, Rectangle(0, 0, 16, 16), Rectangle(x, y, 16, 16));
+}
+
+/**
+ * \brief Checks that copies of the same texture are grouped when nothing
+ * in between overlaps them.
+ */
+void test_disjoint_copies(TestEnvironment& /* env */) {
+
+  RenderQueue::set_batching_enabled(true);
+  RenderQueue queue;
+  add_copy(queue, texture_a, 0, 0);
+  add_copy(queue, texture_b, 20, 0);
+  add_copy(queue, texture_a, 40, 0);
+  add_copy(queue, texture_b, 60, 0);
+  queue.add_fill(0, 0, 0, 255, Rectangle(0, 20, 100, 10));
+  add_copy(queue, texture_a, 80, 0);
+
+  Debug::check_assertion(queue.get_num_commands() == 6, "Wrong number of commands");
+  Debug::check_assertion(queue.get_num_batches() == 3, "Disjoint copies were not grouped");
+}
+
+/**
+ * \brief Checks that a copy is never moved before something that it
+ * overlaps.
+ */
+void test_overlapping_copies(TestEnvironment& /* env */) {
+
+  RenderQueue::set_batching_enabled(true);
+  RenderQueue queue;
+  add_copy(queue, texture_a, 0, 0);
+  add_copy(queue, texture_b, 8, 8);
+  add_copy(queue, texture_a, 12, 12);  // Overlaps b: must stay after it.
+  add_copy(queue, texture_a, 40, 40);  // Joins the previous batch.
+  queue.add_fill(0, 0, 0, 255, Rectangle(0, 0, 100, 100));
+  add_copy(queue, texture_b, 50, 50);  // Covered by the fill.
+
+  Debug::check_assertion(queue.get_num_batches() == 5, "Overlapping copies were reordered");
+}
+
+/**
+ * \brief Checks that nothing is grouped when batching is disabled.
+ */
+void test_batching_disabled(TestEnvironment& /* env */) {
+
+  RenderQueue::set_batching_enabled(false);
+  RenderQueue queue;
+  add_copy(queue, texture_a, 0, 0);
+  add_copy(queue, texture_b, 20, 0);
+  add_copy(queue, texture_a, 40, 0);
+
+  Debug::check_assertion(queue.get_num_batches() == 3, "Copies were grouped without batching");
+}
+
+}
+
+/**
+ * \brief Tests the grouping of accelerated drawings.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_disjoint_copies(env);
+  test_overlapping_copies(env);
+  test_batching_disabled(env);
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/ResourceCache.h"
+#include "test_tools/TestEnvironment.h"
+#include <memory>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief A fake resource.
+ */
+struct Element {
+  int value;
+};
+
+constexpr ResourceType type = ResourceType::ITEM;  // Not cached by the engine.
+
+/**
+ * \brief Adds a fake resource of 400 bytes to the cache.
+ */
+void add(const std::string& id) {
+  ResourceCache::add(type, id, std::make_shared<Element>(), 400);
+}
+
+/**
+ * \brief Checks the least recently used elements are evicted first.
+ */
+void test_lru(TestEnvironment& /* env */) {
+
+  ResourceCache::set_budget(1000);
+
+  add("a");
+  add("b");
+  add("c");
+  Debug::check_assertion(!ResourceCache::contains(type, "a"), "Element a should be evicted");
+  Debug::check_assertion(ResourceCache::contains(type, "b"), "Element b should be kept");
+  Debug::check_assertion(ResourceCache::contains(type, "c"), "Element c should be kept");
+
+  Debug::check_assertion(ResourceCache::find<Element>(type, "b") != nullptr, "Missing element b");
+  Debug::check_assertion(ResourceCache::find<Element>(type, "a") == nullptr, "Unexpected element a");
+  add("d");  // c is now the least recently used one.
+  Debug::check_assertion(ResourceCache::contains(type, "b"), "Element b should be kept");
+  Debug::check_assertion(!ResourceCache::contains(type, "c"), "Element c should be evicted");
+
+  ResourceCache::Statistics statistics = ResourceCache::get_statistics(type);
+  Debug::check_assertion(statistics.hits == 1, "Wrong number of hits");
+  Debug::check_assertion(statistics.misses == 1, "Wrong number of misses");
+  Debug::check_assertion(statistics.evictions == 2, "Wrong number of evictions");
+  Debug::check_assertion(statistics.num_elements == 2, "Wrong number of elements");
+  Debug::check_assertion(statistics.memory_size == 800, "Wrong memory size");
+
+  ResourceCache::clear(type);
+}
+
+/**
+ * \brief Checks that elements in use or pinned are not evicted.
+ */
+void test_pinning(TestEnvironment& /* env */) {
+
+  ResourceCache::set_budget(1000);
+
+  add("a");
+  std::shared_ptr<Element> b = std::make_shared<Element>();
+  ResourceCache::add(type, "b", b, 400);
+  ResourceCache::set_pinned(type, "a", true);
+
+  add("c");
+  add("d");  // a and b are older but must stay.
+  Debug::check_assertion(ResourceCache::contains(type, "a"), "Pinned element a should be kept");
+  Debug::check_assertion(ResourceCache::contains(type, "b"), "Element b in use should be kept");
+  Debug::check_assertion(!ResourceCache::contains(type, "c"), "Element c should be evicted");
+  Debug::check_assertion(ResourceCache::contains(type, "d"), "Element d should be kept");
+
+  // Unpinning or releasing an element makes it evictable again.
+  b = nullptr;
+  ResourceCache::set_pinned(type, "a", false);
+  ResourceCache::set_budget(500);
+  Debug::check_assertion(!ResourceCache::contains(type, "a"), "Element a should be evicted");
+  Debug::check_assertion(!ResourceCache::contains(type, "b"), "Element b should be evicted");
+  Debug::check_assertion(ResourceCache::contains(type, "d"), "Element d should be kept");
+  Debug::check_assertion(ResourceCache::get_statistics(type).memory_size == 400, "Wrong memory size");
+
+  ResourceCache::remove(type, "d");
+  Debug::check_assertion(ResourceCache::get_statistics(type).num_elements == 0, "Elements remaining");
+  ResourceCache::clear(type);
+}
+
+}
+
+/**
+ * \brief Tests for the resource cache.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  const size_t budget = ResourceCache::get_budget();
+  test_lru(env);
+  test_pinning(env);
+  ResourceCache::set_budget(budget);
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/entities/Tileset.h"
+#include "solarus/MainLoop.h"
+#include "solarus/MapData.h"
+#include "solarus/ResourceProvider.h"
+#include "test_tools/TestEnvironment.h"
+#include <memory>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Checks that map data provided by the resource provider is the same
+ * as the one read directly from the data file.
+ */
+void check_same_map_data(const MapData& data, const std::string& map_id) {
+
+  MapData expected_data;
+  bool success = expected_data.import_from_quest_file("maps/" + map_id + ".dat");
+  Debug::check_assertion(success, "Failed to read map '" + map_id + "'");
+
+  Debug::check_assertion(data.get_tileset_id() == expected_data.get_tileset_id(), "Tileset differs");
+  Debug::check_assertion(data.get_size() == expected_data.get_size(), "Size differs");
+  Debug::check_assertion(data.get_location() == expected_data.get_location(), "Location differs");
+  Debug::check_assertion(data.get_num_entities() == expected_data.get_num_entities(), "Entities differ");
+}
+
+/**
+ * \brief Checks getting maps that were prefetched or not.
+ */
+void test_prefetch_maps(TestEnvironment& env) {
+
+  ResourceProvider& resource_provider = env.get_main_loop().get_resource_provider();
+  const std::string map_1 = "teletransportation_tests/start_scrolling";
+  const std::string map_2 = "teletransportation_tests/start_scrolling_jumping";
+  const std::string map_3 = "teletransportation_tests/start_in_hole";
+
+  resource_provider.prefetch_maps({ map_1, map_2 });
+
+  // Prefetched maps are parsed once and kept while they are wanted.
+  std::shared_ptr<const MapData> data_1 = resource_provider.get_map_data(map_1);
+  Debug::check_assertion(data_1 != nullptr, "Missing prefetched map");
+  check_same_map_data(*data_1, map_1);
+  Debug::check_assertion(resource_provider.get_map_data(map_1) == data_1, "Prefetched map parsed again");
+
+  std::shared_ptr<const MapData> data_2 = resource_provider.get_map_data(map_2);
+  Debug::check_assertion(data_2 != nullptr, "Missing prefetched map");
+  check_same_map_data(*data_2, map_2);
+
+  std::shared_ptr<const Tileset> tileset = resource_provider.get_tileset(data_2->get_tileset_id());
+  Debug::check_assertion(tileset->get_id() == data_2->get_tileset_id(), "Wrong tileset");
+  Debug::check_assertion(resource_provider.get_tileset(tileset->get_id()) == tileset, "Tileset loaded twice");
+
+  // Other maps are parsed when requested.
+  std::shared_ptr<const MapData> data_3 = resource_provider.get_map_data(map_3);
+  Debug::check_assertion(data_3 != nullptr, "Missing map");
+  check_same_map_data(*data_3, map_3);
+  Debug::check_assertion(resource_provider.get_map_data(map_3) != data_3, "Map unexpectedly cached");
+
+  // Maps no longer wanted are forgotten.
+  resource_provider.prefetch_maps({ map_2 });
+  Debug::check_assertion(resource_provider.get_map_data(map_1) != data_1, "Map not forgotten");
+  Debug::check_assertion(resource_provider.get_map_data(map_2) == data_2, "Map forgotten");
+
+  resource_provider.prefetch_maps({});
+}
+
+}
+
+/**
+ * \brief Tests for the resource provider.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_prefetch_maps(env);
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/String.h"
+#include "solarus/lua/LuaTools.h"
+#include "solarus/Savegame.h"
+#include "test_tools/TestEnvironment.h"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Reads a value like game:get_value() did with a savegame keyed
+ * by strings: checks the key, then tests each type.
+ * \return The integer or boolean value, the size of a string value or -1.
+ */
+int get_value_by_string(
+    const std::map<std::string, Savegame::SavedValue>& values,
+    const std::string& key) {
+
+  if (!LuaTools::is_valid_lua_identifier(key)) {
+    return -1;
+  }
+
+  const auto& boolean_it = values.find(key);
+  if (boolean_it != values.end() &&
+      boolean_it->second.type == Savegame::SavedValue::VALUE_BOOLEAN) {
+    return values.find(key)->second.int_data;
+  }
+  const auto& integer_it = values.find(key);
+  if (integer_it != values.end() &&
+      integer_it->second.type == Savegame::SavedValue::VALUE_INTEGER) {
+    return values.find(key)->second.int_data;
+  }
+  const auto& string_it = values.find(key);
+  if (string_it != values.end() &&
+      string_it->second.type == Savegame::SavedValue::VALUE_STRING) {
+    return static_cast<int>(values.find(key)->second.string_data.size());
+  }
+  return -1;
+}
+
+/**
+ * \brief Reads a value like game:get_value() does now.
+ * \return The integer or boolean value, the size of a string value or -1.
+ */
+int get_value_by_id(const Savegame& savegame, const std::string& key) {
+
+  const Savegame::SavedValue* value = savegame.get_saved_value(key);
+  if (value == nullptr) {
+    return LuaTools::is_valid_lua_identifier(key) ? -1 : -2;
+  }
+  if (value->type == Savegame::SavedValue::VALUE_STRING) {
+    return static_cast<int>(value->string_data.size());
+  }
+  return value->int_data;
+}
+
+}
+
+/**
+ * \brief Compares reading savegame values with the previous string keyed
+ * storage and with interned keys, with the access pattern of a HUD:
+ * a few values read at each frame from a savegame with hundreds of values.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  Savegame savegame(env.get_main_loop(), "savegame_benchmark.dat");
+  std::map<std::string, Savegame::SavedValue> values;
+
+  // A savegame with many values, named like those of real quests.
+  const int num_values = 400;
+  for (int i = 0; i < num_values; ++i) {
+    const std::string& index = String::to_string(i);
+    Savegame::SavedValue value;
+    value.int_data = 0;
+    if (i % 3 == 0) {
+      value.type = Savegame::SavedValue::VALUE_BOOLEAN;
+      value.int_data = i % 2;
+      savegame.set_boolean("dungeon_" + index + "_chest", value.int_data != 0);
+      values["dungeon_" + index + "_chest"] = value;
+    }
+    else if (i % 3 == 1) {
+      value.type = Savegame::SavedValue::VALUE_INTEGER;
+      value.int_data = i;
+      savegame.set_integer("dungeon_" + index + "_counter", i);
+      values["dungeon_" + index + "_counter"] = value;
+    }
+    else {
+      value.type = Savegame::SavedValue::VALUE_STRING;
+      value.string_data = "npc_" + index;
+      savegame.set_string("dungeon_" + index + "_dialog", value.string_data);
+      values["dungeon_" + index + "_dialog"] = value;
+    }
+  }
+
+  // The values read by the HUD at each frame, including a missing one.
+  const std::vector<std::string> hud_keys = {
+      "dungeon_1_counter", "dungeon_3_chest", "dungeon_100_counter",
+      "dungeon_200_dialog", "dungeon_299_chest", "dungeon_397_counter",
+      "dungeon_398_dialog", "dungeon_0_chest", "hud_missing_value"
+  };
+
+  using Clock = std::chrono::steady_clock;
+  const int num_frames = 20000;
+  int string_checksum = 0;
+  int id_checksum = 0;
+
+  Clock::time_point start = Clock::now();
+  for (int frame = 0; frame < num_frames; ++frame) {
+    for (const std::string& key : hud_keys) {
+      string_checksum += get_value_by_string(values, key);
+    }
+  }
+  const Clock::duration string_duration = Clock::now() - start;
+
+  start = Clock::now();
+  for (int frame = 0; frame < num_frames; ++frame) {
+    for (const std::string& key : hud_keys) {
+      id_checksum += get_value_by_id(savegame, key);
+    }
+  }
+  const Clock::duration id_duration = Clock::now() - start;
+
+  Debug::check_assertion(id_checksum == string_checksum,
+      "Interned keys give different values");
+  Debug::check_assertion(savegame.get_integer("dungeon_100_counter") == 100,
+      "Wrong integer value");
+  Debug::check_assertion(savegame.get_string("dungeon_200_dialog") == "npc_200",
+      "Wrong string value");
+  Debug::check_assertion(!savegame.get_boolean("dungeon_3_chest"),
+      "Wrong boolean value");
+  Debug::check_assertion(!savegame.is_integer("hud_missing_value"),
+      "Missing value found");
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << num_frames << " frames, " << hud_keys.size()
+      << " values read per frame, string keys: "
+      << duration_cast<microseconds>(string_duration).count() << " us, interned keys: "
+      << duration_cast<microseconds>(id_duration).count() << " us" << std::endl;
+
+  return 0;
+}
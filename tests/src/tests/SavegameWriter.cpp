@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lua/BinaryData.h"
+#include "solarus/Savegame.h"
+#include "solarus/SavegameWriter.h"
+#include "test_tools/TestEnvironment.h"
+#include <memory>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+const std::string file_name = "savegame_writer_test.dat";
+
+/**
+ * \brief Creates a savegame object and loads it from its file.
+ */
+std::shared_ptr<Savegame> load_savegame(TestEnvironment& env) {
+
+  std::shared_ptr<Savegame> savegame = std::make_shared<Savegame>(
+      env.get_main_loop(), file_name
+  );
+  savegame->initialize();
+  return savegame;
+}
+
+/**
+ * \brief Checks that a savegame has the values saved by save_values().
+ */
+void check_values(const Savegame& savegame) {
+
+  Debug::check_assertion(savegame.get_integer("counter") == 42, "Wrong integer");
+  Debug::check_assertion(savegame.get_integer("negative") == -7, "Wrong negative integer");
+  Debug::check_assertion(savegame.get_boolean("door_open"), "Wrong boolean");
+  Debug::check_assertion(savegame.get_string("name") == "Say \"hello\"", "Wrong string");
+  Debug::check_assertion(!savegame.is_integer("removed"), "Unset value was saved");
+}
+
+/**
+ * \brief Saves values in a new file, then changes some of them
+ * in a second save.
+ */
+void save_values(TestEnvironment& env) {
+
+  QuestFiles::data_file_delete(file_name);
+  std::shared_ptr<Savegame> savegame = load_savegame(env);
+  Debug::check_assertion(savegame->is_empty(), "Savegame should be new");
+
+  savegame->set_integer("counter", 1);
+  savegame->set_integer("negative", -7);
+  savegame->set_integer("removed", 3);
+  savegame->set_string("name", "Say \"hello\"");
+  savegame->save();
+
+  // Only the changes are sent the second time.
+  savegame->set_integer("counter", 42);
+  savegame->set_boolean("door_open", true);
+  savegame->unset("removed");
+  savegame->save();
+  check_values(*savegame);
+
+  SavegameWriter::flush();
+  Debug::check_assertion(QuestFiles::data_file_exists(file_name), "Savegame not written");
+  Debug::check_assertion(!QuestFiles::data_file_exists(file_name + ".tmp"),
+      "Temporary file not removed");
+}
+
+/**
+ * \brief Saves and loads a savegame in the given format.
+ */
+void test_format(TestEnvironment& env, SavegameWriter::Format format) {
+
+  SavegameWriter::set_format(format);
+  save_values(env);
+
+  const std::string& buffer = QuestFiles::data_file_read(file_name);
+  Debug::check_assertion(BinaryDataReader::is_binary_buffer(buffer) ==
+      (format == SavegameWriter::Format::BINARY), "Wrong savegame format");
+
+  std::shared_ptr<Savegame> savegame = load_savegame(env);
+  Debug::check_assertion(!savegame->is_empty(), "Savegame should exist");
+  check_values(*savegame);
+
+  // Saving again without changes gives the same file.
+  savegame->save();
+  SavegameWriter::flush();
+  Debug::check_assertion(QuestFiles::data_file_read(file_name) == buffer,
+      "Savegame changed without modifications");
+}
+
+/**
+ * \brief Destroys a savegame before the writer thread processes its save,
+ * like at shutdown.
+ */
+void test_save_then_release(TestEnvironment& env) {
+
+  QuestFiles::data_file_delete(file_name);
+
+  SavegameWriter::set_paused(true);
+  {
+    std::shared_ptr<Savegame> savegame = load_savegame(env);
+    savegame->set_integer("counter", 42);
+    savegame->set_integer("negative", -7);
+    savegame->set_boolean("door_open", true);
+    savegame->set_string("name", "Say \"hello\"");
+    savegame->save();
+  }  // The save and the release are now in the same batch.
+  SavegameWriter::set_paused(false);
+  SavegameWriter::flush();
+
+  Debug::check_assertion(QuestFiles::data_file_exists(file_name),
+      "Savegame released before being written was lost");
+  check_values(*load_savegame(env));
+}
+
+}
+
+/**
+ * \brief Tests writing and reading savegames in the Lua and binary formats.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  test_format(env, SavegameWriter::Format::LUA);
+  test_format(env, SavegameWriter::Format::BINARY);
+  test_save_then_release(env);
+
+  SavegameWriter::set_format(SavegameWriter::Format::LUA);
+  QuestFiles::data_file_delete(file_name);
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/Sound.h"
+#include "solarus/CurrentQuest.h"
+#include "solarus/ResourceCache.h"
+#include "solarus/ResourceType.h"
+#include "test_tools/TestEnvironment.h"
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Loads sounds of the quest and prints the time and memory taken.
+ * \param description What is measured.
+ * \param max_memory_size Stop loading sounds once they take this memory.
+ * \return The memory taken by the sounds loaded, in bytes.
+ */
+size_t benchmark_loading(const std::string& description, size_t max_memory_size) {
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start_time = Clock::now();
+
+  std::vector<std::shared_ptr<Sound>> sounds;
+  size_t memory_size = 0;
+  const std::map<std::string, std::string>& sound_elements =
+      CurrentQuest::get_resources(ResourceType::SOUND);
+  for (const auto& kvp : sound_elements) {
+    if (memory_size >= max_memory_size) {
+      break;
+    }
+    std::shared_ptr<Sound> sound = std::make_shared<Sound>(kvp.first);
+    sound->load();
+    memory_size += sound->get_memory_size();
+    sounds.push_back(sound);
+  }
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << description << ": " << sounds.size() << " sounds loaded in "
+      << duration_cast<microseconds>(Clock::now() - start_time).count() << " us, "
+      << memory_size / 1024 << " KB" << std::endl;
+  return memory_size;
+}
+
+}
+
+/**
+ * \brief Compares the startup time and memory of sound effects before and
+ * after lazy loading, streaming and mono sounds.
+ *
+ * Before, all sounds were decoded at startup and mono sounds were converted
+ * to stereo. Now, mono sounds stay mono, long sounds only keep their
+ * encoded data and startup loads sounds only up to the resource cache
+ * budget, the other ones being loaded when first played.
+ *
+ * This benchmark needs an audio device and does nothing if no device
+ * can be opened.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  if (!Sound::is_initialized()) {
+    std::cout << "No audio device, sound benchmark skipped" << std::endl;
+    return 0;
+  }
+
+  const bool mono_enabled = Sound::is_mono_enabled();
+  const size_t stream_threshold = Sound::get_stream_threshold();
+
+  // Before: everything decoded, in stereo.
+  Sound::set_mono_enabled(false);
+  Sound::set_stream_threshold(std::numeric_limits<size_t>::max());
+  const size_t before_size = benchmark_loading("Before, startup",
+      std::numeric_limits<size_t>::max());
+
+  // After: all sounds once played, and what startup loads.
+  Sound::set_mono_enabled(mono_enabled);
+  Sound::set_stream_threshold(stream_threshold);
+  const size_t after_size = benchmark_loading("After, all sounds",
+      std::numeric_limits<size_t>::max());
+  benchmark_loading("After, startup", ResourceCache::get_budget());
+
+  Debug::check_assertion(after_size <= before_size,
+      "Sounds take more memory than before");
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/OggDecoder.h"
+#include "solarus/lowlevel/QuestFiles.h"
+#include "solarus/lowlevel/Sound.h"
+#include "solarus/lowlevel/System.h"
+#include "test_tools/TestEnvironment.h"
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace Solarus;
+
+namespace {
+
+const std::string long_sound_id = "world_warp";       // A mono sound of 2.5 seconds.
+const std::string short_sound_id = "message_letter";  // A mono sound of 0.08 seconds.
+
+/**
+ * \brief Plays a sound and waits until it is finished.
+ * \param sound The sound to play.
+ * \param nb_instances Number of instances to play at the same time.
+ */
+void play_until_finished(Sound& sound, int nb_instances) {
+
+  for (int i = 0; i < nb_instances; ++i) {
+    Debug::check_assertion(sound.start(), "Failed to play sound");
+  }
+  Debug::check_assertion(sound.is_playing(), "Sound is not playing");
+
+  const uint32_t start_time = System::get_real_time();
+  while (sound.is_playing() && System::get_real_time() - start_time < 2000) {
+    Sound::update();
+    System::sleep(10);
+  }
+  Debug::check_assertion(!sound.is_playing(), "Sound did not finish");
+}
+
+/**
+ * \brief Checks that a sound is streamed and plays until its end.
+ * \param mono_enabled Whether mono sounds stay mono.
+ */
+void check_streamed(bool mono_enabled) {
+
+  Sound::set_mono_enabled(mono_enabled);
+  std::shared_ptr<Sound> sound = std::make_shared<Sound>(short_sound_id);
+  sound->load();
+
+  // Only the encoded data is kept in memory.
+  const size_t encoded_size = QuestFiles::data_file_read("sounds/" + short_sound_id + ".ogg").size();
+  Debug::check_assertion(sound->get_memory_size() == encoded_size,
+      "Sound was decoded instead of being streamed");
+
+  play_until_finished(*sound, 2);
+}
+
+/**
+ * \brief Decodes a long sound chunk by chunk like a stream does,
+ * without waiting for it to be played.
+ * \param stereo_output Whether to convert mono data to stereo.
+ * \param decoded_size Size of the sound when decoded at once.
+ */
+void check_decoded_by_chunks(bool stereo_output, size_t decoded_size) {
+
+  const std::shared_ptr<const std::string> data = std::make_shared<const std::string>(
+      QuestFiles::data_file_read("sounds/" + long_sound_id + ".ogg"));
+
+  // Two decoders can share the same data.
+  OggDecoder decoder;
+  OggDecoder other_decoder;
+  Debug::check_assertion(decoder.load(data, false), "Failed to load the OGG data");
+  Debug::check_assertion(other_decoder.load(data, false), "Failed to share the OGG data");
+  decoder.set_stereo_output(stereo_output);
+
+  ALuint buffer = AL_NONE;
+  alGenBuffers(1, &buffer);
+  size_t total_size = 0;
+  int nb_chunks = 0;
+  ALsizei chunk_size = 0;
+  while ((chunk_size = decoder.decode(buffer, 16384)) > 0) {
+    ALint buffer_size = 0;
+    alGetBufferi(buffer, AL_SIZE, &buffer_size);
+    Debug::check_assertion(size_t(buffer_size) == (stereo_output ? 2 : 1) * size_t(chunk_size),
+        "Wrong size of decoded chunk");
+    total_size += chunk_size;
+    ++nb_chunks;
+  }
+  alDeleteBuffers(1, &buffer);
+
+  Debug::check_assertion(nb_chunks > 4, "Sound should need several stream buffers");
+  Debug::check_assertion(total_size == decoded_size, "Sound was not decoded to its end");
+}
+
+}
+
+/**
+ * \brief Checks the conversion of mono sounds and the streaming of long sounds.
+ *
+ * This test needs an audio device. It is run with the null device of
+ * OpenAL Soft and does nothing if no device can be opened.
+ * Only short sounds are played: long ones are decoded without waiting.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  if (!Sound::is_initialized()) {
+    std::cout << "No audio device, sound test skipped" << std::endl;
+    return 0;
+  }
+
+  // Mono sounds stay mono unless mono is disabled.
+  Debug::check_assertion(Sound::is_mono_enabled(), "Mono sounds should be enabled by default");
+  std::shared_ptr<Sound> mono_sound = std::make_shared<Sound>(long_sound_id);
+  mono_sound->load();
+  Sound::set_mono_enabled(false);
+  std::shared_ptr<Sound> stereo_sound = std::make_shared<Sound>(long_sound_id);
+  stereo_sound->load();
+  Sound::set_mono_enabled(true);
+
+  Debug::check_assertion(mono_sound->get_memory_size() > 0, "Sound not decoded");
+  Debug::check_assertion(stereo_sound->get_memory_size() == 2 * mono_sound->get_memory_size(),
+      "Mono sound was not converted to stereo");
+
+  std::shared_ptr<Sound> short_sound = std::make_shared<Sound>(short_sound_id);
+  play_until_finished(*short_sound, 1);
+
+  // Decode a long sound like a stream, with and without the conversion.
+  check_decoded_by_chunks(false, mono_sound->get_memory_size());
+  check_decoded_by_chunks(true, mono_sound->get_memory_size());
+
+  // Stream a short sound, with and without the conversion.
+  const size_t stream_threshold = Sound::get_stream_threshold();
+  Sound::set_stream_threshold(0);
+  check_streamed(false);
+  check_streamed(true);
+  Sound::set_stream_threshold(stream_threshold);
+
+  return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/movements/Movement.h"
+#include "test_tools/TestEnvironment.h"
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Results of a fast movement through a detector.
+ */
+struct Results {
+  int num_hits;           /**< Collisions detected with the moving entity. */
+  int num_notifications;  /**< Calls to on_position_changed() of the movement. */
+  int num_obstacles;      /**< Calls to on_obstacle_reached() of the movement. */
+  int x;                  /**< Final x coordinate of the moving entity. */
+};
+
+/**
+ * \brief Moves an entity of several pixels per cycle through a detector.
+ * \param env The test environment.
+ * \param swept_steps Whether to enable swept steps.
+ * \return What happened.
+ */
+Results move_through_detector(TestEnvironment& env, bool swept_steps) {
+
+  Movement::set_swept_steps_enabled(swept_steps);
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "num_hits = 0\n"
+      "num_notifications = 0\n"
+      "detector = map:create_custom_entity({ x = 120, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "mover = map:create_custom_entity({ x = 64, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "detector:add_collision_test('overlapping', function(detector, other)\n"
+      "  if other == mover then\n"
+      "    num_hits = num_hits + 1\n"
+      "  end\n"
+      "end)\n"
+      "local trajectory = {}\n"
+      "for i = 1, 100 do\n"
+      "  trajectory[i] = { 1, 0 }\n"
+      "end\n"
+      "local movement = sol.movement.create('pixel')\n"
+      "movement:set_trajectory(trajectory)\n"
+      "movement:set_delay(1)\n"
+      "movement:set_ignore_obstacles(true)\n"
+      "function movement:on_position_changed()\n"
+      "  num_notifications = num_notifications + 1\n"
+      "end\n"
+      "movement:start(mover)\n"
+  );
+
+  // 10 steps of 1 pixel per cycle.
+  for (int i = 0; i < 15; ++i) {
+    env.step();
+  }
+
+  env.run_lua(
+      "mover_x = mover:get_position()\n"
+      "detector:remove()\n"
+      "mover:remove()\n"
+  );
+
+  Results results;
+  results.num_hits = env.get_lua_integer("num_hits");
+  results.num_notifications = env.get_lua_integer("num_notifications");
+  results.num_obstacles = 0;
+  results.x = env.get_lua_integer("mover_x");
+  return results;
+}
+
+/**
+ * \brief Moves an entity of several pixels per cycle towards a detector
+ * that stops its movement, with another detector behind.
+ * \param env The test environment.
+ * \param swept_steps Whether to enable swept steps.
+ * \return What happened.
+ */
+Results move_to_stopper(TestEnvironment& env, bool swept_steps) {
+
+  Movement::set_swept_steps_enabled(swept_steps);
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "num_hits = 0\n"
+      "num_notifications = 0\n"
+      "stopper = map:create_custom_entity({ x = 100, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "detector = map:create_custom_entity({ x = 120, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "mover = map:create_custom_entity({ x = 64, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "stopper:add_collision_test('overlapping', function(stopper, other)\n"
+      "  if other == mover then\n"
+      "    mover:stop_movement()\n"
+      "  end\n"
+      "end)\n"
+      "detector:add_collision_test('overlapping', function(detector, other)\n"
+      "  if other == mover then\n"
+      "    num_hits = num_hits + 1\n"
+      "  end\n"
+      "end)\n"
+      "local trajectory = {}\n"
+      "for i = 1, 100 do\n"
+      "  trajectory[i] = { 1, 0 }\n"
+      "end\n"
+      "local movement = sol.movement.create('pixel')\n"
+      "movement:set_trajectory(trajectory)\n"
+      "movement:set_delay(1)\n"
+      "movement:set_ignore_obstacles(true)\n"
+      "function movement:on_position_changed()\n"
+      "  num_notifications = num_notifications + 1\n"
+      "end\n"
+      "movement:start(mover)\n"
+  );
+
+  for (int i = 0; i < 15; ++i) {
+    env.step();
+  }
+
+  env.run_lua(
+      "mover_x = mover:get_position()\n"
+      "stopper:remove()\n"
+      "detector:remove()\n"
+      "mover:remove()\n"
+  );
+
+  Results results;
+  results.num_hits = env.get_lua_integer("num_hits");
+  results.num_notifications = env.get_lua_integer("num_notifications");
+  results.num_obstacles = 0;
+  results.x = env.get_lua_integer("mover_x");
+  return results;
+}
+
+/**
+ * \brief Moves an entity of several pixels per cycle towards a wall,
+ * with a detector that stops its movement just before the wall.
+ * \param env The test environment.
+ * \param swept_steps Whether to enable swept steps.
+ * \return What happened.
+ */
+Results move_to_stopper_before_wall(TestEnvironment& env, bool swept_steps) {
+
+  Movement::set_swept_steps_enabled(swept_steps);
+
+  env.run_lua(
+      "local map = sol.main.get_game():get_map()\n"
+      "num_notifications = 0\n"
+      "num_obstacles = 0\n"
+      "stopper = map:create_custom_entity({ x = 100, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "wall = map:create_custom_entity({ x = 104, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "mover = map:create_custom_entity({ x = 64, y = 213, layer = 0, width = 8, height = 8, direction = 0 })\n"
+      "wall:set_traversable_by(false)\n"
+      "stopper:add_collision_test('overlapping', function(stopper, other)\n"
+      "  if other == mover then\n"
+      "    mover:stop_movement()\n"
+      "  end\n"
+      "end)\n"
+      "local movement = sol.movement.create('straight')\n"
+      "movement:set_angle(0)\n"
+      "movement:set_speed(1000)\n"
+      "movement:set_smooth(false)\n"
+      "function movement:on_position_changed()\n"
+      "  num_notifications = num_notifications + 1\n"
+      "end\n"
+      "function movement:on_obstacle_reached()\n"
+      "  num_obstacles = num_obstacles + 1\n"
+      "end\n"
+      "movement:start(mover)\n"
+  );
+
+  for (int i = 0; i < 15; ++i) {
+    env.step();
+  }
+
+  env.run_lua(
+      "mover_x = mover:get_position()\n"
+      "stopper:remove()\n"
+      "wall:remove()\n"
+      "mover:remove()\n"
+  );
+
+  Results results;
+  results.num_hits = 0;
+  results.num_notifications = env.get_lua_integer("num_notifications");
+  results.num_obstacles = env.get_lua_integer("num_obstacles");
+  results.x = env.get_lua_integer("mover_x");
+  return results;
+}
+
+}
+
+/**
+ * \brief Checks that swept movement steps detect the same collisions with
+ * fewer notifications.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+  env.get_map();
+
+  const Results step_by_step = move_through_detector(env, false);
+  const Results swept = move_through_detector(env, true);
+  Movement::set_swept_steps_enabled(false);
+
+  Debug::check_assertion(step_by_step.x == 164, "The movement did not finish");
+  Debug::check_assertion(swept.x == step_by_step.x, "Swept steps changed the final position");
+  Debug::check_assertion(step_by_step.num_hits > 0, "The detector was not crossed");
+  Debug::check_assertion(swept.num_hits == step_by_step.num_hits,
+      "Swept steps changed the collisions detected");
+  Debug::check_assertion(step_by_step.num_notifications == 100,
+      "Wrong number of position notifications");
+  Debug::check_assertion(swept.num_notifications < step_by_step.num_notifications,
+      "Swept steps were not notified at once");
+
+  // A detector that stops the movement drops the remaining steps.
+  const Results stopped_step_by_step = move_to_stopper(env, false);
+  const Results stopped_swept = move_to_stopper(env, true);
+  Movement::set_swept_steps_enabled(false);
+
+  Debug::check_assertion(stopped_step_by_step.x < 100, "The movement was not stopped");
+  Debug::check_assertion(stopped_step_by_step.num_hits == 0, "The movement went past the stopper");
+  Debug::check_assertion(stopped_swept.x == stopped_step_by_step.x,
+      "Swept steps went on after the movement was stopped");
+  Debug::check_assertion(stopped_swept.num_hits == 0,
+      "Swept steps detected collisions after the movement was stopped");
+
+  // A detector that stops the movement before a wall prevents the obstacle.
+  const Results wall_step_by_step = move_to_stopper_before_wall(env, false);
+  const Results wall_swept = move_to_stopper_before_wall(env, true);
+  Movement::set_swept_steps_enabled(false);
+
+  Debug::check_assertion(wall_step_by_step.x == 93, "The movement was not stopped before the wall");
+  Debug::check_assertion(wall_step_by_step.num_obstacles == 0, "The wall was reached");
+  Debug::check_assertion(wall_swept.x == wall_step_by_step.x,
+      "Swept steps went on after the movement was stopped");
+  Debug::check_assertion(wall_swept.num_obstacles == 0,
+      "Swept steps reached the wall after the movement was stopped");
+
+  return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/FontResource.h"
+#include "solarus/lowlevel/Profiler.h"
+#include "solarus/lowlevel/Surface.h"
+#include "solarus/lowlevel/TextSurface.h"
+#include "test_tools/TestEnvironment.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Solarus;
+
+namespace {
+
+/**
+ * \brief Returns the value of a counter in the current profiler frame.
+ * \param counter The counter to get.
+ * \return Its value.
+ */
+uint64_t get_counter(Profiler::Counter counter) {
+
+  return Profiler::get_counter(Profiler::get_num_frames() - 1, counter);
+}
+
+/**
+ * \brief Reveals dialog lines letter by letter like a dialog box does.
+ * \param[in] lines The lines to show.
+ * \param[in] num_dialogs How many times to show them.
+ * \param[out] widths The width of each line once fully revealed.
+ * \return The time spent.
+ */
+std::chrono::steady_clock::duration show_dialogs(
+    const std::vector<std::string>& lines,
+    int num_dialogs,
+    std::vector<int>& widths) {
+
+  using Clock = std::chrono::steady_clock;
+
+  widths.clear();
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_dialogs; ++i) {
+    for (const std::string& line: lines) {
+      TextSurface text(0, 0);
+      text.set_font("minecraftia");
+      text.set_rendering_mode(TextSurface::RenderingMode::ANTIALIASING);
+      for (size_t size = 1; size <= line.size(); ++size) {
+        text.set_text(line.substr(0, size));
+      }
+      if (i == 0) {
+        widths.push_back(text.get_width());
+      }
+    }
+  }
+  return Clock::now() - start;
+}
+
+/**
+ * \brief Draws a text on a transparent surface of the size of the text.
+ * \param font_id The outline font to use.
+ * \param string The text to draw, revealed letter by letter.
+ * \return The surface.
+ */
+SurfacePtr draw_text(const std::string& font_id, const std::string& string) {
+
+  TextSurface text(0, 0);
+  text.set_font(font_id);
+  text.set_font_size(24);
+  text.set_alignment(
+      TextSurface::HorizontalAlignment::LEFT,
+      TextSurface::VerticalAlignment::TOP
+  );
+  text.set_rendering_mode(TextSurface::RenderingMode::ANTIALIASING);
+  text.set_text_color(Color(40, 120, 200));
+  for (size_t size = 1; size <= string.size(); ++size) {
+    text.set_text(string.substr(0, size));
+  }
+
+  SurfacePtr surface = Surface::create(text.get_size());
+  text.draw(surface);
+  return surface;
+}
+
+/**
+ * \brief Checks that glyphs of a font with left bearings are placed
+ * like in a whole-text render.
+ *
+ * Pixels where glyphs overlap may differ slightly,
+ * but misplaced glyphs would change many pixels.
+ */
+void check_same_pixels() {
+
+  const std::string string = "fjord Wavy Tj jiffy";
+
+  FontResource::set_glyph_cache_enabled(false);
+  const SurfacePtr expected_surface = draw_text("lato_italic", string);
+  FontResource::set_glyph_cache_enabled(true);
+  const SurfacePtr surface = draw_text("lato_italic", string);
+
+  const int width = std::min(surface->get_width(), expected_surface->get_width());
+  const int height = surface->get_height();
+  Debug::check_assertion(height == expected_surface->get_height(),
+      "Wrong text height with the glyph cache");
+  Debug::check_assertion(std::abs(surface->get_width() - expected_surface->get_width()) <= 2,
+      "Wrong text width with the glyph cache");
+
+  const std::string& expected_pixels = expected_surface->get_pixels();
+  const std::string& pixels = surface->get_pixels();
+  int num_different_pixels = 0;
+  int num_visible_pixels = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const size_t index = (y * surface->get_width() + x) * 4;
+      const size_t expected_index = (y * expected_surface->get_width() + x) * 4;
+      bool different = false;
+      for (int channel = 0; channel < 4; ++channel) {
+        const int difference =
+            static_cast<uint8_t>(pixels[index + channel]) -
+            static_cast<uint8_t>(expected_pixels[expected_index + channel]);
+        different = different || std::abs(difference) > 16;
+      }
+      if (different) {
+        ++num_different_pixels;
+      }
+      if (expected_pixels[expected_index + 3] != 0) {
+        ++num_visible_pixels;
+      }
+    }
+  }
+
+  Debug::check_assertion(num_visible_pixels > 0, "Nothing was drawn");
+  Debug::check_assertion(num_different_pixels * 20 < num_visible_pixels,
+      "Glyphs are not placed like in a whole-text render");
+}
+
+}
+
+/**
+ * \brief Reveals dialog lines one character after another with and
+ * without the glyph cache, and compares the results and the times.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+
+  const std::vector<std::string> lines = {
+      "Welcome to the village of Lorem Ipsum!",
+      "The old man near the well knows the way to the temple,",
+      "but he will only tell you if you bring him a bottle of milk.",
+  };
+  const int num_dialogs = 20;
+
+  Profiler::set_enabled(true);
+
+  FontResource::set_glyph_cache_enabled(false);
+  std::vector<int> widths;
+  const std::chrono::steady_clock::duration uncached_duration =
+      show_dialogs(lines, num_dialogs, widths);
+
+  FontResource::set_glyph_cache_enabled(true);
+  Profiler::start_frame();
+  std::vector<int> cached_widths;
+  const std::chrono::steady_clock::duration cached_duration =
+      show_dialogs(lines, num_dialogs, cached_widths);
+  const uint64_t hits = get_counter(Profiler::Counter::GLYPH_CACHE_HITS);
+  const uint64_t misses = get_counter(Profiler::Counter::GLYPH_CACHE_MISSES);
+
+  // The last pixel column of a glyph may be counted differently.
+  for (size_t i = 0; i < lines.size(); ++i) {
+    Debug::check_assertion(std::abs(cached_widths[i] - widths[i]) <= 2,
+        "Wrong text width with the glyph cache");
+  }
+  Debug::check_assertion(misses > 0, "No glyph was rendered");
+  Debug::check_assertion(misses <= 128, "Glyphs were rendered several times");
+  Debug::check_assertion(hits > misses, "Glyphs were not reused");
+
+  // Replacing a text by a different one draws it again.
+  TextSurface text(0, 0);
+  text.set_font("minecraftia");
+  text.set_text("Hello");
+  const int hello_width = text.get_width();
+  text.set_text("Hello world");
+  Debug::check_assertion(text.get_width() > hello_width, "Text not extended");
+  text.set_text("Hello");
+  Debug::check_assertion(text.get_width() == hello_width, "Text not redrawn");
+
+  check_same_pixels();
+
+  FontResource::set_glyph_cache_enabled(false);
+  Profiler::quit();
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << num_dialogs * lines.size() << " lines revealed letter by letter, without glyph cache: "
+      << duration_cast<microseconds>(uncached_duration).count() << " us, with glyph cache: "
+      << duration_cast<microseconds>(cached_duration).count() << " us ("
+      << hits << " hits, " << misses << " misses)" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2006-2015 Christopho, Solarus - http://www.solarus-games.org
+ *
+ * Solarus is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Solarus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "solarus/lowlevel/Debug.h"
+#include "solarus/lowlevel/System.h"
+#include "solarus/lua/LuaContext.h"
+#include "solarus/MainLoop.h"
+#include "test_tools/TestEnvironment.h"
+#include <lua.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace Solarus;
+
+/**
+ * \brief Runs hundreds of long timers attached to many contexts, like
+ * entities waiting for their next action, together with a few short
+ * repeating timers, and measures the cost of updating and stopping them.
+ */
+int main(int argc, char** argv) {
+
+  TestEnvironment env(argc, argv);
+  env.get_map();  // Start a game so that timers behave like in a quest.
+
+  lua_State* l = env.get_main_loop().get_lua_context().get_internal_state();
+
+  const int num_contexts = 500;
+  const int num_short_timers = 10;
+  lua_pushinteger(l, num_contexts);
+  lua_setglobal(l, "num_contexts");
+  lua_pushinteger(l, num_short_timers);
+  lua_setglobal(l, "num_short_timers");
+  env.run_lua(
+      "num_long_calls = 0\n"
+      "num_short_calls = 0\n"
+      "contexts = {}\n"
+      "first_timers = {}\n"
+      "for i = 1, num_contexts do\n"
+      "  local context = {}\n"
+      "  contexts[i] = context\n"
+      "  for j = 1, 4 do\n"
+      "    local timer = sol.timer.start(context, 1000000 + i * 10 + j, function()\n"
+      "      num_long_calls = num_long_calls + 1\n"
+      "    end)\n"
+      "    if j == 1 then\n"
+      "      first_timers[i] = timer\n"
+      "    end\n"
+      "  end\n"
+      "end\n"
+      "for i = 1, num_short_timers do\n"
+      "  sol.timer.start(sol.main, 100, function()\n"
+      "    num_short_calls = num_short_calls + 1\n"
+      "    return true\n"
+      "  end)\n"
+      "end\n"
+  );
+
+  using Clock = std::chrono::steady_clock;
+  const int num_frames = 5000;
+
+  Clock::time_point start = Clock::now();
+  for (int frame = 0; frame < num_frames; ++frame) {
+    env.step();
+  }
+  const Clock::duration update_duration = Clock::now() - start;
+
+  // Each short timer expires every 100 ms.
+  const int num_expirations = num_frames * System::timestep / 100;
+  const int num_short_calls = env.get_lua_integer("num_short_calls");
+  Debug::check_assertion(
+      num_short_calls >= num_short_timers * (num_expirations - 1) &&
+      num_short_calls <= num_short_timers * num_expirations,
+      "Wrong number of repeating timer calls");
+  Debug::check_assertion(env.get_lua_integer("num_long_calls") == 0,
+      "Long timer finished too early");
+
+  // Stop the timers of half of the contexts.
+  start = Clock::now();
+  env.run_lua(
+      "for i = 1, #contexts / 2 do\n"
+      "  sol.timer.stop_all(contexts[i])\n"
+      "end\n"
+  );
+  env.step();
+  const Clock::duration stop_duration = Clock::now() - start;
+
+  env.run_lua(
+      "stopped_remaining = first_timers[1]:get_remaining_time()\n"
+      "running_remaining = first_timers[#first_timers]:get_remaining_time()\n"
+  );
+  Debug::check_assertion(env.get_lua_integer("stopped_remaining") == 0,
+      "Stopped timer is still running");
+  Debug::check_assertion(env.get_lua_integer("running_remaining") > 0,
+      "Timer of another context was stopped");
+
+  // Make a long timer expire earlier than scheduled.
+  env.run_lua("first_timers[#first_timers]:set_remaining_time(50)\n");
+  for (int frame = 0; frame < 10; ++frame) {
+    env.step();
+  }
+  Debug::check_assertion(env.get_lua_integer("num_long_calls") == 1,
+      "Rescheduled timer did not finish");
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::cout << num_frames << " frames, " << num_contexts * 4 + num_short_timers
+      << " timers, update: "
+      << duration_cast<microseconds>(update_duration).count() << " us, stopping "
+      << num_contexts / 2 << " contexts: "
+      << duration_cast<microseconds>(stop_duration).count() << " us" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+-- Tests for events defined on userdata and on the metatable of their type.
+
+local map = ...
+
+local custom_entity_meta = sol.main.get_metatable("custom_entity")
+local map_meta = sol.main.get_metatable("map")
+local num_updates = 0
+local num_meta_updates = 0
+local num_position_changes = 0
+local num_meta_position_changes = 0
+local num_map_updates = 0
+
+local function meta_on_update()
+  num_meta_updates = num_meta_updates + 1
+end
+
+function map:on_started()
+
+  -- Events defined on the userdata itself.
+  function observer:on_update()
+    num_updates = num_updates + 1
+  end
+
+  function observer:on_position_changed()
+    num_position_changes = num_position_changes + 1
+  end
+
+  observer:set_position(32, 61)
+  assert(num_position_changes == 1)
+
+  observer.on_position_changed = nil
+  observer:set_position(40, 61)
+  assert(num_position_changes == 1)
+
+  -- Event defined on the metatable of the type.
+  custom_entity_meta.on_update = meta_on_update
+
+  sol.timer.start(map, 100, function()
+
+    assert(num_updates > 0)
+    assert(num_meta_updates > 0)
+
+    -- Remove both events.
+    observer.on_update = nil
+    custom_entity_meta.on_update = nil
+    num_updates = 0
+    num_meta_updates = 0
+
+    sol.timer.start(map, 100, function()
+
+      assert(num_updates == 0)
+      assert(num_meta_updates == 0)
+
+      -- Define the metatable event again: both entities now get it.
+      custom_entity_meta.on_update = meta_on_update
+
+      sol.timer.start(map, 100, function()
+        assert(num_updates == 0)
+        assert(num_meta_updates > 0)
+        custom_entity_meta.on_update = nil
+
+        -- Metatable events defined with rawset().
+        rawset(custom_entity_meta, "on_position_changed", function()
+          num_meta_position_changes = num_meta_position_changes + 1
+        end)
+        observer:set_position(48, 61)
+        assert(num_meta_position_changes == 1)
+        custom_entity_meta.on_position_changed = nil
+        rawset(custom_entity_meta, "on_update", meta_on_update)
+        num_meta_updates = 0
+
+        -- Metatable event defined after its metatable was replaced.
+        local map_meta_meta = getmetatable(map_meta)
+        setmetatable(map_meta, {
+          __newindex = function(meta, key, value)
+            rawset(meta, key, value)
+          end
+        })
+        map_meta.on_update = function()
+          num_map_updates = num_map_updates + 1
+        end
+
+        sol.timer.start(map, 100, function()
+          assert(num_meta_updates > 0)
+          assert(num_map_updates > 0)
+          custom_entity_meta.on_update = nil
+          map_meta.on_update = nil
+          setmetatable(map_meta, map_meta_meta)
+          sol.main.exit()
+        end)
+      end)
+    end)
+  end)
+end
@@ -0,0 +1,45 @@
+-- Tests for path finding movements towards far targets.
+
+local map = ...
+local hero = map:get_hero()
+
+-- Makes the chaser follow the hero from the other side of the map
+-- and checks that it gets closer.
+local function check_chases_far_hero(callback)
+
+  chaser:set_position(24, 61)
+  hero:set_position(296, 221)
+  local initial_distance = chaser:get_distance(hero)
+  assert(initial_distance > 300)
+
+  local movement = sol.movement.create("path_finding")
+  movement:set_long_range(true)
+  movement:set_target(hero)
+  movement:set_speed(96)
+  movement:start(chaser)
+
+  sol.timer.start(map, 1000, function()
+    assert(chaser:get_distance(hero) < initial_distance - 48)
+    chaser:stop_movement()
+    callback()
+  end)
+end
+
+function map:on_started()
+
+  local movement = sol.movement.create("path_finding")
+  assert(not movement:is_long_range())
+  movement:set_long_range()
+  assert(movement:is_long_range())
+  movement:set_long_range(false)
+  assert(not movement:is_long_range())
+
+  check_chases_far_hero(function()
+
+    -- Entities that modify the ground see their own terrain.
+    chaser:set_modified_ground("traversable")
+    check_chases_far_hero(function()
+      sol.main.exit()
+    end)
+  end)
+end